@@ -1,8 +1,8 @@
 
 core.log("info", "Initializing Asynchronous environment")
 
-function core.job_processor(serialized_func, serialized_param)
-	local func = loadstring(serialized_func)
+-- func is loaded by engine from bytecode of core.handle_async
+function core.job_processor(func, serialized_param)
 	local param = core.deserialize(serialized_param)
 	local retval = nil
 
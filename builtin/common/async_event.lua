@@ -19,8 +19,13 @@ else
 end
 
 function core.handle_async(func, parameter, callback)
-	-- Serialize function
-	local serialized_func = string.dump(func)
+	assert(type(func) == "function")
+
+	-- Serialize function, server dumps it by itself
+	local serialized_func = func
+	if INIT ~= "game" then
+		serialized_func = string.dump(func)
+	end
 
 	assert(serialized_func ~= nil)
 
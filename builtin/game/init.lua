@@ -8,6 +8,7 @@ dofile(commonpath.."vector.lua")
 dofile(gamepath.."constants.lua")
 dofile(gamepath.."item.lua")
 dofile(gamepath.."register.lua")
+dofile(commonpath.."async_event.lua")
 
 if core.setting_getbool("mod_profiling") then
 	dofile(gamepath.."mod_profiling.lua")
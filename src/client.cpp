@@ -1469,6 +1469,36 @@ void Client::addNode(v3s16 p, MapNode n, bool remove_metadata, int fast)
 	}
 }
 
+void Client::addNodesDelta(v3POS blockpos, const std::vector<NodeDelta> &nodes)
+{
+	std::map<v3s16, MapBlock*> modified_blocks;
+	const v3POS blockpos_nodes = blockpos * MAP_BLOCKSIZE;
+
+	for (const auto & delta : nodes) {
+		if (delta.index >= MAP_BLOCKSIZE * MAP_BLOCKSIZE * MAP_BLOCKSIZE)
+			continue;
+		v3POS p = blockpos_nodes + v3POS(
+				delta.index % MAP_BLOCKSIZE,
+				delta.index / MAP_BLOCKSIZE % MAP_BLOCKSIZE,
+				delta.index / (MAP_BLOCKSIZE * MAP_BLOCKSIZE));
+		try {
+			if (delta.action == NODE_DELTA_REMOVE)
+				m_env.getMap().removeNodeAndUpdate(p, modified_blocks, 2);
+			else
+				m_env.getMap().addNodeAndUpdate(p, MapNode(delta.param0, delta.param1, delta.param2),
+						modified_blocks, delta.action == NODE_DELTA_ADD, 2);
+		}
+		catch(InvalidPositionException &e) {
+		}
+	}
+
+	addUpdateMeshTaskWithEdge(blockpos, true);
+	for (auto & i : modified_blocks) {
+		if (i.first != blockpos)
+			addUpdateMeshTaskWithEdge(i.first, true);
+	}
+}
+
 void Client::setPlayerControl(PlayerControl &control)
 {
 	LocalPlayer *player = m_env.getLocalPlayer();
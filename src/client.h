@@ -358,6 +358,7 @@ class Client : public con::PeerHandler, public InventoryManager, public IGameDef
 	void handleCommand_AccessDenied(NetworkPacket* pkt);
 	void handleCommand_RemoveNode(NetworkPacket* pkt);
 	void handleCommand_AddNode(NetworkPacket* pkt);
+	void handleCommand_NodesDelta(NetworkPacket* pkt);
 	void handleCommand_BlockData(NetworkPacket* pkt);
 	void handleCommand_Inventory(NetworkPacket* pkt);
 	void handleCommand_TimeOfDay(NetworkPacket* pkt);
@@ -428,6 +429,8 @@ class Client : public con::PeerHandler, public InventoryManager, public IGameDef
 	// Causes urgent mesh updates (unlike Map::add/removeNodeWithEvent)
 	void removeNode(v3s16 p, int fast = 0);
 	void addNode(v3s16 p, MapNode n, bool remove_metadata = true, int fast = 0);
+	// All changes of one block, one mesh update per touched block
+	void addNodesDelta(v3POS blockpos, const std::vector<NodeDelta> &nodes);
 
 	void setPlayerControl(PlayerControl &control);
 
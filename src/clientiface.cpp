@@ -35,6 +35,7 @@ along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
 #include "serverobject.h"              // TODO this is used for cleanup of only
 #include "log_types.h"
 #include "util/srp.h"
+#include "threading/mutex_auto_lock.h"
 
 #include "util/numeric.h"
 #include "util/mathconstants.h"
@@ -128,12 +129,19 @@ int RemoteClient::GetNextBlocks (
 	m_nearest_unsent_reset_timer += dtime;
 	m_time_from_building += dtime;
 
+	bool fill = false;
 	if (m_nearest_unsent_reset) {
 		m_nearest_unsent_reset = 0;
-		m_nearest_unsent_reset_timer = 999;
+		fill = true;
 		m_nothing_to_send_pause_timer = 0;
 	}
 
+	{
+		MutexAutoLock lock(m_blocks_not_sent_mutex);
+		if (!m_blocks_not_sent.empty())
+			m_nothing_to_send_pause_timer = 0;
+	}
+
 	if(m_nothing_to_send_pause_timer >= 0)
 		return 0;
 
@@ -146,15 +154,6 @@ int RemoteClient::GetNextBlocks (
 	v3f playerspeed = player->getSpeed();
 	if(playerspeed.getLength() > 1000.0*BS) //cheater or bug, ignore him
 		return 0;
-	v3f playerspeeddir(0,0,0);
-	if(playerspeed.getLength() > 1.0*BS)
-		playerspeeddir = playerspeed / playerspeed.getLength();
-	// Predict to next block
-	v3f playerpos_predicted = playerpos + playerspeeddir*MAP_BLOCKSIZE*BS;
-
-	v3s16 center_nodepos = floatToInt(playerpos_predicted, BS);
-
-	v3s16 center = getNodeBlockPos(center_nodepos);
 
 	// Camera position and direction
 	v3f camera_pos = player->getEyePosition();
@@ -164,41 +163,8 @@ int RemoteClient::GetNextBlocks (
 
 	//infostream<<"camera_dir=("<<camera_dir<<")"<< " camera_pos="<<camera_pos<<std::endl;
 
-	/*
-		Get the starting value of the block finder radius.
-	*/
-
-	if(m_last_center != center)
-	{
-		m_last_center = center;
-		m_nearest_unsent_reset_timer = 999;
-	}
-
-	if (m_last_direction.getDistanceFrom(camera_dir)>0.4) { // 1 = 90deg
-		m_last_direction = camera_dir;
-		m_nearest_unsent_reset_timer = 999;
-	}
-
-	/*infostream<<"m_nearest_unsent_reset_timer="
-			<<m_nearest_unsent_reset_timer<<std::endl;*/
-
-	// Reset periodically to workaround for some bugs or stuff
-	if(m_nearest_unsent_reset_timer > 120.0)
-	{
-		m_nearest_unsent_reset_timer = 0;
-		m_nearest_unsent_d = 0;
-		m_nearest_unsent_reset = 0;
-		//infostream<<"Resetting m_nearest_unsent_d for "<<peer_id<<std::endl;
-	}
-
-	//s16 last_nearest_unsent_d = m_nearest_unsent_d;
-	s16 d_start = m_nearest_unsent_d;
-
-	//infostream<<"d_start="<<d_start<<std::endl;
-
 	static const u16 max_simul_sends_setting = g_settings->getU16
 			("max_simultaneous_block_sends_per_client");
-	static const u16 max_simul_sends_usually = max_simul_sends_setting;
 
 	/*
 		Check the time from last addNode/removeNode.
@@ -206,35 +172,16 @@ int RemoteClient::GetNextBlocks (
 		Decrease send rate if player is building stuff.
 	*/
 	static const auto full_block_send_enable_min_time_from_building = g_settings->getFloat("full_block_send_enable_min_time_from_building");
-	if(m_time_from_building < full_block_send_enable_min_time_from_building)
-	{
-		/*
-		max_simul_sends_usually
-			= LIMITED_MAX_SIMULTANEOUS_BLOCK_SENDS;
-		*/
-		if(d_start<=1)
-			d_start=2;
+	bool building = m_time_from_building < full_block_send_enable_min_time_from_building;
+	bool building_ended = false;
+	if (building) {
 		++m_nearest_unsent_reset_want;
 	} else if (m_nearest_unsent_reset_want) {
 		m_nearest_unsent_reset_want = 0;
-		m_nearest_unsent_reset_timer = 999; //magical number more than ^ other number 120 - need to reset d on next iteration
+		// Skipped near blocks are queued again
+		building_ended = true;
 	}
 
-	/*
-		Number of blocks sending + number of blocks selected for sending
-	*/
-	u32 num_blocks_selected = 0;
-	u32 num_blocks_sending = 0;
-
-	/*
-		next time d will be continued from the d from which the nearest
-		unsent block was found this time.
-
-		This is because not necessarily any of the blocks found this
-		time are actually sent.
-	*/
-	s32 new_nearest_unsent_d = -1;
-
 	static const auto max_block_send_distance = g_settings->getS16("max_block_send_distance");
 	s16 full_d_max = max_block_send_distance;
 	if (wanted_range) {
@@ -243,25 +190,8 @@ int RemoteClient::GetNextBlocks (
 			full_d_max = wanted_blocks;
 	}
 
-	s16 d_max = full_d_max;
 	static const s16 d_max_gen = g_settings->getS16("max_block_generate_distance");
 
-	// Don't loop very much at a time
-	s16 max_d_increment_at_time = 10;
-	if(d_max > d_start + max_d_increment_at_time)
-		d_max = d_start + max_d_increment_at_time;
-	/*if(d_max_gen > d_start+2)
-		d_max_gen = d_start+2;*/
-
-	//infostream<<"Starting from "<<d_start<<std::endl;
-
-	s32 nearest_emerged_d = -1;
-	s32 nearest_emergefull_d = -1;
-	s32 nearest_sent_d = -1;
-	//bool queue_is_full = false;
-
-	f32 speed_in_blocks = (playerspeed/(MAP_BLOCKSIZE*BS)).getLength();
-
 	int num_blocks_air = 0;
 	int blocks_occlusion_culled = 0;
 	static const bool server_occlusion = g_settings->getBool("server_occlusion");
@@ -281,324 +211,262 @@ int RemoteClient::GetNextBlocks (
 	if(n && nodemgr->get(n).solidness == 2)
 		occlusion_culling_enabled = false;
 
-	unordered_map_v3POS<bool> occlude_cache;
-
-	s16 d;
-	for(d = d_start; d <= d_max; d++) {
-		/*errorstream<<"checking d="<<d<<" for "
-				<<server->getPlayerName(peer_id)<<std::endl;*/
-		//infostream<<"RemoteClient::SendBlocks(): d="<<d<<" d_start="<<d_start<<" d_max="<<d_max<<" d_max_gen="<<d_max_gen<<std::endl;
+	/*
+		Update send queue with current view
+	*/
+	BlockSendQueue::View view;
+	view.center = getNodeBlockPos(cam_pos_nodes);
+	view.range = full_d_max;
+	view.camera_pos = camera_pos;
+	view.camera_dir = camera_dir;
+	view.camera_fov = ((fov+5)*M_PI/180) * 4./3.;
+	// Where player will be when blocks selected now are received
+	view.motion = playerspeed * 2;
+	float motion_max = full_d_max * MAP_BLOCKSIZE * BS / 2;
+	if (view.motion.getLength() > motion_max)
+		view.motion.setLength(motion_max);
+	// Sunlight: player is on surface, ground hides blocks below.
+	// Dark below sea level: player is in cave, ground hides blocks above.
+	if (n) {
+		u8 light = n.getLight(LIGHTBANK_DAY, nodemgr);
+		if (light == LIGHT_SUN)
+			view.ground = 1;
+		else if (light < LIGHT_MAX / 2 && cam_pos_nodes.Y < -MAP_BLOCKSIZE)
+			view.ground = -1;
+	}
 
-		std::vector<v3POS> list;
-		if (d > 2 && d == d_start && !m_nearest_unsent_reset_want && m_nearest_unsent_reset_timer != 999) { // oops, again magic number from up ^
-			list.push_back(v3POS(0,0,0));
-		}
+	bool rescore = m_send_queue.setView(view) || building_ended;
+	if (fill || (!m_send_queue.queued() && !m_send_queue.scoring()
+			&& m_nearest_unsent_reset_timer > 10)) {
+		// Catch changes of blocks nobody told about
+		m_nearest_unsent_reset_timer = 0;
+		m_send_queue.fill();
+		g_profiler->add("SMap: Send queue fill", 1);
+	} else if (rescore) {
+		m_send_queue.rescore();
+		g_profiler->add("SMap: Send queue rescore", 1);
+	} else {
+		m_send_queue.requeue();
+	}
 
-		bool can_skip = d > 1;
-		// Fast fall/move optimize. speed_in_blocks now limited to 6.4
-		if (speed_in_blocks>0.8 && d <= 2) {
-			can_skip = false;
-			if (d == 0) {
-				for(s16 addn = 0; addn < (speed_in_blocks+1)*2; ++addn)
-					list.push_back(floatToInt(playerspeeddir*addn, 1));
-			} else if (d == 1) {
-				for(s16 addn = 0; addn < (speed_in_blocks+1)*1.5; ++addn) {
-					list.push_back(floatToInt(playerspeeddir*addn, 1) + v3POS( 0,  0,  1)); // back
-					list.push_back(floatToInt(playerspeeddir*addn, 1) + v3POS( -1, 0,  0)); // left
-					list.push_back(floatToInt(playerspeeddir*addn, 1) + v3POS( 1,  0,  0)); // right
-					list.push_back(floatToInt(playerspeeddir*addn, 1) + v3POS( 0,  0, -1)); // front
-				}
-			} else if (d == 2) {
-				for(s16 addn = 0; addn < (speed_in_blocks+1)*1.5; ++addn) {
-					list.push_back(floatToInt(playerspeeddir*addn, 1) + v3POS( -1, 0,  1)); // back left
-					list.push_back(floatToInt(playerspeeddir*addn, 1) + v3POS( 1,  0,  1)); // left right
-					list.push_back(floatToInt(playerspeeddir*addn, 1) + v3POS( -1, 0, -1)); // right left
-					list.push_back(floatToInt(playerspeeddir*addn, 1) + v3POS( 1,  0, -1)); // front right
-				}
-			}
-		} else {
-		/*
-			Get the border/face dot coordinates of a "d-radiused"
-			box
-		*/
-			list = FacePositionCache::getFacePositions(d);
+	{
+		std::vector<v3POS> blocks_not_sent;
+		{
+			MutexAutoLock lock(m_blocks_not_sent_mutex);
+			blocks_not_sent.swap(m_blocks_not_sent);
 		}
+		for (const auto &p : blocks_not_sent)
+			m_send_queue.add(p);
+	}
 
+	// Scoring after fill or rescore is spread over steps, nearest first
+	static const u32 max_scores = 5000;
+	g_profiler->add("SMap: Send queue scores", m_send_queue.scoreNext(max_scores));
 
-		for(auto li=list.begin(); li!=list.end(); ++li)
-		{
-			v3POS p = *li + center;
+	/*
+		Number of blocks selected for sending
+	*/
+	u32 num_blocks_selected = 0;
 
-			/*
-				Send throttling
-				- Don't allow too many simultaneous transfers
-				- EXCEPT when the blocks are very close
+	// Don't check very much at a time
+	static const u32 max_checks = 1000;
+	u32 checks = 0;
 
-				Also, don't send blocks that are already flying.
-			*/
+	unordered_map_v3POS<bool> occlude_cache;
 
-			// Start with the usual maximum
-			u16 max_simul_dynamic = max_simul_sends_usually;
+	BlockSendQueue::Candidate candidate;
+	while (num_blocks_selected < max_simul_sends_setting && checks < max_checks
+			&& m_send_queue.pop(candidate)) {
+		++checks;
+		v3POS p = candidate.pos;
+		s16 d = BlockSendQueue::distance(view, p);
+		// Near blocks and blocks on predicted path are checked for sending always
+		bool can_skip = candidate.score > BLOCK_SEND_NEAR_SCORE;
 
-			// If block is very close, allow full maximum
-			if(d <= BLOCK_SEND_DISABLE_LIMITS_MAX_D)
-				max_simul_dynamic = max_simul_sends_setting;
+		/*
+			Do not go over-limit
+		*/
+		if (blockpos_over_limit(p)) {
+			m_send_queue.done(p);
+			continue;
+		}
 
-			// Don't select too many blocks for sending
-			if (num_blocks_selected + num_blocks_sending >= max_simul_dynamic) {
-				//queue_is_full = true;
-				goto queue_full_break;
-			}
+		// Near blocks are updated by node packets while building
+		if (building && d <= 1)
+			continue;
 
-			/*
-				Do not go over-limit
-			*/
-			if (blockpos_over_limit(p))
-				continue;
+		// If this is true, inexistent block will be made from scratch
+		bool generate = d <= d_max_gen;
 
-			// If this is true, inexistent block will be made from scratch
-			bool generate = d <= d_max_gen;
+		/*
+			Don't send already sent blocks
+		*/
+		unsigned int block_sent = 0;
+		{
+			auto lock = m_blocks_sent.lock_shared_rec();
+			auto it = m_blocks_sent.find(p);
+			if (it != m_blocks_sent.end())
+				block_sent = it->second.time;
+		}
 
-			{
-				/*// Limit the generating area vertically to 2/3
-				if(abs(p.Y - center.Y) > d_max_gen - d_max_gen / 3)
-					generate = false;*/
-
-				/* maybe good idea (if not use block culling) but brokes far (25+) area generate by flooding emergequeue with no generate blocks
-				// Limit the send area vertically to 1/2
-				if(can_skip && abs(p.Y - center.Y) > full_d_max / 2)
-					generate = false;
-				*/
-			}
+		if(block_sent > 0 && block_sent + (d <= 2 ? 1 : d*d*d) > m_uptime) {
+			// Far ones come back with next fill()
+			if (d <= 2)
+				m_send_queue.defer(p);
+			else
+				m_send_queue.done(p);
+			continue;
+		}
 
+		/*
+			Check if map has this block
+		*/
 
-			//infostream<<"d="<<d<<std::endl;
-			/*
-				Don't generate or send if not in sight
-				FIXME This only works if the client uses a small enough
-				FOV setting. The default of 72 degrees is fine.
-			*/
+		MapBlock *block;
+		{
+#if !ENABLE_THREADS
+		auto lock = env->getServerMap().m_nothread_locker.lock_shared_rec();
+#endif
 
-			float camera_fov = ((fov+5)*M_PI/180) * 4./3.;
-			if(can_skip && isBlockInSight(p, camera_pos, camera_dir, camera_fov, 10000*BS) == false)
-			{
-				continue;
-			}
+		block = env->getMap().getBlockNoCreateNoEx(p);
+		}
 
-			/*
-				Don't send already sent blocks
-			*/
-			unsigned int block_sent = 0;
-			{
-				auto lock = m_blocks_sent.lock_shared_rec();
-				block_sent = m_blocks_sent.find(p) != m_blocks_sent.end() ? m_blocks_sent.get(p) : 0;
-			}
+		//bool surely_not_found_on_disk = false;
+		bool block_is_invalid = false;
+		if(block != NULL)
+		{
 
-			if(block_sent > 0 && (/* (block_overflow && d>1) || */ block_sent + (d <= 2 ? 1 : d*d*d) > m_uptime)) {
+			// Unchanged since full send or changed by deltas only
+			if (block_sent > 0 && isBlockSent(p, block->m_changed_counter)) {
+				m_send_queue.done(p);
 				continue;
 			}
 
-			/*
-				Check if map has this block
-			*/
-
-			MapBlock *block;
-			{
+			// Occluded blocks stay candidates, checked again after next rescore
+			if (occlusion_culling_enabled && can_skip) {
+				ScopeProfiler sp(g_profiler, "SMap: Occusion calls");
+				//Occlusion culling
+				auto cpn = p*MAP_BLOCKSIZE;
+
+				// No occlusion culling when free_move is on and camera is
+				// inside ground
+				cpn += v3POS(MAP_BLOCKSIZE/2, MAP_BLOCKSIZE/2, MAP_BLOCKSIZE/2);
+
+				float step = 1;
+				float stepfac = 1.3;
+				float startoff = 5;
+				float endoff = -MAP_BLOCKSIZE;
+				v3POS spn = cam_pos_nodes + v3POS(0,0,0);
+				s16 bs2 = MAP_BLOCKSIZE/2 + 1;
+				u32 needed_count = 1;
 #if !ENABLE_THREADS
-			auto lock = env->getServerMap().m_nothread_locker.lock_shared_rec();
+				auto lock = env->getServerMap().m_nothread_locker.lock_shared_rec();
 #endif
-
-			block = env->getMap().getBlockNoCreateNoEx(p);
-			}
-
-			//bool surely_not_found_on_disk = false;
-			bool block_is_invalid = false;
-			if(block != NULL)
-			{
-
-				/*if (d > 3 && block->content_only == CONTENT_AIR) {
-					continue;
-				}*/
-
-				if (block_sent > 0 && block_sent >= block->m_changed_timestamp) {
+				//VERY BAD COPYPASTE FROM clientmap.cpp!
+				if(
+					isOccluded(&env->getMap(), spn, cpn + v3POS(0,0,0),
+						step, stepfac, startoff, endoff, needed_count, nodemgr, occlude_cache) &&
+					isOccluded(&env->getMap(), spn, cpn + v3POS(bs2,bs2,bs2),
+						step, stepfac, startoff, endoff, needed_count, nodemgr, occlude_cache) &&
+					isOccluded(&env->getMap(), spn, cpn + v3POS(bs2,bs2,-bs2),
+						step, stepfac, startoff, endoff, needed_count, nodemgr, occlude_cache) &&
+					isOccluded(&env->getMap(), spn, cpn + v3POS(bs2,-bs2,bs2),
+						step, stepfac, startoff, endoff, needed_count, nodemgr, occlude_cache) &&
+					isOccluded(&env->getMap(), spn, cpn + v3POS(bs2,-bs2,-bs2),
+						step, stepfac, startoff, endoff, needed_count, nodemgr, occlude_cache) &&
+					isOccluded(&env->getMap(), spn, cpn + v3POS(-bs2,bs2,bs2),
+						step, stepfac, startoff, endoff, needed_count, nodemgr, occlude_cache) &&
+					isOccluded(&env->getMap(), spn, cpn + v3POS(-bs2,bs2,-bs2),
+						step, stepfac, startoff, endoff, needed_count, nodemgr, occlude_cache) &&
+					isOccluded(&env->getMap(), spn, cpn + v3POS(-bs2,-bs2,bs2),
+						step, stepfac, startoff, endoff, needed_count, nodemgr, occlude_cache) &&
+					isOccluded(&env->getMap(), spn, cpn + v3POS(-bs2,-bs2,-bs2),
+						step, stepfac, startoff, endoff, needed_count, nodemgr, occlude_cache)
+				)
+				{
+					g_profiler->add("SMap: Occlusion skip", 1);
+					blocks_occlusion_culled++;
 					continue;
 				}
-
-		if (occlusion_culling_enabled) {
-			ScopeProfiler sp(g_profiler, "SMap: Occusion calls");
-			//Occlusion culling
-			auto cpn = p*MAP_BLOCKSIZE;
-
-			// No occlusion culling when free_move is on and camera is
-			// inside ground
-			cpn += v3POS(MAP_BLOCKSIZE/2, MAP_BLOCKSIZE/2, MAP_BLOCKSIZE/2);
-
-			float step = 1;
-			float stepfac = 1.3;
-			float startoff = 5;
-			float endoff = -MAP_BLOCKSIZE;
-			v3POS spn = cam_pos_nodes + v3POS(0,0,0);
-			s16 bs2 = MAP_BLOCKSIZE/2 + 1;
-			u32 needed_count = 1;
-#if !ENABLE_THREADS
-			auto lock = env->getServerMap().m_nothread_locker.lock_shared_rec();
-#endif
-			//VERY BAD COPYPASTE FROM clientmap.cpp!
-			if( can_skip &&
-				occlusion_culling_enabled &&
-				isOccluded(&env->getMap(), spn, cpn + v3POS(0,0,0),
-					step, stepfac, startoff, endoff, needed_count, nodemgr, occlude_cache) &&
-				isOccluded(&env->getMap(), spn, cpn + v3POS(bs2,bs2,bs2),
-					step, stepfac, startoff, endoff, needed_count, nodemgr, occlude_cache) &&
-				isOccluded(&env->getMap(), spn, cpn + v3POS(bs2,bs2,-bs2),
-					step, stepfac, startoff, endoff, needed_count, nodemgr, occlude_cache) &&
-				isOccluded(&env->getMap(), spn, cpn + v3POS(bs2,-bs2,bs2),
-					step, stepfac, startoff, endoff, needed_count, nodemgr, occlude_cache) &&
-				isOccluded(&env->getMap(), spn, cpn + v3POS(bs2,-bs2,-bs2),
-					step, stepfac, startoff, endoff, needed_count, nodemgr, occlude_cache) &&
-				isOccluded(&env->getMap(), spn, cpn + v3POS(-bs2,bs2,bs2),
-					step, stepfac, startoff, endoff, needed_count, nodemgr, occlude_cache) &&
-				isOccluded(&env->getMap(), spn, cpn + v3POS(-bs2,bs2,-bs2),
-					step, stepfac, startoff, endoff, needed_count, nodemgr, occlude_cache) &&
-				isOccluded(&env->getMap(), spn, cpn + v3POS(-bs2,-bs2,bs2),
-					step, stepfac, startoff, endoff, needed_count, nodemgr, occlude_cache) &&
-				isOccluded(&env->getMap(), spn, cpn + v3POS(-bs2,-bs2,-bs2),
-					step, stepfac, startoff, endoff, needed_count, nodemgr, occlude_cache)
-			)
-			{
-				//infostream<<" occlusion player="<<cam_pos_nodes<<" d="<<d<<" block="<<cpn<<" total="<<blocks_occlusion_culled<<"/"<<num_blocks_selected<<std::endl;
-				g_profiler->add("SMap: Occlusion skip", 1);
-				blocks_occlusion_culled++;
-				continue;
 			}
-		}
-
-				// Reset usage timer, this block will be of use in the future.
-				block->resetUsageTimer();
 
-				if (block->getLightingExpired()) {
-					//env->getServerMap().lighting_modified_blocks.set(p, nullptr);
-					env->getServerMap().lighting_modified_add(p, d);
-					if (block_sent && can_skip)
-						continue;
-				}
+			// Reset usage timer, this block will be of use in the future.
+			block->resetUsageTimer();
 
-				if (block->lighting_broken > 0 && (block_sent || can_skip))
+			if (block->getLightingExpired()) {
+				//env->getServerMap().lighting_modified_blocks.set(p, nullptr);
+				env->getServerMap().lighting_modified_add(p, d);
+				if (block_sent && can_skip) {
+					m_send_queue.defer(p);
 					continue;
-
-				// Block is valid if lighting is up-to-date and data exists
-				if(block->isValid() == false)
-				{
-					block_is_invalid = true;
-				}
-
-				if(block->isGenerated() == false)
-				{
-					continue;
-				}
-
-				/*
-					If block is not close, don't send it unless it is near
-					ground level.
-
-					Block is near ground level if night-time mesh
-					differs from day-time mesh.
-				*/
-/*
-				if(d >= 4)
-				{
-					if(block->getDayNightDiff() == false)
-						continue;
 				}
-*/
 			}
 
-			/*
-				If block has been marked to not exist on disk (dummy)
-				and generating new ones is not wanted, skip block.
-			*/
-			/*
-			if(generate == false && surely_not_found_on_disk == true)
-			{
-				// get next one.
+			if (block->lighting_broken > 0 && (block_sent || can_skip)) {
+				m_send_queue.defer(p);
 				continue;
 			}
-			*/
 
-			/*
-				Add inexistent block to emerge queue.
-			*/
-			if(!block || /*surely_not_found_on_disk ||*/ block_is_invalid)
+			// Block is valid if lighting is up-to-date and data exists
+			if(block->isValid() == false)
 			{
-				//infostream<<"start gen d="<<d<<" p="<<p<<" notfound="<<surely_not_found_on_disk<<" invalid="<< block_is_invalid<<" block="<<block<<" generate="<<generate<<std::endl;
-				if (generate || !env->getServerMap().m_db_miss.count(p)) {
-
-				if (emerge->enqueueBlockEmerge(peer_id, p, generate)) {
-					if (nearest_emerged_d == -1)
-						nearest_emerged_d = d;
-				} else {
-					if (nearest_emergefull_d == -1)
-						nearest_emergefull_d = d;
-					goto queue_full_break;
-				}
-				} else {
-					//infostream << "skip tryload " << p << "\n";
-				}
+				block_is_invalid = true;
+			}
 
-				// get next one.
+			if(block->isGenerated() == false)
+			{
+				// Being generated, other ones wait for next rescore
+				if (generate)
+					m_send_queue.defer(p);
 				continue;
 			}
+		}
 
-			if(nearest_sent_d == -1)
-				nearest_sent_d = d;
+		/*
+			Add inexistent block to emerge queue.
+		*/
+		if(!block || /*surely_not_found_on_disk ||*/ block_is_invalid)
+		{
+			if (generate || !env->getServerMap().m_db_miss.count(p)) {
+				// Checked again on next call, sent when ready
+				m_send_queue.defer(p);
+				if (!emerge->enqueueBlockEmerge(peer_id, p, generate))
+					break;
+			} else {
+				//infostream << "skip tryload " << p << "\n";
+			}
 
-			/*
-				Add block to send queue
-			*/
+			// get next one.
+			continue;
+		}
 
-			PrioritySortedBlockTransfer q((float)d, p, peer_id);
+		/*
+			Add block to send queue
+		*/
 
-			dest.push_back(q);
+		PrioritySortedBlockTransfer q(candidate.score, p, peer_id);
 
-			if (block->content_only == CONTENT_AIR)
-				++num_blocks_air;
-			else
-			num_blocks_selected += 1;
-		}
-	}
-queue_full_break:
+		dest.push_back(q);
 
-	//infostream<<"Stopped at "<<d<<" d_start="<<d_start<< " d_max="<<d_max<<" nearest_emerged_d="<<nearest_emerged_d<<" nearest_emergefull_d="<<nearest_emergefull_d<< " new_nearest_unsent_d="<<new_nearest_unsent_d<< " sel="<<num_blocks_selected<< "+"<<num_blocks_sending << " air="<<num_blocks_air<< " culled=" << blocks_occlusion_culled <<" cEN="<<occlusion_culling_enabled<<std::endl;
-	num_blocks_selected += num_blocks_sending;
-	if(!num_blocks_selected && !num_blocks_air && d_start <= d) {
-		//new_nearest_unsent_d = 0;
-		m_nothing_to_send_pause_timer = 1.0;
-	}
-		
-
-	// If nothing was found for sending and nothing was queued for
-	// emerging, continue next time browsing from here
-	if(nearest_emerged_d != -1 && nearest_emerged_d > nearest_emergefull_d){
-		new_nearest_unsent_d = nearest_emerged_d;
-	} else if(nearest_emergefull_d != -1){
-		new_nearest_unsent_d = nearest_emergefull_d;
-	} else {
-		if(d > full_d_max){
-			new_nearest_unsent_d = 0;
-			m_nothing_to_send_pause_timer = 10.0;
-		} else {
-			if(nearest_sent_d != -1)
-				new_nearest_unsent_d = nearest_sent_d;
-			else
-				new_nearest_unsent_d = d;
-		}
-	}
+		// Done when checked again after sending
+		m_send_queue.defer(p);
 
-	if(new_nearest_unsent_d != -1) {
-		m_nearest_unsent_d = new_nearest_unsent_d;
+		if (block->content_only == CONTENT_AIR)
+			++num_blocks_air;
+		else
+		num_blocks_selected += 1;
 	}
 
-	return num_blocks_selected - num_blocks_sending;
+	//infostream<<"Checked "<<checks<<" candidates="<<m_send_queue.size()<<" queued="<<m_send_queue.queued()<< " sel="<<num_blocks_selected<< " air="<<num_blocks_air<< " culled=" << blocks_occlusion_culled <<" cEN="<<occlusion_culling_enabled<<std::endl;
+	g_profiler->add("SMap: Send queue checks", checks);
+
+	m_nearest_unsent_d = checks ? BlockSendQueue::distance(view, candidate.pos) : 0;
+
+	if(!num_blocks_selected && !num_blocks_air && !m_send_queue.queued()
+			&& !m_send_queue.scoring())
+		m_nothing_to_send_pause_timer = 1.0;
+
+	return num_blocks_selected;
 }
 
 /*
@@ -615,9 +483,28 @@ void RemoteClient::GotBlock(v3s16 p)
 }
 */
 
-void RemoteClient::SentBlock(v3s16 p, double time)
+void RemoteClient::SentBlock(v3s16 p, double time, u32 changed)
 {
-	m_blocks_sent.set(p, time);
+	m_blocks_sent.set(p, {(unsigned int)time, changed});
+}
+
+void RemoteClient::SentBlockDelta(v3s16 p, const std::vector<std::pair<u32, u32>> &changed)
+{
+	auto lock = m_blocks_sent.lock_unique_rec();
+	auto it = m_blocks_sent.find(p);
+	if (it == m_blocks_sent.end())
+		return;
+	// Other change between deltas breaks chain, block is sent again
+	for (const auto &span : changed)
+		if (it->second.changed && it->second.changed == span.first)
+			it->second.changed = span.second;
+}
+
+bool RemoteClient::isBlockSent(v3s16 p, u32 changed)
+{
+	auto lock = m_blocks_sent.lock_shared_rec();
+	auto it = m_blocks_sent.find(p);
+	return it != m_blocks_sent.end() && it->second.changed && it->second.changed == changed;
 }
 
 /*
@@ -636,17 +523,21 @@ void RemoteClient::SentBlock(v3s16 p)
 
 void RemoteClient::SetBlockNotSent(v3s16 p)
 {
-	++m_nearest_unsent_reset;
-/*
-	m_nearest_unsent_d = 0;
-	m_nothing_to_send_pause_timer = 0;
-
-	if(m_blocks_sending.find(p) != m_blocks_sending.end())
-		m_blocks_sending.erase(p);
-	if(m_blocks_sent.find(p) != m_blocks_sent.end())
-		m_blocks_sent.erase(p);
-	m_blocks_modified.insert(p);
-*/
+	{
+		// Changed without delta, next deltas do not make it sent
+		auto lock = m_blocks_sent.lock_unique_rec();
+		auto it = m_blocks_sent.find(p);
+		if (it != m_blocks_sent.end())
+			it->second.changed = 0;
+	}
+	MutexAutoLock lock(m_blocks_not_sent_mutex);
+	// Client is not getting blocks, check all of them later
+	if (m_blocks_not_sent.size() >= 10000) {
+		m_blocks_not_sent.clear();
+		++m_nearest_unsent_reset;
+		return;
+	}
+	m_blocks_not_sent.push_back(p);
 }
 
 void RemoteClient::SetBlocksNotSent()
@@ -656,20 +547,13 @@ void RemoteClient::SetBlocksNotSent()
 
 void RemoteClient::SetBlocksNotSent(std::map<v3s16, MapBlock*> &blocks)
 {
-	++m_nearest_unsent_reset;
-/*
-	for(std::map<v3s16, MapBlock*>::iterator
-			i = blocks.begin();
-			i != blocks.end(); ++i)
-	{
-		v3s16 p = i->first;
-		m_blocks_modified.insert(p);
-	}
-*/
+	for (const auto &i : blocks)
+		SetBlockNotSent(i.first);
 }
 
 void RemoteClient::SetBlockDeleted(v3s16 p) {
 	m_blocks_sent.erase(p);
+	SetBlockNotSent(p);
 }
 
 void RemoteClient::notifyEvent(ClientStateEvent event)
@@ -935,8 +819,19 @@ void ClientInterface::send(u16 peer_id,u8 channelnum,
 void ClientInterface::send(u16 peer_id,u8 channelnum,
 		const msgpack::sbuffer &buffer, bool reliable)
 {
-	SharedBuffer<u8> data((unsigned char*)buffer.data(), buffer.size());
-	send(peer_id, channelnum, data, reliable);
+	m_con->Send(peer_id, channelnum, buffer, reliable);
+}
+
+void ClientInterface::send(u16 peer_id,u8 channelnum,
+		msgpack::sbuffer &&buffer, bool reliable)
+{
+	m_con->Send(peer_id, channelnum, std::move(buffer), reliable);
+}
+
+void ClientInterface::send(const std::vector<u16> &peer_ids, u8 channelnum,
+		msgpack::sbuffer &&buffer, bool reliable)
+{
+	m_con->Send(peer_ids, channelnum, std::move(buffer), reliable);
 }
 #endif
 
@@ -985,8 +880,23 @@ void ClientInterface::sendToAll(u16 channelnum,
 void ClientInterface::sendToAll(u16 channelnum,
 		const msgpack::sbuffer &buffer, bool reliable)
 {
-	SharedBuffer<u8> data((unsigned char*)buffer.data(), buffer.size());
-	sendToAll(channelnum, data, reliable);
+	msgpack::sbuffer copy(buffer.size());
+	copy.write(buffer.data(), buffer.size());
+	sendToAll(channelnum, std::move(copy), reliable);
+}
+
+void ClientInterface::sendToAll(u16 channelnum,
+		msgpack::sbuffer &&buffer, bool reliable)
+{
+	std::vector<u16> peer_ids;
+	{
+		auto lock = m_clients.lock_shared_rec();
+		for (auto & i : m_clients)
+			if (i.second->net_proto_version != 0)
+				peer_ids.push_back(i.second->peer_id);
+	}
+	// One packet for all clients
+	m_con->Send(peer_ids, channelnum, std::move(buffer), reliable);
 }
 #endif
 
@@ -30,6 +30,8 @@ along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
 #include "threading/concurrent_map.h"
 #include "threading/concurrent_unordered_map.h"
 #include "util/unordered_map_hash.h"
+#include "fm_objects_grid.h"
+#include "fm_block_send_queue.h"
 #include "network/networkpacket.h"
 
 #include <list>
@@ -301,14 +303,22 @@ class RemoteClient
 	}
 
 	/*
-		Finds block that should be sent next to the client.
+		Finds blocks that should be sent next to the client, best
+		candidates of m_send_queue first.
 		Environment should be locked when this is called.
-		dtime is used for resetting send radius at slow interval
+		dtime is used for refilling send queue at slow interval
 	*/
 	int GetNextBlocks(ServerEnvironment *env, EmergeManager* emerge,
 			float dtime, double m_uptime, std::vector<PrioritySortedBlockTransfer> &dest);
 
-	void SentBlock(v3s16 p, double time);
+	// changed is MapBlock::m_changed_counter of sent block content
+	void SentBlock(v3s16 p, double time, u32 changed);
+	// Client got node changes of block as delta, changed[i] is change
+	// counter of block before and after change i
+	void SentBlockDelta(v3s16 p, const std::vector<std::pair<u32, u32>> &changed);
+	// Client has block content with change counter changed, from last
+	// full block and deltas after it
+	bool isBlockSent(v3s16 p, u32 changed);
 
 	void SetBlockNotSent(v3s16 p);
 	void SetBlocksNotSent(std::map<v3s16, MapBlock*> &blocks);
@@ -349,6 +359,9 @@ class RemoteClient
 		List of active objects that the client knows of.
 	*/
 	maybe_concurrent_unordered_map<u16, bool> m_known_objects;
+	// Grid cells already checked for objects to add, see
+	// ServerEnvironment::getAddedActiveObjects()
+	ActiveObjectInterest m_object_interest;
 
 	ClientState getState()
 		{ return m_state; }
@@ -404,16 +417,25 @@ class RemoteClient
 		List of block positions.
 		No MapBlock* is stored here because the blocks can get deleted.
 	*/
-	concurrent_unordered_map<v3POS, unsigned int, v3POSHash, v3POSEqual> m_blocks_sent;
+	struct SentBlockInfo {
+		// Time of last full send
+		unsigned int time;
+		// Change counter of block content client has, 0 if not known
+		u32 changed;
+	};
+	concurrent_unordered_map<v3POS, SentBlockInfo, v3POSHash, v3POSEqual> m_blocks_sent;
 	unsigned int m_nearest_unsent_reset_want = 0;
 
 public:
 	std::atomic_int m_nearest_unsent_d;
 private:
 
-	v3s16 m_last_center;
-	v3f   m_last_direction;
+	BlockSendQueue m_send_queue;
+	// Time from last m_send_queue.fill()
 	float m_nearest_unsent_reset_timer;
+	// Changed blocks from other threads, added to m_send_queue by GetNextBlocks()
+	Mutex m_blocks_not_sent_mutex;
+	std::vector<v3POS> m_blocks_not_sent;
 
 	/*
 		Blocks that have been modified since last sending them.
@@ -481,12 +503,17 @@ class ClientInterface {
 
 	/* send message to client */
 	void send(u16 peer_id, u8 channelnum, const msgpack::sbuffer &data, bool reliable);
+	/* send message to clients without copy, data is empty after call */
+	void send(u16 peer_id, u8 channelnum, msgpack::sbuffer &&data, bool reliable);
+	void send(const std::vector<u16> &peer_ids, u8 channelnum,
+			msgpack::sbuffer &&data, bool reliable);
 
 	void send(u16 peer_id, u8 channelnum, SharedBuffer<u8> data, bool reliable); //todo: delete
 
 	/* send to all clients */
 	void sendToAll(u16 channelnum, SharedBuffer<u8> data, bool reliable);
 	void sendToAll(u16 channelnum, msgpack::sbuffer const &buffer, bool reliable);
+	void sendToAll(u16 channelnum, msgpack::sbuffer &&buffer, bool reliable);
 	void sendToAll(u16 channelnum, NetworkPacket* pkt, bool reliable);
 
 	/* delete a client */
@@ -334,8 +334,8 @@ void ClientMap::updateDrawList(video::IVideoDriver* driver, float dtime, unsigne
 		++calls;
 
 		//auto block = getBlockNoCreateNoEx(bp);
-		auto block = m_blocks.get(bp);
-		if (!block)
+		MapBlockP block;
+		if (!m_blocks.get_value(bp, block) || !block)
 			continue;
 
 			int mesh_step = getFarmeshStep(m_control, getNodeBlockPos(cam_pos_nodes), bp);
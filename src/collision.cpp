@@ -30,6 +30,8 @@ along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
 #include "serverobject.h"
 #include <vector>
 #include <set>
+#include <algorithm>
+#include <unordered_map>
 #include "util/timetaker.h"
 #include "profiler.h"
 
@@ -182,6 +184,132 @@ static inline void getNeighborConnectingFace(v3s16 p, INodeDefManager *nodedef,
 		*neighbors |= v;
 }
 
+// Boxes of walkable node n at p in BS units
+static void getNodeCollisionBoxes(Map *map, INodeDefManager *nodedef,
+		v3s16 p, MapNode n, std::vector<aabb3f> &nodeboxes)
+{
+	const ContentFeatures &f = nodedef->get(n);
+	int neighbors = 0;
+	if (f.drawtype == NDT_NODEBOX && f.node_box.type == NODEBOX_CONNECTED) {
+		v3s16 p2 = p;
+
+		p2.Y++;
+		getNeighborConnectingFace(p2, nodedef, map, n, 1, &neighbors);
+
+		p2 = p;
+		p2.Y--;
+		getNeighborConnectingFace(p2, nodedef, map, n, 2, &neighbors);
+
+		p2 = p;
+		p2.Z--;
+		getNeighborConnectingFace(p2, nodedef, map, n, 4, &neighbors);
+
+		p2 = p;
+		p2.X--;
+		getNeighborConnectingFace(p2, nodedef, map, n, 8, &neighbors);
+
+		p2 = p;
+		p2.Z++;
+		getNeighborConnectingFace(p2, nodedef, map, n, 16, &neighbors);
+
+		p2 = p;
+		p2.X++;
+		getNeighborConnectingFace(p2, nodedef, map, n, 32, &neighbors);
+	}
+	nodeboxes.clear();
+	n.getCollisionBoxes(nodedef, &nodeboxes, neighbors);
+	for (auto & box : nodeboxes) {
+		box.MinEdge += v3f(p.X, p.Y, p.Z) * BS;
+		box.MaxEdge += v3f(p.X, p.Y, p.Z) * BS;
+	}
+}
+
+std::shared_ptr<const BlockCollisionBoxes> getBlockCollisionBoxes(
+		INodeDefManager *nodedef, MapBlock *block)
+{
+	u32 changed_counter = block->m_changed_counter;
+	{
+		std::lock_guard<Mutex> lock(block->m_collision_boxes_mutex);
+		if (block->m_collision_boxes &&
+				block->m_collision_boxes->changed_counter == changed_counter)
+			return block->m_collision_boxes;
+	}
+	g_profiler->add("Collision: block boxes build", 1);
+
+	auto cache = std::make_shared<BlockCollisionBoxes>();
+	cache->changed_counter = changed_counter;
+	cache->node_shape.resize(MAP_BLOCKSIZE * MAP_BLOCKSIZE * MAP_BLOCKSIZE,
+			BlockCollisionBoxes::SHAPE_NONE);
+	cache->shape_begin.push_back(0);
+	cache->shape_begin.push_back(0);
+	cache->shape_bouncy.push_back(0);
+
+	std::unordered_map<u32, u16> shapes;
+	std::vector<aabb3f> nodeboxes;
+	{
+		auto lock = block->lock_shared_rec();
+		for (u32 i = 0; i < cache->node_shape.size(); ++i) {
+			MapNode n = block->getNodeNoLock(v3s16(i % MAP_BLOCKSIZE,
+					i / MAP_BLOCKSIZE % MAP_BLOCKSIZE,
+					i / (MAP_BLOCKSIZE * MAP_BLOCKSIZE)));
+			if (!nodedef->isWalkable(n.getContent()))
+				continue;
+			u32 key = (u32)n.getContent() << 8 | n.getParam2();
+			auto it = shapes.find(key);
+			if (it != shapes.end()) {
+				cache->node_shape[i] = it->second;
+				continue;
+			}
+			const ContentFeatures &f = nodedef->get(n);
+			u16 shape = cache->shape_bouncy.size();
+			if ((f.drawtype == NDT_NODEBOX && f.node_box.type == NODEBOX_CONNECTED) ||
+					shape >= BlockCollisionBoxes::SHAPE_LIVE) {
+				shape = BlockCollisionBoxes::SHAPE_LIVE;
+			} else {
+				nodeboxes.clear();
+				n.getCollisionBoxes(nodedef, &nodeboxes);
+				cache->boxes.insert(cache->boxes.end(),
+						nodeboxes.begin(), nodeboxes.end());
+				cache->shape_begin.push_back(cache->boxes.size());
+				cache->shape_bouncy.push_back(itemgroup_get(f.groups, "bouncy"));
+			}
+			shapes[key] = shape;
+			cache->node_shape[i] = shape;
+		}
+	}
+
+	std::lock_guard<Mutex> lock(block->m_collision_boxes_mutex);
+	// Changed meanwhile by writer without block lock
+	if (changed_counter == block->m_changed_counter)
+		block->m_collision_boxes = cache;
+	return cache;
+}
+
+void ObjectBoxSnapshot::add(const ActiveObject *object, const aabb3f &box)
+{
+	Item item = {box, object};
+	m_items.push_back(item);
+	m_max_width = MYMAX(m_max_width, box.MaxEdge.X - box.MinEdge.X);
+}
+
+void ObjectBoxSnapshot::finish()
+{
+	std::sort(m_items.begin(), m_items.end());
+}
+
+void ObjectBoxSnapshot::getInsideArea(const aabb3f &area,
+		const ActiveObject *self, std::vector<aabb3f> &boxes) const
+{
+	// Boxes starting before area.MinEdge.X - m_max_width end before area
+	Item first;
+	first.box.MinEdge.X = area.MinEdge.X - m_max_width;
+	for (auto i = std::lower_bound(m_items.begin(), m_items.end(), first);
+			i != m_items.end() && i->box.MinEdge.X <= area.MaxEdge.X; ++i) {
+		if (i->object != self && i->box.intersectsWithBox(area))
+			boxes.push_back(i->box);
+	}
+}
+
 collisionMoveResult collisionMoveSimple(Environment *env, IGameDef *gamedef,
 		f32 pos_max_d, const aabb3f &box_0,
 		f32 stepheight, f32 dtime,
@@ -247,6 +375,14 @@ collisionMoveResult collisionMoveSimple(Environment *env, IGameDef *gamedef,
 	s16 max_z = MYMAX(oldpos_i.Z, newpos_i.Z) + (box_0.MaxEdge.Z / BS) + 1;
 
 	bool any_position_valid = false;
+	INodeDefManager *nodedef = gamedef->getNodeDefManager();
+	// Client replaces blocks from network without new changed timestamp
+	bool use_block_boxes = dynamic_cast<ServerEnvironment*>(env) != NULL;
+
+	v3s16 last_blockpos(-32768, -32768, -32768);
+	MapBlock *block = NULL;
+	std::shared_ptr<const BlockCollisionBoxes> block_boxes;
+	std::vector<aabb3f> nodeboxes;
 
 	for(s16 x = min_x; x <= max_x; x++)
 	for(s16 y = min_y; y <= max_y; y++)
@@ -254,64 +390,16 @@ collisionMoveResult collisionMoveSimple(Environment *env, IGameDef *gamedef,
 	{
 		v3s16 p(x,y,z);
 
-		bool is_position_valid;
-		MapNode n = map->getNodeNoEx(p, &is_position_valid);
-
-		if (is_position_valid) {
-			// Object collides into walkable nodes
-
-			any_position_valid = true;
-			INodeDefManager *nodedef = gamedef->getNodeDefManager();
-			const ContentFeatures &f = nodedef->get(n);
-			if(f.walkable == false)
-				continue;
-			int n_bouncy_value = itemgroup_get(f.groups, "bouncy");
-
-			int neighbors = 0;
-			if (f.drawtype == NDT_NODEBOX && f.node_box.type == NODEBOX_CONNECTED) {
-				v3s16 p2 = p;
-
-				p2.Y++;
-				getNeighborConnectingFace(p2, nodedef, map, n, 1, &neighbors);
-
-				p2 = p;
-				p2.Y--;
-				getNeighborConnectingFace(p2, nodedef, map, n, 2, &neighbors);
-
-				p2 = p;
-				p2.Z--;
-				getNeighborConnectingFace(p2, nodedef, map, n, 4, &neighbors);
-
-				p2 = p;
-				p2.X--;
-				getNeighborConnectingFace(p2, nodedef, map, n, 8, &neighbors);
-
-				p2 = p;
-				p2.Z++;
-				getNeighborConnectingFace(p2, nodedef, map, n, 16, &neighbors);
-
-				p2 = p;
-				p2.X++;
-				getNeighborConnectingFace(p2, nodedef, map, n, 32, &neighbors);
-			}
-			std::vector<aabb3f> nodeboxes;
-			n.getCollisionBoxes(gamedef->ndef(), &nodeboxes, neighbors);
-			for(std::vector<aabb3f>::iterator
-					i = nodeboxes.begin();
-					i != nodeboxes.end(); ++i)
-			{
-				aabb3f box = *i;
-				box.MinEdge += v3f(x, y, z)*BS;
-				box.MaxEdge += v3f(x, y, z)*BS;
-				cboxes.push_back(box);
-				is_unloaded.push_back(false);
-				is_step_up.push_back(false);
-				bouncy_values.push_back(n_bouncy_value);
-				node_positions.push_back(p);
-				is_object.push_back(false);
-			}
+		v3s16 blockpos = getNodeBlockPos(p);
+		if (blockpos != last_blockpos) {
+			last_blockpos = blockpos;
+			block = map->getBlockNoCreateNoEx(blockpos);
+			block_boxes = block && block->isValid() && use_block_boxes ?
+					getBlockCollisionBoxes(nodedef, block) : nullptr;
 		}
-		else {
+
+		// Dummy blocks without data are unloaded too
+		if (!block || !block->isValid()) {
 			// Collide with unloaded nodes
 			aabb3f box = getNodeBox(p, BS);
 			cboxes.push_back(box);
@@ -320,6 +408,45 @@ collisionMoveResult collisionMoveSimple(Environment *env, IGameDef *gamedef,
 			bouncy_values.push_back(0);
 			node_positions.push_back(p);
 			is_object.push_back(false);
+			continue;
+		}
+
+		// Object collides into walkable nodes
+		any_position_valid = true;
+
+		int n_bouncy_value = 0;
+		u16 shape = BlockCollisionBoxes::SHAPE_LIVE;
+		if (block_boxes) {
+			v3s16 rel = p - blockpos * MAP_BLOCKSIZE;
+			shape = block_boxes->node_shape[rel.Z * MAP_BLOCKSIZE * MAP_BLOCKSIZE +
+					rel.Y * MAP_BLOCKSIZE + rel.X];
+			if (shape == BlockCollisionBoxes::SHAPE_NONE)
+				continue;
+		}
+		if (shape != BlockCollisionBoxes::SHAPE_LIVE) {
+			n_bouncy_value = block_boxes->shape_bouncy[shape];
+			nodeboxes.assign(
+					block_boxes->boxes.begin() + block_boxes->shape_begin[shape],
+					block_boxes->boxes.begin() + block_boxes->shape_begin[shape + 1]);
+			for (auto & box : nodeboxes) {
+				box.MinEdge += v3f(x, y, z) * BS;
+				box.MaxEdge += v3f(x, y, z) * BS;
+			}
+		} else {
+			MapNode n = map->getNodeNoEx(p);
+			if (!nodedef->isWalkable(n.getContent()))
+				continue;
+			n_bouncy_value = itemgroup_get(nodedef->get(n).groups, "bouncy");
+			getNodeCollisionBoxes(map, nodedef, p, n, nodeboxes);
+		}
+
+		for (const auto & box : nodeboxes) {
+			cboxes.push_back(box);
+			is_unloaded.push_back(false);
+			is_step_up.push_back(false);
+			bouncy_values.push_back(n_bouncy_value);
+			node_positions.push_back(p);
+			is_object.push_back(false);
 		}
 	}
 
@@ -340,6 +467,7 @@ collisionMoveResult collisionMoveSimple(Environment *env, IGameDef *gamedef,
 		/* add object boxes to cboxes */
 
 		std::vector<ActiveObject*> objects;
+		std::vector<aabb3f> object_boxes;
 #ifndef SERVER
 		ClientEnvironment *c_env = dynamic_cast<ClientEnvironment*>(env);
 		if (c_env != 0) {
@@ -357,18 +485,31 @@ collisionMoveResult collisionMoveSimple(Environment *env, IGameDef *gamedef,
 		{
 			ServerEnvironment *s_env = dynamic_cast<ServerEnvironment*>(env);
 			if (s_env != 0) {
-				f32 distance = speed_f->getLength();
-				std::vector<u16> s_objects;
-				s_env->getObjectsInsideRadius(s_objects, *pos_f, distance * 1.5);
-				for (std::vector<u16>::iterator iter = s_objects.begin(); iter != s_objects.end(); ++iter) {
-					ServerActiveObject *current = s_env->getActiveObject(*iter);
-					if ((self == 0) || (self != current)) {
-						objects.push_back((ActiveObject*)current);
-					}
-				}
+				// Area swept by box in this step with margin for touching
+				// ground and collision uncertainty radius
+				aabb3f area = box_0;
+				area.MinEdge += *pos_f;
+				area.MaxEdge += *pos_f;
+				aabb3f area_end = area;
+				area_end.MinEdge += *speed_f * dtime;
+				area_end.MaxEdge += *speed_f * dtime;
+				area.addInternalBox(area_end);
+				f32 margin = pos_max_d * 1.1 + 0.15 * BS;
+				area.MinEdge -= v3f(margin, margin, margin);
+				area.MaxEdge += v3f(margin, margin, margin);
+				s_env->getObjectBoxSnapshot()->getInsideArea(area, self, object_boxes);
 			}
 		}
 
+		for (const auto & box : object_boxes) {
+			cboxes.push_back(box);
+			is_unloaded.push_back(false);
+			is_step_up.push_back(false);
+			bouncy_values.push_back(0);
+			node_positions.push_back(v3s16(0,0,0));
+			is_object.push_back(true);
+		}
+
 		for (std::vector<ActiveObject*>::const_iterator iter = objects.begin();
 				iter != objects.end(); ++iter) {
 			ActiveObject *object = *iter;
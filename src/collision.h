@@ -25,9 +25,12 @@ along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "irrlichttypes_bloated.h"
 #include <vector>
+#include <memory>
 
 class Map;
+class MapBlock;
 class IGameDef;
+class INodeDefManager;
 class Environment;
 class ActiveObject;
 
@@ -80,6 +83,60 @@ collisionMoveResult collisionMoveSimple(Environment *env,IGameDef *gamedef,
 		v3f accel_f, ActiveObject *self=NULL,
 		bool collideWithObjects=true);
 
+/*
+	Collision boxes of all nodes of a block, reused by every object moving
+	in block until block changes (see MapBlock::m_collision_boxes).
+	Nodes with same content and param2 share one shape.
+*/
+struct BlockCollisionBoxes
+{
+	enum {
+		SHAPE_NONE = 0,     // Not walkable
+		SHAPE_LIVE = 0xffff // Connected nodebox, depends on neighbours
+	};
+
+	u32 changed_counter;
+	// Shape of node i (MapBlock data order)
+	std::vector<u16> node_shape;
+	// Boxes of shape s relative to node are boxes[shape_begin[s]..shape_begin[s+1])
+	std::vector<u32> shape_begin;
+	std::vector<aabb3f> boxes;
+	std::vector<int> shape_bouncy;
+};
+
+// Cached boxes of block, built again after block changes
+std::shared_ptr<const BlockCollisionBoxes> getBlockCollisionBoxes(
+		INodeDefManager *nodedef, MapBlock *block);
+
+/*
+	Collision boxes of objects sorted by MinEdge.X (sweep and prune).
+	Server takes one snapshot per step, so every object moving in a step
+	collides with others at their positions from start of step.
+*/
+class ObjectBoxSnapshot
+{
+public:
+	ObjectBoxSnapshot(): m_max_width(0) {}
+
+	void add(const ActiveObject *object, const aabb3f &box);
+	// Sorts boxes, call after last add()
+	void finish();
+	// Boxes of objects other than self touching area
+	void getInsideArea(const aabb3f &area, const ActiveObject *self,
+			std::vector<aabb3f> &boxes) const;
+	size_t size() const { return m_items.size(); }
+
+private:
+	struct Item {
+		aabb3f box;
+		const ActiveObject *object;
+		bool operator<(const Item &other) const
+		{ return box.MinEdge.X < other.box.MinEdge.X; }
+	};
+	std::vector<Item> m_items;
+	f32 m_max_width;
+};
+
 // Helper function:
 // Checks for collision of a moving aabbox with a static aabbox
 // Returns -1 if no collision, 0 if X collision, 1 if Y collision, 2 if Z collision
@@ -102,7 +102,7 @@ class LiquidFreeze : public ActiveBlockModifier {
 		//more chance to freeze if air at top
 		static int water_level = g_settings->getS16("water_level");
 		bool top_liquid = ndef->get(n).liquid_type > LIQUID_NONE && p.Y > water_level;
-		int freeze = ((ItemGroupList) ndef->get(n).groups)["freeze"];
+		int freeze = ndef->getGroup(n, CONTENT_GROUP_FREEZE);
 		if (heat <= freeze - 1 && ((!top_liquid && (activate || (heat <= freeze - 50))) || heat <= freeze - 50 ||
 		                           (myrand_range(freeze - 50, heat) <= (freeze + (top_liquid ? -42 : c == CONTENT_AIR ? -10 : -40))))) {
 			content_t c_self = n.getContent();
@@ -168,7 +168,7 @@ class MeltWeather : public ActiveBlockModifier {
 		INodeDefManager *ndef = env->getGameDef()->ndef();
 		float heat = map->updateBlockHeat(env, p);
 		content_t c = map->getNodeTry(p - v3POS(0,  -1, 0 )).getContent(); // top
-		int melt = ((ItemGroupList) ndef->get(n).groups)["melt"];
+		int melt = ndef->getGroup(n, CONTENT_GROUP_MELT);
 		if (heat >= melt + 1 && (activate || heat >= melt + 40 ||
 		                         ((myrand_range(heat, melt + 40)) >= (c == CONTENT_AIR ? melt + 10 : melt + 20)))) {
 			if (ndef->get(n.getContent()).liquid_type == LIQUID_FLOWING || ndef->get(n.getContent()).liquid_type == LIQUID_SOURCE) {
@@ -208,8 +208,8 @@ class MeltHot : public ActiveBlockModifier {
 	                     u32 active_object_count, u32 active_object_count_wider, MapNode neighbor, bool activate) {
 		ServerMap *map = &env->getServerMap();
 		INodeDefManager *ndef = env->getGameDef()->ndef();
-		int hot = ((ItemGroupList) ndef->get(neighbor).groups)["hot"];
-		int melt = ((ItemGroupList) ndef->get(n).groups)["melt"];
+		int hot = ndef->getGroup(neighbor, CONTENT_GROUP_HOT);
+		int melt = ndef->getGroup(n, CONTENT_GROUP_MELT);
 		if (hot > melt) {
 			n.freeze_melt(ndef, +1);
 			map->setNode(p, n);
@@ -242,8 +242,8 @@ class LiquidFreezeCold : public ActiveBlockModifier {
 	                     u32 active_object_count, u32 active_object_count_wider, MapNode neighbor, bool activate) {
 		ServerMap *map = &env->getServerMap();
 		INodeDefManager *ndef = env->getGameDef()->ndef();
-		int cold = ((ItemGroupList) ndef->get(neighbor).groups)["cold"];
-		int freeze = ((ItemGroupList) ndef->get(n).groups)["freeze"];
+		int cold = ndef->getGroup(neighbor, CONTENT_GROUP_COLD);
+		int freeze = ndef->getGroup(n, CONTENT_GROUP_FREEZE);
 		if (cold < freeze) {
 			n.freeze_melt(ndef, -1);
 			map->setNode(p, n);
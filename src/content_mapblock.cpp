@@ -737,7 +737,7 @@ void mapblock_mesh_generate_special(MeshMakeData *data,
 			u16 l = 0;
 			// If this liquid emits light and doesn't contain light, draw
 			// it at what it emits, for an increased effect
-			u8 light_source = nodedef->get(n).light_source;
+			u8 light_source = nodedef->getLightSource(n.getContent());
 			if(light_source != 0){
 				l = decode_light(light_source);
 				l = l | (l<<8);
@@ -136,7 +136,7 @@ void FallingSAO::step(float dtime, bool send_recommended)
 		return;
 	}
 
-	if ((f_under.walkable || (itemgroup_get(f_under.groups, "float") &&
+	if ((f_under.walkable || (ndef->getGroup(n_under, CONTENT_GROUP_FLOAT) &&
 			f_under.liquid_type == LIQUID_NONE))) {
 		if (f_under.leveled && f_under.name.compare(f.name) == 0) {
 			u8 addLevel = n.getLevel(ndef);
@@ -150,7 +150,7 @@ void FallingSAO::step(float dtime, bool send_recommended)
 			}
 		}
 		else if (f_under.buildable_to &&
-				(itemgroup_get(f.groups,"float") == 0 ||
+				(ndef->getGroup(n, CONTENT_GROUP_FLOAT) == 0 ||
 				 f_under.liquid_type == LIQUID_NONE)) {
 			m_env->removeNode(floatToInt(p_under, BS), fast);
 			return;
@@ -31,6 +31,7 @@ along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
 #include "util/string.h"
 
 #include "leveldb/db.h"
+#include "leveldb/write_batch.h"
 
 
 #define ENSURE_STATUS_OK(s) \
@@ -78,6 +79,46 @@ void Database_LevelDB::loadBlock(const v3s16 &pos, std::string *block)
 */
 }
 
+void Database_LevelDB::loadBlocks(const std::vector<v3s16> &pos, const load_callback &callback)
+{
+	auto db = m_database.db;
+	if (!db)
+		return Database::loadBlocks(pos, callback);
+
+	// One snapshot for whole batch: consistent view, no memtable version per Get
+	leveldb::ReadOptions options = m_database.read_options;
+	options.snapshot = db->GetSnapshot();
+	std::vector<std::string> blocks(pos.size());
+	for (size_t i = 0; i < pos.size(); ++i) {
+		if (!db->Get(options, getBlockAsString(pos[i]), &blocks[i]).ok() || blocks[i].empty())
+			db->Get(options, i64tos(getBlockAsInteger(pos[i])), &blocks[i]);
+	}
+	db->ReleaseSnapshot(options.snapshot);
+
+	for (size_t i = 0; i < pos.size(); ++i)
+		callback(pos[i], blocks[i]);
+}
+
+size_t Database_LevelDB::saveBlocks(const blocks_batch &blocks)
+{
+	auto db = m_database.db;
+	if (!db)
+		return 0;
+
+	leveldb::WriteBatch batch;
+	for (const auto &block : blocks) {
+		batch.Put(getBlockAsString(block.first), block.second);
+		batch.Delete(i64tos(getBlockAsInteger(block.first))); // delete old format
+	}
+	auto status = db->Write(m_database.write_options, &batch);
+	if (!status.ok()) {
+		warningstream << "WARNING: saveBlocks: LevelDB error saving "
+			<< blocks.size() << " blocks: " << status.ToString() << std::endl;
+		return 0;
+	}
+	return blocks.size();
+}
+
 bool Database_LevelDB::deleteBlock(const v3s16 &pos)
 {
 	auto ok = m_database.del(getBlockAsString(pos));
@@ -39,6 +39,17 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "log.h"
 #include "exceptions.h"
 #include "settings.h"
+#include "util/string.h"
+#include "util/unordered_map_hash.h"
+#include <cstring>
+
+// Int column of binary result
+static inline s32 pg_binary_to_int(PGresult *res, int row, int col)
+{
+	u32 value;
+	memcpy(&value, PQgetvalue(res, row, col), sizeof(value));
+	return (s32)ntohl(value);
+}
 
 Database_PostgreSQL::Database_PostgreSQL(const Settings &conf) :
 	m_connect_string(""),
@@ -125,6 +136,11 @@ void Database_PostgreSQL::initStatements()
 			"WHERE posX = $1::int4 AND posY = $2::int4 AND "
 			"posZ = $3::int4");
 
+	prepareStatement("read_blocks",
+			"SELECT posX, posY, posZ, data FROM blocks "
+			"WHERE (posX, posY, posZ) IN "
+			"(SELECT * FROM unnest($1::int4[], $2::int4[], $3::int4[]))");
+
 	prepareStatement("write_block",
 			"INSERT INTO blocks (posX, posY, posZ, data) VALUES "
 			"($1::int4, $2::int4, $3::int4, $4::bytea) "
@@ -249,6 +265,74 @@ void Database_PostgreSQL::loadBlock(const v3s16 &pos,
 	PQclear(results);
 }
 
+void Database_PostgreSQL::loadBlocks(const std::vector<v3s16> &pos,
+		const load_callback &callback)
+{
+	if (pos.empty())
+		return;
+
+	verifyDatabase();
+
+	// One query for whole batch, positions passed as three int arrays
+	std::string xs = "{", ys = "{", zs = "{";
+	for (size_t i = 0; i < pos.size(); ++i) {
+		if (i) {
+			xs += ','; ys += ','; zs += ',';
+		}
+		xs += itos(pos[i].X);
+		ys += itos(pos[i].Y);
+		zs += itos(pos[i].Z);
+	}
+	xs += '}'; ys += '}'; zs += '}';
+
+	const void *args[] = { xs.c_str(), ys.c_str(), zs.c_str() };
+	const int argLen[] = { (int)xs.size(), (int)ys.size(), (int)zs.size() };
+	const int argFmt[] = { 0, 0, 0 };
+
+	PGresult *results = execPrepared("read_blocks", ARRLEN(args), args,
+			argLen, argFmt, false);
+
+	unordered_map_v3POS<std::string> blocks;
+	int numrows = PQntuples(results);
+	for (int row = 0; row < numrows; ++row) {
+		v3s16 p(pg_binary_to_int(results, row, 0),
+				pg_binary_to_int(results, row, 1),
+				pg_binary_to_int(results, row, 2));
+		blocks[p] = std::string(PQgetvalue(results, row, 3),
+				PQgetlength(results, row, 3));
+	}
+
+	PQclear(results);
+
+	std::string empty;
+	for (const auto &p : pos) {
+		auto it = blocks.find(p);
+		if (it == blocks.end()) {
+			empty.clear();
+			callback(p, empty);
+		} else {
+			callback(p, it->second);
+		}
+	}
+}
+
+size_t Database_PostgreSQL::saveBlocks(const blocks_batch &blocks)
+{
+	verifyDatabase();
+
+	// Can be called inside of beginSave()/endSave()
+	bool own_transaction = PQtransactionStatus(m_conn) == PQTRANS_IDLE;
+	if (own_transaction)
+		beginSave();
+	size_t saved = 0;
+	for (const auto &block : blocks)
+		if (saveBlock(block.first, block.second))
+			++saved;
+	if (own_transaction)
+		endSave();
+	return saved;
+}
+
 bool Database_PostgreSQL::deleteBlock(const v3s16 &pos)
 {
 	verifyDatabase();
@@ -141,6 +141,86 @@ void Database_Redis::loadBlock(const v3s16 &pos, std::string *block)
 		"Redis command 'HGET %s %s' gave invalid reply."));
 }
 
+void Database_Redis::loadBlocks(const std::vector<v3s16> &pos, const load_callback &callback)
+{
+	if (pos.empty())
+		return;
+
+	// HMGET hash field1 field2 ... : one round trip for whole batch
+	std::vector<std::string> keys;
+	keys.reserve(pos.size());
+	for (const auto &p : pos)
+		keys.push_back(i64tos(getBlockAsInteger(p)));
+
+	std::vector<const char *> argv;
+	std::vector<size_t> argvlen;
+	argv.reserve(keys.size() + 2);
+	argvlen.reserve(keys.size() + 2);
+	argv.push_back("HMGET");
+	argvlen.push_back(5);
+	argv.push_back(hash.c_str());
+	argvlen.push_back(hash.size());
+	for (const auto &key : keys) {
+		argv.push_back(key.c_str());
+		argvlen.push_back(key.size());
+	}
+
+	redisReply *reply = static_cast<redisReply *>(redisCommandArgv(ctx,
+			argv.size(), argv.data(), argvlen.data()));
+	if (!reply) {
+		throw DatabaseException(std::string(
+			"Redis command 'HMGET %s ...' failed: ") + ctx->errstr);
+	}
+	if (reply->type != REDIS_REPLY_ARRAY || reply->elements != pos.size()) {
+		std::string errstr = reply->type == REDIS_REPLY_ERROR ?
+			std::string(reply->str, reply->len) : "invalid reply";
+		freeReplyObject(reply);
+		throw DatabaseException(std::string(
+			"Redis command 'HMGET %s ...' errored: ") + errstr);
+	}
+
+	std::vector<std::string> blocks(pos.size());
+	for (size_t i = 0; i < reply->elements; ++i) {
+		redisReply *element = reply->element[i];
+		if (element->type == REDIS_REPLY_STRING)
+			blocks[i] = std::string(element->str, element->len);
+	}
+	freeReplyObject(reply);
+
+	for (size_t i = 0; i < pos.size(); ++i)
+		callback(pos[i], blocks[i]);
+}
+
+size_t Database_Redis::saveBlocks(const blocks_batch &blocks)
+{
+	// Pipelining: send all commands, then read all replies
+	for (const auto &block : blocks) {
+		std::string tmp = i64tos(getBlockAsInteger(block.first));
+		if (redisAppendCommand(ctx, "HSET %s %s %b", hash.c_str(), tmp.c_str(),
+				block.second.c_str(), block.second.size()) != REDIS_OK) {
+			throw DatabaseException(std::string(
+				"Redis command 'HSET' append failed: ") + ctx->errstr);
+		}
+	}
+
+	size_t saved = 0;
+	for (const auto &block : blocks) {
+		redisReply *reply = nullptr;
+		if (redisGetReply(ctx, (void **)&reply) != REDIS_OK || !reply) {
+			throw DatabaseException(std::string(
+				"Redis command 'HSET' failed: ") + ctx->errstr);
+		}
+		if (reply->type == REDIS_REPLY_ERROR) {
+			warningstream << "saveBlocks: saving block " << PP(block.first)
+				<< " failed: " << std::string(reply->str, reply->len) << std::endl;
+		} else {
+			++saved;
+		}
+		freeReplyObject(reply);
+	}
+	return saved;
+}
+
 bool Database_Redis::deleteBlock(const v3s16 &pos)
 {
 	std::string tmp = i64tos(getBlockAsInteger(pos));
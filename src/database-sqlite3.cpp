@@ -123,14 +123,21 @@ Database_SQLite3::Database_SQLite3(const std::string &savedir) :
 
 void Database_SQLite3::beginSave() {
 	verifyDatabase();
-	SQLRES(sqlite3_step(m_stmt_begin), SQLITE_DONE,
+	// Held till endSave(): other threads can not commit this transaction or start own
+	m_transaction_mutex.lock();
+	int res = sqlite3_step(m_stmt_begin);
+	if (res != SQLITE_DONE)
+		m_transaction_mutex.unlock();
+	SQLRES(res, SQLITE_DONE,
 		"Failed to start SQLite3 transaction");
 	sqlite3_reset(m_stmt_begin);
 }
 
 void Database_SQLite3::endSave() {
 	verifyDatabase();
-	SQLRES(sqlite3_step(m_stmt_end), SQLITE_DONE,
+	int res = sqlite3_step(m_stmt_end);
+	m_transaction_mutex.unlock();
+	SQLRES(res, SQLITE_DONE,
 		"Failed to commit SQLite3 transaction");
 	sqlite3_reset(m_stmt_end);
 }
@@ -219,6 +226,11 @@ bool Database_SQLite3::saveBlock(const v3s16 &pos, const std::string &data)
 
 	verifyDatabase();
 
+	return writeBlock(pos, data);
+}
+
+bool Database_SQLite3::writeBlock(const v3s16 &pos, const std::string &data)
+{
 #ifdef __ANDROID__
 	/**
 	 * Note: For some unknown reason SQLite3 fails to REPLACE blocks on Android,
@@ -248,6 +260,11 @@ void Database_SQLite3::loadBlock(const v3s16 &pos, std::string *block)
 
 	verifyDatabase();
 
+	readBlock(pos, block);
+}
+
+void Database_SQLite3::readBlock(const v3s16 &pos, std::string *block)
+{
 	bindPos(m_stmt_read, pos);
 
 	if (sqlite3_step(m_stmt_read) != SQLITE_ROW) {
@@ -265,6 +282,43 @@ void Database_SQLite3::loadBlock(const v3s16 &pos, std::string *block)
 	sqlite3_reset(m_stmt_read);
 }
 
+void Database_SQLite3::loadBlocks(const std::vector<v3s16> &pos, const load_callback &callback)
+{
+	std::vector<std::string> blocks(pos.size());
+	{
+		std::lock_guard<Mutex> lock(mutex);
+
+		verifyDatabase();
+
+		for (size_t i = 0; i < pos.size(); ++i)
+			readBlock(pos[i], &blocks[i]);
+	}
+	// Without lock: callback can use database
+	for (size_t i = 0; i < pos.size(); ++i)
+		callback(pos[i], blocks[i]);
+}
+
+size_t Database_SQLite3::saveBlocks(const blocks_batch &blocks)
+{
+	// Before mutex, same order as beginSave() + saveBlock()
+	std::lock_guard<RecursiveMutex> transaction_lock(m_transaction_mutex);
+	std::lock_guard<Mutex> lock(mutex);
+
+	verifyDatabase();
+
+	// Can be called inside of beginSave()/endSave() of this thread
+	bool own_transaction = sqlite3_get_autocommit(m_database);
+	if (own_transaction)
+		beginSave();
+	size_t saved = 0;
+	for (const auto &block : blocks)
+		if (writeBlock(block.first, block.second))
+			++saved;
+	if (own_transaction)
+		endSave();
+	return saved;
+}
+
 void Database_SQLite3::createDatabase()
 {
 	assert(m_database); // Pre-condition
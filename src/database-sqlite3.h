@@ -47,6 +47,8 @@ class Database_SQLite3 : public Database
 
 	bool saveBlock(const v3s16 &pos, const std::string &data);
 	void loadBlock(const v3s16 &pos, std::string *block);
+	void loadBlocks(const std::vector<v3s16> &pos, const load_callback &callback);
+	size_t saveBlocks(const blocks_batch &blocks);
 	bool deleteBlock(const v3s16 &pos);
 	void listAllLoadableBlocks(std::vector<v3s16> &dst);
 	bool initialized() const { return m_initialized; }
@@ -61,6 +63,10 @@ class Database_SQLite3 : public Database
 
 	void bindPos(sqlite3_stmt *stmt, const v3s16 &pos, int index=1);
 
+	// Unlocked versions, mutex must be held
+	bool writeBlock(const v3s16 &pos, const std::string &data);
+	void readBlock(const v3s16 &pos, std::string *block);
+
 	bool m_initialized;
 
 	std::string m_savedir;
@@ -74,6 +80,8 @@ class Database_SQLite3 : public Database
 	sqlite3_stmt *m_stmt_end;
 
 	Mutex mutex;
+	// Held by thread between beginSave() and endSave()
+	RecursiveMutex m_transaction_mutex;
 
 	s64 m_busy_handler_data[2];
 
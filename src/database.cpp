@@ -72,6 +72,24 @@ v3s16 Database::getIntegerAsBlock(s64 i)
 	return pos;
 }
 
+void Database::loadBlocks(const std::vector<v3s16> &pos, const load_callback &callback)
+{
+	for (const auto &p : pos) {
+		std::string data;
+		loadBlock(p, &data);
+		callback(p, data);
+	}
+}
+
+size_t Database::saveBlocks(const blocks_batch &blocks)
+{
+	size_t saved = 0;
+	for (const auto &block : blocks)
+		if (saveBlock(block.first, block.second))
+			++saved;
+	return saved;
+}
+
 std::string Database::getBlockAsString(const v3s16 &pos) const {
 	std::ostringstream os;
 	os << "a" << pos.X << "," << pos.Y << "," << pos.Z;
@@ -25,6 +25,7 @@ along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <vector>
 #include <string>
+#include <functional>
 #include "irr_v3d.h"
 #include "irrlichttypes.h"
 #include <string>
@@ -45,6 +46,14 @@ class Database
 	virtual void loadBlock(const v3s16 &pos, std::string *block) = 0;
 	virtual bool deleteBlock(const v3s16 &pos) = 0;
 
+	// Batch access: one round trip / transaction for many blocks.
+	// Callback called once for every requested pos, data is empty if block not found.
+	typedef std::function<void(const v3s16 &pos, std::string &data)> load_callback;
+	typedef std::vector<std::pair<v3s16, std::string>> blocks_batch;
+	virtual void loadBlocks(const std::vector<v3s16> &pos, const load_callback &callback);
+	// Returns count of saved blocks
+	virtual size_t saveBlocks(const blocks_batch &blocks);
+
 	static s64 getBlockAsInteger(const v3s16 &pos);
 	static v3s16 getIntegerAsBlock(s64 i);
 
@@ -185,6 +185,7 @@ void fm_set_default_settings(Settings *settings) {
 	settings->setDefault("liquid_send", android ? "3.0" : "1.0");
 	settings->setDefault("liquid_relax", android ? "1" : "2");
 	settings->setDefault("liquid_fast_flood", "-200");
+	settings->setDefault("liquid_threads", "0");
 
 	// Weather
 	settings->setDefault("weather", threads ? "true" : "false");
@@ -218,16 +219,19 @@ void fm_set_default_settings(Settings *settings) {
 	settings->setDefault("timeout_mul", android ? "5" : "1");
 	settings->setDefault("default_game", "default"); // "minetest"
 	settings->setDefault("max_users", "100"); // "15"
+	settings->setDefault("enet_threads", "1");
 	settings->setDefault("enable_any_name", "0"); // WARNING! SETTING TO "1" COULD CAUSE SECURITY RISKS WITH MODULES WITH PLAYER DATA IN FILES CONTAINS PLAYER NAME IN FILENAME
 	settings->setDefault("default_privs_creative", "interact, shout, fly, fast");
 	settings->setDefault("vertical_spawn_range", "50"); // "16"
 	settings->setDefault("cache_block_before_spawn", "true");
 	settings->setDefault("abm_random", android ? "false" : "true");
+	settings->setDefault("abm_threads", "0");
 	settings->setDefault("active_block_range", android ? "1" : threads ? "4" : "2");
 	settings->setDefault("abm_neighbors_range_max", (threads && !win32 && !android) ? "16" : "1");
 	settings->setDefault("enable_force_load", "true");
 	settings->setDefault("max_simultaneous_block_sends_per_client", "50"); // "10"
 	settings->setDefault("max_block_send_distance", "30"); // "9"
+	settings->setDefault("block_delta_max_nodes", "256");
 	settings->setDefault("server_unload_unused_data_timeout", "65"); // "29"
 	settings->setDefault("max_objects_per_block", "100"); // "49"
 	settings->setDefault("server_occlusion", "true");
@@ -236,8 +240,13 @@ void fm_set_default_settings(Settings *settings) {
 	settings->setDefault("emergequeue_limit_generate", ""); // autodetect from number of cpus
 	settings->setDefault("emergequeue_limit_total", ""); // autodetect from number of cpus
 	settings->setDefault("num_emerge_threads", ""); // "1"
+	settings->setDefault("emerge_load_batch", "16");
+	settings->setDefault("emerge_load_threads", "1");
+	settings->setDefault("mapgen_noise_cache", "512");
 	settings->setDefault("server_map_save_interval", "300"); // "5.3"
 	settings->setDefault("sqlite_synchronous", "1"); // "2"
+	settings->setDefault("block_compression", "zlib");
+	settings->setDefault("block_compression_level", "-1");
 	settings->setDefault("save_generated_block", "true");
 	settings->setDefault("block_delete_time", threads && arm ? "60" : threads ? "30" : "10");
 
@@ -271,6 +280,11 @@ void fm_set_default_settings(Settings *settings) {
 	settings->setDefault("animation_wd_stop", "219");
 */
 	settings->setDefault("more_threads", "true");
+	settings->setDefault("server_workers", "0");
+	settings->setDefault("server_async_threads", "2");
+	settings->setDefault("pathfinder_max_iterations", "100000");
+	settings->setDefault("pathfinder_max_time", "200");
+	settings->setDefault("pathfinder_graph_cache", "1024");
 	settings->setDefault("console_enabled", debug ? "true" : "false");
 
 	if (win32) {
@@ -24,14 +24,17 @@ along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
 #include "emerge.h"
 
 #include <iostream>
-#include <queue>
+#include <deque>
+#include <algorithm>
 
 #include "util/container.h"
+#include "util/unordered_map_hash.h"
 #include "util/thread.h"
 #include "threading/event.h"
 
 #include "config.h"
 #include "constants.h"
+#include "database.h"
 #include "environment.h"
 #include "log_types.h"
 #include "map.h"
@@ -48,6 +51,7 @@ along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
 #include "mg_decoration.h"
 #include "mg_schematic.h"
 #include "nodedef.h"
+#include "porting.h"
 #include "profiler.h"
 #include "scripting_game.h"
 #include "server.h"
@@ -93,18 +97,71 @@ class EmergeThread : public thread_pool {
 	Mapgen *m_mapgen;
 
 	Event m_queue_event;
-	std::queue<v3s16> m_block_queue;
+	std::deque<v3s16> m_block_queue;
 
 	bool popBlockEmerge(v3s16 *pos, BlockEmergeData *bedata);
 
 	EmergeAction getBlockOrStartGen(
-		v3s16 pos, bool allow_gen, MapBlock **block, BlockMakeData *data);
+		v3s16 pos, MapBlock **block, BlockMakeData *data);
 	MapBlock *finishGen(v3s16 pos, BlockMakeData *bmdata,
 		std::map<v3s16, MapBlock *> *modified_blocks);
 
 	friend class EmergeManager;
 };
 
+/*
+	First stage of emerge: gets blocks from memory or database.
+	Only blocks which must be generated are passed to EmergeThread queues,
+	so loading of existing blocks never waits behind long chunk generation.
+*/
+class EmergeLoadThread : public thread_pool {
+public:
+	int id;
+
+	EmergeLoadThread(Server *server, int id);
+
+	void *run();
+
+private:
+	Server *m_server;
+	ServerMap *m_map;
+	EmergeManager *m_emerge;
+
+	// Data of queued blocks read from database by one batch request
+	struct Prefetched {
+		std::string data;
+		u32 time;
+	};
+	unordered_map_v3POS<Prefetched> m_prefetched;
+
+	bool popBlockLoad(v3s16 *pos, BlockEmergeData *bedata);
+	void prefetchBlocks(v3s16 pos);
+	EmergeAction loadBlock(v3s16 pos);
+};
+
+static void setLoadError(Server *server, v3s16 pos,
+	const std::exception &e, bool version_mismatch)
+{
+	std::ostringstream err;
+	if (version_mismatch) {
+		err << "World data version mismatch in MapBlock " << PP(pos) << std::endl
+			<< "----" << std::endl
+			<< "\"" << e.what() << "\"" << std::endl
+			<< "See debug.txt." << std::endl
+			<< "World probably saved by a newer version of " PROJECT_NAME_C "."
+			<< std::endl;
+	} else {
+		err << "Invalid data in MapBlock " << PP(pos) << std::endl
+			<< "----" << std::endl
+			<< "\"" << e.what() << "\"" << std::endl
+			<< "See debug.txt." << std::endl
+			<< "You can ignore this using [ignore_world_load_errors = true]."
+			<< std::endl;
+	}
+	debug_stacks_print();
+	server->setAsyncFatalError(err.str());
+}
+
 ////
 //// Built-in mapgens
 ////
@@ -158,6 +215,8 @@ EmergeManager::EmergeManager(IGameDef *gamedef)
 		{ }
 	if (!g_settings->getU16NoEx("emergequeue_limit_generate", m_qlimit_generate))
 		{ }
+	m_load_batch = g_settings->getU16("emerge_load_batch");
+	noise_cache.setLimit(g_settings->getU16("mapgen_noise_cache"));
 	//errorstream<<"==> qlimit_generate="<<qlimit_generate<<"  qlimit_diskonly="<<qlimit_diskonly<<" qlimit_total="<<qlimit_total<<std::endl;
 
 	// don't trust user input for something very important like this
@@ -171,12 +230,29 @@ EmergeManager::EmergeManager(IGameDef *gamedef)
 	for (s16 i = 0; i < nthreads; i++)
 		m_threads.push_back(new EmergeThread((Server *)gamedef, i));
 
-	infostream << "EmergeManager: using " << nthreads << " threads" << std::endl;
+	s16 nload_threads = g_settings->getS16("emerge_load_threads");
+	if (nload_threads < 1)
+		nload_threads = 1;
+	for (s16 i = 0; i < nload_threads; i++)
+		m_load_threads.push_back(new EmergeLoadThread((Server *)gamedef, i));
+
+	infostream << "EmergeManager: using " << nthreads << " threads, "
+		<< nload_threads << " load threads" << std::endl;
 }
 
 
 EmergeManager::~EmergeManager()
 {
+	for (auto thread : m_load_threads) {
+		if (m_threads_active) {
+			thread->stop();
+			m_load_semaphore.post();
+			thread->wait();
+		}
+
+		delete thread;
+	}
+
 	for (u32 i = 0; i != m_threads.size(); i++) {
 		EmergeThread *thread = m_threads[i];
 
@@ -256,6 +332,9 @@ void EmergeManager::startThreads()
 	for (u32 i = 0; i != m_threads.size(); i++)
 		m_threads[i]->start();
 
+	for (auto thread : m_load_threads)
+		thread->start();
+
 	m_threads_active = true;
 }
 
@@ -266,19 +345,52 @@ void EmergeManager::stopThreads()
 		return;
 
 	// Request thread stop in parallel
+	for (auto thread : m_load_threads) {
+		thread->stop();
+		m_load_semaphore.post();
+	}
 	for (u32 i = 0; i != m_threads.size(); i++) {
 		m_threads[i]->stop();
 		m_threads[i]->signal();
 	}
 
 	// Then do the waiting for each
+	for (auto thread : m_load_threads)
+		thread->wait();
 	for (u32 i = 0; i != m_threads.size(); i++)
 		m_threads[i]->wait();
 
+	cancelPendingItems();
+
 	m_threads_active = false;
 }
 
 
+void EmergeManager::cancelPendingItems()
+{
+	// Callbacks may enqueue again, run them without lock
+	std::vector<std::pair<v3s16, EmergeCallbackList>> cancelled;
+	{
+		MutexAutoLock queuelock(m_queue_mutex);
+		while (!m_load_queue.empty()) {
+			BlockEmergeData bedata;
+			v3s16 pos = m_load_queue.front();
+			m_load_queue.pop_front();
+
+			// Entry already taken by other queue item
+			if (!popBlockEmergeData(pos, &bedata))
+				continue;
+			cancelled.emplace_back(pos, bedata.callbacks);
+		}
+	}
+	for (const auto &item : cancelled)
+		EmergeThread::runCompletionCallbacks(item.first, EMERGE_CANCELLED, item.second);
+
+	for (u32 i = 0; i != m_threads.size(); i++)
+		m_threads[i]->cancelPendingItems();
+}
+
+
 bool EmergeManager::isRunning()
 {
 	return m_threads_active;
@@ -308,7 +420,6 @@ bool EmergeManager::enqueueBlockEmergeEx(
 	EmergeCompletionCallback callback,
 	void *callback_param)
 {
-	EmergeThread *thread = NULL;
 	bool entry_already_exists = false;
 
 	{
@@ -321,11 +432,10 @@ bool EmergeManager::enqueueBlockEmergeEx(
 		if (entry_already_exists)
 			return true;
 
-		thread = getOptimalThread();
-		thread->pushBlock(blockpos);
+		m_load_queue.push_back(blockpos);
 	}
 
-	thread->signal();
+	m_load_semaphore.post();
 
 	return true;
 }
@@ -445,6 +555,7 @@ bool EmergeManager::pushBlockEmergeData(
 	} else {
 		bedata.flags = flags;
 		bedata.peer_requested = peer_requested;
+		bedata.time_queued = bedata.time_loaded = porting::getTimeMs();
 
 		count_peer++;
 	}
@@ -531,7 +642,7 @@ void EmergeThread::signal()
 
 bool EmergeThread::pushBlock(v3s16 pos)
 {
-	m_block_queue.push(pos);
+	m_block_queue.push_back(pos);
 	return true;
 }
 
@@ -545,7 +656,7 @@ void EmergeThread::cancelPendingItems()
 		v3s16 pos;
 
 		pos = m_block_queue.front();
-		m_block_queue.pop();
+		m_block_queue.pop_front();
 
 		m_emerge->popBlockEmergeData(pos, &bedata);
 
@@ -579,7 +690,7 @@ bool EmergeThread::popBlockEmerge(v3s16 *pos, BlockEmergeData *bedata)
 		return false;
 
 	*pos = m_block_queue.front();
-	m_block_queue.pop();
+	m_block_queue.pop_front();
 
 	m_emerge->popBlockEmergeData(*pos, bedata);
 
@@ -590,44 +701,18 @@ bool EmergeThread::popBlockEmerge(v3s16 *pos, BlockEmergeData *bedata)
 
 
 EmergeAction EmergeThread::getBlockOrStartGen(
-	v3s16 pos, bool allow_gen, MapBlock **block, BlockMakeData *bmdata)
+	v3s16 pos, MapBlock **block, BlockMakeData *bmdata)
 {
-	//MutexAutoLock envlock(m_server->m_env_mutex);
-
-	{
 	MAP_NOTHREAD_LOCK(m_map);
-	// 1). Attempt to fetch block from memory
+
+	// 1). Block could be generated by other thread while queued
 	*block = m_map->getBlockNoCreateNoEx(pos, false, true);
-	}
 	if (*block && !(*block)->isDummy() && (*block)->isGenerated())
 		return EMERGE_FROM_MEMORY;
 
-	{
-	MAP_NOTHREAD_LOCK(m_map);
-	// 2). Attempt to load block from disk
-	*block = m_map->loadBlock(pos);
-	}
-
-	if (*block && (*block)->isGenerated())
-	{
-		MAP_NOTHREAD_LOCK(m_map);
-		m_map->prepareBlock(*block);
-		return EMERGE_FROM_DISK;
-	}
-
-	{
-	MAP_NOTHREAD_LOCK(m_map);
-	// 3). Attempt to start generation
-	if (allow_gen && m_map->initBlockMake(pos, bmdata))
+	// 2). Attempt to start generation
+	if (m_map->initBlockMake(pos, bmdata))
 		return EMERGE_GENERATED;
-	}
-
-/*
-	verbosestream << "EmergeThread::getBlockOrStartGen : cancel pos=" << pos << " block="<< *block;
-	if (*block)
-		verbosestream << "dummy=" << (*block)->isDummy() << " generated="<< (*block)->isGenerated();
-	verbosestream << std::endl;
-*/
 
 	// All attempts failed; cancel this block emerge
 	return EMERGE_CANCELLED;
@@ -638,8 +723,6 @@ MapBlock *EmergeThread::finishGen(v3s16 pos, BlockMakeData *bmdata,
 	std::map<v3s16, MapBlock *> *modified_blocks)
 {
 	//MutexAutoLock envlock(m_server->m_env_mutex);
-	ScopeProfiler sp(g_profiler,
-		"EmergeThread: after Mapgen::makeChunk", SPT_AVG);
 
 	/*
 		Perform post-processing on blocks (invalidate lighting, queue liquid
@@ -716,17 +799,14 @@ void *EmergeThread::run()
 			continue;
 		}
 
-		if (blockpos_over_limit(pos))
-			continue;
+		EMERGE_DBG_OUT("pos=" PP(pos));
 
-		bool allow_gen = bedata.flags & BLOCK_EMERGE_ALLOW_GEN;
-		EMERGE_DBG_OUT("pos=" PP(pos) " allow_gen=" << allow_gen);
+		u32 time_start = porting::getTimeMs();
+		g_profiler->histogram("Emerge: generate wait", time_start - bedata.time_loaded);
 
-		action = getBlockOrStartGen(pos, allow_gen, &block, &bmdata);
+		action = getBlockOrStartGen(pos, &block, &bmdata);
 		if (action == EMERGE_GENERATED) {
 			{
-				ScopeProfiler sp(g_profiler,
-					"EmergeThread: Mapgen::makeChunk", SPT_AVG);
 				TimeTaker t("mapgen::make_block()");
 
 				m_mapgen->makeChunk(&bmdata);
@@ -735,44 +815,31 @@ void *EmergeThread::run()
 					t.stop(true); // Hide output
 			}
 
+			u32 time_generated = porting::getTimeMs();
+			g_profiler->histogram("Emerge: generate", time_generated - time_start);
+
 			block = finishGen(pos, &bmdata, &modified_blocks);
+
+			g_profiler->histogram("Emerge: finish", porting::getTimeMs() - time_generated);
 		}
 
 		runCompletionCallbacks(pos, action, bedata.callbacks);
+		g_profiler->histogram("Emerge: total", porting::getTimeMs() - bedata.time_queued);
 
-		if (block) {
-			//modified_blocks[pos] = block;
-		} else if (allow_gen) {
+		if (!block)
 			verbosestream<<"nothing generated at "<<pos<< " emerge action="<< action <<std::endl;
-		}
 
 		if (modified_blocks.size() > 0)
-			m_server->SetBlocksNotSent(/*modified_blocks*/);
+			m_server->SetBlocksNotSent(modified_blocks);
 
 		if (m_mapgen->heat_cache.size() > 1000) {
 			m_mapgen->heat_cache.clear();
 			m_mapgen->humidity_cache.clear();
 		}
 	} catch (VersionMismatchException &e) {
-		std::ostringstream err;
-		err << "World data version mismatch in MapBlock " << PP(pos) << std::endl
-			<< "----" << std::endl
-			<< "\"" << e.what() << "\"" << std::endl
-			<< "See debug.txt." << std::endl
-			<< "World probably saved by a newer version of " PROJECT_NAME_C "."
-			<< std::endl;
-		debug_stacks_print();
-		m_server->setAsyncFatalError(err.str());
+		setLoadError(m_server, pos, e, true);
 	} catch (SerializationError &e) {
-		std::ostringstream err;
-		err << "Invalid data in MapBlock " << PP(pos) << std::endl
-			<< "----" << std::endl
-			<< "\"" << e.what() << "\"" << std::endl
-			<< "See debug.txt." << std::endl
-			<< "You can ignore this using [ignore_world_load_errors = true]."
-			<< std::endl;
-		debug_stacks_print();
-		m_server->setAsyncFatalError(err.str());
+		setLoadError(m_server, pos, e, false);
 	} catch (std::exception &e) {
 		errorstream << m_name << ": exception at " << pos << " : " << e.what() << std::endl;
 	}
@@ -781,3 +848,210 @@ void *EmergeThread::run()
 	END_DEBUG_EXCEPTION_HANDLER
 	return NULL;
 }
+
+
+////
+//// EmergeLoadThread
+////
+
+EmergeLoadThread::EmergeLoadThread(Server *server, int id) :
+	id(id),
+	m_server(server),
+	m_map(NULL),
+	m_emerge(NULL)
+{
+	m_name = "EmergeLoad-" + itos(id);
+}
+
+
+// Block stays in m_blocks_enqueued (and in queue limits) until it is done
+bool EmergeLoadThread::popBlockLoad(v3s16 *pos, BlockEmergeData *bedata)
+{
+	MutexAutoLock queuelock(m_emerge->m_queue_mutex);
+
+	if (m_emerge->m_load_queue.empty())
+		return false;
+
+	*pos = m_emerge->m_load_queue.front();
+	m_emerge->m_load_queue.pop_front();
+
+	auto it = m_emerge->m_blocks_enqueued.find(*pos);
+	if (it == m_emerge->m_blocks_enqueued.end()) {
+		m_prefetched.erase(*pos);
+		return false;
+	}
+
+	bedata->flags = it->second.flags;
+	bedata->time_queued = it->second.time_queued;
+
+	return true;
+}
+
+
+/*
+	Read data of pos and nearby queued blocks with one database request,
+	queue from clients is sorted by distance so neighbours come together.
+*/
+void EmergeLoadThread::prefetchBlocks(v3s16 pos)
+{
+	const u16 batch_max = m_emerge->m_load_batch;
+	if (batch_max <= 1)
+		return;
+
+	// Drop old data: block could be loaded, changed and saved by others
+	u32 now = porting::getTimeMs();
+	for (auto it = m_prefetched.begin(); it != m_prefetched.end();) {
+		if (now - it->second.time > 1000)
+			it = m_prefetched.erase(it);
+		else
+			++it;
+	}
+
+	if (m_prefetched.count(pos))
+		return;
+
+	std::vector<v3s16> batch;
+	batch.push_back(pos);
+	{
+		MutexAutoLock queuelock(m_emerge->m_queue_mutex);
+		for (const auto &p : m_emerge->m_load_queue) {
+			if (batch.size() >= batch_max)
+				break;
+			if (std::abs(p.X - pos.X) > 2 || std::abs(p.Y - pos.Y) > 2 ||
+					std::abs(p.Z - pos.Z) > 2 || m_prefetched.count(p))
+				continue;
+			batch.push_back(p);
+		}
+	}
+
+	// Not needed: already in memory
+	batch.erase(std::remove_if(batch.begin(), batch.end(), [this](const v3s16 &p) {
+		auto block = m_map->getBlockNoCreateNoEx(p, false, true);
+		return block && !block->isDummy() && block->isGenerated();
+	}), batch.end());
+
+	if (batch.size() <= 1)
+		return;
+
+	ScopeProfiler sp(g_profiler, "EmergeThread: load batch", SPT_AVG);
+	g_profiler->avg("EmergeThread: load batch size", batch.size());
+	m_map->dbase->loadBlocks(batch, [this, now](const v3s16 &p, std::string &data) {
+		auto &prefetched = m_prefetched[p];
+		prefetched.data.swap(data);
+		prefetched.time = now;
+	});
+}
+
+
+EmergeAction EmergeLoadThread::loadBlock(v3s16 pos)
+{
+	MapBlock *block;
+
+	{
+	MAP_NOTHREAD_LOCK(m_map);
+	// 1). Attempt to fetch block from memory
+	block = m_map->getBlockNoCreateNoEx(pos, false, true);
+	}
+	if (block && !block->isDummy() && block->isGenerated()) {
+		// Block in memory can be newer than its data read before
+		m_prefetched.erase(pos);
+		return EMERGE_FROM_MEMORY;
+	}
+
+	{
+	MAP_NOTHREAD_LOCK(m_map);
+	// 2). Attempt to load block from disk
+	auto it = m_prefetched.find(pos);
+	if (it != m_prefetched.end()) {
+		block = m_map->loadBlock(pos, &it->second.data);
+		m_prefetched.erase(it);
+	} else {
+		block = m_map->loadBlock(pos);
+	}
+	}
+
+	if (block && block->isGenerated()) {
+		MAP_NOTHREAD_LOCK(m_map);
+		m_map->prepareBlock(block);
+		return EMERGE_FROM_DISK;
+	}
+
+	// Not found, must be generated
+	return EMERGE_CANCELLED;
+}
+
+
+void *EmergeLoadThread::run()
+{
+	DSTACK(FUNCTION_NAME);
+	BEGIN_DEBUG_EXCEPTION_HANDLER
+
+	m_map    = (ServerMap *)&(m_server->m_env->getMap());
+	m_emerge = m_server->m_emerge;
+
+	reg("EmergeLoadThread" + itos(id), 5);
+
+	while (!stopRequested()) {
+		v3s16 pos;
+		BlockEmergeData bedata;
+
+		m_emerge->m_load_semaphore.wait();
+
+		if (!popBlockLoad(&pos, &bedata))
+			continue;
+
+		u32 time_start = porting::getTimeMs();
+		g_profiler->histogram("Emerge: load wait", time_start - bedata.time_queued);
+
+		EmergeAction action = EMERGE_CANCELLED;
+		bool can_generate = !blockpos_over_limit(pos);
+		try {
+			if (can_generate) {
+				prefetchBlocks(pos);
+				action = loadBlock(pos);
+			}
+		} catch (VersionMismatchException &e) {
+			setLoadError(m_server, pos, e, true);
+			action = EMERGE_ERRORED;
+		} catch (SerializationError &e) {
+			setLoadError(m_server, pos, e, false);
+			action = EMERGE_ERRORED;
+		} catch (std::exception &e) {
+			errorstream << m_name << ": exception at " << pos << " : " << e.what() << std::endl;
+			action = EMERGE_ERRORED;
+		}
+
+		u32 time_loaded = porting::getTimeMs();
+		g_profiler->histogram("Emerge: load", time_loaded - time_start);
+
+		EmergeThread *thread = NULL;
+		{
+			MutexAutoLock queuelock(m_emerge->m_queue_mutex);
+
+			// Flags are checked again: generation could be requested while loading
+			auto it = m_emerge->m_blocks_enqueued.find(pos);
+			if (it == m_emerge->m_blocks_enqueued.end())
+				continue;
+
+			if (can_generate && action == EMERGE_CANCELLED &&
+					(it->second.flags & BLOCK_EMERGE_ALLOW_GEN)) {
+				it->second.time_loaded = time_loaded;
+				thread = m_emerge->getOptimalThread();
+				thread->pushBlock(pos);
+			} else {
+				m_emerge->popBlockEmergeData(pos, &bedata);
+			}
+		}
+
+		if (thread) {
+			thread->signal();
+			continue;
+		}
+
+		EmergeThread::runCompletionCallbacks(pos, action, bedata.callbacks);
+		g_profiler->histogram("Emerge: total", porting::getTimeMs() - bedata.time_queued);
+	}
+
+	END_DEBUG_EXCEPTION_HANDLER
+	return NULL;
+}
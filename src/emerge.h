@@ -24,10 +24,13 @@ along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
 #define EMERGE_HEADER
 
 #include <map>
+#include <deque>
 #include "irr_v3d.h"
+#include "threading/semaphore.h"
 #include "util/container.h"
 #include "mapgen.h" // for MapgenParams
 #include "map.h"
+#include "mg_noise_cache.h"
 
 #define BLOCK_EMERGE_ALLOW_GEN   (1 << 0)
 #define BLOCK_EMERGE_FORCE_QUEUE (1 << 1)
@@ -38,6 +41,7 @@ along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
 } while (0)
 
 class EmergeThread;
+class EmergeLoadThread;
 class INodeDefManager;
 class Settings;
 //class ServerEnvironment;
@@ -89,6 +93,10 @@ struct BlockEmergeData {
 	u16 peer_requested;
 	u16 flags;
 	EmergeCallbackList callbacks;
+
+	// porting::getTimeMs() of enqueue and of handoff to generation stage
+	u32 time_queued;
+	u32 time_loaded;
 };
 
 class EmergeManager {
@@ -111,6 +119,9 @@ class EmergeManager {
 	DecorationManager *decomgr;
 	SchematicManager *schemmgr;
 
+	// 2D noise maps shared by mapgens of all threads
+	NoiseMapCache noise_cache;
+
 	// Methods
 	EmergeManager(IGameDef *gamedef);
 	~EmergeManager();
@@ -153,15 +164,21 @@ class EmergeManager {
 private:
 	std::vector<Mapgen *> m_mapgens;
 	std::vector<EmergeThread *> m_threads;
+	std::vector<EmergeLoadThread *> m_load_threads;
 	bool m_threads_active;
 
 	Mutex m_queue_mutex;
 	std::map<v3s16, BlockEmergeData> m_blocks_enqueued;
 	std::map<u16, u16> m_peer_queue_count;
 
+	// First stage: blocks to get from memory or database
+	std::deque<v3s16> m_load_queue;
+	Semaphore m_load_semaphore;
+
 	u16 m_qlimit_total;
 	u16 m_qlimit_diskonly;
 	u16 m_qlimit_generate;
+	u16 m_load_batch;
 
 	// Requires m_queue_mutex held
 	EmergeThread *getOptimalThread();
@@ -175,8 +192,12 @@ class EmergeManager {
 		bool *entry_already_exists);
 
 	bool popBlockEmergeData(v3s16 pos, BlockEmergeData *bedata);
+	// Runs callbacks of not processed blocks with EMERGE_CANCELLED,
+	// threads must be stopped
+	void cancelPendingItems();
 
 	friend class EmergeThread;
+	friend class EmergeLoadThread;
 
 	DISABLE_CLASS_COPY(EmergeManager);
 };
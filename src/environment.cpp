@@ -20,6 +20,7 @@ You should have received a copy of the GNU General Public License
 along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
 #include <fstream>
 #include "environment.h"
 #include "filesys.h"
@@ -57,6 +58,7 @@ along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
 #include "key_value_storage.h"
 #include <random>
 #include "threading/mutex_auto_lock.h"
+#include "threading/task_scheduler.h"
 
 #define PP(x) "("<<(x).X<<","<<(x).Y<<","<<(x).Z<<")"
 
@@ -631,6 +633,7 @@ ServerEnvironment::ServerEnvironment(ServerMap *map,
 	m_game_time = 0;
 	m_use_weather = g_settings->getBool("weather");
 	m_use_weather_biome = g_settings->getBool("weather_biome");
+	m_path_graph_cache.setLimit(g_settings->getU32("pathfinder_graph_cache"));
 
 	// Init custom SAO
 	v3f nullpos;
@@ -960,18 +963,19 @@ void ServerEnvironment::loadDefaultMeta()
 		for(s16 y=-1; y<=1; y++)
 		for(s16 z=-1; z<=1; z++)
 		{
-			MapBlock *block2 = map->getBlockNoCreateNoEx(
-					block->getPos() + v3s16(x,y,z), true);
+			v3s16 p2 = block->getPos() + v3s16(x,y,z);
+			MapBlock *block2 = map->getBlockNoCreateNoEx(p2, true);
 			if(block2==NULL){
 				wider_unknown_count++;
 				continue;
 			}
+			// Active objects by current position from grid, stored from block
+			wider += m_env->m_objects_grid.count(p2);
 			auto lock = block2->m_static_objects.m_active.lock_shared_rec();
-			wider += block2->m_static_objects.m_active.size()
-					+ block2->m_static_objects.m_stored.size();
+			wider += block2->m_static_objects.m_stored.size();
 		}
 		// Extrapolate
-		u32 active_object_count = block->m_static_objects.m_active.size();
+		u32 active_object_count = m_env->m_objects_grid.count(block->getPos());
 		u32 wider_known_count = 3*3*3 - wider_unknown_count;
 		if (wider_known_count)
 		wider += wider_unknown_count * wider / wider_known_count;
@@ -990,6 +994,15 @@ void ServerEnvironment::loadDefaultMeta()
 				block->abm_triggers->clear();
 		}
 
+		// Uniform block (air, stone, water...) without abms for its content
+		content_t content_only;
+		{
+			auto lock = block->lock_shared_rec();
+			content_only = block->content_only;
+		}
+		if (content_only != CONTENT_IGNORE && !m_aabms[content_only])
+			return;
+
 #if ENABLE_THREADS
 		auto map = std::unique_ptr<VoxelManipulator> (new VoxelManipulator);
 		{
@@ -1011,7 +1024,6 @@ void ServerEnvironment::loadDefaultMeta()
 
 		u32 active_object_count_wider;
 		u32 active_object_count = this->countObjects(block, &m_env->getServerMap(), active_object_count_wider);
-		m_env->m_added_objects = 0;
 
 		auto *ndef = m_env->getGameDef()->ndef();
 
@@ -1041,8 +1053,8 @@ void ServerEnvironment::loadDefaultMeta()
 				continue;
 
 			{
-				int hot = ((ItemGroupList) ndef->get(n).groups)["hot"];
-				//todo: int cold = ((ItemGroupList) ndef->get(n).groups)["cold"];
+				int hot = ndef->getGroup(c, CONTENT_GROUP_HOT);
+				//todo: int cold = ndef->getGroup(c, CONTENT_GROUP_COLD);
 				//also humidity todo.
 				if (hot) {
 					++heat_num;
@@ -1050,11 +1062,8 @@ void ServerEnvironment::loadDefaultMeta()
 				}
 			}
 
-			if (!m_aabms[c]) {
-				if (block->content_only != CONTENT_IGNORE)
-					return;
+			if (!m_aabms[c])
 				continue;
-			}
 
 			for(auto & ir: *(m_aabms[c])) {
 				auto i = &ir;
@@ -1380,20 +1389,16 @@ bool ServerEnvironment::swapNode(v3s16 p, const MapNode &n)
 
 void ServerEnvironment::getObjectsInsideRadius(std::vector<u16> &objects, v3f pos, float radius)
 {
-	int obj_null = 0, obj_count = 0;
+	std::vector<u16> candidates;
+	m_objects_grid.getInsideRadius(pos, radius, candidates);
+	if (candidates.empty())
+		return;
 	auto lock = m_active_objects.lock_shared_rec();
-	for(auto
-			i = m_active_objects.begin();
-			i != m_active_objects.end(); ++i)
-	{
-		++obj_count;
-		ServerActiveObject* obj = i->second;
-		if (!obj) {
-			++obj_null;
+	for (auto id : candidates) {
+		ServerActiveObject* obj = nullptr;
+		if (!m_active_objects.get_value(id, obj))
 			continue;
-		}
-		u16 id = i->first;
-		if (obj->m_removed || obj->m_pending_deactivation)
+		if (!obj || obj->m_removed || obj->m_pending_deactivation)
 			continue;
 
 		v3f objectpos = obj->getBasePosition();
@@ -1401,8 +1406,49 @@ void ServerEnvironment::getObjectsInsideRadius(std::vector<u16> &objects, v3f po
 			continue;
 		objects.push_back(id);
 	}
-	if (obj_null)
-		infostream<<"ServerEnvironment::getObjectsInsideRadius(): "<<"got null objects: "<<obj_null<<"/"<<obj_count<<std::endl;
+}
+
+void ServerEnvironment::getObjectsInArea(std::vector<u16> &objects, const aabb3f &box)
+{
+	std::vector<u16> candidates;
+	m_objects_grid.getInsideArea(box, candidates);
+	if (candidates.empty())
+		return;
+	auto lock = m_active_objects.lock_shared_rec();
+	for (auto id : candidates) {
+		ServerActiveObject* obj = nullptr;
+		if (!m_active_objects.get_value(id, obj))
+			continue;
+		if (!obj || obj->m_removed || obj->m_pending_deactivation)
+			continue;
+		if (!box.isPointInside(obj->getBasePosition()))
+			continue;
+		objects.push_back(id);
+	}
+}
+
+std::shared_ptr<const ObjectBoxSnapshot> ServerEnvironment::getObjectBoxSnapshot()
+{
+	std::lock_guard<Mutex> lock(m_object_box_snapshot_mutex);
+	if (m_object_box_snapshot)
+		return m_object_box_snapshot;
+
+	auto snapshot = std::make_shared<ObjectBoxSnapshot>();
+	{
+		auto lock = m_active_objects.lock_shared_rec();
+		for (auto & ir : m_active_objects) {
+			ServerActiveObject *obj = ir.second;
+			if (!obj || obj->m_removed || obj->m_pending_deactivation)
+				continue;
+			aabb3f box;
+			if (obj->getCollisionBox(&box) && obj->collideWithObjects())
+				snapshot->add(obj, box);
+		}
+	}
+	snapshot->finish();
+	g_profiler->add("SEnv: object box snapshot", snapshot->size());
+	m_object_box_snapshot = snapshot;
+	return snapshot;
 }
 
 void ServerEnvironment::clearObjects(ClearObjectsMode mode)
@@ -1452,6 +1498,7 @@ void ServerEnvironment::clearObjects(ClearObjectsMode mode)
 	for (std::vector<u16>::iterator i = objects_to_remove.begin();
 			i != objects_to_remove.end(); ++i) {
 		m_active_objects.erase(*i);
+		m_objects_grid.remove(*i);
 	}
 
 	// Get list of loaded blocks
@@ -1885,6 +1932,11 @@ void ServerEnvironment::step(float dtime, float uptime, unsigned int max_cycle_m
 	{
 		g_profiler->add("SEnv: Objects", objects.size());
 
+		{
+			std::lock_guard<Mutex> lock(m_object_box_snapshot_mutex);
+			m_object_box_snapshot.reset();
+		}
+
 		// This helps the objects to send data at the same time
 		bool send_recommended = false;
 		m_send_recommended_timer += dtime;
@@ -2004,6 +2056,29 @@ int ServerEnvironment::analyzeBlocks(float dtime, unsigned int max_cycle_ms) {
 				active_blocks_list = m_active_blocks.m_list;
 		}
 
+		// Scan is done on private copies (copy_27_blocks_to_vm), so blocks
+		// are analyzed in parallel, triggers are run later by abmTriggersRun
+		static const unsigned int abm_threads = g_settings->getU16("abm_threads");
+		const bool parallel = m_workers && abm_threads != 1;
+		std::vector<MapBlock *> batch;
+		auto batch_run = [&]() {
+			if (parallel && batch.size() > 1) {
+				std::vector<std::function<void()>> tasks;
+				for (auto block : batch)
+					tasks.emplace_back([this, block]() {
+						// Pool threads keep their block cache between tasks
+						m_map->getBlockCacheFlush();
+						analyzeBlock(block);
+					});
+				m_workers->run_all(tasks, abm_threads);
+			} else {
+				for (auto block : batch)
+					analyzeBlock(block);
+			}
+			batch.clear();
+		};
+		const size_t batch_size = parallel ? (abm_threads ? abm_threads : m_workers->workers_count() + 1) * 4 : 1;
+
 		for(auto i = active_blocks_list.begin(); i != active_blocks_list.end(); ++i)
 		{
 			if (n++ < m_active_block_analyzed_last)
@@ -2018,13 +2093,17 @@ int ServerEnvironment::analyzeBlocks(float dtime, unsigned int max_cycle_ms) {
 			if(!block)
 				continue;
 
-			analyzeBlock(block);
+			batch.emplace_back(block);
+			if (batch.size() < batch_size)
+				continue;
+			batch_run();
 
 			if (porting::getTimeMs() > end_ms) {
 				m_active_block_analyzed_last = n;
 				break;
 			}
 		}
+		batch_run();
 		if (!calls)
 			m_active_block_analyzed_last = 0;
 	}
@@ -2075,17 +2154,16 @@ int ServerEnvironment::analyzeBlocks(float dtime, unsigned int max_cycle_ms) {
 
 ServerActiveObject* ServerEnvironment::getActiveObject(u16 id, bool removed)
 {
-	auto lock = m_active_objects.lock_shared_rec();
-	auto n = m_active_objects.find(id);
-	if(n == m_active_objects.end())
+	ServerActiveObject *obj = nullptr;
+	if (!m_active_objects.get_value(id, obj))
 		return NULL;
-	if (!removed && (!n->second || n->second->m_removed || n->second->m_pending_deactivation))
+	if (!removed && (!obj || obj->m_removed || obj->m_pending_deactivation))
 		return NULL;
-	return n->second;
+	return obj;
 }
 
 bool isFreeServerActiveObjectId(u16 id,
-		maybe_concurrent_map<u16, ServerActiveObject*> &objects)
+		active_objects_map &objects)
 {
 	if(id == 0)
 		return false;
@@ -2094,7 +2172,7 @@ bool isFreeServerActiveObjectId(u16 id,
 }
 
 u16 getFreeServerActiveObjectId(
-		maybe_concurrent_map<u16, ServerActiveObject*> &objects)
+		active_objects_map &objects)
 {
 	auto lock = objects.lock_unique_rec();
 	//try to reuse id's as late as possible
@@ -2122,69 +2200,89 @@ u16 ServerEnvironment::addActiveObject(ServerActiveObject *object)
 
 /*
 	Finds out what new objects have been added to
-	inside a radius around a position
+	inside a radius around a position.
+	Objects are taken from grid cells that came into radius or got new
+	objects since last call with same interest, so cost depends on what
+	changed near the player, not on count of all objects.
+	Players have own transfer distance and are few, they are checked
+	directly.
 */
 void ServerEnvironment::getAddedActiveObjects(Player *player, s16 radius,
 		s16 player_radius,
-		maybe_concurrent_unordered_map<u16, bool> &current_objects_shared,
+		maybe_concurrent_unordered_map<u16, bool> &current_objects,
+		ActiveObjectInterest &interest,
 		std::queue<u16> &added_objects)
 {
-	f32 radius_f = radius * BS;
 	f32 player_radius_f = player_radius * BS;
 
 	if (player_radius_f < 0)
 		player_radius_f = 0;
 
-	std::unordered_map<u16, bool> current_objects;
+	s16 radius_cells = (radius + MAP_BLOCKSIZE - 1) / MAP_BLOCKSIZE;
+	auto player_position = player->getPosition();
+	v3POS cell = ActiveObjectGrid::getCell(player_position);
+
+	std::vector<u16> objects;
+	u64 stamp = m_objects_grid.getChanged(cell, radius_cells,
+			interest.valid ? &interest.cell : NULL, interest.stamp, objects);
+
+	std::vector<u16> players;
 	{
-		auto lock = current_objects_shared.try_lock_shared_rec();
+		auto lock = m_players.try_lock_shared_rec();
 		if (!lock->owns_lock())
 			return;
-		current_objects = current_objects_shared;
+		for (auto & p : m_players) {
+			PlayerSAO *sao = p->getPlayerSAO();
+			if (!sao || !sao->getId())
+				continue;
+			if (player_radius_f != 0 &&
+					sao->getBasePosition().getDistanceFrom(player_position) > player_radius_f)
+				continue;
+			players.push_back(sao->getId());
+		}
 	}
+
+	{
+		auto lock = current_objects.try_lock_shared_rec();
+		if (!lock->owns_lock())
+			return;
+		auto known = [&](u16 id) { return current_objects.find(id) != current_objects.end(); };
+		objects.erase(std::remove_if(objects.begin(), objects.end(), known), objects.end());
+		players.erase(std::remove_if(players.begin(), players.end(), known), players.end());
+	}
+
 	/*
-		Go through the object list,
+		Go through candidates,
 		- discard m_removed objects,
-		- discard objects that are too far away,
-		- discard objects that are found in current_objects.
+		- discard players found in grid, they are in players list
 		- add remaining objects to added_objects
 	*/
 	int count = 0;
 	auto lock = m_active_objects.try_lock_shared_rec();
 	if (!lock->owns_lock())
 		return;
-	auto player_position = player->getPosition();
-	for(auto
-			i = m_active_objects.begin();
-			i != m_active_objects.end(); ++i) {
-		u16 id = i->first;
-
-		// Get object
-		ServerActiveObject *object = i->second;
-		if(object == NULL)
-			continue;
+	for (size_t i = 0; i < objects.size() + players.size(); ++i) {
+		bool is_player = i >= objects.size();
+		u16 id = is_player ? players[i - objects.size()] : objects[i];
 
 		// Discard if removed or deactivating
-		if(object->m_removed || object->m_pending_deactivation)
+		ServerActiveObject *object = getActiveObject(id);
+		if (object == NULL)
 			continue;
 
-		f32 distance_f = object->getBasePosition().getDistanceFrom(player_position);
-		if (object->getType() == ACTIVEOBJECT_TYPE_PLAYER) {
-			// Discard if too far
-			if (distance_f > player_radius_f && player_radius_f != 0)
-				continue;
-		} else if (distance_f > radius_f)
+		if (is_player != (object->getType() == ACTIVEOBJECT_TYPE_PLAYER))
 			continue;
 
-		// Discard if already on current_objects
-		auto n = current_objects.find(id);
-		if(n != current_objects.end())
-			continue;
 		// Add to added_objects
 		added_objects.push(id);
+		// Interest is kept, rest is found again on next call
 		if (++count > 20)
-			break;
+			return;
 	}
+
+	interest.valid = true;
+	interest.cell = cell;
+	interest.stamp = stamp;
 }
 
 /*
@@ -2196,7 +2294,7 @@ void ServerEnvironment::getRemovedActiveObjects(Player *player, s16 radius,
 		maybe_concurrent_unordered_map<u16, bool> &current_objects,
 		std::queue<u16> &removed_objects)
 {
-	f32 radius_f = radius * BS;
+	s16 radius_cells = (radius + MAP_BLOCKSIZE - 1) / MAP_BLOCKSIZE;
 	f32 player_radius_f = player_radius * BS;
 
 	if (player_radius_f < 0)
@@ -2216,9 +2314,11 @@ void ServerEnvironment::getRemovedActiveObjects(Player *player, s16 radius,
 		  error condition; objects should be set m_removed=true and removed
 		  only after all clients have been informed about removal), or
 		- object has m_removed=true, or
-		- object is too far away
+		- object is too far away: out of radius for players, in cell out
+		  of radius for other objects (same as getAddedActiveObjects())
 	*/
 	auto player_position = player->getPosition();
+	v3POS player_cell = ActiveObjectGrid::getCell(player_position);
 
 	for(auto
 			i = current_objects_vector.begin();
@@ -2239,11 +2339,13 @@ void ServerEnvironment::getRemovedActiveObjects(Player *player, s16 radius,
 			continue;
 		}
 
-		f32 distance_f = object->getBasePosition().getDistanceFrom(player_position);
 		if (object->getType() == ACTIVEOBJECT_TYPE_PLAYER) {
+			f32 distance_f = object->getBasePosition().getDistanceFrom(player_position);
 			if (distance_f <= player_radius_f || player_radius_f == 0)
 				continue;
-		} else if (distance_f <= radius_f)
+		} else if (ActiveObjectGrid::inRange(
+				ActiveObjectGrid::getCell(object->getBasePosition()),
+				player_cell, radius_cells))
 			continue;
 
 		// Object is no longer visible
@@ -2262,17 +2364,17 @@ void ServerEnvironment::setStaticForActiveObjectsInBlock(
 			so_it = block->m_static_objects.m_active.begin();
 			so_it != block->m_static_objects.m_active.end(); ++so_it) {
 		// Get the ServerActiveObject counterpart to this StaticObject
-		std::map<u16, ServerActiveObject *>::iterator ao_it;
-		ao_it = m_active_objects.find(so_it->first);
-		if (ao_it == m_active_objects.end()) {
+		ServerActiveObject *sao = nullptr;
+		if (!m_active_objects.get_value(so_it->first, sao)) {
 			// If this ever happens, there must be some kind of nasty bug.
 			errorstream << "ServerEnvironment::setStaticForObjectsInBlock(): "
 				"Object from MapBlock::m_static_objects::m_active not found "
 				"in m_active_objects";
 			continue;
 		}
+		if (!sao)
+			continue;
 
-		ServerActiveObject *sao = ao_it->second;
 		sao->m_static_exists = static_exists;
 		sao->m_static_block  = static_block;
 	}
@@ -2339,6 +2441,7 @@ u16 ServerEnvironment::addActiveObjectRaw(ServerActiveObject *object,
 			<<"added (id="<<object->getId()<<")"<<std::endl;*/
 
 	m_active_objects.set(object->getId(), object);
+	m_objects_grid.add(object->getId(), object->getBasePosition());
 
 /*
 	m_active_objects[object->getId()] = object;
@@ -2502,6 +2605,7 @@ void ServerEnvironment::removeRemovedObjects(unsigned int max_cycle_ms)
 			i != objects_to_remove.end(); ++i) {
 		objects_to_delete.push_back(m_active_objects.get(*i));
 		m_active_objects.erase(*i);
+		m_objects_grid.remove(*i);
 	}
 	objects_to_remove.clear();
 	}
@@ -2928,6 +3032,7 @@ void ServerEnvironment::deactivateFarObjects(bool force_delete)
 			for(auto & i : objects_to_remove) {
 			objects_to_delete.push_back(m_active_objects.get(i));
 			m_active_objects.erase(i);
+			m_objects_grid.remove(i);
 		}
 		objects_to_remove.clear();
 	}
@@ -47,6 +47,7 @@ along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
 #include "network/connection.h"
 #include "fm_bitset.h"
 #include "threading/concurrent_unordered_map.h"
+#include "threading/concurrent_sharded_map.h"
 #include "threading/concurrent_vector.h"
 #include <unordered_set>
 #include "util/container.h" // Queue
@@ -54,6 +55,8 @@ along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
 #include "circuit.h"
 #include "key_value_storage.h"
 #include <unordered_set>
+#include "fm_objects_grid.h"
+#include "pathfinder.h"
 //--
 
 #include "threading/mutex.h"
@@ -61,6 +64,7 @@ along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
 #include "network/networkprotocol.h" // for AccessDeniedCode
 
 class ServerEnvironment;
+class ObjectBoxSnapshot;
 class ActiveBlockModifier;
 class ServerActiveObject;
 class ITextureSource;
@@ -71,10 +75,13 @@ class ClientMap;
 class GameScripting;
 class Player;
 class RemotePlayer;
+class task_scheduler;
 
 struct ItemStack;
 class PlayerSAO;
 
+typedef maybe_concurrent_sharded_map<u16, ServerActiveObject*> active_objects_map;
+
 namespace epixel
 {
 class ItemSAO;
@@ -438,11 +445,13 @@ class ServerEnvironment : public Environment
 
 	/*
 		Find out what new objects have been added to
-		inside a radius around a position
+		inside a radius around a position.
+		interest is updated, pass the same one for every call of one client
 	*/
 	void getAddedActiveObjects(Player *player, s16 radius,
 			s16 player_radius,
 			maybe_concurrent_unordered_map<u16, bool> &current_objects,
+			ActiveObjectInterest &interest,
 			std::queue<u16> &added_objects);
 
 	/*
@@ -486,6 +495,10 @@ class ServerEnvironment : public Environment
 
 	// Find all active objects inside a radius around a point
 	void getObjectsInsideRadius(std::vector<u16> &objects, v3f pos, float radius);
+	// Find all active objects with base position inside box
+	void getObjectsInArea(std::vector<u16> &objects, const aabb3f &box);
+	// Collision boxes of colliding objects, taken once per step
+	std::shared_ptr<const ObjectBoxSnapshot> getObjectBoxSnapshot();
 
 	// Clear objects, loading and going through every MapBlock
 	void clearObjects(ClearObjectsMode mode);
@@ -505,12 +518,15 @@ class ServerEnvironment : public Environment
 	bool m_use_weather;
 	bool m_use_weather_biome;
 	bool m_more_threads;
+	task_scheduler *m_workers = nullptr;
 	ABMHandler m_abmhandler;
 	void analyzeBlock(MapBlock * block);
 	IntervalLimiter m_analyze_blocks_interval;
 	IntervalLimiter m_abm_random_interval;
 	std::list<v3POS> m_abm_random_blocks;
 	int analyzeBlocks(float dtime, unsigned int max_cycle_ms);
+	// Cycle was cut by max_cycle_ms, next analyzeBlocks() continues it
+	bool analyzeBlocksPending() { return m_active_block_analyzed_last || !m_abm_random_blocks.empty(); }
 
 	std::set<v3s16>* getForceloadedBlocks() { return &m_active_blocks.m_forceloaded_list; };
 
@@ -594,12 +610,19 @@ class ServerEnvironment : public Environment
 	// Key-value storage
 public:
 	std::unordered_map<std::string, KeyValueStorage> m_key_value_storage;
+	// Active objects by block, updated by ServerActiveObject::setBasePosition
+	ActiveObjectGrid m_objects_grid;
+	// Block walkability graphs of hierarchical find_path
+	PathGraphCache m_path_graph_cache;
 private:
+	// Reset before objects step, see getObjectBoxSnapshot()
+	std::shared_ptr<const ObjectBoxSnapshot> m_object_box_snapshot;
+	Mutex m_object_box_snapshot_mutex;
 
 	// World path
 	const std::string m_path_world;
 	// Active object list
-	maybe_concurrent_map<u16, ServerActiveObject*> m_active_objects;
+	active_objects_map m_active_objects;
 	std::vector<u16> objects_to_remove;
 	std::vector<ServerActiveObject*> objects_to_delete;
 	// Outgoing network message buffer for active objects
@@ -0,0 +1,220 @@
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "fm_block_send_queue.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include "constants.h"
+#include "util/numeric.h"
+
+float BlockSendQueue::score(const View &view, const v3POS &p)
+{
+	const float block_size = MAP_BLOCKSIZE * BS;
+	v3f rel = v3f((p.X + 0.5f) * block_size, (p.Y + 0.5f) * block_size,
+			(p.Z + 0.5f) * block_size) - view.camera_pos;
+
+	// Distance to path from camera to predicted position
+	float t = 0;
+	float motion_sq = view.motion.getLengthSQ();
+	if (motion_sq > 0)
+		t = rangelim(rel.dotProduct(view.motion) / motion_sq, 0.f, 1.f);
+	float d = (rel - view.motion * t).getLength() / block_size;
+
+	// Ground hides blocks above underground player and below player on surface
+	float dy = rel.Y / block_size;
+	if (view.ground * dy < -1)
+		d += std::fabs(dy) * 0.5f;
+
+	if (d <= BLOCK_SEND_NEAR_SCORE)
+		return d;
+
+	if (!isBlockInSight(p, view.camera_pos, view.camera_dir, view.camera_fov, 10000 * BS))
+		return d + BLOCK_SEND_OUT_OF_SIGHT;
+
+	// Center of view first: 1x straight ahead, 1.5x at 90 degrees
+	float length = rel.getLength();
+	float cosangle = length > 0 ? view.camera_dir.dotProduct(rel) / length : 1;
+	return d * (1.5f - 0.5f * cosangle);
+}
+
+s16 BlockSendQueue::distance(const View &view, const v3POS &p)
+{
+	v3POS rel = p - view.center;
+	return std::max(std::max(std::abs(rel.X), std::abs(rel.Y)), std::abs(rel.Z));
+}
+
+// Calls f(p) for blocks in range of center but out of range of
+// inner_center, inner_range < 0 for no inner range
+template <typename F>
+static void forEachOutside(const v3POS &center, int range,
+		const v3POS &inner_center, int inner_range, F f)
+{
+	for (int x = center.X - range; x <= center.X + range; ++x)
+	for (int y = center.Y - range; y <= center.Y + range; ++y) {
+		bool inner = inner_range >= 0
+				&& std::abs(x - inner_center.X) <= inner_range
+				&& std::abs(y - inner_center.Y) <= inner_range;
+		for (int z = center.Z - range; z <= center.Z + range; ++z) {
+			if (inner && std::abs(z - inner_center.Z) <= inner_range) {
+				// Skip rest of inner range in this row
+				z = inner_center.Z + inner_range;
+				continue;
+			}
+			f(v3POS(x, y, z));
+		}
+	}
+}
+
+bool BlockSendQueue::setView(const View &view)
+{
+	if (!m_has_view) {
+		m_view = view;
+		m_has_view = true;
+		fill();
+		return false;
+	}
+
+	if (view.center != m_view.center || view.range != m_view.range) {
+		View old_view = m_view;
+		m_view = view;
+		// Only blocks leaving and entering range, queue entries of dropped
+		// ones are skipped by pop()
+		forEachOutside(old_view.center, old_view.range, view.center, view.range,
+				[this](const v3POS &p) { m_candidates.erase(p); });
+		forEachOutside(view.center, view.range, old_view.center, old_view.range,
+				[this](const v3POS &p) { add(p); });
+	} else {
+		m_view = view;
+	}
+
+	return view.center != m_scored_view.center
+		|| view.ground != m_scored_view.ground
+		|| view.camera_dir.getDistanceFrom(m_scored_view.camera_dir) > 0.4 // 1 = 90deg
+		|| view.motion.getDistanceFrom(m_scored_view.motion) > MAP_BLOCKSIZE * BS;
+}
+
+void BlockSendQueue::fill()
+{
+	forEachOutside(m_view.center, m_view.range, m_view.center, -1,
+			[this](const v3POS &p) { m_candidates.emplace(p, 0); });
+	rescore();
+}
+
+void BlockSendQueue::add(const v3POS &p)
+{
+	if (distance(m_view, p) > m_view.range)
+		return;
+	// Queued again even if already queued, old entry is skipped by pop()
+	push(m_candidates.emplace(p, 0).first);
+}
+
+void BlockSendQueue::rescore()
+{
+	m_scored_view = m_view;
+	m_pass_id = m_next_id;
+	m_score_d = 0;
+	// Deferred ones are not queued, scored again by scoreNext()
+	m_deferred.clear();
+}
+
+u32 BlockSendQueue::scoreNext(u32 max)
+{
+	u32 scored = 0;
+	while (scored < max && scoring()) {
+		forEachOutside(m_view.center, m_score_d, m_view.center, m_score_d - 1,
+				[this, &scored](const v3POS &p) {
+			auto it = m_candidates.find(p);
+			// Skip ones queued since rescore()
+			if (it == m_candidates.end() || it->second >= m_pass_id)
+				return;
+			push(it);
+			++scored;
+		});
+		++m_score_d;
+	}
+	return scored;
+}
+
+void BlockSendQueue::requeue()
+{
+	for (const auto &p : m_deferred) {
+		auto it = m_candidates.find(p);
+		if (it != m_candidates.end() && !it->second)
+			push(it);
+	}
+	m_deferred.clear();
+}
+
+bool BlockSendQueue::pop(Candidate &c)
+{
+	while (!m_queue.empty()) {
+		std::pop_heap(m_queue.begin(), m_queue.end());
+		c = m_queue.back();
+		m_queue.pop_back();
+		auto it = m_candidates.find(c.pos);
+		// Skip done ones and old entries of queued again ones
+		if (it == m_candidates.end() || it->second != c.id)
+			continue;
+		// Scored with view before rescore(), queue with new score
+		if (c.id < m_pass_id) {
+			push(it);
+			continue;
+		}
+		it->second = 0;
+		return true;
+	}
+	return false;
+}
+
+void BlockSendQueue::done(const v3POS &p)
+{
+	m_candidates.erase(p);
+}
+
+void BlockSendQueue::defer(const v3POS &p)
+{
+	m_deferred.push_back(p);
+}
+
+void BlockSendQueue::push(candidates_t::iterator it)
+{
+	Candidate c;
+	c.score = score(m_view, it->first);
+	c.pos = it->first;
+	c.id = 0;
+	if (c.score < BLOCK_SEND_OUT_OF_SIGHT) {
+		c.id = m_next_id++;
+		m_queue.push_back(c);
+		std::push_heap(m_queue.begin(), m_queue.end());
+	}
+	it->second = c.id;
+	compact();
+}
+
+void BlockSendQueue::compact()
+{
+	// Every candidate has one entry at most, so it is done rarely
+	if (m_queue.size() <= m_candidates.size() * 2 + 64)
+		return;
+	m_queue.erase(std::remove_if(m_queue.begin(), m_queue.end(),
+			[this](const Candidate &c) {
+				auto it = m_candidates.find(c.pos);
+				return it == m_candidates.end() || it->second != c.id;
+			}), m_queue.end());
+	std::make_heap(m_queue.begin(), m_queue.end());
+}
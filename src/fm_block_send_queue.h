@@ -0,0 +1,127 @@
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FM_BLOCK_SEND_QUEUE_HEADER
+#define FM_BLOCK_SEND_QUEUE_HEADER
+
+#include <vector>
+#include "irr_v3d.h"
+#include "util/unordered_map_hash.h"
+
+// Score of blocks near predicted path of player, these are always in sight
+#define BLOCK_SEND_NEAR_SCORE 2.0f
+// Added to score of blocks out of sight
+#define BLOCK_SEND_OUT_OF_SIGHT 1000.0f
+
+/*
+	Blocks one client may need, kept between server steps.
+	Candidates are all blocks in range not known to be sent and unchanged.
+	Lowest score is checked first: distance to predicted path of player,
+	weighted by angle from view direction and by ground between player and
+	block. Blocks out of sight are not queued until view turns to them.
+	Moving to next block or changing range adds and drops only blocks
+	entering and leaving range. When view changes enough candidates are
+	scored again by scoreNext() nearest first, some of them each step,
+	queued ones with old score are scored again when popped.
+*/
+class BlockSendQueue
+{
+public:
+	struct View {
+		View() : range(0), camera_fov(0), ground(0) {}
+
+		// Block of player, range is counted from it like getFacePositions()
+		v3POS center;
+		s16 range;
+		// In BS units, same as for isBlockInSight()
+		v3f camera_pos;
+		v3f camera_dir;
+		float camera_fov;
+		// Predicted movement of player, BS units
+		v3f motion;
+		// -1 player is underground, 1 under open sky, 0 unknown
+		s8 ground;
+	};
+
+	struct Candidate {
+		float score;
+		v3POS pos;
+		// Queued with this id, older entries of same block are skipped
+		u64 id;
+		// Top of heap is lowest score
+		bool operator<(const Candidate &other) const { return score > other.score; }
+	};
+
+	BlockSendQueue() : m_has_view(false), m_next_id(1), m_pass_id(1), m_score_d(0) {}
+
+	static float score(const View &view, const v3POS &p);
+	// Chebyshev distance in blocks from view center
+	static s16 distance(const View &view, const v3POS &p);
+
+	// Returns true if candidates should be scored again (rescore())
+	bool setView(const View &view);
+	const View &getView() const { return m_view; }
+
+	// All blocks in range become candidates, scored again
+	void fill();
+	// Block in range becomes candidate (changed, deleted on client)
+	void add(const v3POS &p);
+	// Start scoring candidates again with current view
+	void rescore();
+	// Score about max candidates not scored since rescore(), nearest first.
+	// Returns number of scored ones.
+	u32 scoreNext(u32 max);
+	// Some candidates are not scored since rescore()
+	bool scoring() const { return m_has_view && m_score_d <= m_view.range; }
+	// Queue deferred candidates again with current view
+	void requeue();
+
+	// Next queued candidate with lowest score, it stays candidate and is
+	// queued again by rescore() or defer()
+	bool pop(Candidate &c);
+	// Block is sent or not needed, no more candidate
+	void done(const v3POS &p);
+	// Check candidate again on next requeue()
+	void defer(const v3POS &p);
+
+	size_t size() const { return m_candidates.size(); }
+	size_t queued() const { return m_queue.size(); }
+
+private:
+	typedef unordered_map_v3POS<u64> candidates_t;
+
+	void push(candidates_t::iterator it);
+	// Drop queue entries of done or again queued blocks
+	void compact();
+
+	View m_view;
+	// View of last rescore()
+	View m_scored_view;
+	bool m_has_view;
+	// Candidate -> id of its queue entry, 0 if not queued
+	candidates_t m_candidates;
+	// Heap of Candidate
+	std::vector<Candidate> m_queue;
+	std::vector<v3POS> m_deferred;
+	u64 m_next_id;
+	// Entries queued before this id have score of old view
+	u64 m_pass_id;
+	// Distance of next blocks for scoreNext()
+	s16 m_score_d;
+};
+
+#endif
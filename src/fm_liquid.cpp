@@ -25,6 +25,11 @@ along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
 #include "scripting_game.h"
 #include "profiler.h"
 #include "emerge.h"
+#include "environment.h"
+#include "threading/task_scheduler.h"
+#include "util/string.h"
+#include <algorithm>
+#include <functional>
 
 #define LIQUID_DEBUG 0
 
@@ -69,16 +74,142 @@ const s8 liquid_random_map[4][7] = {
 #define D_TOP 6
 #define D_SELF 1
 
-u32 Map::transformLiquidsReal(Server *m_server, unsigned int max_cycle_ms) {
+struct LiquidRegionStep {
+	LiquidRegionQueue::RegionP region;
+	u32 initial_size;
+	u32 loopcount;
+	s32 regenerated;
+	// list of nodes that due to viscosity have not reached their max level height
+	std::list<v3POS> must_reflow, must_reflow_second;
+	LiquidRegionStep(const LiquidRegionQueue::RegionP &region_, u32 size) :
+		region(region_), initial_size(size), loopcount(0), regenerated(0) {}
+};
 
-	INodeDefManager *nodemgr = m_gamedef->ndef();
+u32 Map::transformLiquidsReal(Server *m_server, unsigned int max_cycle_ms) {
 
 	DSTACK(FUNCTION_NAME);
 	//TimeTaker timer("transformLiquidsReal()");
-	u32 loopcount = 0;
 	u32 initial_size = transforming_liquid_size();
+	u16 loop_rand = myrand();
+
+	u32 end_ms = porting::getTimeMs() + max_cycle_ms;
 
+	std::vector<std::pair<LiquidRegionQueue::RegionP, u32>> regions;
+	m_transforming_liquid.getRegions(regions);
+
+	// Deepest queues to profiler: where liquid load comes from
+	auto deepest = std::min<size_t>(regions.size(), 5);
+	std::partial_sort(regions.begin(), regions.begin() + deepest, regions.end(),
+		[](const std::pair<LiquidRegionQueue::RegionP, u32> &a, const std::pair<LiquidRegionQueue::RegionP, u32> &b) {
+			return a.second > b.second;
+		});
+	for (size_t i = 0; i < deepest; ++i) {
+		auto p = regions[i].first->pos * (1 << LiquidRegionQueue::REGION_BITS);
+		g_profiler->avg("Server: liquids queue region (" + itos(p.X) + "," + itos(p.Y) + "," + itos(p.Z) + ")", regions[i].second);
+	}
+	g_profiler->avg("Server: liquids regions", regions.size());
+
+	// Smallest queues first: one broken dam gets only rest of time
+	std::vector<LiquidRegionStep> steps[LiquidRegionQueue::COLORS];
+	for (const auto & region : regions)
+		steps[LiquidRegionQueue::getColor(region.first->pos)].emplace_back(region.first, region.second);
+	regions.clear();
+	u8 colors_left = 0;
+	for (auto & color_steps : steps) {
+		std::sort(color_steps.begin(), color_steps.end(),
+			[](const LiquidRegionStep &a, const LiquidRegionStep &b) {
+				return a.initial_size < b.initial_size;
+			});
+		if (!color_steps.empty())
+			++colors_left;
+	}
+
+	static const unsigned int liquid_threads = g_settings->getU16("liquid_threads");
+	auto workers = m_server->getEnv().m_workers;
+	const bool parallel = workers && liquid_threads != 1;
+
+	// Regions of one color are processed concurrently, colors one by one
+	for (auto & color_steps : steps) {
+		if (color_steps.empty())
+			continue;
+		u32 now = porting::getTimeMs();
+		u32 color_end_ms = now >= end_ms ? now : now + (end_ms - now) / colors_left;
+		--colors_left;
+		if (parallel && color_steps.size() > 1) {
+			std::vector<std::function<void()>> tasks;
+			for (auto & step : color_steps) {
+				auto step_p = &step;
+				tasks.emplace_back([this, m_server, step_p, initial_size, color_end_ms, loop_rand]() {
+					// Pool threads keep their block cache between tasks
+					getBlockCacheFlush();
+					transformLiquidsRegion(m_server, *step_p, initial_size, color_end_ms, loop_rand);
+				});
+			}
+			workers->run_all(tasks, liquid_threads);
+		} else {
+			for (auto & step : color_steps)
+				transformLiquidsRegion(m_server, step, initial_size, color_end_ms, loop_rand);
+		}
+	}
+
+	u32 loopcount = 0;
 	s32 regenerated = 0;
+	for (const auto & color_steps : steps) {
+		for (const auto & step : color_steps) {
+			loopcount += step.loopcount;
+			regenerated += step.regenerated;
+		}
+	}
+
+	u32 ret = loopcount >= initial_size ? 0 : transforming_liquid_size();
+	if (ret || loopcount > m_liquid_step_flow)
+		m_liquid_step_flow += (m_liquid_step_flow > loopcount ? -1 : 1) * (int)loopcount / 10;
+	/*
+	if (loopcount)
+		infostream<<"Map::transformLiquidsReal(): loopcount="<<loopcount<<" initial_size="<<initial_size
+		<<" avgflow="<<m_liquid_step_flow
+		<<" queue="<< transforming_liquid_size()
+		<<" per="<< porting::getTimeMs() - (end_ms - max_cycle_ms)
+		<<" ret="<<ret<<std::endl;
+	*/
+
+	{
+		//TimeTaker timer13("transformLiquidsReal() reflow");
+		// Reflow goes to queues of own regions, also for nodes across region border
+		for (auto & color_steps : steps)
+			for (auto & step : color_steps) {
+				for (const auto & p : step.must_reflow)
+					m_transforming_liquid.push_back(p);
+				step.must_reflow.clear();
+			}
+		for (auto & color_steps : steps)
+			for (auto & step : color_steps) {
+				for (const auto & p : step.must_reflow_second)
+					m_transforming_liquid.push_back(p);
+				step.must_reflow_second.clear();
+			}
+	}
+
+	g_profiler->add("Server: liquids real processed", loopcount);
+	if (regenerated)
+		g_profiler->add("Server: liquids regenerated", regenerated);
+	if (loopcount < initial_size)
+		g_profiler->add("Server: liquids queue", initial_size);
+
+	return loopcount;
+}
+
+// One region step, runs concurrently with regions of same color:
+// touches only nodes not farther than 2 from queued ones
+void Map::transformLiquidsRegion(Server *m_server, LiquidRegionStep &step, u32 total_size, u32 end_ms, u16 loop_rand) {
+
+	INodeDefManager *nodemgr = m_gamedef->ndef();
+
+	u32 &loopcount = step.loopcount;
+	u32 initial_size = step.initial_size;
+	s32 &regenerated = step.regenerated;
+	auto &must_reflow = step.must_reflow;
+	auto &must_reflow_second = step.must_reflow_second;
 
 #if LIQUID_DEBUG
 	bool debug = 1;
@@ -90,18 +221,11 @@ u32 Map::transformLiquidsReal(Server *m_server, unsigned int max_cycle_ms) {
 	s16 liquid_pressure = m_server->m_emerge->params.liquid_pressure;
 	//g_settings->getS16NoEx("liquid_pressure", liquid_pressure);
 
-	// list of nodes that due to viscosity have not reached their max level height
-	//unordered_map_v3POS<bool> must_reflow, must_reflow_second, must_reflow_third;
-	std::list<v3POS> must_reflow, must_reflow_second, must_reflow_third;
-	// List of MapBlocks that will require a lighting update (due to lava)
 	int falling = 0;
-	u16 loop_rand = myrand();
-
-	u32 end_ms = porting::getTimeMs() + max_cycle_ms;
 
 NEXT_LIQUID:
 	;
-	while (transforming_liquid_size() > 0) {
+	while (true) {
 		// This should be done here so that it is done when continue is used
 		if (loopcount >= initial_size * 2 || porting::getTimeMs() > end_ms)
 			break;
@@ -110,10 +234,8 @@ u32 Map::transformLiquidsReal(Server *m_server, unsigned int max_cycle_ms) {
 			Get a queued transforming liquid node
 		*/
 		v3POS p0;
-		{
-			//MutexAutoLock lock(m_transforming_liquid_mutex);
-			p0 = transforming_liquid_pop();
-		}
+		if (!m_transforming_liquid.pop_front(*step.region, p0))
+			break;
 		s16 total_level = 0;
 		//u16 level_max = 0;
 		// surrounding flowing liquid nodes
@@ -163,8 +285,10 @@ u32 Map::transformLiquidsReal(Server *m_server, unsigned int max_cycle_ms) {
 				continue;
 			}
 
+			// Only liquids read other fields of f
 			const auto & f = nodemgr->get(nb.content);
-			switch (f.liquid_type) {
+			const auto liquid_type = nodemgr->getLiquidType(nb.content);
+			switch (liquid_type) {
 			case LIQUID_NONE:
 				if (nb.content == CONTENT_AIR) {
 					liquid_levels[i] = 0;
@@ -188,7 +312,7 @@ u32 Map::transformLiquidsReal(Server *m_server, unsigned int max_cycle_ms) {
 					if (liquid_levels[i])
 						nb.liquid = 1;
 				} else {
-					int drop = ((ItemGroupList) f.groups)["drop_by_liquid"];
+					int drop = nodemgr->getGroup(nb.content, CONTENT_GROUP_DROP_BY_LIQUID);
 					if (drop && !(loopcount % drop) ) {
 						liquid_levels[i] = 0;
 						nb.liquid = 1;
@@ -253,9 +377,9 @@ u32 Map::transformLiquidsReal(Server *m_server, unsigned int max_cycle_ms) {
 			}
 
 			// only self, top, bottom swap
-			if (f.liquid_type && e <= 2) {
+			if (liquid_type && e <= 2) {
 				try {
-					nb.weight = ((ItemGroupList) f.groups)["weight"];
+					nb.weight = nodemgr->getGroup(nb.content, CONTENT_GROUP_WEIGHT);
 					if (e == 1 && neighbors[D_BOTTOM].weight && neighbors[D_SELF].weight > neighbors[D_BOTTOM].weight) {
 						setNode(neighbors[D_SELF].pos, neighbors[D_BOTTOM].node);
 						setNode(neighbors[D_BOTTOM].pos, neighbors[D_SELF].node);
@@ -299,7 +423,7 @@ u32 Map::transformLiquidsReal(Server *m_server, unsigned int max_cycle_ms) {
 			infostream << "get node i=" << (int)i << " " << PP(nb.pos) << " c="
 			           << nb.content << " p0=" << (int)nb.node.param0 << " p1="
 			           << (int)nb.node.param1 << " p2=" << (int)nb.node.param2 << " lt="
-			           << f.liquid_type
+			           << liquid_type
 			           //<< " lk=" << liquid_kind << " lkf=" << liquid_kind_flowing
 			           << " l=" << nb.liquid	<< " inf=" << nb.infinity << " nlevel=" << (int)liquid_levels[i]
 			           << " totallevel=" << (int)total_level << " cansame="
@@ -312,7 +436,7 @@ u32 Map::transformLiquidsReal(Server *m_server, unsigned int max_cycle_ms) {
 
 		s16 level_max = nodemgr->get(liquid_kind_flowing).getMaxLevel();
 		s16 level_max_compressed = nodemgr->get(liquid_kind_flowing).getMaxLevel(1);
-		s16 pressure = liquid_pressure ? ((ItemGroupList) nodemgr->get(liquid_kind).groups)["pressure"] : 0;
+		s16 pressure = liquid_pressure ? nodemgr->getGroup(liquid_kind, CONTENT_GROUP_PRESSURE) : 0;
 		auto liquid_renewable = nodemgr->get(liquid_kind).liquid_renewable;
 #if LIQUID_DEBUG
 		s16 total_was = total_level; //debug
@@ -342,7 +466,7 @@ u32 Map::transformLiquidsReal(Server *m_server, unsigned int max_cycle_ms) {
 
 		// fill bottom block
 		if (neighbors[D_BOTTOM].liquid) {
-			if (falling++ < 100 && !liquid_levels[D_BOTTOM] && ((ItemGroupList) nodemgr->get(liquid_kind).groups)["falling_node"]) {
+			if (falling++ < 100 && !liquid_levels[D_BOTTOM] && nodemgr->getGroup(liquid_kind, CONTENT_GROUP_FALLING_NODE)) {
 				fall_down = true;
 				//m_server->getEnv().nodeUpdate(neighbors[D_SELF].pos, 2);
 				//goto NEXT_LIQUID;
@@ -596,7 +720,7 @@ u32 Map::transformLiquidsReal(Server *m_server, unsigned int max_cycle_ms) {
 			            fast_flood					&&
 			            p0.Y < water_level			&&
 			            p0.Y > fast_flood			&&
-			            initial_size >= 1000			&&
+			            total_size >= 1000			&&
 			            ii != D_TOP					&&
 			            want_level >= level_max / 4	&&
 			            can_liquid_same_level >= 5	&&
@@ -725,46 +849,4 @@ u32 Map::transformLiquidsReal(Server *m_server, unsigned int max_cycle_ms) {
 		}*/
 		//g_profiler->graphAdd("liquids", 1);
 	}
-
-	u32 ret = loopcount >= initial_size ? 0 : transforming_liquid_size();
-	if (ret || loopcount > m_liquid_step_flow)
-		m_liquid_step_flow += (m_liquid_step_flow > loopcount ? -1 : 1) * (int)loopcount / 10;
-	/*
-	if (loopcount)
-		infostream<<"Map::transformLiquidsReal(): loopcount="<<loopcount<<" initial_size="<<initial_size
-		<<" avgflow="<<m_liquid_step_flow
-		<<" reflow="<<must_reflow.size()
-		<<" reflow_second="<<must_reflow_second.size()
-		<<" reflow_third="<<must_reflow_third.size()
-		<<" queue="<< transforming_liquid_size()
-		<<" per="<< porting::getTimeMs() - (end_ms - max_cycle_ms)
-		<<" ret="<<ret<<std::endl;
-	*/
-
-	{
-		//TimeTaker timer13("transformLiquidsReal() reflow");
-		//auto lock = m_transforming_liquid.lock_unique_rec();
-		std::lock_guard<Mutex> lock(m_transforming_liquid_mutex);
-
-		//m_transforming_liquid.insert(must_reflow.begin(), must_reflow.end());
-		for (const auto & p : must_reflow)
-			m_transforming_liquid.push_back(p);
-		must_reflow.clear();
-		//m_transforming_liquid.insert(must_reflow_second.begin(), must_reflow_second.end());
-		for (const auto & p : must_reflow_second)
-			m_transforming_liquid.push_back(p);
-		must_reflow_second.clear();
-		//m_transforming_liquid.insert(must_reflow_third.begin(), must_reflow_third.end());
-		for (const auto & p : must_reflow_third)
-			m_transforming_liquid.push_back(p);
-		must_reflow_third.clear();
-	}
-
-	g_profiler->add("Server: liquids real processed", loopcount);
-	if (regenerated)
-		g_profiler->add("Server: liquids regenerated", regenerated);
-	if (loopcount < initial_size)
-		g_profiler->add("Server: liquids queue", initial_size);
-
-	return loopcount;
 }
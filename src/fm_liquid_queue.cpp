@@ -0,0 +1,90 @@
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "fm_liquid_queue.h"
+
+// Pushes hold map mutex: region can not be removed by getRegions() while filled
+bool LiquidRegionQueue::push_back(const v3POS &p)
+{
+	auto pos = getRegion(p);
+	std::lock_guard<Mutex> lock(m_mutex);
+	auto & region = m_regions[pos];
+	if (!region) {
+		region = std::make_shared<Region>();
+		region->pos = pos;
+	}
+	std::lock_guard<Mutex> region_lock(region->mutex);
+	if (!region->queue.push_back(p))
+		return false;
+	++m_size;
+	return true;
+}
+
+bool LiquidRegionQueue::pop_front(v3POS &p)
+{
+	std::lock_guard<Mutex> lock(m_mutex);
+	for (auto i = m_regions.begin(); i != m_regions.end();) {
+		auto & region = *i->second;
+		{
+			std::lock_guard<Mutex> region_lock(region.mutex);
+			if (region.queue.size()) {
+				p = region.queue.front();
+				region.queue.pop_front();
+				--m_size;
+				return true;
+			}
+		}
+		i = m_regions.erase(i);
+	}
+	return false;
+}
+
+bool LiquidRegionQueue::pop_front(Region &region, v3POS &p)
+{
+	std::lock_guard<Mutex> region_lock(region.mutex);
+	if (!region.queue.size())
+		return false;
+	p = region.queue.front();
+	region.queue.pop_front();
+	--m_size;
+	return true;
+}
+
+void LiquidRegionQueue::getRegions(std::vector<std::pair<RegionP, u32>> &regions)
+{
+	std::lock_guard<Mutex> lock(m_mutex);
+	regions.reserve(regions.size() + m_regions.size());
+	for (auto i = m_regions.begin(); i != m_regions.end();) {
+		u32 size;
+		{
+			std::lock_guard<Mutex> region_lock(i->second->mutex);
+			size = i->second->queue.size();
+		}
+		if (!size) {
+			i = m_regions.erase(i);
+			continue;
+		}
+		regions.emplace_back(i->second, size);
+		++i;
+	}
+}
+
+size_t LiquidRegionQueue::regionsCount()
+{
+	std::lock_guard<Mutex> lock(m_mutex);
+	return m_regions.size();
+}
@@ -0,0 +1,83 @@
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FM_LIQUID_QUEUE_HEADER
+#define FM_LIQUID_QUEUE_HEADER
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+#include "irr_v3d.h"
+#include "constants.h"
+#include "threading/mutex.h"
+#include "util/container.h"
+#include "util/unordered_map_hash.h"
+
+/*
+	Queue of transforming liquid nodes split by map regions of 2x2x2 blocks.
+	Every region have own queue, so one big flow can be limited without
+	stopping all others.
+	Liquid step reads and writes only nearest nodes, regions with same color
+	(parity of region coordinates) are never neighbours and can be processed
+	concurrently. Nodes pushed from one region to other are just queued to
+	its region (border handoff).
+*/
+
+class LiquidRegionQueue
+{
+public:
+	static const int REGION_BITS = MAP_BLOCKP + 1;
+	static const u8 COLORS = 8;
+
+	struct Region {
+		v3POS pos;
+		Mutex mutex;
+		UniqueQueue<v3POS> queue;
+	};
+	typedef std::shared_ptr<Region> RegionP;
+
+	static v3POS getRegion(const v3POS &p)
+	{
+		return v3POS(p.X >> REGION_BITS, p.Y >> REGION_BITS, p.Z >> REGION_BITS);
+	}
+	static u8 getColor(const v3POS &region)
+	{
+		return (region.X & 1) | ((region.Y & 1) << 1) | ((region.Z & 1) << 2);
+	}
+
+	LiquidRegionQueue() { m_size = 0; }
+
+	bool push_back(const v3POS &p);
+	// From any region
+	bool pop_front(v3POS &p);
+	// From one region returned by getRegions()
+	bool pop_front(Region &region, v3POS &p);
+
+	// Not empty regions with their queue sizes, empty regions are removed
+	void getRegions(std::vector<std::pair<RegionP, u32>> &regions);
+
+	u32 size() const { return m_size; }
+	size_t regionsCount();
+
+private:
+	Mutex m_mutex;
+	std::unordered_map<v3POS, RegionP, v3POSHash, v3POSEqual> m_regions;
+	std::atomic<u32> m_size;
+};
+
+#endif
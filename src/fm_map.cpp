@@ -26,6 +26,7 @@ along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
 #include "mg_biome.h"
 #include "gamedef.h"
 #include "util/directiontables.h"
+#include "voxelalgorithms.h"
 
 
 #if HAVE_THREAD_LOCAL
@@ -58,15 +59,8 @@ MapBlock* Map::getBlockNoCreateNoEx(v3POS p, bool trylock, bool nocache) {
 	}
 
 	MapBlockP block;
-	{
-		auto lock = trylock ? m_blocks.try_lock_shared_rec() : m_blocks.lock_shared_rec();
-		if (!lock->owns_lock())
-			return nullptr;
-		auto n = m_blocks.find(p);
-		if(n == m_blocks.end())
-			return nullptr;
-		block = n->second;
-	}
+	if (!m_blocks.get_value(p, block, trylock))
+		return nullptr;
 
 	if (!nocache) {
 #if ENABLE_THREADS && !HAVE_THREAD_LOCAL
@@ -93,6 +87,11 @@ void Map::getBlockCacheFlush() {
 	m_block_cache = nullptr;
 }
 
+u32 Map::getBlockChanged(v3POS p) {
+	MapBlock *block = getBlockNoCreateNoEx(p);
+	return block ? (u32)block->m_changed_counter : 0;
+}
+
 MapBlock * Map::createBlankBlockNoInsert(v3POS & p) {
 	auto block = new MapBlock(this, p, m_gamedef);
 	return block;
@@ -175,9 +174,8 @@ MapNode Map::getNodeNoLock(v3POS p) //dont use
 }
 */
 v3POS Map::transforming_liquid_pop() {
-	std::lock_guard<Mutex> lock(m_transforming_liquid_mutex);
-	auto front = m_transforming_liquid.front();
-	m_transforming_liquid.pop_front();
+	v3POS front;
+	m_transforming_liquid.pop_front(front);
 	return front;
 
 	//auto lock = m_transforming_liquid.lock_unique_rec();
@@ -272,7 +270,7 @@ int ServerMap::getSurface(v3POS basepos, int searchup, bool walkable_only) {
 	v3POS runpos = basepos;
 	INodeDefManager *nodemgr = m_gamedef->ndef();
 
-	bool last_was_walkable = nodemgr->get(node).walkable;
+	bool last_was_walkable = nodemgr->isWalkable(node.getContent());
 
 	while ((runpos.Y < max) && (node.param0 != CONTENT_AIR)) {
 		runpos.Y += 1;
@@ -286,7 +284,7 @@ int ServerMap::getSurface(v3POS basepos, int searchup, bool walkable_only) {
 				return runpos.Y;
 			}
 		} else {
-			bool is_walkable = nodemgr->get(node).walkable;
+			bool is_walkable = nodemgr->isWalkable(node.getContent());
 
 			if (last_was_walkable && (!is_walkable)) {
 				return runpos.Y;
@@ -501,6 +499,10 @@ u32 Map::updateLighting(Map::lighting_map_t & a_blocks, unordered_map_v3POS<int>
 
 	int num_bottom_invalid = 0;
 
+	// Blocks with cleared light in this call
+	bool region_empty = true;
+	v3POS region_min, region_max;
+
 	//MutexAutoLock lock2(m_update_lighting_mutex);
 
 	MAP_NOTHREAD_LOCK(this);
@@ -536,6 +538,18 @@ u32 Map::updateLighting(Map::lighting_map_t & a_blocks, unordered_map_v3POS<int>
 				++loopcount;
 				processed[pos] = i->first.Y;
 				v3POS posnodes = block->getPosRelative();
+
+				if (region_empty) {
+					region_min = region_max = pos;
+					region_empty = false;
+				} else {
+					region_min.X = MYMIN(region_min.X, pos.X);
+					region_min.Y = MYMIN(region_min.Y, pos.Y);
+					region_min.Z = MYMIN(region_min.Z, pos.Z);
+					region_max.X = MYMAX(region_max.X, pos.X);
+					region_max.Y = MYMAX(region_max.Y, pos.Y);
+					region_max.Z = MYMAX(region_max.Z, pos.Z);
+				}
 				//modified_blocks[pos] = block;
 
 				block->setLightingExpired(true);
@@ -544,6 +558,30 @@ u32 Map::updateLighting(Map::lighting_map_t & a_blocks, unordered_map_v3POS<int>
 				/*
 					Clear all light from block
 				*/
+				if (block->content_only != CONTENT_IGNORE
+						&& !nodemgr->get(block->content_only).light_source) {
+					// Uniform block: one node for all, only borders collected
+					MapNode n = block->getContentOnlyNode();
+					u8 oldlight_day = n.getLight(LIGHTBANK_DAY, nodemgr);
+					u8 oldlight_night = n.getLight(LIGHTBANK_NIGHT, nodemgr);
+					n.setLight(LIGHTBANK_DAY, 0, nodemgr);
+					n.setLight(LIGHTBANK_NIGHT, 0, nodemgr);
+					block->fill(n);
+					block->raiseModified(MOD_STATE_WRITE_NEEDED, MapBlock::modified_light_no);
+					if (oldlight_day || oldlight_night)
+					for(s16 z = 0; z < MAP_BLOCKSIZE; z++)
+						for(s16 x = 0; x < MAP_BLOCKSIZE; x++) {
+							bool edge = x == 0 || x == MAP_BLOCKSIZE - 1
+							        || z == 0 || z == MAP_BLOCKSIZE - 1;
+							for(s16 y = 0; y < MAP_BLOCKSIZE; y += edge ? 1 : MAP_BLOCKSIZE - 1) {
+								v3POS p_map = v3POS(x, y, z) + posnodes;
+								if(oldlight_day)
+									unlight_from_day[p_map] = oldlight_day;
+								if(oldlight_night)
+									unlight_from_night[p_map] = oldlight_night;
+							}
+						}
+				} else
 				for(s16 z = 0; z < MAP_BLOCKSIZE; z++)
 					for(s16 x = 0; x < MAP_BLOCKSIZE; x++)
 						for(s16 y = 0; y < MAP_BLOCKSIZE; y++) {
@@ -608,16 +646,51 @@ u32 Map::updateLighting(Map::lighting_map_t & a_blocks, unordered_map_v3POS<int>
 
 	}
 
-	{
-		//TimeTaker timer("updateLighting: unspreadLight");
-		unspreadLight(LIGHTBANK_DAY, unlight_from_day, light_sources, modified_blocks);
-		unspreadLight(LIGHTBANK_NIGHT, unlight_from_night, light_sources, modified_blocks);
-	}
+	// Light can't go further than one block from changed blocks:
+	// spread light of nodes around them in dense copy of that area.
+	// Too big areas (far away blocks in one queue) use slow per node map access
+	static const s32 light_region_max_blocks = 512;
+	region_min -= v3POS(1, 1, 1);
+	region_max += v3POS(1, 1, 1);
+	const v3POS region_size = region_max - region_min + v3POS(1, 1, 1);
+
+	if (!region_empty && region_size.X * region_size.Y * region_size.Z <= light_region_max_blocks) {
+		//TimeTaker timer("updateLighting: LightPropagator");
+		MMVManip vm(this);
+		vm.initialEmerge(region_min, region_max, false);
+
+		VoxelArea area(region_min * MAP_BLOCKSIZE,
+				(region_max + v3POS(1, 1, 1)) * MAP_BLOCKSIZE - v3POS(1, 1, 1));
+		voxalgo::LightPropagator light(vm, area, nodemgr, true);
+		for (auto & i : unlight_from_day)
+			light.addUnlight(i.first, i.second, 0);
+		for (auto & i : unlight_from_night)
+			light.addUnlight(i.first, 0, i.second);
+		for (auto & p : light_sources)
+			light.addSource(p);
+		light.run();
+
+		std::vector<v3POS> changed_blocks;
+		light.getChangedBlocks(changed_blocks);
+		for (auto & pos : changed_blocks) {
+			MapBlock *block = getBlockNoCreateNoEx(pos);
+			if (!block || block->isDummy())
+				continue;
+			block->copyLightFrom(vm, light.getChangedNodes());
+			modified_blocks[pos] = block;
+		}
+	} else {
+		{
+			//TimeTaker timer("updateLighting: unspreadLight");
+			unspreadLight(LIGHTBANK_DAY, unlight_from_day, light_sources, modified_blocks);
+			unspreadLight(LIGHTBANK_NIGHT, unlight_from_night, light_sources, modified_blocks);
+		}
 
-	{
-		//TimeTaker timer("updateLighting: spreadLight");
-		spreadLight(LIGHTBANK_DAY, light_sources, modified_blocks, porting::getTimeMs() + max_cycle_ms * 10);
-		spreadLight(LIGHTBANK_NIGHT, light_sources, modified_blocks, porting::getTimeMs() + max_cycle_ms * 10);
+		{
+			//TimeTaker timer("updateLighting: spreadLight");
+			spreadLight(LIGHTBANK_DAY, light_sources, modified_blocks, porting::getTimeMs() + max_cycle_ms * 10);
+			spreadLight(LIGHTBANK_NIGHT, light_sources, modified_blocks, porting::getTimeMs() + max_cycle_ms * 10);
+		}
 	}
 
 	//infostream<<"light: processed="<<processed.size()<< " loopcount="<<loopcount<< " ablocks_bef="<<a_blocks.size();
@@ -633,6 +706,8 @@ u32 Map::updateLighting(Map::lighting_map_t & a_blocks, unordered_map_v3POS<int>
 			continue;
 		block->setLightingExpired(false);
 		block->lighting_broken = 0;
+		// Sunlighted air and dark underground blocks become uniform again
+		block->analyzeContent();
 	}
 	//infostream<< " ablocks_aft="<<a_blocks.size()<<std::endl;
 
@@ -655,75 +730,92 @@ bool Map::propagateSunlight(v3POS pos, std::set<v3POS> & light_sources,
 
 	v3POS pos_relative = block->getPosRelative();
 
+	// Uniform solid block: light stops at top node in every column, nothing to change
+	content_t content_only;
+	{
+		auto lock = block->lock_shared_rec();
+		content_only = block->content_only;
+	}
+	const bool content_only_opaque = !remove_light && content_only != CONTENT_IGNORE
+		&& !nodemgr->get(content_only).light_propagates
+		&& !nodemgr->get(content_only).sunlight_propagates;
+
 	for(s16 x = 0; x < MAP_BLOCKSIZE; ++x) {
 		for(s16 z = 0; z < MAP_BLOCKSIZE; ++z) {
-			bool no_sunlight = false;
+			// Whether or not the block below should see LIGHT_SUN
+			bool sunlight_should_go_down = false;
 
-			// Check if node above block has sunlight
+			if (!content_only_opaque) {
+				bool no_sunlight = false;
 
-			MapNode n = getNode(pos_relative + v3POS(x, MAP_BLOCKSIZE, z));
-			if (n) {
-				if(n.getLight(LIGHTBANK_DAY, m_gamedef->ndef()) != LIGHT_SUN) {
-					no_sunlight = true;
-				}
-			} else {
+				// Check if node above block has sunlight
 
-				// NOTE: This makes over-ground roofed places sunlighted
-				// Assume sunlight, unless is_underground==true
-				if(block->getIsUnderground()) {
-					no_sunlight = true;
+				MapNode n = getNode(pos_relative + v3POS(x, MAP_BLOCKSIZE, z));
+				if (n) {
+					if(n.getLight(LIGHTBANK_DAY, m_gamedef->ndef()) != LIGHT_SUN) {
+						no_sunlight = true;
+					}
 				} else {
-					MapNode n = block->getNode(v3POS(x, MAP_BLOCKSIZE - 1, z));
-					if(n && m_gamedef->ndef()->get(n).sunlight_propagates == false)
+
+					// NOTE: This makes over-ground roofed places sunlighted
+					// Assume sunlight, unless is_underground==true
+					if(block->getIsUnderground()) {
 						no_sunlight = true;
+					} else {
+						MapNode n = block->getNode(v3POS(x, MAP_BLOCKSIZE - 1, z));
+						if(n && m_gamedef->ndef()->get(n).sunlight_propagates == false)
+							no_sunlight = true;
+					}
+					// NOTE: As of now, this just would make everything dark.
+					// No sunlight here
+					//no_sunlight = true;
 				}
-				// NOTE: As of now, this just would make everything dark.
-				// No sunlight here
-				//no_sunlight = true;
-			}
 
-			s16 y = MAP_BLOCKSIZE - 1;
+				s16 y = MAP_BLOCKSIZE - 1;
 
-			// This makes difference to diminishing in water.
-			//bool stopped_to_solid_object = false;
+				// This makes difference to diminishing in water.
+				//bool stopped_to_solid_object = false;
 
-			u8 current_light = no_sunlight ? 0 : LIGHT_SUN;
+				u8 current_light = no_sunlight ? 0 : LIGHT_SUN;
 
-			for(; y >= 0; --y) {
-				v3POS pos(x, y, z);
-				MapNode n = block->getNode(pos);
+				for(; y >= 0; --y) {
+					v3POS pos(x, y, z);
+					MapNode n = block->getNode(pos);
 
-				if(current_light == 0) {
-					// Do nothing
-				} else if(current_light == LIGHT_SUN && nodemgr->get(n).sunlight_propagates) {
-					// Do nothing: Sunlight is continued
-				} else if(nodemgr->get(n).light_propagates == false) {
-					// A solid object is on the way.
-					//stopped_to_solid_object = true;
+					if(current_light == 0) {
+						// Do nothing
+					} else if(current_light == LIGHT_SUN && nodemgr->get(n).sunlight_propagates) {
+						// Do nothing: Sunlight is continued
+					} else if(nodemgr->get(n).light_propagates == false) {
+						// A solid object is on the way.
+						//stopped_to_solid_object = true;
 
-					// Light stops.
-					current_light = 0;
-				} else {
-					// Diminish light
-					current_light = diminish_light(current_light);
-				}
+						// Light stops.
+						current_light = 0;
+					} else {
+						// Diminish light
+						current_light = diminish_light(current_light);
+					}
 
-				u8 old_light = n.getLight(LIGHTBANK_DAY, nodemgr);
+					u8 old_light = n.getLight(LIGHTBANK_DAY, nodemgr);
 
-				if(current_light > old_light || remove_light) {
-					n.setLight(LIGHTBANK_DAY, current_light, nodemgr);
-					block->setNode(pos, n);
-				}
+					if(current_light > old_light || remove_light) {
+						n.setLight(LIGHTBANK_DAY, current_light, nodemgr);
+						block->setNode(pos, n);
+					}
+
+					if(diminish_light(current_light) != 0) {
+						light_sources.insert(pos_relative + pos);
+					}
 
-				if(diminish_light(current_light) != 0) {
-					light_sources.insert(pos_relative + pos);
+					// Light stopped, nothing more to change below
+					if (current_light == 0 && !remove_light)
+						break;
 				}
 
+				sunlight_should_go_down = (current_light == LIGHT_SUN);
 			}
 
-			// Whether or not the block below should see LIGHT_SUN
-			bool sunlight_should_go_down = (current_light == LIGHT_SUN);
-
 			/*
 				If the block below hasn't already been marked invalid:
 
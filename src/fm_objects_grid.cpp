@@ -0,0 +1,188 @@
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "fm_objects_grid.h"
+#include <algorithm>
+#include "constants.h"
+#include "util/numeric.h"
+
+// Keep far away objects and huge radiuses in s16 range
+static inline v3f clamp_pos(const v3f &pos)
+{
+	const float limit = (MAX_MAP_GENERATION_LIMIT + MAP_BLOCKSIZE) * BS;
+	return v3f(
+		rangelim(pos.X, -limit, limit),
+		rangelim(pos.Y, -limit, limit),
+		rangelim(pos.Z, -limit, limit));
+}
+
+v3POS ActiveObjectGrid::getCell(const v3f &pos)
+{
+	v3POS p = floatToInt(clamp_pos(pos), BS);
+	return v3POS(p.X >> MAP_BLOCKP, p.Y >> MAP_BLOCKP, p.Z >> MAP_BLOCKP);
+}
+
+bool ActiveObjectGrid::inRange(const v3POS &cell, const v3POS &center, s16 radius)
+{
+	s32 x = cell.X - center.X, y = cell.Y - center.Y, z = cell.Z - center.Z;
+	return x * x + y * y + z * z <= (s32)radius * radius;
+}
+
+void ActiveObjectGrid::add(u16 id, const v3f &pos)
+{
+	auto cell = getCell(pos);
+	std::lock_guard<Mutex> lock(m_mutex);
+	auto i = m_objects.find(id);
+	if (i != m_objects.end()) {
+		if (i->second == cell)
+			return;
+		auto & old = m_cells[i->second].ids;
+		old.erase(std::remove(old.begin(), old.end(), id), old.end());
+		if (old.empty())
+			m_cells.erase(i->second);
+		i->second = cell;
+	} else {
+		m_objects.emplace(id, cell);
+	}
+	auto & c = m_cells[cell];
+	c.ids.push_back(id);
+	c.changed = ++m_stamp;
+}
+
+void ActiveObjectGrid::remove(u16 id)
+{
+	std::lock_guard<Mutex> lock(m_mutex);
+	auto i = m_objects.find(id);
+	if (i == m_objects.end())
+		return;
+	auto cell = m_cells.find(i->second);
+	if (cell != m_cells.end()) {
+		auto & ids = cell->second.ids;
+		ids.erase(std::remove(ids.begin(), ids.end(), id), ids.end());
+		if (ids.empty())
+			m_cells.erase(cell);
+	}
+	m_objects.erase(i);
+}
+
+void ActiveObjectGrid::move(u16 id, const v3f &pos)
+{
+	auto cell = getCell(pos);
+	std::lock_guard<Mutex> lock(m_mutex);
+	auto i = m_objects.find(id);
+	if (i == m_objects.end() || i->second == cell)
+		return;
+	auto old = m_cells.find(i->second);
+	if (old != m_cells.end()) {
+		auto & ids = old->second.ids;
+		ids.erase(std::remove(ids.begin(), ids.end(), id), ids.end());
+		if (ids.empty())
+			m_cells.erase(old);
+	}
+	i->second = cell;
+	auto & c = m_cells[cell];
+	c.ids.push_back(id);
+	c.changed = ++m_stamp;
+}
+
+void ActiveObjectGrid::clear()
+{
+	std::lock_guard<Mutex> lock(m_mutex);
+	m_cells.clear();
+	m_objects.clear();
+}
+
+void ActiveObjectGrid::getInsideCells(const v3POS &minp, const v3POS &maxp, std::vector<u16> &ids)
+{
+	std::lock_guard<Mutex> lock(m_mutex);
+	const u64 volume = (u64)(maxp.X - minp.X + 1) * (maxp.Y - minp.Y + 1) * (maxp.Z - minp.Z + 1);
+	if (volume > m_cells.size()) {
+		// Big area: cheaper to walk all occupied cells
+		for (const auto & cell : m_cells) {
+			const auto & p = cell.first;
+			if (p.X < minp.X || p.X > maxp.X || p.Y < minp.Y || p.Y > maxp.Y ||
+					p.Z < minp.Z || p.Z > maxp.Z)
+				continue;
+			ids.insert(ids.end(), cell.second.ids.begin(), cell.second.ids.end());
+		}
+		return;
+	}
+	v3POS p;
+	for (p.X = minp.X; p.X <= maxp.X; ++p.X)
+	for (p.Y = minp.Y; p.Y <= maxp.Y; ++p.Y)
+	for (p.Z = minp.Z; p.Z <= maxp.Z; ++p.Z) {
+		auto cell = m_cells.find(p);
+		if (cell == m_cells.end())
+			continue;
+		ids.insert(ids.end(), cell->second.ids.begin(), cell->second.ids.end());
+	}
+}
+
+void ActiveObjectGrid::getInsideRadius(const v3f &pos, float radius, std::vector<u16> &ids)
+{
+	v3f r(radius, radius, radius);
+	getInsideCells(getCell(pos - r), getCell(pos + r), ids);
+}
+
+void ActiveObjectGrid::getInsideArea(const aabb3f &box, std::vector<u16> &ids)
+{
+	getInsideCells(getCell(box.MinEdge), getCell(box.MaxEdge), ids);
+}
+
+u64 ActiveObjectGrid::getChanged(const v3POS &center, s16 radius,
+		const v3POS *old_center, u64 since, std::vector<u16> &ids)
+{
+	auto check = [&](const v3POS &p, const Cell &cell) {
+		if (!inRange(p, center, radius))
+			return;
+		if (old_center && cell.changed <= since && inRange(p, *old_center, radius))
+			return;
+		ids.insert(ids.end(), cell.ids.begin(), cell.ids.end());
+	};
+
+	std::lock_guard<Mutex> lock(m_mutex);
+	const u64 volume = (u64)(2 * radius + 1) * (2 * radius + 1) * (2 * radius + 1);
+	if (volume > m_cells.size()) {
+		for (const auto & cell : m_cells)
+			check(cell.first, cell.second);
+		return m_stamp;
+	}
+	v3POS p;
+	for (p.X = center.X - radius; p.X <= center.X + radius; ++p.X)
+	for (p.Y = center.Y - radius; p.Y <= center.Y + radius; ++p.Y)
+	for (p.Z = center.Z - radius; p.Z <= center.Z + radius; ++p.Z) {
+		auto cell = m_cells.find(p);
+		if (cell != m_cells.end())
+			check(p, cell->second);
+	}
+	return m_stamp;
+}
+
+u32 ActiveObjectGrid::count(const v3POS &blockpos)
+{
+	std::lock_guard<Mutex> lock(m_mutex);
+	auto cell = m_cells.find(blockpos);
+	if (cell == m_cells.end())
+		return 0;
+	return cell->second.ids.size();
+}
+
+size_t ActiveObjectGrid::size()
+{
+	std::lock_guard<Mutex> lock(m_mutex);
+	return m_objects.size();
+}
@@ -0,0 +1,91 @@
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FM_OBJECTS_GRID_HEADER
+#define FM_OBJECTS_GRID_HEADER
+
+#include <vector>
+#include <unordered_map>
+#include "irr_v3d.h"
+#include "irr_aabb3d.h"
+#include "threading/mutex.h"
+#include "util/unordered_map_hash.h"
+
+/*
+	Spatial index of active objects: object ids bucketed by block position.
+	Only ids are stored, callers must check that object still exists.
+	Positions are in float (BS) units, buckets are MAP_BLOCKSIZE nodes.
+	Every cell remembers when an object last entered it, so per-client
+	interest (see getChanged()) is updated from changed cells only.
+*/
+
+// Part of the grid one client was told about, owned by the client
+struct ActiveObjectInterest
+{
+	ActiveObjectInterest() : valid(false), stamp(0) {}
+	// Next getChanged() returns all cells in range
+	void reset() { valid = false; }
+
+	bool valid;
+	v3POS cell;
+	u64 stamp;
+};
+
+class ActiveObjectGrid
+{
+public:
+	static v3POS getCell(const v3f &pos);
+	// Cell is inside sphere of radius cells around center cell
+	static bool inRange(const v3POS &cell, const v3POS &center, s16 radius);
+
+	void add(u16 id, const v3f &pos);
+	void remove(u16 id);
+	// Does nothing for unknown ids (object not yet added or already removed)
+	void move(u16 id, const v3f &pos);
+	void clear();
+
+	// Candidates: ids from all cells touching the sphere/box
+	void getInsideRadius(const v3f &pos, float radius, std::vector<u16> &ids);
+	void getInsideArea(const aabb3f &box, std::vector<u16> &ids);
+
+	// Ids from cells in range of center which were out of range of
+	// old_center or got objects after since; NULL old_center means all
+	// cells in range. Returns stamp to pass as since on next call.
+	u64 getChanged(const v3POS &center, s16 radius, const v3POS *old_center,
+			u64 since, std::vector<u16> &ids);
+
+	// Objects in one block
+	u32 count(const v3POS &blockpos);
+	size_t size();
+
+private:
+	void getInsideCells(const v3POS &minp, const v3POS &maxp, std::vector<u16> &ids);
+
+	struct Cell {
+		Cell() : changed(0) {}
+		std::vector<u16> ids;
+		// Stamp of last object entering the cell
+		u64 changed;
+	};
+
+	Mutex m_mutex;
+	unordered_map_v3POS<Cell> m_cells;
+	std::unordered_map<u16, v3POS> m_objects;
+	u64 m_stamp = 0;
+};
+
+#endif
@@ -90,119 +90,6 @@ void *ServerThread::run()
 
 
 
-class MapThread : public thread_pool {
-	Server *m_server;
-public:
-
-	MapThread(Server *server):
-		thread_pool("Map", 15),
-		m_server(server)
-	{}
-
-	void * run() {
-		DSTACK(FUNCTION_NAME);
-
-		auto time = porting::getTimeMs();
-		while(!stopRequested()) {
-			auto time_now = porting::getTimeMs();
-			try {
-				m_server->getEnv().getMap().getBlockCacheFlush();
-				if (!m_server->AsyncRunMapStep((time_now - time) / 1000.0f, 1))
-					std::this_thread::sleep_for(std::chrono::milliseconds(200));
-				else
-					std::this_thread::sleep_for(std::chrono::milliseconds(10));
-#if !EXEPTION_DEBUG
-			} catch(std::exception &e) {
-				errorstream << m_name << ": exception: " << e.what() << std::endl;
-			} catch (...) {
-				errorstream << m_name << ": Ooops..." << std::endl;
-#else
-			} catch (int) { //nothing
-#endif
-			}
-			time = time_now;
-		}
-		//END_DEBUG_EXCEPTION_HANDLER
-		return nullptr;
-	}
-};
-
-class SendBlocksThread : public thread_pool {
-	Server *m_server;
-public:
-
-	SendBlocksThread(Server *server):
-		thread_pool("SendBlocks", 30),
-		m_server(server)
-	{}
-
-	void * run() {
-		DSTACK(FUNCTION_NAME);
-		BEGIN_DEBUG_EXCEPTION_HANDLER
-
-		auto time = porting::getTimeMs();
-		while(!stopRequested()) {
-			//infostream<<"S run d="<<m_server->m_step_dtime<< " myt="<<(porting::getTimeMs() - time)/1000.0f<<std::endl;
-			try {
-				m_server->getEnv().getMap().getBlockCacheFlush();
-				auto time_now = porting::getTimeMs();
-				auto sent = m_server->SendBlocks((time_now - time) / 1000.0f);
-				time = time_now;
-				std::this_thread::sleep_for(std::chrono::milliseconds(sent ? 5 : 100));
-#if !EXEPTION_DEBUG
-			} catch(std::exception &e) {
-				errorstream << m_name << ": exception: " << e.what() << std::endl;
-			} catch (...) {
-				errorstream << m_name << ": Ooops..." << std::endl;
-#else
-			} catch (int) { //nothing
-#endif
-			}
-		}
-		END_DEBUG_EXCEPTION_HANDLER
-		return nullptr;
-	}
-};
-
-
-class LiquidThread : public thread_pool {
-	Server *m_server;
-public:
-
-	LiquidThread(Server *server):
-		thread_pool("Liquid", 4),
-		m_server(server)
-	{}
-
-	void * run() {
-		DSTACK(FUNCTION_NAME);
-		BEGIN_DEBUG_EXCEPTION_HANDLER
-
-		unsigned int max_cycle_ms = 1000;
-		while(!stopRequested()) {
-			try {
-				m_server->getEnv().getMap().getBlockCacheFlush();
-				auto time_start = porting::getTimeMs();
-				m_server->getEnv().getMap().getBlockCacheFlush();
-				m_server->getEnv().getMap().transformLiquids(m_server, max_cycle_ms);
-				auto time_spend = porting::getTimeMs() - time_start;
-				std::this_thread::sleep_for(std::chrono::milliseconds(time_spend > 300 ? 1 : 300 - time_spend));
-
-#if !EXEPTION_DEBUG
-			} catch(std::exception &e) {
-				errorstream << m_name << ": exception: " << e.what() << std::endl;
-			} catch (...) {
-				errorstream << m_name << ": Ooops..." << std::endl;
-#else
-			} catch (int) { //nothing
-#endif
-			}
-		}
-		END_DEBUG_EXCEPTION_HANDLER
-		return nullptr;
-	}
-};
-
 class EnvThread : public thread_pool {
 	Server *m_server;
 public:
@@ -239,42 +126,71 @@ class EnvThread : public thread_pool {
 	}
 };
 
-class AbmThread : public thread_pool {
-	Server *m_server;
-public:
-
-	AbmThread(Server *server):
-		thread_pool("Abm", 20),
-		m_server(server)
-	{}
-
-	void * run() {
-		DSTACK(FUNCTION_NAME);
-		BEGIN_DEBUG_EXCEPTION_HANDLER
-
-		unsigned int max_cycle_ms = 10000;
-		unsigned int time = porting::getTimeMs();
-		while(!stopRequested()) {
-			try {
-				auto ctime = porting::getTimeMs();
-				unsigned int dtimems = ctime - time;
-				time = ctime;
-				m_server->getEnv().analyzeBlocks(dtimems / 1000.0f, max_cycle_ms);
-				std::this_thread::sleep_for(std::chrono::milliseconds(dtimems > 1000 ? 100 : 1000 - dtimems));
-#if !EXEPTION_DEBUG
-			} catch(std::exception &e) {
-				errorstream << m_name << ": exception: " << e.what() << std::endl;
-			} catch (...) {
-				errorstream << m_name << ": Ooops..." << std::endl;
-#else
-			} catch (int) { //nothing
-#endif
-			}
-		}
-		END_DEBUG_EXCEPTION_HANDLER
-		return nullptr;
-	}
-};
+// Map, send blocks, liquid and abm steps are repeated on m_workers scheduler.
+// Each run does one bounded unit of work (step_cycle_ms), returned value is
+// delay before next run: 0 if work left (queue is not empty), rest of polling
+// interval if idle.
+// Env step keeps own thread: it is one game tick (objects, players, lua
+// globalsteps) that can not be resumed in the middle, and it must not wait
+// in shared queue behind other steps backlog.
+void Server::startWorkerTasks() {
+	static const unsigned int step_cycle_ms = 100;
+	u32 time_start = porting::getTimeMs();
+	std::vector<task_scheduler::repeat_type> steps;
+
+	steps.emplace_back([this, time_start]() mutable -> int {
+		auto time_now = porting::getTimeMs();
+		m_env->getMap().getBlockCacheFlush();
+		auto ret = AsyncRunMapStep((time_now - time_start) / 1000.0f, step_cycle_ms / 1000.0f);
+		time_start = time_now;
+		g_profiler->avg("Server: tasks queue", m_workers->size());
+		return ret ? 0 : 200;
+	});
+
+	steps.emplace_back([this, time_start]() mutable -> int {
+		auto time_now = porting::getTimeMs();
+		m_env->getMap().getBlockCacheFlush();
+		auto sent = SendBlocks((time_now - time_start) / 1000.0f);
+		time_start = time_now;
+		return sent ? 0 : 100;
+	});
+
+	steps.emplace_back([this, time_start]() mutable -> int {
+		static const unsigned int interval_ms = 300;
+		m_env->getMap().getBlockCacheFlush();
+		auto left = m_env->getMap().transformLiquids(this, step_cycle_ms);
+		if (left)
+			return 0;
+		// Wave done, next one after interval from start of this one
+		auto time_spend = porting::getTimeMs() - time_start;
+		time_start += time_spend > interval_ms ? time_spend : interval_ms;
+		return time_spend > interval_ms ? 0 : interval_ms - time_spend;
+	});
+
+	steps.emplace_back([this, time_start]() mutable -> int {
+		static const unsigned int interval_ms = 1000;
+		auto time_now = porting::getTimeMs();
+		m_env->getMap().getBlockCacheFlush();
+		m_env->analyzeBlocks((time_now - time_start) / 1000.0f, step_cycle_ms);
+		time_start = time_now;
+		if (m_env->analyzeBlocksPending())
+			return 0;
+		auto time_spend = porting::getTimeMs() - time_now;
+		return time_spend > interval_ms ? 0 : interval_ms - time_spend;
+	});
+
+	// One thread per step, so they never wait for each other, and
+	// server_workers more for fanned out tasks
+	int workers = g_settings->getS32("server_workers");
+	if (workers <= 0)
+		workers = std::thread::hardware_concurrency();
+	if (workers <= 0)
+		workers = 1;
+	m_workers->restart(steps.size() + workers);
+
+	for (const auto &step : steps)
+		m_workers->repeat(step);
+}
 
 int Server::AsyncRunMapStep(float dtime, float dedicated_server_step, bool async) {
 	DSTACK(FUNCTION_NAME);
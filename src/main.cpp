@@ -54,6 +54,9 @@ along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
 #include "fontengine.h"
 #include "gameparams.h"
 #include "database.h"
+#include "serialization.h"
+#include "util/serialize.h"
+#include "util/string.h"
 #include "config.h"
 #if USE_CURSES
 	#include "terminal_chat_console.h"
@@ -123,6 +126,7 @@ static bool determine_subgame(GameParams *game_params);
 
 static bool run_dedicated_server(const GameParams &game_params, const Settings &cmd_args);
 static bool migrate_database(const GameParams &game_params, const Settings &cmd_args);
+static bool train_compression_dictionary(const GameParams &game_params, const Settings &cmd_args);
 
 /**********************************************************************/
 
@@ -332,6 +336,8 @@ static void set_allowed_options(OptionList *allowed_options)
 			_("Set gameid (\"--gameid list\" prints available ones)"))));
 	allowed_options->insert(std::make_pair("migrate", ValueSpec(VALUETYPE_STRING,
 			_("Migrate from current map backend to another (Only works when using minetestserver or with --server)"))));
+	allowed_options->insert(std::make_pair("compression-dictionary", ValueSpec(VALUETYPE_STRING,
+			_("Train zstd dictionary from N sampled map blocks and compare zlib with zstd on them (Only works when using minetestserver or with --server)"))));
 
 	allowed_options->insert(std::make_pair("autoexit", ValueSpec(VALUETYPE_STRING,
 			_("Exit after X seconds"))));
@@ -905,6 +911,9 @@ static bool run_dedicated_server(const GameParams &game_params, const Settings &
 	if (cmd_args.exists("migrate"))
 		return migrate_database(game_params, cmd_args);
 
+	if (cmd_args.exists("compression-dictionary"))
+		return train_compression_dictionary(game_params, cmd_args);
+
 	if (cmd_args.exists("terminal")) {
 #if USE_CURSES
 		bool name_ok = true;
@@ -1024,7 +1033,8 @@ static bool migrate_database(const GameParams &game_params, const Settings &cmd_
 	std::vector<v3s16> blocks;
 	old_db->listAllLoadableBlocks(blocks);
 	new_db->beginSave();
-	for (std::vector<v3s16>::const_iterator it = blocks.begin(); it != blocks.end(); ++it) {
+	const size_t batch_size = 0x100;
+	for (size_t start = 0; start < blocks.size(); start += batch_size) {
 		if (kill) return false;
 
 		/* old slow migrate, but better for future leveldb
@@ -1039,14 +1049,19 @@ static bool migrate_database(const GameParams &game_params, const Settings &cmd_
 		}
 		*/
 
-		std::string data;
-		old_db->loadBlock(*it, &data);
-		if (!data.empty()) {
-			new_db->saveBlock(*it, data);
-		} else {
-			errorstream << "Failed to load block " << PP(*it) << ", skipping it." << std::endl;
-		}
-		if (++count % 0xFF == 0 && time(NULL) - last_update_time >= 1) {
+		std::vector<v3s16> batch_pos(blocks.begin() + start,
+			blocks.begin() + std::min(blocks.size(), start + batch_size));
+		Database::blocks_batch batch;
+		batch.reserve(batch_pos.size());
+		old_db->loadBlocks(batch_pos, [&batch](const v3s16 &pos, std::string &data) {
+			if (!data.empty()) {
+				batch.emplace_back(pos, std::move(data));
+			} else {
+				errorstream << "Failed to load block " << PP(pos) << ", skipping it." << std::endl;
+			}
+		});
+		count += new_db->saveBlocks(batch);
+		if (time(NULL) - last_update_time >= 1) {
 			std::cerr << " Migrated " << count << " blocks, "
 				<< (100.0 * count / blocks.size()) << "% completed.\r";
 			new_db->endSave();
@@ -1069,3 +1084,126 @@ static bool migrate_database(const GameParams &game_params, const Settings &cmd_
 	return true;
 }
 
+// Uncompressed bulk node data and node metadata of serialized block
+static bool get_block_payloads(const std::string &blob, std::vector<std::string> &payloads)
+{
+	try {
+		std::istringstream is(blob, std::ios_base::binary);
+		u8 version = readU8(is);
+		if (version < 22 || !ser_ver_supported(version))
+			return false;
+		readU8(is); // flags
+		readU8(is); // content_width
+		readU8(is); // params_width
+		std::ostringstream nodes(std::ios_base::binary);
+		decompressBlockData(is, nodes, version);
+		payloads.push_back(nodes.str());
+		std::ostringstream metadata(std::ios_base::binary);
+		decompressBlockData(is, metadata, version);
+		if (!metadata.str().empty())
+			payloads.push_back(metadata.str());
+	} catch (std::exception &e) {
+		return false;
+	}
+	return true;
+}
+
+static bool train_compression_dictionary(const GameParams &game_params, const Settings &cmd_args)
+{
+#if USE_ZSTD
+	const size_t samples_max = std::max(1, stoi(cmd_args.get("compression-dictionary")));
+	std::string dictionary_path = game_params.world_path + DIR_DELIM + BLOCK_COMPRESSION_DICTIONARY_FILE;
+	if (fs::PathExists(dictionary_path)) {
+		// Blocks saved with it would become unreadable
+		errorstream << "Dictionary " << dictionary_path << " already exists, not replacing it" << std::endl;
+		return false;
+	}
+
+	Settings world_mt;
+	std::string world_mt_path = game_params.world_path + DIR_DELIM + "world.mt";
+	if (!world_mt.readConfigFile(world_mt_path.c_str()) || !world_mt.exists("backend")) {
+		errorstream << "Cannot read backend from world.mt!" << std::endl;
+		return false;
+	}
+	Database *db = ServerMap::createDatabase(world_mt.get("backend"), game_params.world_path, world_mt);
+
+	std::vector<v3s16> blocks;
+	db->listAllLoadableBlocks(blocks);
+	// Evenly spread sample over whole world
+	std::vector<v3s16> sample;
+	const size_t step = std::max<size_t>(1, blocks.size() / samples_max);
+	for (size_t i = 0; i < blocks.size() && sample.size() < samples_max; i += step)
+		sample.push_back(blocks[i]);
+
+	std::vector<std::string> payloads;
+	db->loadBlocks(sample, [&payloads](const v3s16 &pos, std::string &data) {
+		if (!data.empty())
+			get_block_payloads(data, payloads);
+	});
+	delete db;
+	if (payloads.empty()) {
+		errorstream << "No readable blocks in world" << std::endl;
+		return false;
+	}
+
+	std::string dictionary = trainZstdDictionary(payloads, 112640);
+	if (dictionary.empty() || !setZstdDictionary(dictionary))
+		return false;
+
+	// Benchmark on same real blocks
+	const int zstd_level = std::max(1, g_settings->getS32("block_compression_level"));
+	size_t raw_size = 0;
+	auto bench = [&payloads, &raw_size](const std::string &name,
+			const std::function<void(const std::string &, std::ostream &)> &compress,
+			const std::function<void(const std::string &, std::ostream &)> &decompress) {
+		size_t size = 0;
+		u32 compress_us = 0, decompress_us = 0;
+		raw_size = 0;
+		for (const auto &payload : payloads) {
+			raw_size += payload.size();
+			std::ostringstream os(std::ios_base::binary);
+			u32 start = porting::getTimeUs();
+			compress(payload, os);
+			compress_us += porting::getTimeUs() - start;
+			std::string compressed = os.str();
+			size += compressed.size();
+			std::ostringstream out(std::ios_base::binary);
+			start = porting::getTimeUs();
+			decompress(compressed, out);
+			decompress_us += porting::getTimeUs() - start;
+			if (out.str() != payload)
+				errorstream << name << ": roundtrip mismatch" << std::endl;
+		}
+		actionstream << name << ": " << size << " bytes (" << (100.0 * size / raw_size)
+			<< "%), compress " << compress_us / 1000 << " ms, decompress "
+			<< decompress_us / 1000 << " ms" << std::endl;
+	};
+	auto zlib_decompress = [](const std::string &data, std::ostream &os) {
+		std::istringstream is(data, std::ios_base::binary);
+		decompressZlib(is, os);
+	};
+	bench("zlib level 2",
+		[](const std::string &data, std::ostream &os) { compressZlib(data, os, 2); },
+		zlib_decompress);
+	bench("zstd level " + itos(zstd_level),
+		[zstd_level](const std::string &data, std::ostream &os) { compressZstd(data, os, zstd_level); },
+		decompressZstd);
+	bench("zstd level " + itos(zstd_level) + " with dictionary",
+		[zstd_level](const std::string &data, std::ostream &os) { compressZstd(data, os, zstd_level, true); },
+		decompressZstd);
+	actionstream << "Sampled " << sample.size() << " blocks, " << payloads.size()
+		<< " payloads, " << raw_size << " bytes uncompressed" << std::endl;
+
+	if (!fs::safeWriteToFile(dictionary_path, dictionary)) {
+		errorstream << "Failed to write " << dictionary_path << std::endl;
+		return false;
+	}
+	actionstream << "Saved " << dictionary.size() << " bytes dictionary to "
+		<< dictionary_path << ", used for disk blocks with block_compression = zstd" << std::endl;
+	return true;
+#else
+	errorstream << "Built without zstd" << std::endl;
+	return false;
+#endif
+}
+
@@ -49,6 +49,7 @@ along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
 #include "database-sqlite3.h"
 #include <deque>
 #include <queue>
+#include <fstream>
 #include "database-leveldb.h"
 #include "database-redis.h"
 #if USE_POSTGRESQL
@@ -1395,10 +1396,13 @@ bool Map::addNodeWithEvent(v3s16 p, MapNode n, bool remove_metadata)
 	event.p = p;
 	event.n = n;
 
+	event.block_changed_before = getBlockChanged(getNodeBlockPos(p));
+
 	bool succeeded = true;
 	try{
 		std::map<v3s16, MapBlock*> modified_blocks;
 		addNodeAndUpdate(p, n, modified_blocks, remove_metadata);
+		event.block_changed_after = getBlockChanged(getNodeBlockPos(p));
 
 		// Copy modified_blocks to event
 		for(std::map<v3s16, MapBlock*>::iterator
@@ -1423,10 +1427,13 @@ bool Map::removeNodeWithEvent(v3s16 p)
 	event.type = MEET_REMOVENODE;
 	event.p = p;
 
+	event.block_changed_before = getBlockChanged(getNodeBlockPos(p));
+
 	bool succeeded = true;
 	try{
 		std::map<v3s16, MapBlock*> modified_blocks;
 		removeNodeAndUpdate(p, modified_blocks);
+		event.block_changed_after = getBlockChanged(getNodeBlockPos(p));
 
 		// Copy modified_blocks to event
 		for(std::map<v3s16, MapBlock*>::iterator
@@ -1697,13 +1704,11 @@ struct NodeNeighbor {
 };
 
 void Map::transforming_liquid_add(v3POS p) {
-	std::lock_guard<Mutex> lock(m_transforming_liquid_mutex);
 	//m_transforming_liquid.set(p, 1);
 	m_transforming_liquid.push_back(p);
 }
 
 u32 Map::transforming_liquid_size() {
-	std::lock_guard<Mutex> lock(m_transforming_liquid_mutex);
 	return m_transforming_liquid.size();
 }
 
@@ -2279,6 +2284,23 @@ ServerMap::ServerMap(std::string savedir, IGameDef *gamedef, EmergeManager *emer
 	if (!conf.updateConfigFile(conf_path.c_str()))
 		errorstream << "ServerMap::ServerMap(): Failed to update world.mt!" << std::endl;
 
+	setBlockCompression(g_settings->get("block_compression"),
+		g_settings->getS32("block_compression_level"));
+#if USE_ZSTD
+	// Loaded even with zlib: needed to read blocks saved with it
+	std::ifstream dictionary_is((savedir + DIR_DELIM + BLOCK_COMPRESSION_DICTIONARY_FILE).c_str(),
+		std::ios_base::binary);
+	if (dictionary_is.good()) {
+		std::ostringstream dictionary;
+		dictionary << dictionary_is.rdbuf();
+		if (setZstdDictionary(dictionary.str()))
+			infostream << "ServerMap: loaded zstd dictionary, "
+				<< dictionary.str().size() << " bytes" << std::endl;
+		else
+			errorstream << "ServerMap: failed to load zstd dictionary" << std::endl;
+	}
+#endif
+
 	m_savedir = savedir;
 	m_map_saving_enabled = false;
 	m_map_loading_enabled = true;
@@ -2384,14 +2406,17 @@ bool ServerMap::initBlockMake(v3s16 blockpos, BlockMakeData *data)
 	EMERGE_DBG_OUT("initBlockMake(): " PP(bpmin) " - " PP(bpmax));
 
 	{
-		auto lock = m_mapgen_process.lock_unique_rec();
-		auto gen = m_mapgen_process.get(bpmin);
-		auto now = porting::getTimeMs();
-		if (gen > now - 60000 ) {
+		unsigned int now = porting::getTimeMs();
+		bool generating = m_mapgen_process.update(bpmin, [now](unsigned int &gen) {
+			if (gen > now - 60000)
+				return true;
+			gen = now;
+			return false;
+		});
+		if (generating) {
 			//verbosestream << " already generating" << blockpos_min << " for " << blockpos << " gentime=" << now - gen << std::endl;
 			return false;
 		}
-		m_mapgen_process.set(bpmin, now);
 	}
 
 	v3s16 extra_borders(1, 1, 1);
@@ -3299,7 +3324,7 @@ bool ServerMap::saveBlock(MapBlock *block, Database *db)
 	}
 
 	// Format used for writing
-	u8 version = SER_FMT_VER_HIGHEST_WRITE;
+	u8 version = getBlockDiskVersion();
 
 	/*
 		[0] u8 serialization version
@@ -3318,15 +3343,19 @@ bool ServerMap::saveBlock(MapBlock *block, Database *db)
 	return ret;
 }
 
-MapBlock * ServerMap::loadBlock(v3s16 p3d)
+MapBlock * ServerMap::loadBlock(v3s16 p3d, const std::string *blob_loaded)
 {
 	DSTACK(FUNCTION_NAME);
 	ScopeProfiler sp(g_profiler, "ServerMap::loadBlock");
 	const auto sector = this;
 	MapBlock *block = nullptr;
 	try {
-		std::string blob;
-		dbase->loadBlock(p3d, &blob);
+		std::string blob_read;
+		if (!blob_loaded) {
+			dbase->loadBlock(p3d, &blob_read);
+			blob_loaded = &blob_read;
+		}
+		const std::string &blob = *blob_loaded;
 	if(!blob.length()) {
 		m_db_miss.set(p3d, 1);
 		return nullptr;
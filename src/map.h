@@ -29,6 +29,7 @@ along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
 #include <map>
 #include "util/unordered_map_hash.h"
 #include "threading/concurrent_unordered_map.h"
+#include "threading/concurrent_sharded_map.h"
 #include <list>
 
 #include "irrlichttypes_bloated.h"
@@ -38,6 +39,7 @@ along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
 #include "modifiedstate.h"
 #include "util/container.h"
 #include "nodetimer.h"
+#include "fm_liquid_queue.h"
 
 #include "mapblock.h"
 #include <unordered_set>
@@ -53,6 +55,7 @@ class NodeMetadata;
 class IGameDef;
 class IRollbackManager;
 class EmergeManager;
+struct LiquidRegionStep;
 class ServerEnvironment;
 struct BlockMakeData;
 struct MapgenParams;
@@ -88,11 +91,17 @@ struct MapEditEvent
 	MapNode n;
 	std::set<v3s16> modified_blocks;
 	u16 already_known_by_peer;
+	// MapBlock::m_changed_counter of block of p before and after node
+	// change, with its light update
+	u32 block_changed_before;
+	u32 block_changed_after;
 
 	MapEditEvent():
 		type(MEET_OTHER),
 		n(CONTENT_AIR),
-		already_known_by_peer(0)
+		already_known_by_peer(0),
+		block_changed_before(0),
+		block_changed_after(0)
 	{ }
 
 	MapEditEvent * clone()
@@ -102,6 +111,9 @@ struct MapEditEvent
 		event->p = p;
 		event->n = n;
 		event->modified_blocks = modified_blocks;
+		event->already_known_by_peer = already_known_by_peer;
+		event->block_changed_before = block_changed_before;
+		event->block_changed_after = block_changed_after;
 		return event;
 	}
 
@@ -182,6 +194,8 @@ class Map /*: public NodeContainer*/
 	MapBlock * getBlockNoCreateNoEx(v3POS p, bool trylock = false, bool nocache = false);
 	MapBlockP getBlock(v3POS p, bool trylock = false, bool nocache = false);
 	void getBlockCacheFlush();
+	// MapBlock::m_changed_counter of block, 0 if not loaded
+	u32 getBlockChanged(v3POS p);
 
 	/* Server overrides */
 	virtual MapBlock * emergeBlock(v3s16 p, bool create_blank=false)
@@ -294,6 +308,7 @@ class Map /*: public NodeContainer*/
 
 	u32 transformLiquids(Server *m_server, unsigned int max_cycle_ms);
 	u32 transformLiquidsReal(Server *m_server, unsigned int max_cycle_ms);
+	void transformLiquidsRegion(Server *m_server, LiquidRegionStep &step, u32 total_size, u32 end_ms, u16 loop_rand);
 	/*
 		Node metadata
 		These are basically coordinate wrappers to MapBlock
@@ -352,7 +367,7 @@ class Map /*: public NodeContainer*/
 
 
 // from old mapsector:
-	typedef maybe_concurrent_unordered_map<v3POS, MapBlockP, v3POSHash, v3POSEqual> m_blocks_type;
+	typedef maybe_concurrent_sharded_map<v3POS, MapBlockP, v3POSHash, v3POSEqual> m_blocks_type;
 	m_blocks_type m_blocks;
 	//MapBlock * getBlockNoCreateNoEx(v3s16 & p);
 	MapBlock * createBlankBlockNoInsert(v3s16 & p);
@@ -400,8 +415,7 @@ class Map /*: public NodeContainer*/
 
 public:
 	//concurrent_unordered_map<v3POS, bool, v3POSHash, v3POSEqual> m_transforming_liquid;
-	Mutex m_transforming_liquid_mutex;
-	UniqueQueue<v3POS> m_transforming_liquid;
+	LiquidRegionQueue m_transforming_liquid;
 	typedef unordered_map_v3POS<int> lighting_map_t;
 	Mutex m_lighting_modified_mutex;
 	std::map<v3POS, int> m_lighting_modified_blocks;
@@ -501,7 +515,8 @@ class ServerMap : public Map
 
 	bool saveBlock(MapBlock *block);
 	static bool saveBlock(MapBlock *block, Database *db);
-	MapBlock* loadBlock(v3s16 p);
+	// blob: data already read from database (Database::loadBlocks), nullptr - read now
+	MapBlock* loadBlock(v3s16 p, const std::string *blob = nullptr);
 
 	bool deleteBlock(v3s16 blockpos);
 
@@ -532,7 +547,7 @@ class ServerMap : public Map
 	std::string m_savedir;
 	bool m_map_saving_enabled;
 	bool m_map_loading_enabled;
-	concurrent_unordered_map<v3POS, unsigned int, v3POSHash, v3POSEqual> m_mapgen_process;
+	maybe_concurrent_sharded_map<v3POS, unsigned int, v3POSHash, v3POSEqual> m_mapgen_process;
 private:
 
 #if 0
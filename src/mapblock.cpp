@@ -23,6 +23,7 @@ along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
 #include "mapblock.h"
 
 #include <sstream>
+#include <algorithm>
 #include "map.h"
 #include "light.h"
 #include "nodedef.h"
@@ -63,10 +64,16 @@ static const char *modified_reason_strings[] = {
 	"deactivateFarObjects: Static data moved out",
 	"deactivateFarObjects: Static data changed considerably",
 	"finishBlockMake: expireDayNightDiff",
+	"copyFrom: VoxelManipulator",
 	"unknown",
 };
 
 
+// Values of MapBlock::m_changed_counter are unique among all blocks, a
+// reloaded block is never taken for its old version by caches outside of
+// it (pathfinder graphs)
+static std::atomic_uint s_changed_counter(0);
+
 /*
 	MapBlock
 */
@@ -91,6 +98,7 @@ MapBlock::MapBlock(Map *parent, v3s16 pos, IGameDef *gamedef, bool dummy):
 	humidity_add = 0;
 	m_timestamp = BLOCK_TIMESTAMP_UNDEFINED;
 	m_changed_timestamp = 0;
+	m_changed_counter = ++s_changed_counter;
 	m_day_night_differs_expired = true;
 	m_lighting_expired = true;
 	m_refcount = 0;
@@ -150,7 +158,7 @@ MapNode MapBlock::getNodeParent(v3s16 p, bool *is_valid_position)
 	if (isValidPosition(p) == false)
 		return m_parent->getNodeNoEx(getPosRelative() + p);
 
-	if (data == NULL) {
+	if (!isValid()) {
 		if (is_valid_position)
 			*is_valid_position = false;
 		return MapNode(CONTENT_IGNORE);
@@ -159,7 +167,7 @@ MapNode MapBlock::getNodeParent(v3s16 p, bool *is_valid_position)
 
 	if (is_valid_position)
 		*is_valid_position = true;
-	return data[p.Z * zstride + p.Y * ystride + p.X];
+	return getNodeNoLock(p);
 }
 
 std::string MapBlock::getModifiedReasonString()
@@ -381,6 +389,13 @@ void MapBlock::copyTo(VoxelManipulator &dst)
 {
 	auto lock = lock_shared_rec();
 	v3s16 data_size(MAP_BLOCKSIZE, MAP_BLOCKSIZE, MAP_BLOCKSIZE);
+
+	if (!data) {
+		if (content_only != CONTENT_IGNORE)
+			dst.fill(getContentOnlyNode(), getPosRelative(), data_size);
+		return;
+	}
+
 	VoxelArea data_area(v3s16(0,0,0), data_size - v3s16(1,1,1));
 
 	// Copy from data to VoxelManipulator
@@ -394,9 +409,43 @@ void MapBlock::copyFrom(VoxelManipulator &dst)
 	v3s16 data_size(MAP_BLOCKSIZE, MAP_BLOCKSIZE, MAP_BLOCKSIZE);
 	VoxelArea data_area(v3s16(0,0,0), data_size - v3s16(1,1,1));
 
+	expandContentOnly();
+
 	// Copy from VoxelManipulator to data
 	dst.copyTo(data, data_area, v3s16(0,0,0),
 			getPosRelative(), data_size);
+
+	// Mapgen and lighting results are often uniform (air, stone, water)
+	analyzeContent();
+
+	raiseModified(MOD_STATE_WRITE_NEEDED, MOD_REASON_VMANIP);
+}
+
+void MapBlock::copyLightFrom(VoxelManipulator &src, const std::vector<bool> &changed_light)
+{
+	auto lock = lock_unique_rec();
+	if (!isValid())
+		return;
+
+	expandContentOnly();
+
+	const v3s16 relpos = getPosRelative();
+	for (s16 z = 0; z < MAP_BLOCKSIZE; z++)
+	for (s16 y = 0; y < MAP_BLOCKSIZE; y++) {
+		u32 si = src.m_area.index(relpos.X, relpos.Y + y, relpos.Z + z);
+		u32 di = z * zstride + y * ystride;
+		for (s16 x = 0; x < MAP_BLOCKSIZE; x++, si++, di++) {
+			// Not lit by propagator: light may be set by other thread meanwhile
+			if (!changed_light[si])
+				continue;
+			// Node changed by other thread while light was calculated
+			if (data[di].param0 != src.m_data[si].param0)
+				continue;
+			data[di].param1 = src.m_data[si].param1;
+		}
+	}
+
+	raiseModified(MOD_STATE_WRITE_NEEDED, modified_light_no);
 }
 
 void MapBlock::actuallyUpdateDayNightDiff()
@@ -406,8 +455,13 @@ void MapBlock::actuallyUpdateDayNightDiff()
 	// Running this function un-expires m_day_night_differs
 	m_day_night_differs_expired = false;
 
+	auto lock = lock_shared_rec();
+
 	if (data == NULL) {
-		m_day_night_differs = false;
+		MapNode n = getContentOnlyNode();
+		// Invalid block or only air
+		m_day_night_differs = content_only != CONTENT_IGNORE && content_only != CONTENT_AIR
+			&& !n.isLightDayNightEq(nodemgr);
 		return;
 	}
 
@@ -416,7 +470,6 @@ void MapBlock::actuallyUpdateDayNightDiff()
 	/*
 		Check if any lighting value differs
 	*/
-	auto lock = lock_shared_rec();
 	for (u32 i = 0; i < nodecount; i++) {
 		MapNode &n = data[i];
 
@@ -450,7 +503,7 @@ void MapBlock::expireDayNightDiff()
 {
 	//INodeDefManager *nodemgr = m_gamedef->ndef();
 
-	if(data == NULL){
+	if(!isValid()){
 		m_day_night_differs = false;
 		m_day_night_differs_expired = false;
 		return;
@@ -469,7 +522,7 @@ s16 MapBlock::getGroundLevel(v2s16 p2d)
 		s16 y = MAP_BLOCKSIZE-1;
 		for(; y>=0; y--)
 		{
-			MapNode n = getNodeRef(p2d.X, y, p2d.Y);
+			MapNode n = getNodeNoLock(v3POS(p2d.X, y, p2d.Y));
 			if(m_gamedef->ndef()->get(n).walkable)
 			{
 				if(y == MAP_BLOCKSIZE-1)
@@ -591,7 +644,7 @@ void MapBlock::serialize(std::ostream &os, u8 version, bool disk, bool use_conte
 	if(!ser_ver_supported(version))
 		throw VersionMismatchException("ERROR: MapBlock format not supported");
 
-	if(data == NULL)
+	if(!isValid())
 	{
 		throw SerializationError("ERROR: Not writing dummy block.");
 	}
@@ -599,18 +652,9 @@ void MapBlock::serialize(std::ostream &os, u8 version, bool disk, bool use_conte
 	FATAL_ERROR_IF(version < SER_FMT_VER_LOWEST_WRITE, "Serialisation version error");
 
 	// First byte
-	u8 flags = 0;
-	if(is_underground)
-		flags |= 0x01;
-	if(getDayNightDiff())
-		flags |= 0x02;
-	if(m_lighting_expired)
-		flags |= 0x04;
-	if(m_generated == false)
-	{
-		flags |= 0x08;
+	u8 flags = getSerializeFlags();
+	if (flags & 0x08)
 		infostream<<" serialize not generated block"<<std::endl;
-	}
 
 	writeU8(os, flags);
 
@@ -625,8 +669,12 @@ void MapBlock::serialize(std::ostream &os, u8 version, bool disk, bool use_conte
 	if(disk)
 	{
 		MapNode *tmp_nodes = new MapNode[nodecount];
-		for(u32 i=0; i<nodecount; i++)
-			tmp_nodes[i] = data[i];
+		if (data) {
+			for(u32 i=0; i<nodecount; i++)
+				tmp_nodes[i] = data[i];
+		} else {
+			std::fill(tmp_nodes, tmp_nodes + nodecount, getContentOnlyNode());
+		}
 		getBlockNodeIdMapping(&nimap, tmp_nodes, m_gamedef->ndef());
 
 		u8 content_width = 2;
@@ -634,7 +682,7 @@ void MapBlock::serialize(std::ostream &os, u8 version, bool disk, bool use_conte
 		writeU8(os, content_width);
 		writeU8(os, params_width);
 		MapNode::serializeBulk(os, version, tmp_nodes, nodecount,
-				content_width, params_width, true);
+				content_width, params_width, true, true);
 		delete[] tmp_nodes;
 	}
 	else
@@ -643,8 +691,14 @@ void MapBlock::serialize(std::ostream &os, u8 version, bool disk, bool use_conte
 		u8 params_width = 2;
 		writeU8(os, content_width);
 		writeU8(os, params_width);
-		MapNode::serializeBulk(os, version, data, nodecount,
-				content_width, params_width, true);
+		if (data) {
+			MapNode::serializeBulk(os, version, data, nodecount,
+					content_width, params_width, true);
+		} else {
+			std::vector<MapNode> tmp_nodes(nodecount, getContentOnlyNode());
+			MapNode::serializeBulk(os, version, tmp_nodes.data(), nodecount,
+					content_width, params_width, true);
+		}
 	}
 
 	/*
@@ -652,7 +706,7 @@ void MapBlock::serialize(std::ostream &os, u8 version, bool disk, bool use_conte
 	*/
 	std::ostringstream oss(std::ios_base::binary);
 	m_node_metadata.serialize(oss);
-	compressZlib(oss.str(), os);
+	compressBlockData(oss.str(), os, version, disk);
 
 	/*
 		Data that goes to disk, but not the network
@@ -680,9 +734,62 @@ void MapBlock::serialize(std::ostream &os, u8 version, bool disk, bool use_conte
 	}
 }
 
+u8 MapBlock::getSerializeFlags()
+{
+	u8 flags = 0;
+	if(is_underground)
+		flags |= 0x01;
+	if(getDayNightDiff())
+		flags |= 0x02;
+	if(m_lighting_expired)
+		flags |= 0x04;
+	if(m_generated == false)
+		flags |= 0x08;
+	return flags;
+}
+
+std::shared_ptr<std::string> MapBlock::serializeNetworkCached(u8 version, bool use_content_only)
+{
+	auto lock = lock_shared_rec();
+
+	u8 flags = getSerializeFlags();
+	u32 changed_counter = m_changed_counter;
+	{
+		std::lock_guard<Mutex> cache_lock(m_serialize_cache_mutex);
+		for (const auto & item : m_serialize_cache) {
+			if (item.version == version && item.use_content_only == use_content_only
+					&& item.flags == flags && item.changed_counter == changed_counter) {
+				g_profiler->add("Server: block serialize cache hit", 1);
+				return item.data;
+			}
+		}
+	}
+	g_profiler->add("Server: block serialize cache miss", 1);
+
+	std::ostringstream os(std::ios_base::binary);
+	serialize(os, version, false, use_content_only);
+	auto data = std::make_shared<std::string>(os.str());
+
+	// Changed meanwhile by writer without block lock
+	if (flags != getSerializeFlags() || changed_counter != m_changed_counter)
+		return data;
+
+	std::lock_guard<Mutex> cache_lock(m_serialize_cache_mutex);
+	for (auto & item : m_serialize_cache) {
+		if (item.version == version && item.use_content_only == use_content_only) {
+			item.flags = flags;
+			item.changed_counter = changed_counter;
+			item.data = data;
+			return data;
+		}
+	}
+	m_serialize_cache.push_back({version, use_content_only, flags, changed_counter, data});
+	return data;
+}
+
 void MapBlock::serializeNetworkSpecific(std::ostream &os, u16 net_proto_version)
 {
-	if(data == NULL)
+	if(!isValid())
 	{
 		throw SerializationError("ERROR: Not writing dummy block.");
 	}
@@ -704,6 +811,7 @@ bool MapBlock::deSerialize(std::istream &is, u8 version, bool disk)
 
 	TRACESTREAM(<<"MapBlock::deSerialize "<<PP(getPos())<<std::endl);
 
+	m_changed_counter = ++s_changed_counter;
 	m_day_night_differs_expired = false;
 
 	if(version <= 21)
@@ -725,12 +833,12 @@ bool MapBlock::deSerialize(std::istream &is, u8 version, bool disk)
 	}
 
 	if (!disk && content_only != CONTENT_IGNORE) {
-		auto n = MapNode(content_only, content_only_param1, content_only_param2);
-		for (u32 i = 0; i < MAP_BLOCKSIZE*MAP_BLOCKSIZE*MAP_BLOCKSIZE; i++)
-			data[i] = n;
+		fill(getContentOnlyNode());
 		return true;
 	}
 
+	expandContentOnly();
+
 	/*
 		Bulk node data
 	*/
@@ -753,7 +861,7 @@ bool MapBlock::deSerialize(std::istream &is, u8 version, bool disk)
 	// Ignore errors
 	try {
 		std::ostringstream oss(std::ios_base::binary);
-		decompressZlib(is, oss);
+		decompressBlockData(is, oss, version);
 		std::istringstream iss(oss.str(), std::ios_base::binary);
 		if (version >= 23)
 			m_node_metadata.deSerialize(iss, m_gamedef->idef());
@@ -807,10 +915,10 @@ bool MapBlock::deSerialize(std::istream &is, u8 version, bool disk)
 					<<": Node timers (ver>=25)"<<std::endl);
 			m_node_timers.deSerialize(is, version);
 		}
-
-		analyzeContent();
 	}
 
+	analyzeContent();
+
 	TRACESTREAM(<<"MapBlock::deSerialize "<<PP(getPos())
 			<<": Done."<<std::endl);
 	return true;
@@ -856,9 +964,10 @@ void MapBlock::deSerializeNetworkSpecific(std::istream &is)
 
 		auto lock = lock_unique_rec();
 
-		const auto &f0 = nodedef->get(data[index].getContent());
+		const auto &f0 = nodedef->get(getNodeNoLock(p).getContent());
 
-		data[index] = n;
+		if (!prepareWrite(n))
+			data[index] = n;
 
 		modified_light light = modified_light_no;
 		if (f0.light_propagates != f1.light_propagates || f0.solidness != f1.solidness || f0.light_source != f1.light_source) /*|| f0.drawtype != f1.drawtype*/
@@ -870,6 +979,10 @@ void MapBlock::deSerializeNetworkSpecific(std::istream &is)
 	{
 		if(mod >= MOD_STATE_WRITE_NEEDED /*&& m_timestamp != BLOCK_TIMESTAMP_UNDEFINED*/) {
 			m_changed_timestamp = (unsigned int)m_parent->time_life;
+			m_changed_counter = ++s_changed_counter;
+			// Old data never matches again, senders keep their own pointers
+			std::lock_guard<Mutex> cache_lock(m_serialize_cache_mutex);
+			m_serialize_cache.clear();
 		}
 		if(mod > m_modified){
 			m_modified = mod;
@@ -885,7 +998,9 @@ void MapBlock::pushElementsToCircuit(Circuit* circuit)
 }
 
 	content_t MapBlock::analyzeContent() {
-		auto lock = lock_shared_rec();
+		auto lock = lock_unique_rec();
+		if (!data)
+			return content_only;
 		content_only = data[0].param0;
 		content_only_param1 = data[0].param1;
 		content_only_param2 = data[0].param2;
@@ -895,9 +1010,56 @@ void MapBlock::pushElementsToCircuit(Circuit* circuit)
 				break;
 			}
 		}
+		// Uniform block: keep one node instead of data[]
+		if (content_only != CONTENT_IGNORE) {
+			::operator delete(data);
+			data = nullptr;
+		}
 		return content_only;
 	}
 
+	void MapBlock::fill(const MapNode &n) {
+		auto lock = lock_unique_rec();
+		content_only = n.param0;
+		content_only_param1 = n.param1;
+		content_only_param2 = n.param2;
+		if (content_only == CONTENT_IGNORE) {
+			// Ignore can't be stored as uniform
+			reallocate();
+			return;
+		}
+		if (data) {
+			::operator delete(data);
+			data = nullptr;
+		}
+	}
+
+	void MapBlock::expandContentOnly() {
+		// Callers from deSerialize() and copy functions may hold it already
+		auto lock = lock_unique_rec();
+		if (data) {
+			content_only = CONTENT_IGNORE;
+			return;
+		}
+		auto nodes = reinterpret_cast<MapNode*>( ::operator new(nodecount * sizeof(MapNode)));
+		std::fill(nodes, nodes + nodecount,
+			content_only != CONTENT_IGNORE ? getContentOnlyNode() : ignoreNode);
+		data = nodes;
+		content_only = CONTENT_IGNORE;
+	}
+
+	bool MapBlock::prepareWrite(const MapNode &n) {
+		if (content_only == CONTENT_IGNORE) {
+			if (!data)
+				expandContentOnly();
+			return false;
+		}
+		if (n.param0 == content_only && n.param1 == content_only_param1 && n.param2 == content_only_param2)
+			return true;
+		expandContentOnly();
+		return false;
+	}
+
 
 #ifndef SERVER
 MapBlock::mesh_type MapBlock::getMesh(int step) {
@@ -947,6 +1109,8 @@ void MapBlock::deSerialize_pre22(std::istream &is, u8 version, bool disk)
 	m_lighting_expired = false;
 	m_generated = true;
 
+	expandContentOnly();
+
 	// Make a temporary buffer
 	u32 ser_length = MapNode::serializedLength(version);
 	SharedBuffer<u8> databuf_nodelist(nodecount * ser_length);
@@ -45,6 +45,7 @@ class VoxelManipulator;
 class Circuit;
 class ServerEnvironment;
 struct ActiveABM;
+struct BlockCollisionBoxes;
 
 #define BLOCK_TIMESTAMP_UNDEFINED 0xffffffff
 
@@ -139,7 +140,8 @@ struct abm_trigger_one {
 #define MOD_REASON_STATIC_DATA_REMOVED       (1 << 16)
 #define MOD_REASON_STATIC_DATA_CHANGED       (1 << 17)
 #define MOD_REASON_EXPIRE_DAYNIGHTDIFF       (1 << 18)
-#define MOD_REASON_UNKNOWN                   (1 << 19)
+#define MOD_REASON_VMANIP                    (1 << 19)
+#define MOD_REASON_UNKNOWN                   (1 << 20)
 
 ////
 //// MapBlock itself
@@ -173,6 +175,7 @@ class MapBlock /*: public NodeContainer*/
 		else
 		for (u32 i = 0; i < nodecount; i++)
 			data[i] = ignoreNode;
+		content_only = CONTENT_IGNORE;
 	}
 
 	/*
@@ -282,11 +285,17 @@ class MapBlock /*: public NodeContainer*/
 		if (m_lighting_expired)
 			return false;
 */
-		if (data == NULL)
+		if (data == NULL && content_only == CONTENT_IGNORE)
 			return false;
 		return true;
 	}
 
+	// False for dummy and uniform (content_only) blocks
+	inline bool isDataAllocated()
+	{
+		return data != NULL;
+	}
+
 	////
 	//// Position stuff
 	////
@@ -315,7 +324,7 @@ class MapBlock /*: public NodeContainer*/
 
 	inline bool isValidPosition(s16 x, s16 y, s16 z)
 	{
-		return data != NULL
+		return isValid()
 			&& x >= 0 && x < MAP_BLOCKSIZE
 			&& y >= 0 && y < MAP_BLOCKSIZE
 			&& z >= 0 && z < MAP_BLOCKSIZE;
@@ -334,7 +343,7 @@ class MapBlock /*: public NodeContainer*/
 			return ignoreNode;
 
 		auto lock = lock_shared_rec();
-		return data[p.Z * zstride + p.Y * ystride + p.X];
+		return getNodeNoLock(p);
 	}
 
 	MapNode getNodeNoEx(v3POS p);
@@ -368,7 +377,7 @@ class MapBlock /*: public NodeContainer*/
 	MapNode getNodeNoLock(v3POS p)
 	{
 		if (!data)
-			return ignoreNode;
+			return content_only != CONTENT_IGNORE ? getContentOnlyNode() : ignoreNode;
 		return data[p.Z*zstride + p.Y*ystride + p.X];
 	}
 
@@ -378,12 +387,12 @@ class MapBlock /*: public NodeContainer*/
 
 	inline MapNode getNodeNoCheck(s16 x, s16 y, s16 z, bool *valid_position)
 	{
-		*valid_position = data != NULL;
+		*valid_position = isValid();
 		if (!valid_position)
 			return ignoreNode;
 
 		auto lock = lock_shared_rec();
-		return data[z * zstride + y * ystride + x];
+		return getNodeNoLock(v3POS(x, y, z));
 	}
 
 	inline MapNode getNodeNoCheck(v3s16 p, bool *valid_position)
@@ -398,7 +407,8 @@ class MapBlock /*: public NodeContainer*/
 
 		auto lock = lock_unique_rec();
 
-		data[p.Z * zstride + p.Y * ystride + p.X] = n;
+		if (!prepareWrite(n))
+			data[p.Z * zstride + p.Y * ystride + p.X] = n;
 		raiseModified(MOD_STATE_WRITE_NEEDED, MOD_REASON_SET_NODE_NO_CHECK);
 	}
 
@@ -427,6 +437,10 @@ class MapBlock /*: public NodeContainer*/
 	// Copies data from VoxelManipulator getPosRelative()
 	void copyFrom(VoxelManipulator &dst);
 
+	// Copies only light (param1) of nodes set in changed_light (indexed as
+	// src data) and not changed in block meanwhile from VoxelManipulator
+	void copyLightFrom(VoxelManipulator &src, const std::vector<bool> &changed_light);
+
 	// Update day-night lighting difference flag.
 	// Sets m_day_night_differs to appropriate value.
 	// These methods don't care about neighboring blocks.
@@ -561,6 +575,10 @@ class MapBlock /*: public NodeContainer*/
 	void serializeNetworkSpecific(std::ostream &os, u16 net_proto_version);
 	void deSerializeNetworkSpecific(std::istream &is);
 
+	// Network serialize() result shared between all clients with same version,
+	// reused until block changes (see m_changed_counter)
+	std::shared_ptr<std::string> serializeNetworkCached(u8 version, bool use_content_only);
+
 	void pushElementsToCircuit(Circuit* circuit);
 
 #ifndef SERVER // Only on client
@@ -577,6 +595,9 @@ class MapBlock /*: public NodeContainer*/
 
 	void deSerialize_pre22(std::istream &is, u8 version, bool disk);
 
+	// First byte of serialize()
+	u8 getSerializeFlags();
+
 	/*
 		Used only internally, because changes can't be tracked
 	*/
@@ -586,6 +607,8 @@ class MapBlock /*: public NodeContainer*/
 		if (!isValidPosition(x, y, z))
 			throw InvalidPositionException("getNodeRef InvalidPosition");
 
+		// Reference can be written
+		expandContentOnly();
 		return data[z * zstride + y * ystride + x];
 	}
 
@@ -620,6 +643,9 @@ class MapBlock /*: public NodeContainer*/
 
 	// Last really changed time (need send to client)
 	std::atomic_uint m_changed_timestamp;
+	// New value on every change, unlike m_changed_timestamp it differs for
+	// changes within one second and for blocks loaded again
+	std::atomic_uint m_changed_counter;
 	u32 m_next_analyze_timestamp;
 	typedef std::list<abm_trigger_one> abm_triggers_type;
 	std::unique_ptr<abm_triggers_type> abm_triggers;
@@ -627,6 +653,21 @@ class MapBlock /*: public NodeContainer*/
 	void abmTriggersRun(ServerEnvironment * m_env, u32 time, bool activate = false);
 	u32 m_abm_timestamp;
 
+	struct serialize_cache_item {
+		u8 version;
+		bool use_content_only;
+		u8 flags;
+		u32 changed_counter;
+		std::shared_ptr<std::string> data;
+	};
+	// One item per version and content_only mode, cleared by raiseModified()
+	std::vector<serialize_cache_item> m_serialize_cache;
+	Mutex m_serialize_cache_mutex;
+
+	// Collision boxes of nodes, reused until block changes (see m_changed_counter)
+	std::shared_ptr<const BlockCollisionBoxes> m_collision_boxes;
+	Mutex m_collision_boxes_mutex;
+
 	u32 getActualTimestamp() {
 		u32 block_timestamp = 0;
 		if (m_changed_timestamp && m_changed_timestamp != BLOCK_TIMESTAMP_UNDEFINED) {
@@ -638,9 +679,17 @@ class MapBlock /*: public NodeContainer*/
 	}
 
 	// Set to content type of a node if the block consists solely of nodes of one type, otherwise set to CONTENT_IGNORE
+	// Then block can be stored without data[] (see data)
 	content_t content_only;
 	u8 content_only_param1, content_only_param2;
+	// Find if block is uniform and free data[] if it is
 	content_t analyzeContent();
+	MapNode getContentOnlyNode() const
+	{
+		return MapNode(content_only, content_only_param1, content_only_param2);
+	}
+	// Set all nodes of block to n without data[] allocation
+	void fill(const MapNode &n);
 	std::atomic_short lighting_broken;
 
 	static const u32 ystride = MAP_BLOCKSIZE;
@@ -671,9 +720,17 @@ class MapBlock /*: public NodeContainer*/
 	/*
 		If NULL, block is a dummy block.
 		Dummy blocks are used for caching not-found-on-disk blocks.
+		If NULL and content_only != CONTENT_IGNORE all nodes are
+		getContentOnlyNode(), data[] allocated on first write of other node.
 	*/
 	MapNode *data;
 
+	// Lock must be held.
+	// Allocate data[] of uniform block and forget content_only
+	void expandContentOnly();
+	// Before write of n: returns true if n is same as uniform block node (nothing to write)
+	bool prepareWrite(const MapNode &n);
+
 	/*
 		- On the server, this is used for telling whether the
 		  block has been modified from the one on disk.
@@ -263,8 +263,8 @@ static u8 getFaceLight(enum LightBank bank, MapNode n, MapNode n2,
 		light = l2;
 
 	// Boost light level for light sources
-	u8 light_source = MYMAX(ndef->get(n).light_source,
-			ndef->get(n2).light_source);
+	u8 light_source = MYMAX(ndef->getLightSource(n.getContent()),
+			ndef->getLightSource(n2.getContent()));
 	if(light_source > light)
 		light = light_source;
 
@@ -865,14 +865,14 @@ static void getTileInfo(
 		tile = getNodeTile(n0, p, face_dir, data);
 		p_corrected = p;
 		face_dir_corrected = face_dir;
-		light_source = ndef->get(n0).light_source;
+		light_source = ndef->getLightSource(n0.getContent());
 	}
 	else
 	{
 		tile = getNodeTile(n1, p + face_dir, -face_dir, data);
 		p_corrected = p + face_dir;
 		face_dir_corrected = -face_dir;
-		light_source = ndef->get(n1).light_source;
+		light_source = ndef->getLightSource(n1.getContent());
 	}
 
 	// eg. water and glass
@@ -79,6 +79,7 @@ Mapgen::Mapgen()
 	flags       = 0;
 
 	liquid_pressure = 0;
+	m_emerge  = NULL;
 
 	vm        = NULL;
 	ndef      = NULL;
@@ -116,6 +117,15 @@ Mapgen::~Mapgen()
 }
 
 
+float *Mapgen::noiseMap2D(Noise *noise, float x, float z,
+	float *persistence_map)
+{
+	if (!m_emerge)
+		return noise->perlinMap2D(x, z, persistence_map);
+	return m_emerge->noise_cache.perlinMap2D(noise, x, z, persistence_map);
+}
+
+
 u32 Mapgen::getBlockSeed(v3s16 p, int seed)
 {
 	return (u32)seed   +
@@ -144,7 +154,7 @@ s16 Mapgen::findGroundLevelFull(v2s16 p2d)
 
 	for (y = y_nodes_max; y >= y_nodes_min; y--) {
 		MapNode &n = vm->m_data[i];
-		if (ndef->get(n).walkable)
+		if (ndef->isWalkable(n.getContent()))
 			break;
 
 		vm->m_area.add_y(em, i, -1);
@@ -162,7 +172,7 @@ s16 Mapgen::findGroundLevel(v2s16 p2d, s16 ymin, s16 ymax)
 
 	for (y = ymax; y >= ymin; y--) {
 		MapNode &n = vm->m_data[i];
-		if (ndef->get(n).walkable)
+		if (ndef->isWalkable(n.getContent()))
 			break;
 
 		vm->m_area.add_y(em, i, -1);
@@ -180,7 +190,7 @@ s16 Mapgen::findLiquidSurface(v2s16 p2d, s16 ymin, s16 ymax)
 
 	for (y = ymax; y >= ymin; y--) {
 		MapNode &n = vm->m_data[i];
-		if (ndef->get(n).walkable)
+		if (ndef->isWalkable(n.getContent()))
 			return -MAX_MAP_GENERATION_LIMIT;
 		else if (ndef->get(n).isLiquid())
 			break;
@@ -252,56 +262,6 @@ void Mapgen::setLighting(u8 light, v3s16 nmin, v3s16 nmax)
 	}
 }
 
-void Mapgen::lightSpread(VoxelArea &a, v3s16 p, u8 light,
-		unordered_map_v3POS<u8> & skip, int r)
-{
-	if (light <= 1 || !a.contains(p))
-		return;
-
-	u32 vi = vm->m_area.index(p);
-	MapNode &n = vm->m_data[vi];
-
-	// Decay light in each of the banks separately
-	u8 light_day = light & 0x0F;
-	if (light_day > 0)
-		light_day -= 0x01;
-
-	u8 light_night = light & 0xF0;
-	if (light_night > 0x10)
-		light_night -= 0x10;
-
-	// Bail out only if we have no more light from either bank to propogate, or
-	// we hit a solid block that light cannot pass through.
-	if ((light_day  <= (n.param1 & 0x0F) &&
-		light_night <= (n.param1 & 0xF0)) ||
-		!ndef->get(n).light_propagates)
-		return;
-
-	// Since this recursive function only terminates when there is no light from
-	// either bank left, we need to take the max of both banks into account for
-	// the case where spreading has stopped for one light bank but not the other.
-	light = MYMAX(light_day, n.param1 & 0x0F) |
-			MYMAX(light_night, n.param1 & 0xF0);
-
-	n.param1 = light;
-
-	if (++r > 100) {
-		//errorstream<<"mapgen light recursion stop r="<<r << " p=" << p << " lwas=" << (int)n.param1 << " lnow="<< (int )light << " day="<<(int)light_day << " ni="<<(int)light_night<<" skip="<<skip.size() << "\n";
-		return;
-	}
-
-	if (skip.count(p))
-		return;
-	skip.emplace(p, 1);
-
-	lightSpread(a, p + v3s16(0, 0, 1), light, skip, r);
-	lightSpread(a, p + v3s16(0, 1, 0), light, skip, r);
-	lightSpread(a, p + v3s16(1, 0, 0), light, skip, r);
-	lightSpread(a, p - v3s16(0, 0, 1), light, skip, r);
-	lightSpread(a, p - v3s16(0, 1, 0), light, skip, r);
-	lightSpread(a, p - v3s16(1, 0, 0), light, skip, r);
-}
-
 void Mapgen::calcLighting(v3s16 nmin, v3s16 nmax, v3s16 full_nmin, v3s16 full_nmax,
 	bool propagate_shadow)
 {
@@ -356,7 +316,7 @@ void Mapgen::propagateSunlight(v3s16 nmin, v3s16 nmax, bool propagate_shadow)
 
 			for (int y = a.MaxEdge.Y; y >= a.MinEdge.Y; y--) {
 				MapNode &n = vm->m_data[i];
-				if (!ndef->get(n).sunlight_propagates)
+				if (!ndef->sunlightPropagates(n.getContent()))
 					break;
 				n.param1 = LIGHT_SUN;
 				vm->m_area.add_y(em, i, -1);
@@ -371,6 +331,7 @@ void Mapgen::spreadLight(v3s16 nmin, v3s16 nmax)
 {
 	//TimeTaker t("spreadLight");
 	VoxelArea a(nmin, nmax);
+	voxalgo::LightPropagator light(*vm, a, ndef);
 
 	for (int z = a.MinEdge.Z; z <= a.MaxEdge.Z; z++) {
 		for (int y = a.MinEdge.Y; y <= a.MaxEdge.Y; y++) {
@@ -380,31 +341,25 @@ void Mapgen::spreadLight(v3s16 nmin, v3s16 nmax)
 				if (n.getContent() == CONTENT_IGNORE)
 					continue;
 
-				const ContentFeatures &cf = ndef->get(n);
-				if (!cf.light_propagates)
+				content_t c = n.getContent();
+				if (!ndef->lightPropagates(c))
 					continue;
 
 				// TODO(hmmmmm): Abstract away direct param1 accesses with a
 				// wrapper, but something lighter than MapNode::get/setLight
 
-				u8 light_produced = cf.light_source;
+				u8 light_produced = ndef->getLightSource(c);
 				if (light_produced)
 					n.param1 = light_produced | (light_produced << 4);
 
-				u8 light = n.param1;
-				if (light) {
-					unordered_map_v3POS<u8> skip;
-					lightSpread(a, v3s16(x,     y,     z + 1), light, skip);
-					lightSpread(a, v3s16(x,     y + 1, z    ), light, skip);
-					lightSpread(a, v3s16(x + 1, y,     z    ), light, skip);
-					lightSpread(a, v3s16(x,     y,     z - 1), light, skip);
-					lightSpread(a, v3s16(x,     y - 1, z    ), light, skip);
-					lightSpread(a, v3s16(x - 1, y,     z    ), light, skip);
-				}
+				if (n.param1)
+					light.addSource(v3s16(x, y, z));
 			}
 		}
 	}
 
+	light.run();
+
 	//printf("spreadLight: %dms\n", t.stop());
 }
 
@@ -177,12 +177,15 @@ class Mapgen {
 	void updateLiquid(v3s16 nmin, v3s16 nmax);
 
 	void setLighting(u8 light, v3s16 nmin, v3s16 nmax);
-	void lightSpread(VoxelArea &a, v3s16 p, u8 light, unordered_map_v3POS<u8> & skip, int r = 0);
 	void calcLighting(v3s16 nmin, v3s16 nmax, v3s16 full_nmin, v3s16 full_nmax,
 		bool propagate_shadow = true);
 	void propagateSunlight(v3s16 nmin, v3s16 nmax, bool propagate_shadow);
 	void spreadLight(v3s16 nmin, v3s16 nmax);
 
+	// noise->perlinMap2D() shared with other chunks of same column
+	float *noiseMap2D(Noise *noise, float x, float z,
+		float *persistence_map = NULL);
+
 	virtual void makeChunk(BlockMakeData *data) {}
 	virtual int getGroundLevelAtPoint(v2s16 p) { return 0; }
 
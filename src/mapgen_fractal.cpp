@@ -352,16 +352,16 @@ void MapgenFractal::calculateNoise()
 	s16 x = node_min.X;
 	s16 z = node_min.Z;
 
-	noise_seabed->perlinMap2D(x, z);
+	noiseMap2D(noise_seabed, x, z);
 
 	// Cave noises are calculated in generateCaves()
 	// only if solid terrain is present in mapchunk
 
-	noise_filler_depth->perlinMap2D(x, z);
-	noise_heat->perlinMap2D(x, z);
-	noise_humidity->perlinMap2D(x, z);
-	noise_heat_blend->perlinMap2D(x, z);
-	noise_humidity_blend->perlinMap2D(x, z);
+	noiseMap2D(noise_filler_depth, x, z);
+	noiseMap2D(noise_heat, x, z);
+	noiseMap2D(noise_humidity, x, z);
+	noiseMap2D(noise_heat_blend, x, z);
+	noiseMap2D(noise_humidity_blend, x, z);
 
 	for (s32 i = 0; i < csize.X * csize.Z; i++) {
 		noise_heat->result[i] += noise_heat_blend->result[i];
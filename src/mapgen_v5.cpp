@@ -379,18 +379,18 @@ void MapgenV5::calculateNoise()
 	s16 y = node_min.Y - 1;
 	s16 z = node_min.Z;
 
-	noise_factor->perlinMap2D(x, z);
-	noise_height->perlinMap2D(x, z);
+	noiseMap2D(noise_factor, x, z);
+	noiseMap2D(noise_height, x, z);
 	noise_ground->perlinMap3D(x, y, z);
 
 	// Cave noises are calculated in generateCaves()
 	// only if solid terrain is present in mapchunk
 
-	noise_filler_depth->perlinMap2D(x, z);
-	noise_heat->perlinMap2D(x, z);
-	noise_humidity->perlinMap2D(x, z);
-	noise_heat_blend->perlinMap2D(x, z);
-	noise_humidity_blend->perlinMap2D(x, z);
+	noiseMap2D(noise_filler_depth, x, z);
+	noiseMap2D(noise_heat, x, z);
+	noiseMap2D(noise_humidity, x, z);
+	noiseMap2D(noise_heat_blend, x, z);
+	noiseMap2D(noise_humidity_blend, x, z);
 
 	for (s32 i = 0; i < csize.X * csize.Z; i++) {
 		noise_heat->result[i] += noise_heat_blend->result[i];
@@ -422,31 +422,31 @@ void MapgenV7::calculateNoise()
 	s16 y = node_min.Y - 1;
 	s16 z = node_min.Z;
 
-	noise_terrain_persist->perlinMap2D(x, z);
+	noiseMap2D(noise_terrain_persist, x, z);
 	float *persistmap = noise_terrain_persist->result;
 
-	noise_terrain_base->perlinMap2D(x, z, persistmap);
-	noise_terrain_alt->perlinMap2D(x, z, persistmap);
-	noise_height_select->perlinMap2D(x, z);
+	noiseMap2D(noise_terrain_base, x, z, persistmap);
+	noiseMap2D(noise_terrain_alt, x, z, persistmap);
+	noiseMap2D(noise_height_select, x, z);
 
 	if (spflags & MGV7_MOUNTAINS) {
 		noise_mountain->perlinMap3D(x, y, z);
-		noise_mount_height->perlinMap2D(x, z);
+		noiseMap2D(noise_mount_height, x, z);
 	}
 
 	if ((spflags & MGV7_RIDGES) && node_max.Y >= water_level) {
 		noise_ridge->perlinMap3D(x, y, z);
-		noise_ridge_uwater->perlinMap2D(x, z);
+		noiseMap2D(noise_ridge_uwater, x, z);
 	}
 
 	// Cave noises are calculated in generateCaves()
 	// only if solid terrain is present in mapchunk
 
-	noise_filler_depth->perlinMap2D(x, z);
-	noise_heat->perlinMap2D(x, z);
-	noise_humidity->perlinMap2D(x, z);
-	noise_heat_blend->perlinMap2D(x, z);
-	noise_humidity_blend->perlinMap2D(x, z);
+	noiseMap2D(noise_filler_depth, x, z);
+	noiseMap2D(noise_heat, x, z);
+	noiseMap2D(noise_humidity, x, z);
+	noiseMap2D(noise_heat_blend, x, z);
+	noiseMap2D(noise_humidity_blend, x, z);
 
 	for (s32 i = 0; i < csize.X * csize.Z; i++) {
 		noise_heat->result[i] += noise_heat_blend->result[i];
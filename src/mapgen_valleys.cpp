@@ -390,16 +390,16 @@ void MapgenValleys::calculateNoise()
 
 	//TimeTaker tcn("actualNoise");
 
-	noise_filler_depth->perlinMap2D(x, z);
-	noise_heat_blend->perlinMap2D(x, z);
-	noise_heat->perlinMap2D(x, z);
-	noise_humidity_blend->perlinMap2D(x, z);
-	noise_humidity->perlinMap2D(x, z);
-	noise_inter_valley_slope->perlinMap2D(x, z);
-	noise_rivers->perlinMap2D(x, z);
-	noise_terrain_height->perlinMap2D(x, z);
-	noise_valley_depth->perlinMap2D(x, z);
-	noise_valley_profile->perlinMap2D(x, z);
+	noiseMap2D(noise_filler_depth, x, z);
+	noiseMap2D(noise_heat_blend, x, z);
+	noiseMap2D(noise_heat, x, z);
+	noiseMap2D(noise_humidity_blend, x, z);
+	noiseMap2D(noise_humidity, x, z);
+	noiseMap2D(noise_inter_valley_slope, x, z);
+	noiseMap2D(noise_rivers, x, z);
+	noiseMap2D(noise_terrain_height, x, z);
+	noiseMap2D(noise_valley_depth, x, z);
+	noiseMap2D(noise_valley_profile, x, z);
 
 	noise_inter_valley_fill->perlinMap3D(x, y, z);
 
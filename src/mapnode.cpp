@@ -60,7 +60,7 @@ MapNode::MapNode(INodeDefManager *ndef, const std::string &name,
 void MapNode::setLight(enum LightBank bank, u8 a_light, INodeDefManager *nodemgr)
 {
 	// If node doesn't contain light data, ignore this
-	if(nodemgr->get(*this).param_type != CPT_LIGHT)
+	if (!nodemgr->hasLightParam(getContent()))
 		return;
 	if(bank == LIGHTBANK_DAY)
 	{
@@ -78,12 +78,12 @@ void MapNode::setLight(enum LightBank bank, u8 a_light, INodeDefManager *nodemgr
 
 bool MapNode::isLightDayNightEq(INodeDefManager *nodemgr) const
 {
-	const ContentFeatures &f = nodemgr->get(*this);
 	bool isEqual;
 
-	if (f.param_type == CPT_LIGHT) {
-		u8 day   = MYMAX(f.light_source, param1 & 0x0f);
-		u8 night = MYMAX(f.light_source, (param1 >> 4) & 0x0f);
+	if (nodemgr->hasLightParam(getContent())) {
+		u8 light_source = nodemgr->getLightSource(getContent());
+		u8 day   = MYMAX(light_source, param1 & 0x0f);
+		u8 night = MYMAX(light_source, (param1 >> 4) & 0x0f);
 		isEqual = day == night;
 	} else {
 		isEqual = true;
@@ -95,15 +95,15 @@ bool MapNode::isLightDayNightEq(INodeDefManager *nodemgr) const
 u8 MapNode::getLight(enum LightBank bank, INodeDefManager *nodemgr) const
 {
 	// Select the brightest of [light source, propagated light]
-	const ContentFeatures &f = nodemgr->get(*this);
+	content_t c = getContent();
 
 	u8 light;
-	if(f.param_type == CPT_LIGHT)
+	if (nodemgr->hasLightParam(c))
 		light = bank == LIGHTBANK_DAY ? param1 & 0x0f : (param1 >> 4) & 0x0f;
 	else
 		light = 0;
 
-	return MYMAX(f.light_source, light);
+	return MYMAX(nodemgr->getLightSource(c), light);
 }
 
 u8 MapNode::getLightNoChecks(enum LightBank bank, const ContentFeatures *f) const
@@ -115,8 +115,10 @@ u8 MapNode::getLightNoChecks(enum LightBank bank, const ContentFeatures *f) cons
 bool MapNode::getLightBanks(u8 &lightday, u8 &lightnight, INodeDefManager *nodemgr) const
 {
 	// Select the brightest of [light source, propagated light]
-	const ContentFeatures &f = nodemgr->get(*this);
-	if(f.param_type == CPT_LIGHT)
+	content_t c = getContent();
+	bool light_param = nodemgr->hasLightParam(c);
+	u8 light_source = nodemgr->getLightSource(c);
+	if(light_param)
 	{
 		lightday = param1 & 0x0f;
 		lightnight = (param1>>4)&0x0f;
@@ -126,11 +128,11 @@ bool MapNode::getLightBanks(u8 &lightday, u8 &lightnight, INodeDefManager *nodem
 		lightday = 0;
 		lightnight = 0;
 	}
-	if(f.light_source > lightday)
-		lightday = f.light_source;
-	if(f.light_source > lightnight)
-		lightnight = f.light_source;
-	return f.param_type == CPT_LIGHT || f.light_source != 0;
+	if(light_source > lightday)
+		lightday = light_source;
+	if(light_source > lightnight)
+		lightnight = light_source;
+	return light_param || light_source != 0;
 }
 
 u8 MapNode::getFaceDir(INodeDefManager *nodemgr) const
@@ -647,7 +649,7 @@ void MapNode::deSerialize(u8 *source, u8 version)
 }
 void MapNode::serializeBulk(std::ostream &os, int version,
 		const MapNode *nodes, u32 nodecount,
-		u8 content_width, u8 params_width, bool compressed)
+		u8 content_width, u8 params_width, bool compressed, bool disk)
 {
 	if(!ser_ver_supported(version))
 		throw VersionMismatchException("ERROR: MapNode format not supported");
@@ -683,7 +685,7 @@ void MapNode::serializeBulk(std::ostream &os, int version,
 
 	if(compressed)
 	{
-		compressZlib(databuf, os);
+		compressBlockData(databuf, os, version, disk);
 	}
 	else
 	{
@@ -710,7 +712,7 @@ void MapNode::deSerializeBulk(std::istream &is, int version,
 	if(compressed)
 	{
 		std::ostringstream os(std::ios_base::binary);
-		decompressZlib(is, os);
+		decompressBlockData(is, os, version);
 		std::string s = os.str();
 		if(s.size() != len)
 			throw SerializationError("deSerializeBulkNodes: "
@@ -0,0 +1,126 @@
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "mg_noise_cache.h"
+#include <string.h>
+#include "noise.h"
+#include "profiler.h"
+
+template <typename T>
+static void appendKey(std::string &key, const T &value)
+{
+	key.append((const char *)&value, sizeof(value));
+}
+
+// Fields are appended one by one: NoiseParams has padding
+std::string NoiseMapCache::getKey(const Noise *noise, float x, float y)
+{
+	const NoiseParams &np = noise->np;
+	std::string key;
+	key.reserve(80);
+	appendKey(key, np.offset);
+	appendKey(key, np.scale);
+	appendKey(key, np.spread.X);
+	appendKey(key, np.spread.Y);
+	appendKey(key, np.spread.Z);
+	appendKey(key, np.seed);
+	appendKey(key, np.octaves);
+	appendKey(key, np.persist);
+	appendKey(key, np.lacunarity);
+	appendKey(key, np.flags);
+	appendKey(key, np.far_scale);
+	appendKey(key, np.far_spread);
+	appendKey(key, np.far_persist);
+	appendKey(key, np.far_lacunarity);
+	appendKey(key, noise->seed);
+	appendKey(key, noise->sx);
+	appendKey(key, noise->sy);
+	appendKey(key, x);
+	appendKey(key, y);
+	return key;
+}
+
+
+void NoiseMapCache::setLimit(size_t limit)
+{
+	std::lock_guard<Mutex> lock(m_mutex);
+	m_limit = limit;
+	while (m_lru.size() > m_limit) {
+		m_maps.erase(m_lru.back());
+		m_lru.pop_back();
+	}
+}
+
+
+float *NoiseMapCache::perlinMap2D(Noise *noise, float x, float y,
+	float *persistence_map)
+{
+	if (!m_limit || noise->sz > 1)
+		return noise->perlinMap2D(x, y, persistence_map);
+
+	size_t bufsize = noise->sx * noise->sy;
+	std::string key = getKey(noise, x, y);
+
+	MapP map;
+	{
+		std::lock_guard<Mutex> lock(m_mutex);
+		auto it = m_maps.find(key);
+		if (it != m_maps.end()) {
+			map = it->second.first;
+			m_lru.splice(m_lru.begin(), m_lru, it->second.second);
+		}
+	}
+
+	if (map && (persistence_map ?
+			map->persistence.size() == bufsize && !memcmp(map->persistence.data(),
+				persistence_map, sizeof(float) * bufsize) :
+			map->persistence.empty())) {
+		memcpy(noise->result, map->result.data(), sizeof(float) * bufsize);
+		g_profiler->add("Mapgen: noise cache hit", 1);
+		return noise->result;
+	}
+
+	// Computed outside of lock, other threads are not waiting for it
+	noise->perlinMap2D(x, y, persistence_map);
+	g_profiler->add("Mapgen: noise cache miss", 1);
+
+	auto computed = std::make_shared<Map>();
+	computed->result.assign(noise->result, noise->result + bufsize);
+	if (persistence_map)
+		computed->persistence.assign(persistence_map, persistence_map + bufsize);
+
+	std::lock_guard<Mutex> lock(m_mutex);
+	auto it = m_maps.find(key);
+	if (it != m_maps.end()) {
+		it->second.first = computed;
+		return noise->result;
+	}
+	m_lru.push_front(key);
+	m_maps[key] = std::make_pair(MapP(computed), m_lru.begin());
+	while (m_lru.size() > m_limit) {
+		m_maps.erase(m_lru.back());
+		m_lru.pop_back();
+	}
+	return noise->result;
+}
+
+
+size_t NoiseMapCache::size()
+{
+	std::lock_guard<Mutex> lock(m_mutex);
+	return m_maps.size();
+}
@@ -0,0 +1,69 @@
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MG_NOISE_CACHE_HEADER
+#define MG_NOISE_CACHE_HEADER
+
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "irrlichttypes.h"
+#include "threading/mutex.h"
+
+class Noise;
+
+/*
+	LRU cache of 2D noise maps shared by all emerge threads.
+	Chunks of one column have same 2D inputs, so vertical neighbours of
+	a generated chunk skip all 2D noise work.
+	Key is everything the map depends on: noise parameters, seed, size and
+	position; maps made with persistence map are reused only for equal one.
+*/
+class NoiseMapCache
+{
+public:
+	NoiseMapCache() : m_limit(0) {}
+
+	// Maximum count of cached maps, 0 disables cache
+	void setLimit(size_t limit);
+
+	// Same as noise->perlinMap2D(), result is in noise->result
+	float *perlinMap2D(Noise *noise, float x, float y,
+		float *persistence_map = NULL);
+
+	size_t size();
+
+private:
+	struct Map {
+		std::vector<float> result;
+		std::vector<float> persistence;
+	};
+	typedef std::shared_ptr<const Map> MapP;
+	typedef std::list<std::string> LruList;
+
+	static std::string getKey(const Noise *noise, float x, float y);
+
+	Mutex m_mutex;
+	size_t m_limit;
+	std::unordered_map<std::string, std::pair<MapP, LruList::iterator>> m_maps;
+	// Most recently used first
+	LruList m_lru;
+};
+
+#endif
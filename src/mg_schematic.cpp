@@ -262,10 +262,8 @@ void Schematic::placeOnMap(Map *map, v3s16 p, u32 flags,
 	//// Create & dispatch map modification events to observers
 	MapEditEvent event;
 	event.type = MEET_OTHER;
-/*
 	for (it = modified_blocks.begin(); it != modified_blocks.end(); ++it)
 		event.modified_blocks.insert(it->first);
-*/
 
 	map->dispatchEvent(&event);
 }
@@ -325,7 +323,8 @@ bool Schematic::deserializeFromMts(std::istream *is,
 	delete []schemdata;
 	schemdata = new MapNode[nodecount];
 
-	MapNode::deSerializeBulk(ss, SER_FMT_VER_HIGHEST_READ, schemdata,
+	// Schematic files always have zlib bulk data
+	MapNode::deSerializeBulk(ss, SER_FMT_VER_HIGHEST_WRITE, schemdata,
 		nodecount, 2, 2, true);
 
 	// Fix probability values for nodes that were ignore; removed in v2
@@ -283,6 +283,12 @@ void Client::handleCommand_AddNode(NetworkPacket* pkt)
 
 	addNode(p, n, remove_metadata, 2);
 }
+
+void Client::handleCommand_NodesDelta(NetworkPacket* pkt)
+{
+	// Freeminer protocol only, minetest servers never send it
+}
+
 void Client::handleCommand_BlockData(NetworkPacket* pkt)
 {
 	// Ignore too small packet
@@ -138,6 +138,15 @@ void Client::handleCommand_AddNode(NetworkPacket* pkt)      {
 	addNode(p, n, remove_metadata, 2); //fast add
 }
 
+void Client::handleCommand_NodesDelta(NetworkPacket* pkt)   {
+	auto & packet = *(pkt->packet);
+	v3POS blockpos = packet[TOCLIENT_NODES_DELTA_POS].as<v3POS>();
+	std::vector<NodeDelta> nodes;
+	packet[TOCLIENT_NODES_DELTA_NODES].convert(nodes);
+
+	addNodesDelta(blockpos, nodes);
+}
+
 void Client::handleCommand_BlockData(NetworkPacket* pkt)    {
 	auto & packet = *(pkt->packet);
 	v3s16 p = packet[TOCLIENT_BLOCKDATA_POS].as<v3s16>();
@@ -20,6 +20,11 @@ You should have received a copy of the GNU General Public License
 along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <cstdlib>
+#ifndef _WIN32
+#include <sys/types.h>
+#include <sys/socket.h>
+#endif
 #include "network/fm_connection.h"
 #include "serialization.h"
 #include "log.h"
@@ -96,6 +101,7 @@ Connection::Connection(u32 protocol_id, u32 max_packet_size, float timeout,
 	m_timeout(timeout),
 	m_enet_host(nullptr),
 	m_peer_id(0),
+	m_shards_ready(0),
 	m_bc_peerhandler(peerhandler),
 	m_last_recieved(0),
 	m_last_recieved_warn(0),
@@ -107,8 +113,26 @@ Connection::Connection(u32 protocol_id, u32 max_packet_size, float timeout,
 }
 
 
+static void destroy_unsent(MutexedQueue<ConnectionCommand> &queue) {
+	while(!queue.empty()) {
+		ConnectionCommand c = queue.pop_frontNoEx();
+		if (c.packet && !c.packet->referenceCount)
+			enet_packet_destroy(c.packet);
+	}
+}
+
 Connection::~Connection() {
 	join();
+	for (auto &shard : m_shards)
+		if (shard->thread.joinable())
+			shard->thread.join();
+	// Packets of commands never processed
+	destroy_unsent(m_command_queue);
+	for (auto &shard : m_shards) {
+		destroy_unsent(shard->commands);
+		enet_host_destroy(shard->host);
+	}
+	m_shards.clear();
 	if(m_enet_host)
 		enet_host_destroy(m_enet_host);
 	m_enet_host = nullptr;
@@ -121,9 +145,9 @@ void * Connection::run() {
 		EXCEPTION_HANDLER_BEGIN;
 		while(!m_command_queue.empty()) {
 			ConnectionCommand c = m_command_queue.pop_frontNoEx();
-			processCommand(c);
+			processCommand(c, m_enet_host);
 		}
-		receive();
+		receive(m_enet_host, 0);
 		EXCEPTION_HANDLER_END;
 	}
 
@@ -132,12 +156,35 @@ void * Connection::run() {
 	return nullptr;
 }
 
+void Connection::runShard(Shard *shard) {
+	std::string name = m_name + itos(shard->index);
+	porting::setThreadName(name.c_str());
+	g_logger.registerThread(name);
+
+	while(!stopRequested()) {
+		EXCEPTION_HANDLER_BEGIN;
+		while(!shard->commands.empty()) {
+			ConnectionCommand c = shard->commands.pop_frontNoEx();
+			processCommand(c, shard->host);
+		}
+		receive(shard->host, shard->index);
+		EXCEPTION_HANDLER_END;
+	}
+
+	for (size_t i = 0; i < shard->host->peerCount; ++i)
+		if (shard->host->peers[i].state == ENET_PEER_STATE_CONNECTED)
+			enet_peer_disconnect(&shard->host->peers[i], 0);
+	enet_host_flush(shard->host);
+
+	g_logger.deregisterThread();
+}
+
 void Connection::putEvent(ConnectionEvent &e) {
 	//if(e.type == CONNEVENT_NONE) return;
 	m_event_queue.push_back(e);
 }
 
-void Connection::processCommand(ConnectionCommand &c) {
+void Connection::processCommand(ConnectionCommand &c, ENetHost *host) {
 	switch(c.type) {
 	case CONNCMD_NONE:
 		dout_con << getDesc() << " processing CONNCMD_NONE" << std::endl;
@@ -162,32 +209,41 @@ void Connection::processCommand(ConnectionCommand &c) {
 		return;
 	case CONNCMD_SEND:
 		dout_con << getDesc() << " processing CONNCMD_SEND" << std::endl;
-		send(c.peer_id, c.channelnum, c.data, c.reliable);
+		send(host, c.peer_id, c.channelnum, c.data, c.reliable);
 		return;
 	case CONNCMD_SEND_TO_ALL:
 		dout_con << getDesc() << " processing CONNCMD_SEND_TO_ALL" << std::endl;
-		sendToAll(c.channelnum, c.data, c.reliable);
+		sendToAll(host, c.channelnum, c.data, c.reliable);
 		return;
 	case CONNCMD_DELETE_PEER:
 		dout_con << getDesc() << " processing CONNCMD_DELETE_PEER" << std::endl;
 		deletePeer(c.peer_id, false);
 		return;
+	case CONNCMD_SEND_PACKET:
+		dout_con << getDesc() << " processing CONNCMD_SEND_PACKET" << std::endl;
+		sendPacket(host, c.peer_ids, c.channelnum, c.packet);
+		return;
+	case CONNCMD_SEND_PACKET_TO_ALL:
+		dout_con << getDesc() << " processing CONNCMD_SEND_PACKET_TO_ALL" << std::endl;
+		sendPacketToAll(host, c.channelnum, c.packet);
+		return;
 	}
 }
 
 // Receive packets from the network and buffers and create ConnectionEvents
-void Connection::receive() {
-	if (!m_enet_host) {
+void Connection::receive(ENetHost *host, u8 shard) {
+	if (!host) {
 		return;
 	}
 	ENetEvent event;
-	int ret = enet_host_service(m_enet_host, & event, 10);
+	int ret = enet_host_service(host, & event, 10);
 	if (ret > 0) {
 		m_last_recieved = porting::getTimeMs();
 		m_last_recieved_warn = 0;
 		switch (event.type) {
 		case ENET_EVENT_TYPE_CONNECT: {
 			//MutexAutoLock peerlock(m_peers_mutex);
+			MutexAutoLock peeridlock(m_peer_id_mutex);
 			u16 peer_id = 0;
 			static u16 last_try = PEER_ID_SERVER + 1;
 			if (m_peers.size() > 0) {
@@ -206,6 +262,8 @@ void Connection::receive() {
 			if (!peer_id)
 				last_try = peer_id = m_peers.rbegin()->first + 1;
 
+			if (shard)
+				m_peers_shard.set(peer_id, shard);
 			m_peers.set(peer_id, event.peer);
 			auto addr = Address(event.peer->address.host, event.peer->address.port);
 #if defined(ENET_IPV6)
@@ -288,11 +346,59 @@ void Connection::serve(Address bind_addr) {
 #endif
 	address.port = bind_addr.getPort(); // fmtodo
 
-	m_enet_host = enet_host_create(&address, g_settings->getU16("max_users"), CHANNEL_COUNT, 0, 0);
+	u16 threads = rangelim(g_settings->getU16("enet_threads"), 1, 16);
+#ifndef SO_REUSEPORT
+	if (threads > 1) {
+		warningstream << "enet_threads: SO_REUSEPORT is not supported, using 1 thread" << std::endl;
+		threads = 1;
+	}
+#endif
+
+	m_enet_host = createHost(address, threads > 1);
 	if (!m_enet_host) {
 		ConnectionEvent ev(CONNEVENT_BIND_FAILED);
 		putEvent(ev);
+		return;
+	}
+
+	for (u16 i = 1; i < threads; ++i) {
+		ENetHost *host = createHost(address, true);
+		if (!host) {
+			errorstream << "enet_threads: failed to create host " << i << std::endl;
+			break;
+		}
+		m_shards.emplace_back(new Shard(host, i));
 	}
+	// Shards are not changed after this, other threads may route to them
+	m_shards_ready = m_shards.size();
+	for (auto &shard : m_shards)
+		shard->thread = std::thread(&Connection::runShard, this, shard.get());
+	if (!m_shards.empty())
+		infostream << "enet: serving with " << m_shards.size() + 1 << " threads" << std::endl;
+}
+
+// All hosts of server are bound to same address, kernel spreads clients by address hash
+ENetHost *Connection::createHost(ENetAddress &address, bool reuse_port) {
+	u16 max_users = g_settings->getU16("max_users");
+	if (!reuse_port)
+		return enet_host_create(&address, max_users, CHANNEL_COUNT, 0, 0);
+
+#ifdef SO_REUSEPORT
+	ENetHost *host = enet_host_create(NULL, max_users, CHANNEL_COUNT, 0, 0);
+	if (!host)
+		return nullptr;
+	int set_option_on = 1;
+	if (setsockopt(host->socket, SOL_SOCKET, SO_REUSEPORT,
+			(const char*) &set_option_on, sizeof(set_option_on)) < 0
+			|| enet_socket_bind(host->socket, &address) < 0) {
+		enet_host_destroy(host);
+		return nullptr;
+	}
+	host->address = address;
+	return host;
+#else
+	return nullptr;
+#endif
 }
 
 // peer
@@ -358,40 +464,105 @@ void Connection::disconnect() {
 	auto lock = m_peers.lock_unique_rec();
 	for (auto i = m_peers.begin();
 	        i != m_peers.end(); ++i)
-		enet_peer_disconnect(i->second, 0);
+		if (i->second->host == m_enet_host) // other shards disconnect own peers
+			enet_peer_disconnect(i->second, 0);
 	m_peers.clear();
 	m_peers_address.clear();
+	m_peers_shard.clear();
 }
 
-void Connection::sendToAll(u8 channelnum, SharedBuffer<u8> data, bool reliable) {
-	ENetPacket *packet = enet_packet_create(*data, data.getSize(), reliable ? ENET_PACKET_FLAG_RELIABLE : 0);
-	enet_host_broadcast(m_enet_host, 0, packet);
+static ENetPacket *create_packet(const u8 *data, size_t size, bool reliable) {
+	return enet_packet_create(data, size, reliable ? ENET_PACKET_FLAG_RELIABLE : 0);
 }
 
-void Connection::send(u16 peer_id, u8 channelnum,
-                      SharedBuffer<u8> data, bool reliable) {
-	{
-		//MutexAutoLock peerlock(m_peers_mutex);
-		if (m_peers.find(peer_id) == m_peers.end())
-			return;
+// Memory shared by packets of several shards, enet reference counts are per host thread
+struct PacketData {
+	char *data;
+	std::atomic_uint refs;
+};
+
+static void free_packet_data(ENetPacket *packet) {
+	auto shared = (PacketData *)packet->userData;
+	if (--shared->refs)
+		return;
+	::free(shared->data);
+	delete shared;
+}
+
+// Takes memory of buffer, count packets with same data are returned,
+// memory is freed when last of them destroyed by enet
+static std::vector<ENetPacket *> create_packets(msgpack::sbuffer &buffer, bool reliable, size_t count) {
+	std::vector<ENetPacket *> packets;
+	if (!count) {
+		::free(buffer.release());
+		return packets;
+	}
+	size_t size = buffer.size();
+	auto shared = new PacketData;
+	shared->data = buffer.release();
+	shared->refs = count;
+	for (size_t i = 0; i < count; ++i) {
+		ENetPacket *packet = enet_packet_create(shared->data, size,
+				ENET_PACKET_FLAG_NO_ALLOCATE | (reliable ? ENET_PACKET_FLAG_RELIABLE : 0));
+		packet->userData = shared;
+		packet->freeCallback = free_packet_data;
+		packets.push_back(packet);
 	}
-	//dout_con<<getDesc()<<" sending to peer_id="<<peer_id<<std::endl;
+	return packets;
+}
 
-	assert(channelnum < CHANNEL_COUNT);
+void Connection::sendToAll(ENetHost *host, u8 channelnum, SharedBuffer<u8> data, bool reliable) {
+	sendPacketToAll(host, channelnum, create_packet(*data, data.getSize(), reliable));
+}
 
-	ENetPacket *packet = enet_packet_create(*data, data.getSize(), reliable ? ENET_PACKET_FLAG_RELIABLE : 0);
+void Connection::send(ENetHost *host, u16 peer_id, u8 channelnum,
+                      SharedBuffer<u8> data, bool reliable) {
+	sendPacket(host, {peer_id}, channelnum, create_packet(*data, data.getSize(), reliable));
+}
 
-	ENetPeer *peer = getPeer(peer_id);
-	if(!peer) {
-		deletePeer(peer_id, false);
+void Connection::sendPacketToAll(ENetHost *host, u8 channelnum, ENetPacket *packet) {
+	if (!host) {
+		enet_packet_destroy(packet);
 		return;
 	}
-	if (enet_peer_send(peer, channelnum, packet) < 0) {
-		infostream << "enet_peer_send failed peer=" << peer_id << " reliable=" << reliable << " size=" << data.getSize() << std::endl;
-		if (reliable)
+	enet_host_broadcast(host, 0, packet);
+}
+
+void Connection::sendPacket(ENetHost *host, const std::vector<u16> &peer_ids, u8 channelnum,
+                            ENetPacket *packet) {
+	assert(channelnum < CHANNEL_COUNT);
+	bool reliable = packet->flags & ENET_PACKET_FLAG_RELIABLE;
+
+	for (auto peer_id : peer_ids) {
+		//dout_con<<getDesc()<<" sending to peer_id="<<peer_id<<std::endl;
+		{
+			//MutexAutoLock peerlock(m_peers_mutex);
+			if (m_peers.find(peer_id) == m_peers.end())
+				continue;
+		}
+
+		ENetPeer *peer = getPeer(peer_id);
+		if(!peer) {
 			deletePeer(peer_id, false);
-		return;
+			continue;
+		}
+		// Routed by stale shard (peer id reused by other host), peer and packet
+		// can be used only from thread of its own host
+		if (peer->host != host) {
+			infostream << "sendPacket: peer=" << peer_id << " is not on this host, dropped" << std::endl;
+			continue;
+		}
+		if (enet_peer_send(peer, channelnum, packet) < 0) {
+			infostream << "enet_peer_send failed peer=" << peer_id << " reliable=" << reliable << " size=" << packet->dataLength << std::endl;
+			if (reliable)
+				deletePeer(peer_id, false);
+			continue;
+		}
 	}
+
+	// Not queued to any peer
+	if (!packet->referenceCount)
+		enet_packet_destroy(packet);
 }
 
 ENetPeer* Connection::getPeer(u16 peer_id) {
@@ -405,6 +576,9 @@ ENetPeer* Connection::getPeer(u16 peer_id) {
 
 bool Connection::deletePeer(u16 peer_id, bool timeout) {
 	//MutexAutoLock peerlock(m_peers_mutex);
+	// Id is free only after its shard is gone, else connect can reuse it
+	// and lose the new shard
+	MutexAutoLock peeridlock(m_peer_id_mutex);
 	if(m_peers.find(peer_id) == m_peers.end())
 		return false;
 
@@ -414,8 +588,9 @@ bool Connection::deletePeer(u16 peer_id, bool timeout) {
 	putEvent(e);
 
 	// delete m_peers[peer_id]; -- enet should handle this
-	m_peers.erase(peer_id);
+	m_peers_shard.erase(peer_id);
 	m_peers_address.erase(peer_id);
+	m_peers.erase(peer_id);
 	return true;
 }
 
@@ -448,6 +623,22 @@ void Connection::putCommand(ConnectionCommand &c) {
 	m_command_queue.push_back(c);
 }
 
+void Connection::putCommand(ConnectionCommand &c, u8 shard) {
+	if (!shard)
+		m_command_queue.push_back(c);
+	else
+		m_shards[shard - 1]->commands.push_back(c);
+}
+
+// Peer is used only by thread of its host
+u8 Connection::getShard(u16 peer_id) {
+	if (!m_shards_ready)
+		return 0;
+	auto lock = m_peers_shard.lock_shared_rec();
+	auto it = m_peers_shard.find(peer_id);
+	return it == m_peers_shard.end() ? 0 : it->second;
+}
+
 void Connection::Serve(Address bind_address) {
 	ConnectionCommand c;
 	c.serve(bind_address);
@@ -525,7 +716,13 @@ void Connection::SendToAll(u8 channelnum, SharedBuffer<u8> data, bool reliable)
 
 	ConnectionCommand c;
 	c.sendToAll(channelnum, data, reliable);
-	putCommand(c);
+	putCommand(c, 0);
+	// SharedBuffer reference count is not atomic, own copy for every thread
+	for (u8 shard = 1; shard <= m_shards_ready; ++shard) {
+		ConnectionCommand shard_c;
+		shard_c.sendToAll(channelnum, SharedBuffer<u8>(*data, data.getSize()), reliable);
+		putCommand(shard_c, shard);
+	}
 }
 
 void Connection::Send(u16 peer_id, u8 channelnum,
@@ -534,12 +731,57 @@ void Connection::Send(u16 peer_id, u8 channelnum,
 
 	ConnectionCommand c;
 	c.send(peer_id, channelnum, data, reliable);
-	putCommand(c);
+	putCommand(c, getShard(peer_id));
 }
 
 void Connection::Send(u16 peer_id, u8 channelnum, const msgpack::sbuffer &buffer, bool reliable) {
-	SharedBuffer<u8> data((unsigned char*)buffer.data(), buffer.size());
-	Send(peer_id, channelnum, data, reliable);
+	assert(channelnum < CHANNEL_COUNT);
+
+	// Buffer stays with caller, one copy right into packet
+	ConnectionCommand c;
+	c.sendPacket({peer_id}, channelnum,
+			create_packet((const u8 *)buffer.data(), buffer.size(), reliable));
+	putCommand(c, getShard(peer_id));
+}
+
+void Connection::Send(u16 peer_id, u8 channelnum, msgpack::sbuffer &&buffer, bool reliable) {
+	Send(std::vector<u16>{peer_id}, channelnum, std::move(buffer), reliable);
+}
+
+void Connection::Send(const std::vector<u16> &peer_ids, u8 channelnum,
+                      msgpack::sbuffer &&buffer, bool reliable) {
+	assert(channelnum < CHANNEL_COUNT);
+
+	// One packet per shard with peers
+	std::vector<std::vector<u16>> shard_peers(m_shards_ready + 1);
+	for (auto peer_id : peer_ids)
+		shard_peers[getShard(peer_id)].push_back(peer_id);
+	size_t count = 0;
+	for (auto &ids : shard_peers)
+		if (!ids.empty())
+			++count;
+
+	auto packets = create_packets(buffer, reliable, count);
+	auto packet = packets.begin();
+	for (u8 shard = 0; shard < shard_peers.size(); ++shard) {
+		if (shard_peers[shard].empty())
+			continue;
+		ConnectionCommand c;
+		c.sendPacket(shard_peers[shard], channelnum, *packet++);
+		putCommand(c, shard);
+	}
+}
+
+void Connection::SendToAll(u8 channelnum, msgpack::sbuffer &&buffer, bool reliable) {
+	assert(channelnum < CHANNEL_COUNT);
+
+	u8 shards = m_shards_ready + 1;
+	auto packets = create_packets(buffer, reliable, shards);
+	for (u8 shard = 0; shard < shards; ++shard) {
+		ConnectionCommand c;
+		c.sendPacketToAll(channelnum, packets[shard]);
+		putCommand(c, shard);
+	}
 }
 
 Address Connection::GetPeerAddress(u16 peer_id) {
@@ -33,14 +33,19 @@ along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
 #include "util/thread.h"
 #include <iostream>
 #include <fstream>
+#include <atomic>
 #include <list>
 #include <map>
+#include <memory>
+#include <thread>
+#include <vector>
 
 #include "enet/enet.h"
 #include "../msgpack_fix.h"
 #include "util/msgpack_serialize.h"
 #include "threading/concurrent_map.h"
 #include "../threading/concurrent_unordered_map.h"
+#include "threading/mutex.h"
 
 #define CHANNEL_COUNT 3
 
@@ -225,6 +230,8 @@ enum ConnectionCommandType {
 	CONNCMD_SEND,
 	CONNCMD_SEND_TO_ALL,
 	CONNCMD_DELETE_PEER,
+	CONNCMD_SEND_PACKET,
+	CONNCMD_SEND_PACKET_TO_ALL,
 };
 
 struct ConnectionCommand {
@@ -234,8 +241,11 @@ struct ConnectionCommand {
 	u8 channelnum;
 	Buffer<u8> data;
 	bool reliable;
+	// Ready enet packet and its receivers, reliability is in packet flags
+	ENetPacket *packet;
+	std::vector<u16> peer_ids;
 
-	ConnectionCommand(): type(CONNCMD_NONE) {}
+	ConnectionCommand(): type(CONNCMD_NONE), packet(nullptr) {}
 
 	void serve(Address address_) {
 		type = CONNCMD_SERVE;
@@ -262,6 +272,18 @@ struct ConnectionCommand {
 		data = data_;
 		reliable = reliable_;
 	}
+	void sendPacket(const std::vector<u16> &peer_ids_, u8 channelnum_,
+	                ENetPacket *packet_) {
+		type = CONNCMD_SEND_PACKET;
+		peer_ids = peer_ids_;
+		channelnum = channelnum_;
+		packet = packet_;
+	}
+	void sendPacketToAll(u8 channelnum_, ENetPacket *packet_) {
+		type = CONNCMD_SEND_PACKET_TO_ALL;
+		channelnum = channelnum_;
+		packet = packet_;
+	}
 	void deletePeer(u16 peer_id_) {
 		type = CONNCMD_DELETE_PEER;
 		peer_id = peer_id_;
@@ -293,6 +315,15 @@ class Connection: public thread_pool {
 	void SendToAll(u8 channelnum, SharedBuffer<u8> data, bool reliable);
 	void Send(u16 peer_id, u8 channelnum, SharedBuffer<u8> data, bool reliable);
 	void Send(u16 peer_id, u8 channelnum, const msgpack::sbuffer &buffer, bool reliable);
+	/*
+		Memory of buffer is given to enet packet without copy and freed
+		when packet is sent, buffer is empty after call.
+		Packet for many peers is made once and shared by all of them.
+	*/
+	void Send(u16 peer_id, u8 channelnum, msgpack::sbuffer &&buffer, bool reliable);
+	void Send(const std::vector<u16> &peer_ids, u8 channelnum,
+	          msgpack::sbuffer &&buffer, bool reliable);
+	void SendToAll(u8 channelnum, msgpack::sbuffer &&buffer, bool reliable);
 	u16 GetPeerID() { return m_peer_id; }
 	void DeletePeer(u16 peer_id);
 	Address GetPeerAddress(u16 peer_id);
@@ -301,16 +332,36 @@ class Connection: public thread_pool {
 	size_t events_size();
 
 private:
+	/*
+		Additional hosts bound to the same port (enet_threads), each one
+		served by own thread. Kernel gives every client address to one of
+		the sockets, peers of a host are used only from its thread.
+		m_enet_host and run() thread are shard 0.
+	*/
+	struct Shard {
+		Shard(ENetHost *host_, u8 index_): host(host_), index(index_) {}
+		ENetHost *host;
+		u8 index;
+		MutexedQueue<ConnectionCommand> commands;
+		std::thread thread;
+	};
+
+	void runShard(Shard *shard);
+	ENetHost *createHost(ENetAddress &address, bool reuse_port);
+	u8 getShard(u16 peer_id);
+	void putCommand(ConnectionCommand &c, u8 shard);
 	void putEvent(ConnectionEvent &e);
-	void processCommand(ConnectionCommand &c);
+	void processCommand(ConnectionCommand &c, ENetHost *host);
 	void send(float dtime);
-	void receive();
+	void receive(ENetHost *host, u8 shard);
 	void runTimeouts(float dtime);
 	void serve(Address address);
 	void connect(Address address);
 	void disconnect();
-	void sendToAll(u8 channelnum, SharedBuffer<u8> data, bool reliable);
-	void send(u16 peer_id, u8 channelnum, SharedBuffer<u8> data, bool reliable);
+	void sendToAll(ENetHost *host, u8 channelnum, SharedBuffer<u8> data, bool reliable);
+	void send(ENetHost *host, u16 peer_id, u8 channelnum, SharedBuffer<u8> data, bool reliable);
+	void sendPacket(ENetHost *host, const std::vector<u16> &peer_ids, u8 channelnum, ENetPacket *packet);
+	void sendPacketToAll(ENetHost *host, u8 channelnum, ENetPacket *packet);
 	ENetPeer* getPeer(u16 peer_id);
 	bool deletePeer(u16 peer_id, bool timeout);
 
@@ -328,10 +379,18 @@ class Connection: public thread_pool {
 	concurrent_unordered_map<u16, Address> m_peers_address;
 	//Mutex m_peers_mutex;
 
+	std::vector<std::unique_ptr<Shard>> m_shards;
+	// Count of m_shards ready for other threads
+	std::atomic_uint m_shards_ready;
+	// Peers of shards other than 0
+	concurrent_unordered_map<u16, u8> m_peers_shard;
+	Mutex m_peer_id_mutex;
+
 	// Backwards compatibility
 	PeerHandler *m_bc_peerhandler;
-	unsigned int m_last_recieved;
-	unsigned int m_last_recieved_warn;
+	// Written by receive() of every shard
+	std::atomic_uint m_last_recieved;
+	std::atomic_uint m_last_recieved_warn;
 
 	void SetPeerID(u16 id) { m_peer_id = id; }
 	u32 GetProtocolID() { return m_protocol_id; }
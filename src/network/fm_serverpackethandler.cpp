@@ -347,7 +347,7 @@ void Server::handleCommand_Init_Legacy(NetworkPacket* pkt) {
 		PACK(TOCLIENT_INIT_WEATHER, g_settings->getBool("weather"));
 
 		// Send as reliable
-		m_clients.send(peer_id, 0, buffer, true);
+		m_clients.send(peer_id, 0, std::move(buffer), true);
 		m_clients.event(peer_id, CSE_InitLegacy);
 	}
 
@@ -36,7 +36,7 @@ void Server::SendMovement(u16 peer_id)
 	PACK(TOCLIENT_MOVEMENT_FALL_AERODYNAMICS, g_settings->getFloat("movement_fall_aerodynamics"));
 
 	// Send as reliable
-	m_clients.send(peer_id, 0, buffer, true);
+	m_clients.send(peer_id, 0, std::move(buffer), true);
 }
 
 void Server::SendHP(u16 peer_id, u8 hp)
@@ -48,7 +48,7 @@ void Server::SendHP(u16 peer_id, u8 hp)
 	PACK(TOCLIENT_HP_HP, hp);
 
 	// Send as reliable
-	m_clients.send(peer_id, 0, buffer, true);
+	m_clients.send(peer_id, 0, std::move(buffer), true);
 }
 
 void Server::SendBreath(u16 peer_id, u16 breath)
@@ -57,7 +57,7 @@ void Server::SendBreath(u16 peer_id, u16 breath)
 	MSGPACK_PACKET_INIT(TOCLIENT_BREATH, 1);
 	PACK(TOCLIENT_BREATH_BREATH, breath);
 	// Send as reliable
-	m_clients.send(peer_id, 0, buffer, true);
+	m_clients.send(peer_id, 0, std::move(buffer), true);
 }
 
 void Server::SendAccessDenied(u16 peer_id, AccessDeniedCode reason, const std::string &custom_reason, bool reconnect)
@@ -69,7 +69,7 @@ void Server::SendAccessDenied(u16 peer_id, AccessDeniedCode reason, const std::s
 	PACK(TOCLIENT_ACCESS_DENIED_RECONNECT, reconnect);
 
 	// Send as reliable
-	m_clients.send(peer_id, 0, buffer, true);
+	m_clients.send(peer_id, 0, std::move(buffer), true);
 }
 
 void Server::SendDeathscreen(u16 peer_id,bool set_camera_point_target,
@@ -82,7 +82,7 @@ void Server::SendDeathscreen(u16 peer_id,bool set_camera_point_target,
 	PACK(TOCLIENT_DEATHSCREEN_CAMERA_POINT, camera_point_target);
 
 	// Send as reliable
-	m_clients.send(peer_id, 0, buffer, true);
+	m_clients.send(peer_id, 0, std::move(buffer), true);
 }
 
 void Server::SendItemDef(u16 peer_id,
@@ -101,7 +101,7 @@ void Server::SendItemDef(u16 peer_id,
 		PACK(TOCLIENT_ITEMDEF_DEFINITIONS, *itemdef);
 	}
 
-	m_clients.send(peer_id, 0, buffer, true);
+	m_clients.send(peer_id, 0, std::move(buffer), true);
 }
 
 void Server::SendNodeDef(u16 peer_id,
@@ -121,7 +121,7 @@ void Server::SendNodeDef(u16 peer_id,
 	}
 
 	// Send as reliable
-	m_clients.send(peer_id, 0, buffer, true);
+	m_clients.send(peer_id, 0, std::move(buffer), true);
 }
 
 /*
@@ -147,7 +147,7 @@ void Server::SendInventory(PlayerSAO* playerSAO)
 	PACK(TOCLIENT_INVENTORY_DATA, s);
 
 	// Send as reliable
-	m_clients.send(playerSAO->getPeerID(), 0, buffer, true);
+	m_clients.send(playerSAO->getPeerID(), 0, std::move(buffer), true);
 }
 
 void Server::SendChatMessage(u16 peer_id, const std::string &message)
@@ -160,11 +160,11 @@ void Server::SendChatMessage(u16 peer_id, const std::string &message)
 	if (peer_id != PEER_ID_INEXISTENT)
 	{
 		// Send as reliable
-		m_clients.send(peer_id, 0, buffer, true);
+		m_clients.send(peer_id, 0, std::move(buffer), true);
 	}
 	else
 	{
-		m_clients.sendToAll(0,buffer,true);
+		m_clients.sendToAll(0,std::move(buffer),true);
 	}
 }
 
@@ -178,7 +178,7 @@ void Server::SendShowFormspecMessage(u16 peer_id, const std::string &formspec,
 	PACK(TOCLIENT_SHOW_FORMSPEC_NAME, formname);
 
 	// Send as reliable
-	m_clients.send(peer_id, 0, buffer, true);
+	m_clients.send(peer_id, 0, std::move(buffer), true);
 }
 
 // Spawns a particle on peer with peer_id
@@ -201,11 +201,11 @@ void Server::SendSpawnParticle(u16 peer_id, v3f pos, v3f velocity, v3f accelerat
 	if (peer_id != PEER_ID_INEXISTENT)
 	{
 	// Send as reliable
-		m_clients.send(peer_id, 0, buffer, true);
+		m_clients.send(peer_id, 0, std::move(buffer), true);
 	}
 	else
 	{
-		m_clients.sendToAll(0,buffer,true);
+		m_clients.sendToAll(0,std::move(buffer),true);
 	}
 }
 
@@ -237,10 +237,10 @@ void Server::SendAddParticleSpawner(u16 peer_id, u16 amount, float spawntime, v3
 	if (peer_id != PEER_ID_INEXISTENT)
 	{
 		// Send as reliable
-		m_clients.send(peer_id, 0, buffer, true);
+		m_clients.send(peer_id, 0, std::move(buffer), true);
 	}
 	else {
-		m_clients.sendToAll(0,buffer,true);
+		m_clients.sendToAll(0,std::move(buffer),true);
 	}
 }
 
@@ -253,10 +253,10 @@ void Server::SendDeleteParticleSpawner(u16 peer_id, u32 id)
 
 	if (peer_id != PEER_ID_INEXISTENT) {
 		// Send as reliable
-		m_clients.send(peer_id, 0, buffer, true);
+		m_clients.send(peer_id, 0, std::move(buffer), true);
 	}
 	else {
-		m_clients.sendToAll(0,buffer,true);
+		m_clients.sendToAll(0,std::move(buffer),true);
 	}
 
 }
@@ -279,7 +279,7 @@ void Server::SendHUDAdd(u16 peer_id, u32 id, HudElement *form)
 	PACK(TOCLIENT_HUDADD_SIZE, form->size);
 
 	// Send as reliable
-	m_clients.send(peer_id, 1, buffer, true);
+	m_clients.send(peer_id, 1, std::move(buffer), true);
 }
 
 void Server::SendHUDRemove(u16 peer_id, u32 id)
@@ -289,7 +289,7 @@ void Server::SendHUDRemove(u16 peer_id, u32 id)
 
 	// Send as reliable
 
-	m_clients.send(peer_id, 1, buffer, true);
+	m_clients.send(peer_id, 1, std::move(buffer), true);
 }
 
 void Server::SendHUDChange(u16 peer_id, u32 id, HudElementStat stat, void *value)
@@ -324,7 +324,7 @@ void Server::SendHUDChange(u16 peer_id, u32 id, HudElementStat stat, void *value
 	}
 
 	// Send as reliable
-	m_clients.send(peer_id, 0, buffer, true);
+	m_clients.send(peer_id, 0, std::move(buffer), true);
 }
 
 void Server::SendHUDSetFlags(u16 peer_id, u32 flags, u32 mask)
@@ -336,7 +336,7 @@ void Server::SendHUDSetFlags(u16 peer_id, u32 flags, u32 mask)
 	PACK(TOCLIENT_HUD_SET_FLAGS_MASK, mask);
 
 	// Send as reliable
-	m_clients.send(peer_id, 0, buffer, true);
+	m_clients.send(peer_id, 0, std::move(buffer), true);
 }
 
 void Server::SendHUDSetParam(u16 peer_id, u16 param, const std::string &value)
@@ -346,7 +346,7 @@ void Server::SendHUDSetParam(u16 peer_id, u16 param, const std::string &value)
 	PACK(TOCLIENT_HUD_SET_PARAM_VALUE, value);
 
 	// Send as reliable
-	m_clients.send(peer_id, 0, buffer, true);
+	m_clients.send(peer_id, 0, std::move(buffer), true);
 }
 
 void Server::SendSetSky(u16 peer_id, const video::SColor &bgcolor,
@@ -358,7 +358,7 @@ void Server::SendSetSky(u16 peer_id, const video::SColor &bgcolor,
 	PACK(TOCLIENT_SET_SKY_PARAMS, params);
 
 	// Send as reliable
-	m_clients.send(peer_id, 0, buffer, true);
+	m_clients.send(peer_id, 0, std::move(buffer), true);
 }
 
 void Server::SendOverrideDayNightRatio(u16 peer_id, bool do_override,
@@ -369,7 +369,7 @@ void Server::SendOverrideDayNightRatio(u16 peer_id, bool do_override,
 	PACK(TOCLIENT_OVERRIDE_DAY_NIGHT_RATIO_VALUE, ratio);
 
 	// Send as reliable
-	m_clients.send(peer_id, 0, buffer, true);
+	m_clients.send(peer_id, 0, std::move(buffer), true);
 }
 
 void Server::SendTimeOfDay(u16 peer_id, u16 time, f32 time_speed)
@@ -382,11 +382,11 @@ void Server::SendTimeOfDay(u16 peer_id, u16 time, f32 time_speed)
 	PACK(TOCLIENT_TIME_OF_DAY_TIME_SPEED, time_speed);
 
 	if (peer_id == PEER_ID_INEXISTENT) {
-		m_clients.sendToAll(0,buffer,true);
+		m_clients.sendToAll(0,std::move(buffer),true);
 	}
 	else {
 		// Send as reliable
-		m_clients.send(peer_id, 0, buffer, true);
+		m_clients.send(peer_id, 0, std::move(buffer), true);
 	}
 }
 
@@ -428,7 +428,7 @@ void Server::SendMovePlayer(u16 peer_id)
 	PACK(TOCLIENT_MOVE_PLAYER_YAW, player->getYaw());
 	//PACK(TOCLIENT_MOVE_PLAYER_SPEED, player->getSpeed());
 	// Send as reliable
-	m_clients.send(peer_id, 0, buffer, true);
+	m_clients.send(peer_id, 0, std::move(buffer), true);
 }
 
 void Server::SendPunchPlayer(u16 peer_id, v3f speed)
@@ -441,7 +441,7 @@ void Server::SendPunchPlayer(u16 peer_id, v3f speed)
 	MSGPACK_PACKET_INIT(TOCLIENT_PUNCH_PLAYER, 1);
 	PACK(TOCLIENT_PUNCH_PLAYER_SPEED, speed);
 	// Send as reliable
-	m_clients.send(peer_id, 0, buffer, true);
+	m_clients.send(peer_id, 0, std::move(buffer), true);
 }
 
 void Server::SendLocalPlayerAnimations(u16 peer_id, v2s32 animation_frames[4], f32 animation_speed)
@@ -454,7 +454,7 @@ void Server::SendLocalPlayerAnimations(u16 peer_id, v2s32 animation_frames[4], f
 	PACK(TOCLIENT_LOCAL_PLAYER_ANIMATIONS_FRAME_SPEED, animation_speed);
 
 	// Send as reliable
-	m_clients.send(peer_id, 0, buffer, true);
+	m_clients.send(peer_id, 0, std::move(buffer), true);
 }
 
 void Server::SendEyeOffset(u16 peer_id, v3f first, v3f third)
@@ -463,7 +463,7 @@ void Server::SendEyeOffset(u16 peer_id, v3f first, v3f third)
 	PACK(TOCLIENT_EYE_OFFSET_FIRST, first);
 	PACK(TOCLIENT_EYE_OFFSET_THIRD, third);
 	// Send as reliable
-	m_clients.send(peer_id, 0, buffer, true);
+	m_clients.send(peer_id, 0, std::move(buffer), true);
 }
 void Server::SendPlayerPrivileges(u16 peer_id)
 {
@@ -481,7 +481,7 @@ void Server::SendPlayerPrivileges(u16 peer_id)
 	PACK(TOCLIENT_PRIVILEGES_PRIVILEGES, privs);
 
 	// Send as reliable
-	m_clients.send(peer_id, 0, buffer, true);
+	m_clients.send(peer_id, 0, std::move(buffer), true);
 }
 
 void Server::SendPlayerInventoryFormspec(u16 peer_id)
@@ -497,16 +497,39 @@ void Server::SendPlayerInventoryFormspec(u16 peer_id)
 	PACK(TOCLIENT_INVENTORY_FORMSPEC_DATA, FORMSPEC_VERSION_STRING + player->inventory_formspec);
 
 	// Send as reliable
-	m_clients.send(peer_id, 0, buffer, true);
+	m_clients.send(peer_id, 0, std::move(buffer), true);
 }
 
-void Server::SendActiveObjectMessages(u16 peer_id, const ActiveObjectMessages &datas, bool reliable)
+void ActiveObjectMessagesEncoded::add(const ActiveObjectMessage &aom)
+{
+	// Same bytes as one packed element of ActiveObjectMessages
+	msgpack::sbuffer buffer;
+	msgpack::packer<msgpack::sbuffer> pk(&buffer);
+	pk.pack_array(2);
+	pk.pack((unsigned int)aom.id);
+	pk.pack(aom.datastring);
+
+	if (aom.reliable) {
+		reliable.append(buffer.data(), buffer.size());
+		++reliable_count;
+	} else {
+		unreliable.append(buffer.data(), buffer.size());
+		++unreliable_count;
+	}
+}
+
+void Server::SendActiveObjectMessages(u16 peer_id, const std::vector<const std::string *> &datas,
+		u32 count, bool reliable)
 {
 	MSGPACK_PACKET_INIT(TOCLIENT_ACTIVE_OBJECT_MESSAGES, 1);
-	PACK(TOCLIENT_ACTIVE_OBJECT_MESSAGES_MESSAGES, datas);
+	// ActiveObjectMessages array from already packed elements
+	pk.pack((int)TOCLIENT_ACTIVE_OBJECT_MESSAGES_MESSAGES);
+	pk.pack_array(count);
+	for (auto data : datas)
+		buffer.write(data->data(), data->size());
 
 	// Send as reliable
-	m_clients.send(peer_id, 0, buffer, reliable);
+	m_clients.send(peer_id, 0, std::move(buffer), reliable);
 }
 
 
@@ -576,12 +599,8 @@ s32 Server::playSound(const SimpleSoundSpec &spec,
 	PACK(TOCLIENT_PLAY_SOUND_POS, pos);
 	PACK(TOCLIENT_PLAY_SOUND_OBJECT_ID, params.object);
 	PACK(TOCLIENT_PLAY_SOUND_LOOP, params.loop);
-	// Send
-	for(auto i = dst_clients.begin();
-			i != dst_clients.end(); i++){
-		// Send as reliable
-		m_clients.send(*i, 0, buffer, true);
-	}
+	// Send as reliable, one packet for all
+	m_clients.send(dst_clients, 0, std::move(buffer), true);
 	return id;
 }
 void Server::stopSound(s32 handle)
@@ -595,12 +614,9 @@ void Server::stopSound(s32 handle)
 	// Create packet
 	MSGPACK_PACKET_INIT(TOCLIENT_STOP_SOUND, 1);
 	PACK(TOCLIENT_STOP_SOUND_ID, handle);
-	// Send
-	for(std::set<u16>::iterator i = psound.clients.begin();
-			i != psound.clients.end(); i++){
-		// Send as reliable
-		m_clients.send(*i, 0, buffer, true);
-	}
+	// Send as reliable, one packet for all
+	m_clients.send(std::vector<u16>(psound.clients.begin(), psound.clients.end()),
+			0, std::move(buffer), true);
 	// Remove sound reference
 	m_playing_sounds.erase(i);
 }
@@ -617,6 +633,7 @@ void Server::sendRemoveNode(v3s16 p, u16 ignore_id,
 	PACK(TOCLIENT_REMOVENODE_POS, p);
 
 	std::vector<u16> clients = m_clients.getClientIDs();
+	std::vector<u16> send_to;
 	for(auto
 		i = clients.begin();
 		i != clients.end(); ++i)
@@ -634,9 +651,11 @@ void Server::sendRemoveNode(v3s16 p, u16 ignore_id,
 			}
 		}
 
-		// Send as reliable
-		m_clients.send(*i, 0, buffer, true);
+		send_to.push_back(*i);
 	}
+
+	// Send as reliable, one packet for all
+	m_clients.send(send_to, 0, std::move(buffer), true);
 }
 
 void Server::sendAddNode(v3s16 p, MapNode n, u16 ignore_id,
@@ -646,7 +665,14 @@ void Server::sendAddNode(v3s16 p, MapNode n, u16 ignore_id,
 	float maxd = far_d_nodes*BS;
 	v3f p_f = intToFloat(p, BS);
 
+	// Create packet
+	MSGPACK_PACKET_INIT(TOCLIENT_ADDNODE, 3);
+	PACK(TOCLIENT_ADDNODE_POS, p);
+	PACK(TOCLIENT_ADDNODE_NODE, n);
+	PACK(TOCLIENT_ADDNODE_REMOVE_METADATA, remove_metadata);
+
 	std::vector<u16> clients = m_clients.getClientIDs();
+	std::vector<u16> send_to;
 	for(auto
 				i = clients.begin();
 		i != clients.end(); ++i)
@@ -665,19 +691,108 @@ void Server::sendAddNode(v3s16 p, MapNode n, u16 ignore_id,
 				}
 			}
 		}
-		SharedBuffer<u8> reply(0);
 		RemoteClient* client = m_clients.lockedGetClientNoEx(*i);
 		if (client != 0)
-		{
-			// Create packet
-			MSGPACK_PACKET_INIT(TOCLIENT_ADDNODE, 3);
-			PACK(TOCLIENT_ADDNODE_POS, p);
-			PACK(TOCLIENT_ADDNODE_NODE, n);
-			PACK(TOCLIENT_ADDNODE_REMOVE_METADATA, remove_metadata);
+			send_to.push_back(*i);
+	}
+
+	// Send as reliable, one packet for all
+	m_clients.send(send_to, 0, std::move(buffer), true);
+}
+
+void Server::sendNodesDelta(v3POS blockpos, const BlockNodesDelta &delta, float far_d_nodes)
+{
+	static const u16 max_nodes = g_settings->getU16("block_delta_max_nodes");
+	const auto &nodes = delta.nodes;
+	const auto &known_by_peer = delta.known_by_peer;
+	// Too many changes: full block is smaller and cheaper to apply
+	bool full_block = nodes.size() > max_nodes;
+
+	float maxd = (far_d_nodes + MAP_BLOCKSIZE / 2) * BS;
+	v3f p_f = intToFloat(blockpos * MAP_BLOCKSIZE + v3POS(MAP_BLOCKSIZE / 2, MAP_BLOCKSIZE / 2, MAP_BLOCKSIZE / 2), BS);
+
+	MSGPACK_PACKET_INIT(TOCLIENT_NODES_DELTA, 2);
+	PACK(TOCLIENT_NODES_DELTA_POS, blockpos);
+	PACK(TOCLIENT_NODES_DELTA_NODES, nodes);
+
+	g_profiler->add("Server: nodes delta blocks", 1);
+	g_profiler->add("Server: nodes delta nodes", nodes.size());
+
+	std::vector<u16> clients = m_clients.getClientIDs();
+	std::vector<u16> send_to;
+	for(auto
+		i = clients.begin();
+		i != clients.end(); ++i)
+	{
+		RemoteClient* client = m_clients.lockedGetClientNoEx(*i);
+		if (!client)
+			continue;
+
+		if (full_block) {
+			client->SetBlockNotSent(blockpos);
+			continue;
+		}
+
+		// Get player
+		Player *player = m_env->getPlayer(*i);
+		if(player) {
+			// If player is far away, only set modified block not sent
+			v3f player_pos = player->getPosition();
+			if(player_pos.getDistanceFrom(p_f) > maxd) {
+				client->SetBlockNotSent(blockpos);
+				continue;
+			}
+		}
 
-			m_clients.send(*i, 0, buffer, true);
+		// Changes made by this peer are already known by it
+		std::vector<NodeDelta> unknown;
+		bool known = std::find(known_by_peer.begin(), known_by_peer.end(), *i) != known_by_peer.end();
+		if (known) {
+			for (size_t n = 0; n < nodes.size(); ++n)
+				if (known_by_peer[n] != *i)
+					unknown.push_back(nodes[n]);
+		}
+
+		// Client has all changes after this, block is not sent again for them
+		client->SentBlockDelta(blockpos, delta.changed);
+		if (known && unknown.empty())
+			continue;
+
+		if (client->net_proto_version_fm >= 3) {
+			if (!known) {
+				send_to.push_back(*i);
+				continue;
+			}
+			MSGPACK_PACKET_INIT(TOCLIENT_NODES_DELTA, 2);
+			PACK(TOCLIENT_NODES_DELTA_POS, blockpos);
+			PACK(TOCLIENT_NODES_DELTA_NODES, unknown);
+			m_clients.send(*i, 0, std::move(buffer), true);
+			continue;
+		}
+
+		// Old client: one packet per node
+		for (const auto & node : known ? unknown : nodes) {
+			v3POS p = blockpos * MAP_BLOCKSIZE + v3POS(
+					node.index % MAP_BLOCKSIZE,
+					node.index / MAP_BLOCKSIZE % MAP_BLOCKSIZE,
+					node.index / (MAP_BLOCKSIZE * MAP_BLOCKSIZE));
+			if (node.action == NODE_DELTA_REMOVE) {
+				MSGPACK_PACKET_INIT(TOCLIENT_REMOVENODE, 1);
+				PACK(TOCLIENT_REMOVENODE_POS, p);
+				m_clients.send(*i, 0, std::move(buffer), true);
+			} else {
+				MSGPACK_PACKET_INIT(TOCLIENT_ADDNODE, 3);
+				PACK(TOCLIENT_ADDNODE_POS, p);
+				PACK(TOCLIENT_ADDNODE_NODE, MapNode(node.param0, node.param1, node.param2));
+				PACK(TOCLIENT_ADDNODE_REMOVE_METADATA, node.action == NODE_DELTA_ADD);
+				m_clients.send(*i, 0, std::move(buffer), true);
+			}
 		}
 	}
+
+	// Send as reliable, one packet for all new clients
+	if (!send_to.empty())
+		m_clients.send(send_to, 0, std::move(buffer), true);
 }
 
 void Server::SendBlockNoLock(u16 peer_id, MapBlock *block, u8 ver, u16 net_proto_version)
@@ -690,13 +805,11 @@ void Server::SendBlockNoLock(u16 peer_id, MapBlock *block, u8 ver, u16 net_proto
 	MSGPACK_PACKET_INIT(TOCLIENT_BLOCKDATA, 8);
 	PACK(TOCLIENT_BLOCKDATA_POS, block->getPos());
 
-	std::ostringstream os(std::ios_base::binary);
-
 	auto client = m_clients.getClient(peer_id);
 	if (!client)
 		return;
-	block->serialize(os, ver, false, client->net_proto_version_fm >= 1);
-	PACK(TOCLIENT_BLOCKDATA_DATA, os.str());
+	auto data = block->serializeNetworkCached(ver, client->net_proto_version_fm >= 1);
+	PACK(TOCLIENT_BLOCKDATA_DATA, *data);
 
 	PACK(TOCLIENT_BLOCKDATA_HEAT, (s16)(block->heat + block->heat_add));
 	PACK(TOCLIENT_BLOCKDATA_HUMIDITY, (s16)(block->humidity + block->humidity_add));
@@ -709,7 +822,7 @@ void Server::SendBlockNoLock(u16 peer_id, MapBlock *block, u8 ver, u16 net_proto
 	/*
 		Send packet
 	*/
-	m_clients.send(peer_id, 2, buffer, reliable);
+	m_clients.send(peer_id, 2, std::move(buffer), reliable);
 }
 
 void Server::sendMediaAnnouncement(u16 peer_id)
@@ -727,7 +840,7 @@ void Server::sendMediaAnnouncement(u16 peer_id)
 	PACK(TOCLIENT_ANNOUNCE_MEDIA_REMOTE_SERVER, g_settings->get("remote_media"));
 
 	// Send as reliable
-	m_clients.send(peer_id, 0, buffer, true);
+	m_clients.send(peer_id, 0, std::move(buffer), true);
 }
 
 void Server::sendRequestedMedia(u16 peer_id,
@@ -773,7 +886,7 @@ void Server::sendRequestedMedia(u16 peer_id,
 		if (size > 0xffff) {
 			MSGPACK_PACKET_INIT(TOCLIENT_MEDIA, 1);
 			PACK(TOCLIENT_MEDIA_MEDIA, media_data);
-			m_clients.send(peer_id, 2, buffer, true);
+			m_clients.send(peer_id, 2, std::move(buffer), true);
 			media_data.clear();
 			size = 0;
 		}
@@ -782,7 +895,7 @@ void Server::sendRequestedMedia(u16 peer_id,
 	if (!media_data.empty()) {
 		MSGPACK_PACKET_INIT(TOCLIENT_MEDIA, 1);
 		PACK(TOCLIENT_MEDIA_MEDIA, media_data);
-		m_clients.send(peer_id, 2, buffer, true);
+		m_clients.send(peer_id, 2, std::move(buffer), true);
 	}
 }
 
@@ -804,10 +917,10 @@ void Server::sendDetachedInventory(const std::string &name, u16 peer_id)
 	if (peer_id != PEER_ID_INEXISTENT)
 	{
 		// Send as reliable
-		m_clients.send(peer_id, 0, buffer, true);
+		m_clients.send(peer_id, 0, std::move(buffer), true);
 	}
 	else
 	{
-		m_clients.sendToAll(0,buffer,true);
+		m_clients.sendToAll(0,std::move(buffer),true);
 	}
 }
@@ -163,7 +163,8 @@ along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
 #define CLIENT_PROTOCOL_VERSION_MIN_LEGACY 13
 #define CLIENT_PROTOCOL_VERSION_MAX LATEST_PROTOCOL_VERSION
 
-#define CLIENT_PROTOCOL_VERSION_FM 2
+// 3: TOCLIENT_NODES_DELTA
+#define CLIENT_PROTOCOL_VERSION_FM 3
 #define SERVER_PROTOCOL_VERSION_FM 0
 
 // Constant that differentiates the protocol from random data and other protocols
@@ -278,6 +279,33 @@ enum {
 	TOCLIENT_REMOVENODE_POS
 };
 
+#define TOCLIENT_NODES_DELTA 0x23
+enum {
+	// v3s16 block position
+	TOCLIENT_NODES_DELTA_POS,
+	// list of NodeDelta, applied in order
+	TOCLIENT_NODES_DELTA_NODES
+};
+
+enum NodeDeltaAction {
+	NODE_DELTA_ADD,     // set node, remove metadata
+	NODE_DELTA_SWAP,    // set node, keep metadata
+	NODE_DELTA_REMOVE   // remove node
+};
+
+struct NodeDelta {
+	NodeDelta(u16 index_, u16 param0_, u8 param1_, u8 param2_, u8 action_) :
+		index(index_), param0(param0_), param1(param1_), param2(param2_), action(action_) {}
+	NodeDelta() : index(0), param0(0), param1(0), param2(0), action(NODE_DELTA_ADD) {}
+	// z*MAP_BLOCKSIZE*MAP_BLOCKSIZE + y*MAP_BLOCKSIZE + x inside block
+	u16 index;
+	u16 param0;
+	u8 param1;
+	u8 param2;
+	u8 action;
+	MSGPACK_DEFINE(index, param0, param1, param2, action);
+};
+
 #define TOCLIENT_INVENTORY 0x27
 enum {
 	// string, serialized inventory
@@ -1033,6 +1033,19 @@ void ContentFeatures::updateTextures(ITextureSource *tsrc, IShaderSource *shdsrc
 #endif
 */
 
+const char *content_group_names[CONTENT_GROUP_MAX] = {
+	"hot",
+	"cold",
+	"melt",
+	"freeze",
+	"falling_node",
+	"float",
+	"attached_node",
+	"weight",
+	"drop_by_liquid",
+	"pressure",
+};
+
 /*
 	CNodeDefManager
 */
@@ -1075,6 +1088,8 @@ class CNodeDefManager: public IWritableNodeDefManager {
 
 private:
 	void addNameIdMapping(content_t i, std::string name);
+	void updateGroupRatings(content_t i);
+	void updateContentFlags(content_t i);
 
 	// Features indexed by id
 	std::vector<ContentFeatures> m_content_features;
@@ -1127,6 +1142,11 @@ CNodeDefManager::~CNodeDefManager()
 void CNodeDefManager::clear()
 {
 	m_content_features.clear();
+	for (auto & ratings : m_group_ratings)
+		ratings.clear();
+	m_content_flags.clear();
+	m_light_source.clear();
+	m_liquid_type.clear();
 	m_name_id_mapping.clear();
 	m_name_id_mapping_with_aliases.clear();
 	m_group_to_items.clear();
@@ -1197,6 +1217,9 @@ void CNodeDefManager::clear()
 		if (c)
 			m_content_features[0] = f;
 	}
+
+	for (content_t c = 0; c < m_content_features.size(); ++c)
+		updateContentFlags(c);
 }
 
 
@@ -1352,6 +1375,8 @@ content_t CNodeDefManager::set(const std::string &name, const ContentFeatures &d
 		addNameIdMapping(id, name);
 	}
 	m_content_features[id] = def;
+	updateGroupRatings(id);
+	updateContentFlags(id);
 	verbosestream << "NodeDefManager: registering content id \"" << id
 		<< "\": name=\"" << def.name << "\""<<std::endl;
 
@@ -1558,6 +1583,8 @@ void CNodeDefManager::deSerialize(std::istream &is)
 			m_content_features.resize((u32)(i) + 1);
 		m_content_features[i] = f;
 		addNameIdMapping(i, f.name);
+		updateGroupRatings(i);
+		updateContentFlags(i);
 		verbosestream << "deserialized " << f.name << std::endl;
 	}
 }
@@ -1613,6 +1640,8 @@ void CNodeDefManager::msgpack_unpack(msgpack::object o)
 			m_content_features.resize((u32)(i) + 1);
 		m_content_features[i] = f;
 		addNameIdMapping(i, f.name);
+		updateGroupRatings(i);
+		updateContentFlags(i);
 		verbosestream<<"deserialized "<<f.name<<std::endl;
 	}
 }
@@ -1625,6 +1654,42 @@ void CNodeDefManager::addNameIdMapping(content_t i, std::string name)
 }
 
 
+void CNodeDefManager::updateGroupRatings(content_t i)
+{
+	const ItemGroupList &groups = m_content_features[i].groups;
+	for (int group = 0; group < CONTENT_GROUP_MAX; ++group) {
+		std::vector<int> &ratings = m_group_ratings[group];
+		if (i >= ratings.size())
+			ratings.resize((u32)(i) + 1, 0);
+		ratings[i] = itemgroup_get(groups, content_group_names[group]);
+	}
+}
+
+
+void CNodeDefManager::updateContentFlags(content_t i)
+{
+	if (i >= m_content_flags.size()) {
+		m_content_flags.resize((u32)(i) + 1, 0);
+		m_light_source.resize((u32)(i) + 1, 0);
+		m_liquid_type.resize((u32)(i) + 1, LIQUID_NONE);
+	}
+
+	const ContentFeatures &f = m_content_features[i];
+	u8 flags = 0;
+	if (f.walkable)
+		flags |= CONTENT_FLAG_WALKABLE;
+	if (f.light_propagates)
+		flags |= CONTENT_FLAG_LIGHT_PROPAGATES;
+	if (f.sunlight_propagates)
+		flags |= CONTENT_FLAG_SUNLIGHT_PROPAGATES;
+	if (f.param_type == CPT_LIGHT)
+		flags |= CONTENT_FLAG_LIGHT_PARAM;
+	m_content_flags[i] = flags;
+	m_light_source[i] = f.light_source;
+	m_liquid_type[i] = f.liquid_type;
+}
+
+
 IWritableNodeDefManager *createNodeDefManager()
 {
 	return new CNodeDefManager();
@@ -40,6 +40,7 @@ along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
 #include "constants.h" // BS
 #include "fm_bitset.h"
 #include <unordered_set>
+#include <array>
 
 
 #include "msgpack_fix.h"
@@ -465,10 +466,86 @@ struct ContentFeatures
 //#endif
 };
 
+/*
+	Frequently used groups, ratings are stored in dense per content arrays
+	(see INodeDefManager::getGroup) to not copy and search ItemGroupList
+	in hot loops
+*/
+enum ContentGroup
+{
+	CONTENT_GROUP_HOT,
+	CONTENT_GROUP_COLD,
+	CONTENT_GROUP_MELT,
+	CONTENT_GROUP_FREEZE,
+	CONTENT_GROUP_FALLING_NODE,
+	CONTENT_GROUP_FLOAT,
+	CONTENT_GROUP_ATTACHED_NODE,
+	CONTENT_GROUP_WEIGHT,
+	CONTENT_GROUP_DROP_BY_LIQUID,
+	CONTENT_GROUP_PRESSURE,
+	CONTENT_GROUP_MAX
+};
+
+extern const char *content_group_names[CONTENT_GROUP_MAX];
+
+/*
+	Frequently read ContentFeatures fields are also stored in dense per
+	content arrays (structure of arrays, see INodeDefManager::getContentFlags)
+	so hot loops of collision, lighting, liquids and meshing read one byte
+	instead of a big ContentFeatures
+*/
+enum ContentFlag
+{
+	CONTENT_FLAG_WALKABLE            = 1 << 0,
+	CONTENT_FLAG_LIGHT_PROPAGATES    = 1 << 1,
+	CONTENT_FLAG_SUNLIGHT_PROPAGATES = 1 << 2,
+	// param_type == CPT_LIGHT
+	CONTENT_FLAG_LIGHT_PARAM         = 1 << 3,
+};
+
 class INodeDefManager {
 public:
 	INodeDefManager(){}
 	virtual ~INodeDefManager(){}
+	// Same as itemgroup_get(get(c).groups, content_group_names[group])
+	inline int getGroup(content_t c, ContentGroup group) const
+	{
+		const auto &ratings = m_group_ratings[group];
+		return c < ratings.size() ? ratings[c] : 0;
+	}
+	inline int getGroup(const MapNode &n, ContentGroup group) const
+	{
+		return getGroup(n.getContent(), group);
+	}
+	// Same as fields of get(c), ids out of range are CONTENT_UNKNOWN
+	inline u8 getContentFlags(content_t c) const
+	{
+		return getDense(m_content_flags, c);
+	}
+	inline bool isWalkable(content_t c) const
+	{
+		return getContentFlags(c) & CONTENT_FLAG_WALKABLE;
+	}
+	inline bool lightPropagates(content_t c) const
+	{
+		return getContentFlags(c) & CONTENT_FLAG_LIGHT_PROPAGATES;
+	}
+	inline bool sunlightPropagates(content_t c) const
+	{
+		return getContentFlags(c) & CONTENT_FLAG_SUNLIGHT_PROPAGATES;
+	}
+	inline bool hasLightParam(content_t c) const
+	{
+		return getContentFlags(c) & CONTENT_FLAG_LIGHT_PARAM;
+	}
+	inline u8 getLightSource(content_t c) const
+	{
+		return getDense(m_light_source, c);
+	}
+	inline LiquidType getLiquidType(content_t c) const
+	{
+		return (LiquidType)getDense(m_liquid_type, c);
+	}
 	// Get node definition
 	virtual const ContentFeatures &get(content_t c) const=0;
 	virtual const ContentFeatures &get(const MapNode &n) const=0;
@@ -491,6 +568,21 @@ class INodeDefManager {
 	virtual void pendNodeResolve(NodeResolver *nr)=0;
 	virtual bool cancelNodeResolveCallback(NodeResolver *nr)=0;
 	virtual bool nodeboxConnects(const MapNode from, const MapNode to, u8 connect_face)=0;
+
+protected:
+	// Indexed by ContentGroup, then by content id
+	std::array<std::vector<int>, CONTENT_GROUP_MAX> m_group_ratings;
+
+	// Indexed by content id
+	std::vector<u8> m_content_flags;
+	std::vector<u8> m_light_source;
+	std::vector<u8> m_liquid_type;
+
+private:
+	static inline u8 getDense(const std::vector<u8> &values, content_t c)
+	{
+		return c < values.size() ? values[c] : values[CONTENT_UNKNOWN];
+	}
 };
 
 class IWritableNodeDefManager : public INodeDefManager {
@@ -31,11 +31,7 @@ along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
 #include "util/string.h"
 #include "exceptions.h"
 #include "log_types.h"
-
-#define NOISE_MAGIC_X    1619
-#define NOISE_MAGIC_Y    31337
-#define NOISE_MAGIC_Z    52591
-#define NOISE_MAGIC_SEED 1013
+#include "noise_simd.h"
 
 typedef float (*Interp2dFxn)(
 		float v00, float v10, float v01, float v11,
@@ -446,6 +442,7 @@ Noise::Noise(NoiseParams *np_, int seed, u32 sx, u32 sy, u32 sz)
 	this->persist_buf  = NULL;
 	this->gradient_buf = NULL;
 	this->result       = NULL;
+	this->kernels      = NoiseKernels::getBest();
 
 	allocBuffers();
 }
@@ -569,6 +566,11 @@ void Noise::gradientMap2D(
 		float step_x, float step_y,
 		int seed)
 {
+	if (kernels) {
+		gradientMap2DRows(x, y, step_x, step_y, seed);
+		return;
+	}
+
 	float v00, v01, v10, v11, u, v, orig_u;
 	u32 index, i, j, noisex, noisey;
 	u32 nlx, nly;
@@ -633,6 +635,11 @@ void Noise::gradientMap3D(
 		float step_x, float step_y, float step_z,
 		int seed)
 {
+	if (kernels) {
+		gradientMap3DRows(x, y, z, step_x, step_y, step_z, seed);
+		return;
+	}
+
 	float v000, v010, v100, v110;
 	float v001, v011, v101, v111;
 	float u, v, w, orig_u, orig_v;
@@ -719,6 +726,132 @@ void Noise::gradientMap3D(
 #undef idx
 
 
+/*
+ * Same results as loops above, but by rows of kernels:
+ * interpolation along x is done once for every lattice row (it is the same
+ * for all map rows between two lattice rows), then map rows are interpolated
+ * between x-interpolated lattice rows. Order of float operations is kept.
+ */
+void Noise::interpolateColumns(float u, float step_x, bool eased)
+{
+	m_column_t.resize(sx);
+	m_column_index.resize(sx);
+
+	u32 noisex = 0;
+	for (u32 i = 0; i != sx; i++) {
+		m_column_index[i] = noisex;
+		m_column_t[i] = eased ? easeCurve(u) : u;
+
+		u += step_x;
+		if (u >= 1.0) {
+			u -= 1.0;
+			noisex++;
+		}
+	}
+}
+
+
+void Noise::gradientMap2DRows(
+		float x, float y,
+		float step_x, float step_y,
+		int seed)
+{
+	bool eased = np.flags & (NOISE_FLAG_DEFAULTS | NOISE_FLAG_EASED);
+
+	s32 x0 = floor(x);
+	s32 y0 = floor(y);
+	float u = x - (float)x0;
+	float v = y - (float)y0;
+
+	//calculate noise point lattice
+	u32 nlx = (u32)(u + sx * step_x) + 2;
+	u32 nly = (u32)(v + sy * step_y) + 2;
+	for (u32 j = 0; j != nly; j++)
+		kernels->noiseRow(&noise_buf[j * nlx], nlx,
+			noiseHashBase(x0, y0 + j, 0, seed));
+
+	interpolateColumns(u, step_x, eased);
+	m_xlerp_buf.resize(sx * nly);
+	for (u32 j = 0; j != nly; j++)
+		kernels->lerpIndexed(&m_xlerp_buf[j * sx], &noise_buf[j * nlx],
+			m_column_index.data(), m_column_t.data(), sx);
+
+	//calculate interpolations
+	u32 noisey = 0;
+	for (u32 j = 0; j != sy; j++) {
+		kernels->lerpRow(&gradient_buf[j * sx],
+			&m_xlerp_buf[noisey * sx], &m_xlerp_buf[(noisey + 1) * sx],
+			eased ? easeCurve(v) : v, sx);
+
+		v += step_y;
+		if (v >= 1.0) {
+			v -= 1.0;
+			noisey++;
+		}
+	}
+}
+
+
+void Noise::gradientMap3DRows(
+		float x, float y, float z,
+		float step_x, float step_y, float step_z,
+		int seed)
+{
+	bool eased = np.flags & NOISE_FLAG_EASED;
+
+	s32 x0 = floor(x);
+	s32 y0 = floor(y);
+	s32 z0 = floor(z);
+	float u = x - (float)x0;
+	float v = y - (float)y0;
+	float w = z - (float)z0;
+	float orig_v = v;
+
+	//calculate noise point lattice
+	u32 nlx = (u32)(u + sx * step_x) + 2;
+	u32 nly = (u32)(v + sy * step_y) + 2;
+	u32 nlz = (u32)(w + sz * step_z) + 2;
+	for (u32 k = 0; k != nlz; k++)
+		for (u32 j = 0; j != nly; j++)
+			kernels->noiseRow(&noise_buf[(k * nly + j) * nlx], nlx,
+				noiseHashBase(x0, y0 + j, z0 + k, seed));
+
+	interpolateColumns(u, step_x, eased);
+	m_xlerp_buf.resize(sx * nly * nlz);
+	for (u32 l = 0; l != nly * nlz; l++)
+		kernels->lerpIndexed(&m_xlerp_buf[l * sx], &noise_buf[l * nlx],
+			m_column_index.data(), m_column_t.data(), sx);
+
+	//calculate interpolations
+	u32 index  = 0;
+	u32 noisez = 0;
+	for (u32 k = 0; k != sz; k++) {
+		float tz = eased ? easeCurve(w) : w;
+		v = orig_v;
+		u32 noisey = 0;
+		for (u32 j = 0; j != sy; j++) {
+			const float *row = &m_xlerp_buf[(noisez * nly + noisey) * sx];
+			kernels->lerpRow2(&gradient_buf[index],
+				row, row + sx, row + nly * sx, row + nly * sx + sx,
+				eased ? easeCurve(v) : v, tz, sx);
+			index += sx;
+
+			v += step_y;
+			if (v >= 1.0) {
+				v -= 1.0;
+				noisey++;
+			}
+		}
+
+		w += step_z;
+		if (w >= 1.0) {
+			w -= 1.0;
+			noisez++;
+		}
+	}
+}
+
+
 float *Noise::perlinMap2D(float x, float y, float *persistence_map)
 {
 	auto far_scale = farscale(np.far_scale, x, y);
@@ -807,6 +940,16 @@ float *Noise::perlinMap3D(float x, float y, float z, float *persistence_map)
 void Noise::updateResults(float g, float *gmap,
 	float *persistence_map, size_t bufsize)
 {
+	if (kernels) {
+		bool absvalue = np.flags & NOISE_FLAG_ABSVALUE;
+		if (persistence_map)
+			kernels->accumulatePersist(result, gmap, gradient_buf,
+				persistence_map, absvalue, bufsize);
+		else
+			kernels->accumulate(result, gradient_buf, g, absvalue, bufsize);
+		return;
+	}
+
 	// This looks very ugly, but it is 50-70% faster than having
 	// conditional statements inside the loop
 	if (np.flags & NOISE_FLAG_ABSVALUE) {
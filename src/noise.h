@@ -25,6 +25,7 @@ along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
 #define NOISE_HEADER
 
 #include <atomic>
+#include <vector>
 
 #include "irr_v3d.h"
 #include "exceptions.h"
@@ -32,6 +33,20 @@ along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
 
 extern FlagDesc flagdesc_noiseparams[];
 
+struct NoiseKernels;
+
+#define NOISE_MAGIC_X    1619
+#define NOISE_MAGIC_Y    31337
+#define NOISE_MAGIC_Z    52591
+#define NOISE_MAGIC_SEED 1013
+
+// Input of noise2d/noise3d hash, next x is base + NOISE_MAGIC_X
+inline u32 noiseHashBase(s32 x, s32 y, s32 z, s32 seed)
+{
+	return NOISE_MAGIC_X * (u32)x + NOISE_MAGIC_Y * (u32)y
+		+ NOISE_MAGIC_Z * (u32)z + NOISE_MAGIC_SEED * (u32)seed;
+}
+
 float farscale(float scale, float z);
 float farscale(float scale, float x, float z);
 float farscale(float scale, float x, float y, float z);
@@ -182,6 +197,9 @@ class Noise {
 	float *persist_buf;
 	float *result;
 
+	// Row kernels for maps, NULL for original per point loops
+	const NoiseKernels *kernels;
+
 	Noise(NoiseParams *np, int seed, u32 sx, u32 sy, u32 sz=1);
 	~Noise();
 
@@ -225,6 +243,21 @@ class Noise {
 	void resizeNoiseBuf(bool is3d);
 	void updateResults(float g, float *gmap, float *persistence_map, size_t bufsize);
 
+	void gradientMap2DRows(
+		float x, float y,
+		float step_x, float step_y,
+		int seed);
+	void gradientMap3DRows(
+		float x, float y, float z,
+		float step_x, float step_y, float step_z,
+		int seed);
+	void interpolateColumns(float u, float step_x, bool eased);
+
+	// Lattice rows interpolated along x, columns interpolation parameters
+	std::vector<float> m_xlerp_buf;
+	std::vector<float> m_column_t;
+	std::vector<u32> m_column_index;
+
 };
 
 float NoisePerlin2D(NoiseParams *np, float x, float y, int seed);
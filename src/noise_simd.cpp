@@ -0,0 +1,393 @@
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "noise_simd.h"
+#include <math.h>
+#include "noise.h"
+
+// Only on x86_64 scalar float math is done with SSE too
+#if defined(__x86_64__) || defined(_M_X64)
+	#define NOISE_SIMD_SSE2 1
+	#include <emmintrin.h>
+	#if defined(__GNUC__)
+		#define NOISE_SIMD_AVX2 1
+		#include <immintrin.h>
+	#endif
+#endif
+
+static inline float noiseHash(u32 n)
+{
+	n &= 0x7fffffff;
+	n = (n >> 13) ^ n;
+	n = (n * (n * n * 60493 + 19990303) + 1376312589) & 0x7fffffff;
+	return 1.f - (float)(int)n / 0x40000000;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Scalar, also the portable fallback
+
+static void noiseRowScalar(float *out, u32 count, u32 base)
+{
+	for (u32 i = 0; i != count; i++, base += NOISE_MAGIC_X)
+		out[i] = noiseHash(base);
+}
+
+static void lerpIndexedScalar(float *out, const float *row,
+	const u32 *index, const float *t, u32 count)
+{
+	for (u32 i = 0; i != count; i++) {
+		float v0 = row[index[i]];
+		float v1 = row[index[i] + 1];
+		out[i] = v0 + (v1 - v0) * t[i];
+	}
+}
+
+static void lerpRowScalar(float *out, const float *a, const float *b,
+	float t, u32 count)
+{
+	for (u32 i = 0; i != count; i++)
+		out[i] = a[i] + (b[i] - a[i]) * t;
+}
+
+static void lerpRow2Scalar(float *out, const float *a, const float *b,
+	const float *c, const float *d, float ty, float tz, u32 count)
+{
+	for (u32 i = 0; i != count; i++) {
+		float u = a[i] + (b[i] - a[i]) * ty;
+		float v = c[i] + (d[i] - c[i]) * ty;
+		out[i] = u + (v - u) * tz;
+	}
+}
+
+static void accumulateScalar(float *result, const float *gradient,
+	float g, bool absvalue, u32 count)
+{
+	if (absvalue) {
+		for (u32 i = 0; i != count; i++)
+			result[i] += g * fabs(gradient[i]);
+	} else {
+		for (u32 i = 0; i != count; i++)
+			result[i] += g * gradient[i];
+	}
+}
+
+static void accumulatePersistScalar(float *result, float *gmap,
+	const float *gradient, const float *persistence,
+	bool absvalue, u32 count)
+{
+	if (absvalue) {
+		for (u32 i = 0; i != count; i++) {
+			result[i] += gmap[i] * fabs(gradient[i]);
+			gmap[i] *= persistence[i];
+		}
+	} else {
+		for (u32 i = 0; i != count; i++) {
+			result[i] += gmap[i] * gradient[i];
+			gmap[i] *= persistence[i];
+		}
+	}
+}
+
+static const NoiseKernels noise_kernels_scalar = {
+	"scalar",
+	noiseRowScalar,
+	lerpIndexedScalar,
+	lerpRowScalar,
+	lerpRow2Scalar,
+	accumulateScalar,
+	accumulatePersistScalar,
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// SSE2, 4 floats
+
+#if NOISE_SIMD_SSE2
+
+// SSE2 has no 32 bit low multiply (pmulld is SSE4.1)
+static inline __m128i mulloSSE2(__m128i a, __m128i b)
+{
+	__m128i even = _mm_mul_epu32(a, b);
+	__m128i odd  = _mm_mul_epu32(_mm_srli_si128(a, 4), _mm_srli_si128(b, 4));
+	return _mm_unpacklo_epi32(
+		_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+		_mm_shuffle_epi32(odd,  _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+static inline __m128 noiseHashSSE2(__m128i n)
+{
+	const __m128i mask = _mm_set1_epi32(0x7fffffff);
+	n = _mm_and_si128(n, mask);
+	n = _mm_xor_si128(_mm_srli_epi32(n, 13), n);
+	__m128i m = mulloSSE2(mulloSSE2(n, n), _mm_set1_epi32(60493));
+	m = _mm_add_epi32(m, _mm_set1_epi32(19990303));
+	m = _mm_add_epi32(mulloSSE2(n, m), _mm_set1_epi32(1376312589));
+	m = _mm_and_si128(m, mask);
+	__m128 f = _mm_div_ps(_mm_cvtepi32_ps(m), _mm_set1_ps((float)0x40000000));
+	return _mm_sub_ps(_mm_set1_ps(1.f), f);
+}
+
+static inline __m128 lerpSSE2(__m128 a, __m128 b, __m128 t)
+{
+	return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), t));
+}
+
+static void noiseRowSSE2(float *out, u32 count, u32 base)
+{
+	u32 i = 0;
+	__m128i n = _mm_add_epi32(_mm_set1_epi32((int)base),
+		_mm_setr_epi32(0, NOISE_MAGIC_X, NOISE_MAGIC_X * 2, NOISE_MAGIC_X * 3));
+	const __m128i step = _mm_set1_epi32(NOISE_MAGIC_X * 4);
+	for (; i + 4 <= count; i += 4) {
+		_mm_storeu_ps(out + i, noiseHashSSE2(n));
+		n = _mm_add_epi32(n, step);
+	}
+	noiseRowScalar(out + i, count - i, base + i * NOISE_MAGIC_X);
+}
+
+static void lerpIndexedSSE2(float *out, const float *row,
+	const u32 *index, const float *t, u32 count)
+{
+	u32 i = 0;
+	for (; i + 4 <= count; i += 4) {
+		const u32 *n = index + i;
+		__m128 v0 = _mm_setr_ps(row[n[0]], row[n[1]], row[n[2]], row[n[3]]);
+		__m128 v1 = _mm_setr_ps(row[n[0] + 1], row[n[1] + 1],
+			row[n[2] + 1], row[n[3] + 1]);
+		_mm_storeu_ps(out + i, lerpSSE2(v0, v1, _mm_loadu_ps(t + i)));
+	}
+	lerpIndexedScalar(out + i, row, index + i, t + i, count - i);
+}
+
+static void lerpRowSSE2(float *out, const float *a, const float *b,
+	float t, u32 count)
+{
+	u32 i = 0;
+	const __m128 vt = _mm_set1_ps(t);
+	for (; i + 4 <= count; i += 4)
+		_mm_storeu_ps(out + i,
+			lerpSSE2(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i), vt));
+	lerpRowScalar(out + i, a + i, b + i, t, count - i);
+}
+
+static void lerpRow2SSE2(float *out, const float *a, const float *b,
+	const float *c, const float *d, float ty, float tz, u32 count)
+{
+	u32 i = 0;
+	const __m128 vty = _mm_set1_ps(ty);
+	const __m128 vtz = _mm_set1_ps(tz);
+	for (; i + 4 <= count; i += 4) {
+		__m128 u = lerpSSE2(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i), vty);
+		__m128 v = lerpSSE2(_mm_loadu_ps(c + i), _mm_loadu_ps(d + i), vty);
+		_mm_storeu_ps(out + i, lerpSSE2(u, v, vtz));
+	}
+	lerpRow2Scalar(out + i, a + i, b + i, c + i, d + i, ty, tz, count - i);
+}
+
+static inline __m128 absSSE2(__m128 v, bool absvalue)
+{
+	return absvalue ? _mm_and_ps(v, _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff))) : v;
+}
+
+static void accumulateSSE2(float *result, const float *gradient,
+	float g, bool absvalue, u32 count)
+{
+	u32 i = 0;
+	const __m128 vg = _mm_set1_ps(g);
+	for (; i + 4 <= count; i += 4) {
+		__m128 v = _mm_mul_ps(vg, absSSE2(_mm_loadu_ps(gradient + i), absvalue));
+		_mm_storeu_ps(result + i, _mm_add_ps(_mm_loadu_ps(result + i), v));
+	}
+	accumulateScalar(result + i, gradient + i, g, absvalue, count - i);
+}
+
+static void accumulatePersistSSE2(float *result, float *gmap,
+	const float *gradient, const float *persistence,
+	bool absvalue, u32 count)
+{
+	u32 i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m128 vg = _mm_loadu_ps(gmap + i);
+		__m128 v = _mm_mul_ps(vg, absSSE2(_mm_loadu_ps(gradient + i), absvalue));
+		_mm_storeu_ps(result + i, _mm_add_ps(_mm_loadu_ps(result + i), v));
+		_mm_storeu_ps(gmap + i, _mm_mul_ps(vg, _mm_loadu_ps(persistence + i)));
+	}
+	accumulatePersistScalar(result + i, gmap + i, gradient + i,
+		persistence + i, absvalue, count - i);
+}
+
+static const NoiseKernels noise_kernels_sse2 = {
+	"sse2",
+	noiseRowSSE2,
+	lerpIndexedSSE2,
+	lerpRowSSE2,
+	lerpRow2SSE2,
+	accumulateSSE2,
+	accumulatePersistSSE2,
+};
+
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+// AVX2, 8 floats. Only "avx2" target: "fma" would allow contraction of a * b + c
+
+#if NOISE_SIMD_AVX2
+
+#define AVX2_FUNCTION __attribute__((target("avx2")))
+
+AVX2_FUNCTION static inline __m256 noiseHashAVX2(__m256i n)
+{
+	const __m256i mask = _mm256_set1_epi32(0x7fffffff);
+	n = _mm256_and_si256(n, mask);
+	n = _mm256_xor_si256(_mm256_srli_epi32(n, 13), n);
+	__m256i m = _mm256_mullo_epi32(_mm256_mullo_epi32(n, n), _mm256_set1_epi32(60493));
+	m = _mm256_add_epi32(m, _mm256_set1_epi32(19990303));
+	m = _mm256_add_epi32(_mm256_mullo_epi32(n, m), _mm256_set1_epi32(1376312589));
+	m = _mm256_and_si256(m, mask);
+	__m256 f = _mm256_div_ps(_mm256_cvtepi32_ps(m), _mm256_set1_ps((float)0x40000000));
+	return _mm256_sub_ps(_mm256_set1_ps(1.f), f);
+}
+
+AVX2_FUNCTION static inline __m256 lerpAVX2(__m256 a, __m256 b, __m256 t)
+{
+	return _mm256_add_ps(a, _mm256_mul_ps(_mm256_sub_ps(b, a), t));
+}
+
+AVX2_FUNCTION static void noiseRowAVX2(float *out, u32 count, u32 base)
+{
+	u32 i = 0;
+	__m256i n = _mm256_add_epi32(_mm256_set1_epi32((int)base),
+		_mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+			_mm256_set1_epi32(NOISE_MAGIC_X)));
+	const __m256i step = _mm256_set1_epi32(NOISE_MAGIC_X * 8);
+	for (; i + 8 <= count; i += 8) {
+		_mm256_storeu_ps(out + i, noiseHashAVX2(n));
+		n = _mm256_add_epi32(n, step);
+	}
+	noiseRowScalar(out + i, count - i, base + i * NOISE_MAGIC_X);
+}
+
+AVX2_FUNCTION static void lerpIndexedAVX2(float *out, const float *row,
+	const u32 *index, const float *t, u32 count)
+{
+	u32 i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256i n = _mm256_loadu_si256((const __m256i *)(index + i));
+		__m256 v0 = _mm256_i32gather_ps(row, n, 4);
+		__m256 v1 = _mm256_i32gather_ps(row + 1, n, 4);
+		_mm256_storeu_ps(out + i, lerpAVX2(v0, v1, _mm256_loadu_ps(t + i)));
+	}
+	lerpIndexedScalar(out + i, row, index + i, t + i, count - i);
+}
+
+AVX2_FUNCTION static void lerpRowAVX2(float *out, const float *a, const float *b,
+	float t, u32 count)
+{
+	u32 i = 0;
+	const __m256 vt = _mm256_set1_ps(t);
+	for (; i + 8 <= count; i += 8)
+		_mm256_storeu_ps(out + i,
+			lerpAVX2(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), vt));
+	lerpRowScalar(out + i, a + i, b + i, t, count - i);
+}
+
+AVX2_FUNCTION static void lerpRow2AVX2(float *out, const float *a, const float *b,
+	const float *c, const float *d, float ty, float tz, u32 count)
+{
+	u32 i = 0;
+	const __m256 vty = _mm256_set1_ps(ty);
+	const __m256 vtz = _mm256_set1_ps(tz);
+	for (; i + 8 <= count; i += 8) {
+		__m256 u = lerpAVX2(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), vty);
+		__m256 v = lerpAVX2(_mm256_loadu_ps(c + i), _mm256_loadu_ps(d + i), vty);
+		_mm256_storeu_ps(out + i, lerpAVX2(u, v, vtz));
+	}
+	lerpRow2Scalar(out + i, a + i, b + i, c + i, d + i, ty, tz, count - i);
+}
+
+AVX2_FUNCTION static inline __m256 absAVX2(__m256 v, bool absvalue)
+{
+	return absvalue ?
+		_mm256_and_ps(v, _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff))) : v;
+}
+
+AVX2_FUNCTION static void accumulateAVX2(float *result, const float *gradient,
+	float g, bool absvalue, u32 count)
+{
+	u32 i = 0;
+	const __m256 vg = _mm256_set1_ps(g);
+	for (; i + 8 <= count; i += 8) {
+		__m256 v = _mm256_mul_ps(vg, absAVX2(_mm256_loadu_ps(gradient + i), absvalue));
+		_mm256_storeu_ps(result + i, _mm256_add_ps(_mm256_loadu_ps(result + i), v));
+	}
+	accumulateScalar(result + i, gradient + i, g, absvalue, count - i);
+}
+
+AVX2_FUNCTION static void accumulatePersistAVX2(float *result, float *gmap,
+	const float *gradient, const float *persistence,
+	bool absvalue, u32 count)
+{
+	u32 i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256 vg = _mm256_loadu_ps(gmap + i);
+		__m256 v = _mm256_mul_ps(vg, absAVX2(_mm256_loadu_ps(gradient + i), absvalue));
+		_mm256_storeu_ps(result + i, _mm256_add_ps(_mm256_loadu_ps(result + i), v));
+		_mm256_storeu_ps(gmap + i, _mm256_mul_ps(vg, _mm256_loadu_ps(persistence + i)));
+	}
+	accumulatePersistScalar(result + i, gmap + i, gradient + i,
+		persistence + i, absvalue, count - i);
+}
+
+#undef AVX2_FUNCTION
+
+static const NoiseKernels noise_kernels_avx2 = {
+	"avx2",
+	noiseRowAVX2,
+	lerpIndexedAVX2,
+	lerpRowAVX2,
+	lerpRow2AVX2,
+	accumulateAVX2,
+	accumulatePersistAVX2,
+};
+
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+
+const NoiseKernels *NoiseKernels::getScalar()
+{
+	return &noise_kernels_scalar;
+}
+
+std::vector<const NoiseKernels *> NoiseKernels::getSupported()
+{
+	std::vector<const NoiseKernels *> sets;
+	sets.push_back(&noise_kernels_scalar);
+#if NOISE_SIMD_SSE2
+	sets.push_back(&noise_kernels_sse2);
+#endif
+#if NOISE_SIMD_AVX2
+	if (__builtin_cpu_supports("avx2"))
+		sets.push_back(&noise_kernels_avx2);
+#endif
+	return sets;
+}
+
+const NoiseKernels *NoiseKernels::getBest()
+{
+	static const NoiseKernels *best = getSupported().back();
+	return best;
+}
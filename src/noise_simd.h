@@ -0,0 +1,65 @@
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef NOISE_SIMD_HEADER
+#define NOISE_SIMD_HEADER
+
+#include <vector>
+#include "irrlichttypes.h"
+
+/*
+	Row kernels of Noise maps.
+	Every set does the same float operations in the same order as the scalar
+	noise code (no FMA, no reciprocals), so maps are bit-identical with any
+	set and worlds have no seams between servers with different cpus.
+*/
+struct NoiseKernels {
+	const char *name;
+
+	// out[i] = noise2d/noise3d hash of lattice point x0 + i,
+	// base is hash input of x0 (see noiseHashBase())
+	void (*noiseRow)(float *out, u32 count, u32 base);
+
+	// out[i] = row[index[i]] + (row[index[i] + 1] - row[index[i]]) * t[i]
+	void (*lerpIndexed)(float *out, const float *row,
+		const u32 *index, const float *t, u32 count);
+
+	// out[i] = a[i] + (b[i] - a[i]) * t
+	void (*lerpRow)(float *out, const float *a, const float *b,
+		float t, u32 count);
+
+	// out[i] = lerp(lerp(a[i], b[i], ty), lerp(c[i], d[i], ty), tz)
+	void (*lerpRow2)(float *out, const float *a, const float *b,
+		const float *c, const float *d, float ty, float tz, u32 count);
+
+	// result[i] += g * gradient[i] (or its absolute value)
+	void (*accumulate)(float *result, const float *gradient,
+		float g, bool absvalue, u32 count);
+
+	// result[i] += gmap[i] * gradient[i]; gmap[i] *= persistence[i]
+	void (*accumulatePersist)(float *result, float *gmap,
+		const float *gradient, const float *persistence,
+		bool absvalue, u32 count);
+
+	static const NoiseKernels *getScalar();
+	// Fastest set supported by this cpu, selected once at runtime
+	static const NoiseKernels *getBest();
+	// All sets supported by this cpu, scalar first
+	static std::vector<const NoiseKernels *> getSupported();
+};
+
+#endif
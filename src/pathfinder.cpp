@@ -29,6 +29,14 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "map.h"
 #include "log.h"
 #include "irr_aabb3d.h"
+#include "porting.h"
+#include "profiler.h"
+#include "settings.h"
+#include "util/unordered_map_hash.h"
+#include <algorithm>
+#include <cstring>
+#include <queue>
+#include <unordered_set>
 
 //#define PATHFINDER_DEBUG
 //#define PATHFINDER_CALC_TIME
@@ -393,6 +401,14 @@ std::vector<v3s16> get_path(ServerEnvironment* env,
 							unsigned int max_drop,
 							PathAlgorithm algo)
 {
+	if (algo == PA_HIERARCHICAL) {
+		PathSearch search(source, destination,
+				searchdistance, max_jump, max_drop);
+		search.run(env, g_settings->getU32("pathfinder_max_iterations"),
+				g_settings->getU32("pathfinder_max_time"));
+		return search.getPath();
+	}
+
 	Pathfinder searchclass;
 
 	return searchclass.getPath(env,
@@ -1415,3 +1431,629 @@ void Pathfinder::printPath(std::vector<v3s16> path)
 }
 
 #endif
+
+/******************************************************************************/
+/* Hierarchical search                                                        */
+/******************************************************************************/
+
+static const v3s16 path_directions[4] = {
+	v3s16( 1, 0, 0),
+	v3s16(-1, 0, 0),
+	v3s16( 0, 0, 1),
+	v3s16( 0, 0,-1)
+};
+
+static inline u8 pathNodeFlags(INodeDefManager *ndef, MapNode n)
+{
+	content_t c = n.getContent();
+	if (c == CONTENT_IGNORE)
+		return PathBlockGraph::NODE_IGNORE;
+	return ndef->isWalkable(c) ? PathBlockGraph::NODE_WALKABLE : 0;
+}
+
+static inline u32 manhattanDist(v3s16 a, v3s16 b)
+{
+	return abs(a.X - b.X) + abs(a.Y - b.Y) + abs(a.Z - b.Z);
+}
+
+/**
+ * move rules of Pathfinder::calcCost(): step to side, jump up or drop down
+ * @param target standable position after move
+ * @return cost of move, 0 if move is impossible
+ */
+template <typename Reader>
+static u8 pathMove(const Reader &read, v3s16 pos, v3s16 dir,
+		int max_jump, int max_drop, v3s16 &target)
+{
+	v3s16 pos2 = pos + dir;
+	u8 flags = read(pos2);
+	if (flags & PathBlockGraph::NODE_IGNORE)
+		return 0;
+
+	if (!(flags & PathBlockGraph::NODE_WALKABLE)) {
+		for (v3s16 testpos = pos2 + v3s16(0, -1, 0);
+				pos2.Y - testpos.Y - 1 <= max_drop; testpos.Y--) {
+			flags = read(testpos);
+			if (flags & PathBlockGraph::NODE_IGNORE)
+				return 0;
+			if (flags & PathBlockGraph::NODE_WALKABLE) {
+				target = testpos + v3s16(0, 1, 0);
+				return target == pos2 ? 1 : 2;
+			}
+		}
+		return 0;
+	}
+
+	for (v3s16 testpos = pos2 + v3s16(0, 1, 0);
+			testpos.Y - pos2.Y <= max_jump; testpos.Y++) {
+		flags = read(testpos);
+		if (flags & PathBlockGraph::NODE_IGNORE)
+			return 0;
+		if (!(flags & PathBlockGraph::NODE_WALKABLE)) {
+			target = testpos;
+			return 2;
+		}
+	}
+	return 0;
+}
+
+/** node flags of box around block */
+class PathNodeWindow {
+public:
+	/** box of all nodes read by moves from nodes of block */
+	PathNodeWindow(v3s16 blockpos, int max_jump, int max_drop) :
+		m_minp(blockpos * MAP_BLOCKSIZE - v3s16(1, max_drop + 1, 1)),
+		m_maxp(blockpos * MAP_BLOCKSIZE +
+				v3s16(MAP_BLOCKSIZE, MAP_BLOCKSIZE - 1 + max_jump, MAP_BLOCKSIZE)),
+		m_ystride(m_maxp.X - m_minp.X + 1),
+		m_zstride(m_ystride * (m_maxp.Y - m_minp.Y + 1)),
+		m_flags(m_zstride * (m_maxp.Z - m_minp.Z + 1),
+				PathBlockGraph::NODE_IGNORE)
+	{}
+
+	inline bool contains(v3s16 p) const
+	{
+		return p.X >= m_minp.X && p.Y >= m_minp.Y && p.Z >= m_minp.Z &&
+				p.X <= m_maxp.X && p.Y <= m_maxp.Y && p.Z <= m_maxp.Z;
+	}
+
+	inline u8 &at(v3s16 p)
+	{
+		v3s16 rel = p - m_minp;
+		return m_flags[rel.Z * m_zstride + rel.Y * m_ystride + rel.X];
+	}
+
+	inline u8 operator()(v3s16 p) const
+	{
+		if (!contains(p))
+			return PathBlockGraph::NODE_IGNORE;
+		v3s16 rel = p - m_minp;
+		return m_flags[rel.Z * m_zstride + rel.Y * m_ystride + rel.X];
+	}
+
+	v3s16 m_minp;
+	v3s16 m_maxp;
+
+private:
+	int m_ystride;
+	int m_zstride;
+	std::vector<u8> m_flags;
+};
+
+/** live map data, used for moves inside of corridor */
+struct PathMapReader {
+	Map *map;
+	INodeDefManager *ndef;
+
+	inline u8 operator()(v3s16 p) const
+	{
+		return pathNodeFlags(ndef, map->getNodeNoEx(p));
+	}
+};
+
+static inline u16 pathFindRoot(std::vector<u16> &parent, u16 i)
+{
+	while (parent[i] != i) {
+		parent[i] = parent[parent[i]];
+		i = parent[i];
+	}
+	return i;
+}
+
+/******************************************************************************/
+void PathBlockGraph::build(v3s16 blockpos_, int max_jump, int max_drop,
+		const NodeReader &reader)
+{
+	const int volume = MAP_BLOCKSIZE * MAP_BLOCKSIZE * MAP_BLOCKSIZE;
+	blockpos = blockpos_;
+	max_jump = rangelim(max_jump, 0, PATH_GRAPH_MAX_STEP);
+	max_drop = rangelim(max_drop, 0, PATH_GRAPH_MAX_STEP);
+
+	PathNodeWindow window(blockpos, max_jump, max_drop);
+	v3s16 p;
+	for (p.Z = window.m_minp.Z; p.Z <= window.m_maxp.Z; p.Z++)
+	for (p.Y = window.m_minp.Y; p.Y <= window.m_maxp.Y; p.Y++)
+	for (p.X = window.m_minp.X; p.X <= window.m_maxp.X; p.X++)
+		window.at(p) = reader(p);
+
+	v3s16 minp = blockpos * MAP_BLOCKSIZE;
+	v3s16 maxp = minp + v3s16(1, 1, 1) * (MAP_BLOCKSIZE - 1);
+
+	std::vector<u16> parent(volume);
+	std::vector<bool> standable(volume);
+	for (int i = 0; i < volume; ++i) {
+		parent[i] = i;
+		v3s16 pos = minp + v3s16(i % MAP_BLOCKSIZE,
+				i / MAP_BLOCKSIZE % MAP_BLOCKSIZE,
+				i / (MAP_BLOCKSIZE * MAP_BLOCKSIZE));
+		standable[i] = window(pos) == 0 &&
+				window(pos + v3s16(0, -1, 0)) == NODE_WALKABLE;
+	}
+
+	// Moves possible in both directions join regions, others are portals
+	std::vector<std::pair<u16, Portal> > found;
+	for (int i = 0; i < volume; ++i) {
+		if (!standable[i])
+			continue;
+		v3s16 pos = minp + v3s16(i % MAP_BLOCKSIZE,
+				i / MAP_BLOCKSIZE % MAP_BLOCKSIZE,
+				i / (MAP_BLOCKSIZE * MAP_BLOCKSIZE));
+		for (int d = 0; d < 4; ++d) {
+			v3s16 target;
+			u8 cost = pathMove(window, pos, path_directions[d],
+					max_jump, max_drop, target);
+			if (!cost)
+				continue;
+			v3s16 back;
+			if (target.X >= minp.X && target.Y >= minp.Y && target.Z >= minp.Z &&
+					target.X <= maxp.X && target.Y <= maxp.Y && target.Z <= maxp.Z &&
+					pathMove(window, target, -path_directions[d],
+							max_jump, max_drop, back) && back == pos) {
+				v3s16 rel = target - minp;
+				u16 a = pathFindRoot(parent, i);
+				u16 b = pathFindRoot(parent, rel.Z * MAP_BLOCKSIZE * MAP_BLOCKSIZE +
+						rel.Y * MAP_BLOCKSIZE + rel.X);
+				parent[MYMAX(a, b)] = MYMIN(a, b);
+				continue;
+			}
+			Portal portal = {pos, target, cost};
+			found.push_back(std::make_pair((u16)i, portal));
+		}
+	}
+
+	region_count = 0;
+	regions.assign(volume, 0);
+	std::vector<u16> root_region(volume, 0);
+	for (int i = 0; i < volume; ++i) {
+		if (!standable[i])
+			continue;
+		u16 root = pathFindRoot(parent, i);
+		if (!root_region[root])
+			root_region[root] = ++region_count;
+		regions[i] = root_region[root];
+	}
+
+	portal_begin.assign(region_count + 2, 0);
+	for (auto & f : found)
+		portal_begin[regions[f.first] + 1]++;
+	for (u32 r = 1; r < portal_begin.size(); ++r)
+		portal_begin[r] += portal_begin[r - 1];
+	portals.resize(found.size());
+	std::vector<u32> next = portal_begin;
+	for (auto & f : found)
+		portals[next[regions[f.first]]++] = f.second;
+}
+
+/******************************************************************************/
+u16 PathBlockGraph::getRegion(v3s16 pos) const
+{
+	v3s16 rel = pos - blockpos * MAP_BLOCKSIZE;
+	if (rel.X < 0 || rel.Y < 0 || rel.Z < 0 || rel.X >= MAP_BLOCKSIZE ||
+			rel.Y >= MAP_BLOCKSIZE || rel.Z >= MAP_BLOCKSIZE ||
+			regions.empty())
+		return 0;
+	return regions[rel.Z * MAP_BLOCKSIZE * MAP_BLOCKSIZE +
+			rel.Y * MAP_BLOCKSIZE + rel.X];
+}
+
+/******************************************************************************/
+static inline u64 pathBlockKey(v3s16 blockpos, u16 low)
+{
+	return ((u64)(u16)blockpos.X << 48) | ((u64)(u16)blockpos.Y << 32) |
+			((u64)(u16)blockpos.Z << 16) | low;
+}
+
+static inline v3s16 pathKeyBlockPos(u64 key)
+{
+	return v3s16(key >> 48, key >> 32, key >> 16);
+}
+
+/******************************************************************************/
+void PathGraphCache::setLimit(size_t limit)
+{
+	std::lock_guard<Mutex> lock(m_mutex);
+	m_limit = limit;
+	while (m_lru.size() > m_limit) {
+		m_graphs.erase(m_lru.back());
+		m_lru.pop_back();
+	}
+}
+
+/******************************************************************************/
+std::shared_ptr<const PathBlockGraph> PathGraphCache::get(Map *map,
+		INodeDefManager *ndef, v3s16 blockpos, int max_jump, int max_drop)
+{
+	max_jump = rangelim(max_jump, 0, PATH_GRAPH_MAX_STEP);
+	max_drop = rangelim(max_drop, 0, PATH_GRAPH_MAX_STEP);
+
+	// Graph is valid while none of 3x3x3 blocks changed, loaded or unloaded
+	MapBlock *blocks[27];
+	u32 stamps[27];
+	u32 loaded = 0;
+	for (int i = 0; i < 27; ++i) {
+		blocks[i] = map->getBlockNoCreateNoEx(blockpos +
+				v3s16(i % 3 - 1, i / 3 % 3 - 1, i / 9 - 1));
+		stamps[i] = blocks[i] ? (u32)blocks[i]->m_changed_counter : 0;
+		if (blocks[i])
+			loaded |= 1 << i;
+	}
+	if (!blocks[13])
+		return GraphP();
+
+	u64 key = pathBlockKey(blockpos, max_jump << 8 | max_drop);
+	if (m_limit) {
+		std::lock_guard<Mutex> lock(m_mutex);
+		auto it = m_graphs.find(key);
+		if (it != m_graphs.end()) {
+			const GraphP &graph = it->second.first;
+			if (graph->loaded == loaded &&
+					!memcmp(graph->stamps, stamps, sizeof(stamps))) {
+				m_lru.splice(m_lru.begin(), m_lru, it->second.second);
+				g_profiler->add("Pathfinder: graph cache hit", 1);
+				return graph;
+			}
+		}
+	}
+	g_profiler->add("Pathfinder: graph cache miss", 1);
+
+	// Copy flags block by block, only one block is locked at a time
+	PathNodeWindow window(blockpos, max_jump, max_drop);
+	for (int i = 0; i < 27; ++i) {
+		MapBlock *block = blocks[i];
+		if (!block)
+			continue;
+		v3s16 bmin = block->getPosRelative();
+		v3s16 bmax = bmin + v3s16(1, 1, 1) * (MAP_BLOCKSIZE - 1);
+		v3s16 from(MYMAX(bmin.X, window.m_minp.X), MYMAX(bmin.Y, window.m_minp.Y),
+				MYMAX(bmin.Z, window.m_minp.Z));
+		v3s16 to(MYMIN(bmax.X, window.m_maxp.X), MYMIN(bmax.Y, window.m_maxp.Y),
+				MYMIN(bmax.Z, window.m_maxp.Z));
+		if (from.X > to.X || from.Y > to.Y || from.Z > to.Z)
+			continue;
+		auto lock = block->lock_shared_rec();
+		v3s16 p;
+		for (p.Z = from.Z; p.Z <= to.Z; p.Z++)
+		for (p.Y = from.Y; p.Y <= to.Y; p.Y++)
+		for (p.X = from.X; p.X <= to.X; p.X++)
+			window.at(p) = pathNodeFlags(ndef, block->getNodeNoLock(p - bmin));
+	}
+
+	auto graph = std::make_shared<PathBlockGraph>();
+	graph->build(blockpos, max_jump, max_drop,
+			[&window](v3s16 p) { return window(p); });
+	memcpy(graph->stamps, stamps, sizeof(stamps));
+	graph->loaded = loaded;
+
+	if (!m_limit)
+		return graph;
+
+	// Changed while copied, graph may mix old and new nodes
+	for (int i = 0; i < 27; ++i)
+		if (blocks[i] && stamps[i] != blocks[i]->m_changed_counter)
+			return graph;
+
+	std::lock_guard<Mutex> lock(m_mutex);
+	auto it = m_graphs.find(key);
+	if (it != m_graphs.end()) {
+		it->second.first = graph;
+		m_lru.splice(m_lru.begin(), m_lru, it->second.second);
+		return graph;
+	}
+	m_lru.push_front(key);
+	m_graphs[key] = std::make_pair(GraphP(graph), m_lru.begin());
+	while (m_lru.size() > m_limit) {
+		m_graphs.erase(m_lru.back());
+		m_lru.pop_back();
+	}
+	return graph;
+}
+
+/******************************************************************************/
+size_t PathGraphCache::size()
+{
+	std::lock_guard<Mutex> lock(m_mutex);
+	return m_graphs.size();
+}
+
+/******************************************************************************/
+struct PathSearch::State {
+	enum Phase {
+		PHASE_START,
+		PHASE_REGIONS,
+		PHASE_NODES
+	};
+
+	/** A* item, key of region (block and region) or of node position */
+	struct SearchNode {
+		u32   cost;
+		v3s16 pos;       /**< entry node of region or node position */
+		u64   parent;
+		bool  closed;
+	};
+	typedef std::pair<u32, u64> OpenItem;
+	typedef std::priority_queue<OpenItem, std::vector<OpenItem>,
+			std::greater<OpenItem> > OpenList;
+
+	State(v3s16 source_, v3s16 destination_, int searchdistance,
+			int max_jump_, int max_drop_) :
+		source(source_),
+		destination(destination_),
+		max_jump(rangelim(max_jump_, 0, PATH_GRAPH_MAX_STEP)),
+		max_drop(rangelim(max_drop_, 0, PATH_GRAPH_MAX_STEP)),
+		phase(PHASE_START),
+		goal(0),
+		map(NULL),
+		ndef(NULL),
+		cache(NULL)
+	{
+		v3s16 dist(searchdistance, searchdistance, searchdistance);
+		block_min = getNodeBlockPos(v3s16(MYMIN(source.X, destination.X),
+				MYMIN(source.Y, destination.Y),
+				MYMIN(source.Z, destination.Z)) - dist);
+		block_max = getNodeBlockPos(v3s16(MYMAX(source.X, destination.X),
+				MYMAX(source.Y, destination.Y),
+				MYMAX(source.Z, destination.Z)) + dist);
+	}
+
+	const PathBlockGraph *getGraph(v3s16 blockpos);
+	/** key of region containing standable node pos, 0 if none */
+	u64 getRegionKey(v3s16 pos);
+
+	Status step(std::vector<v3s16> &path);
+	Status start();
+	Status stepRegions();
+	Status stepNodes(std::vector<v3s16> &path);
+
+	v3s16 source;
+	v3s16 destination;
+	int   max_jump;
+	int   max_drop;
+	v3s16 block_min;
+	v3s16 block_max;
+
+	Phase phase;
+	std::unordered_map<u64, SearchNode> nodes;
+	OpenList open;
+	u64 goal;
+	/** regions found by first phase, node search does not leave them */
+	std::unordered_set<u64> corridor;
+
+	/** graphs used by current run(), checked again by next run() */
+	unordered_map_v3POS<std::shared_ptr<const PathBlockGraph> > graphs;
+	Map *map;
+	INodeDefManager *ndef;
+	PathGraphCache *cache;
+};
+
+/******************************************************************************/
+const PathBlockGraph *PathSearch::State::getGraph(v3s16 blockpos)
+{
+	auto it = graphs.find(blockpos);
+	if (it != graphs.end())
+		return it->second.get();
+	auto graph = cache->get(map, ndef, blockpos, max_jump, max_drop);
+	graphs[blockpos] = graph;
+	return graph.get();
+}
+
+/******************************************************************************/
+u64 PathSearch::State::getRegionKey(v3s16 pos)
+{
+	v3s16 blockpos = getNodeBlockPos(pos);
+	if (blockpos.X < block_min.X || blockpos.Y < block_min.Y ||
+			blockpos.Z < block_min.Z || blockpos.X > block_max.X ||
+			blockpos.Y > block_max.Y || blockpos.Z > block_max.Z)
+		return 0;
+	const PathBlockGraph *graph = getGraph(blockpos);
+	if (!graph)
+		return 0;
+	u16 region = graph->getRegion(pos);
+	return region ? pathBlockKey(blockpos, region) : 0;
+}
+
+/******************************************************************************/
+PathSearch::Status PathSearch::State::step(std::vector<v3s16> &path)
+{
+	switch (phase) {
+	case PHASE_START:
+		return start();
+	case PHASE_REGIONS:
+		return stepRegions();
+	case PHASE_NODES:
+		return stepNodes(path);
+	}
+	return FAILED;
+}
+
+/******************************************************************************/
+PathSearch::Status PathSearch::State::start()
+{
+	u64 start = getRegionKey(source);
+	goal = getRegionKey(destination);
+	if (!start) {
+		VERBOSE_TARGET << "invalid startpos " << PPOS(source) << std::endl;
+		return FAILED;
+	}
+	if (!goal) {
+		VERBOSE_TARGET << "invalid stoppos " << PPOS(destination) << std::endl;
+		return FAILED;
+	}
+
+	SearchNode node = {0, source, 0, false};
+	nodes[start] = node;
+	open.push(std::make_pair(manhattanDist(source, destination), start));
+	phase = PHASE_REGIONS;
+	return SEARCHING;
+}
+
+/******************************************************************************/
+PathSearch::Status PathSearch::State::stepRegions()
+{
+	if (open.empty()) {
+		VERBOSE_TARGET << "no path from " << PPOS(source) << " to "
+				<< PPOS(destination) << std::endl;
+		return FAILED;
+	}
+
+	u64 key = open.top().second;
+	open.pop();
+	SearchNode &current = nodes[key];
+	if (current.closed)
+		return SEARCHING;
+	current.closed = true;
+
+	if (key == goal) {
+		for (u64 k = goal; k; k = nodes[k].parent)
+			corridor.insert(k);
+
+		// Second phase: same A* over nodes of corridor
+		nodes.clear();
+		open = OpenList();
+		u64 start = pathBlockKey(source, 1);
+		SearchNode node = {0, source, 0, false};
+		nodes[start] = node;
+		open.push(std::make_pair(manhattanDist(source, destination), start));
+		phase = PHASE_NODES;
+		return SEARCHING;
+	}
+
+	const PathBlockGraph *graph = getGraph(pathKeyBlockPos(key));
+	u16 region = key & 0xffff;
+	// Graph rebuilt between run() calls can have other regions
+	if (!graph || region > graph->region_count)
+		return SEARCHING;
+
+	for (u32 i = graph->portal_begin[region];
+			i < graph->portal_begin[region + 1]; ++i) {
+		const PathBlockGraph::Portal &portal = graph->portals[i];
+		u64 next = getRegionKey(portal.to);
+		if (!next)
+			continue;
+		u32 cost = current.cost + manhattanDist(current.pos, portal.from) +
+				portal.cost;
+		auto it = nodes.find(next);
+		if (it != nodes.end() && it->second.cost <= cost)
+			continue;
+		SearchNode node = {cost, portal.to, key, false};
+		nodes[next] = node;
+		open.push(std::make_pair(cost + manhattanDist(portal.to, destination),
+				next));
+	}
+	return SEARCHING;
+}
+
+/******************************************************************************/
+PathSearch::Status PathSearch::State::stepNodes(std::vector<v3s16> &path)
+{
+	if (open.empty()) {
+		VERBOSE_TARGET << "corridor from " << PPOS(source) << " to "
+				<< PPOS(destination) << " changed" << std::endl;
+		return FAILED;
+	}
+
+	u64 key = open.top().second;
+	open.pop();
+	SearchNode &current = nodes[key];
+	if (current.closed)
+		return SEARCHING;
+	current.closed = true;
+
+	if (current.pos == destination) {
+		path.clear();
+		for (u64 k = key; k; k = nodes[k].parent) {
+			path.push_back(nodes[k].pos);
+			if (nodes[k].pos == source)
+				break;
+		}
+		std::reverse(path.begin(), path.end());
+		return FOUND;
+	}
+
+	PathMapReader reader = {map, ndef};
+	for (int d = 0; d < 4; ++d) {
+		v3s16 target;
+		u8 move_cost = pathMove(reader, current.pos, path_directions[d],
+				max_jump, max_drop, target);
+		if (!move_cost || !corridor.count(getRegionKey(target)))
+			continue;
+		u32 cost = current.cost + move_cost;
+		u64 next = pathBlockKey(target, 1);
+		auto it = nodes.find(next);
+		if (it != nodes.end() && it->second.cost <= cost)
+			continue;
+		SearchNode node = {cost, target, key, false};
+		nodes[next] = node;
+		open.push(std::make_pair(cost + manhattanDist(target, destination),
+				next));
+	}
+	return SEARCHING;
+}
+
+/******************************************************************************/
+PathSearch::PathSearch(v3s16 source,
+		v3s16 destination,
+		unsigned int searchdistance,
+		unsigned int max_jump,
+		unsigned int max_drop) :
+	m_status(SEARCHING),
+	m_iterations(0),
+	m_state(new State(source, destination, searchdistance, max_jump, max_drop))
+{
+}
+
+PathSearch::~PathSearch()
+{
+}
+
+/******************************************************************************/
+PathSearch::Status PathSearch::run(ServerEnvironment *env,
+		u32 max_iterations, u32 max_time_ms)
+{
+	if (m_status != SEARCHING)
+		return m_status;
+
+	State &state = *m_state;
+	state.map = &env->getMap();
+	state.ndef = env->getGameDef()->ndef();
+	state.cache = &env->m_path_graph_cache;
+	state.graphs.clear();
+
+	u32 start_ms = porting::getTimeMs();
+	u32 iterations = 0;
+	while (m_status == SEARCHING) {
+		if (max_iterations && iterations >= max_iterations)
+			break;
+		if (max_time_ms && porting::getTimeMs() - start_ms >= max_time_ms)
+			break;
+		++iterations;
+		m_status = state.step(m_path);
+	}
+	m_iterations += iterations;
+	g_profiler->add("Pathfinder: iterations", iterations);
+
+	// Keep only what next run() needs
+	state.graphs.clear();
+	if (m_status != SEARCHING)
+		m_state.reset();
+	return m_status;
+}
@@ -24,13 +24,21 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 /* Includes                                                                   */
 /******************************************************************************/
 #include <vector>
+#include <list>
+#include <memory>
+#include <functional>
+#include <unordered_map>
 #include "irr_v3d.h"
+#include "irrlichttypes.h"
+#include "threading/mutex.h"
 
 /******************************************************************************/
 /* Forward declarations                                                       */
 /******************************************************************************/
 
 class ServerEnvironment;
+class Map;
+class INodeDefManager;
 
 /******************************************************************************/
 /* Typedefs and macros                                                        */
@@ -47,9 +55,15 @@ typedef enum {
 typedef enum {
 	PA_DIJKSTRA,           /**< Dijkstra shortest path algorithm             */
 	PA_PLAIN,            /**< A* algorithm using heuristics to find a path */
-	PA_PLAIN_NP          /**< A* algorithm without prefetching of map data */
+	PA_PLAIN_NP,         /**< A* algorithm without prefetching of map data */
+	PA_HIERARCHICAL      /**< A* over block graphs, then A* over nodes      */
 } PathAlgorithm;
 
+/** longest jump or drop of hierarchical search, moves stay inside neighbour
+ * blocks so block graph depends only on its 3x3x3 blocks */
+#define PATH_GRAPH_MAX_STEP 15
+
+
 /******************************************************************************/
 /* declarations                                                               */
 /******************************************************************************/
@@ -63,4 +77,128 @@ std::vector<v3s16> get_path(ServerEnvironment *env,
 							unsigned int max_drop,
 							PathAlgorithm algo);
 
+/** walkability graph of one MapBlock used by PathSearch
+ *
+ * Standable nodes (not walkable, walkable below) reachable from each other
+ * by moves in both directions form a region. Every other move (leaving the
+ * block or one way drop) is a portal from its region to a node position.
+ */
+struct PathBlockGraph {
+	enum {
+		NODE_WALKABLE = 1,
+		NODE_IGNORE   = 2
+	};
+	/** returns NODE_* flags of node at map position */
+	typedef std::function<u8(v3s16)> NodeReader;
+
+	struct Portal {
+		v3s16 from;
+		v3s16 to;
+		u8    cost;
+	};
+
+	PathBlockGraph() : region_count(0), loaded(0) {}
+
+	/**
+	 * build graph from node flags
+	 * @param blockpos position of block
+	 * @param max_jump maximum number of nodes to jump up, <= PATH_GRAPH_MAX_STEP
+	 * @param max_drop maximum number of nodes to drop, <= PATH_GRAPH_MAX_STEP
+	 * @param reader node flags source, called once per node around block
+	 */
+	void build(v3s16 blockpos, int max_jump, int max_drop,
+			const NodeReader &reader);
+
+	/** region of node at map position, 0 if not standable or outside block */
+	u16 getRegion(v3s16 pos) const;
+
+	v3s16 blockpos;
+	u16   region_count;
+	/** region of every node in MapBlock data order, 0 is not standable */
+	std::vector<u16> regions;
+	/** portals of region r are portals[portal_begin[r]..portal_begin[r+1]) */
+	std::vector<Portal> portals;
+	std::vector<u32> portal_begin;
+
+	/** change counters of 3x3x3 blocks graph was built from */
+	u32 stamps[27];
+	/** bit per block of stamps, set if block was loaded */
+	u32 loaded;
+};
+
+/** LRU cache of block graphs, shared by all searches of environment */
+class PathGraphCache {
+public:
+	PathGraphCache() : m_limit(0) {}
+
+	/** maximum count of cached graphs, 0 disables cache */
+	void setLimit(size_t limit);
+
+	/**
+	 * get graph of block, rebuilt if block or one of its neighbours changed
+	 * @return graph or NULL if block is not loaded
+	 */
+	std::shared_ptr<const PathBlockGraph> get(Map *map, INodeDefManager *ndef,
+			v3s16 blockpos, int max_jump, int max_drop);
+
+	size_t size();
+
+private:
+	typedef std::shared_ptr<const PathBlockGraph> GraphP;
+	typedef std::list<u64> LruList;
+
+	Mutex  m_mutex;
+	size_t m_limit;
+	std::unordered_map<u64, std::pair<GraphP, LruList::iterator> > m_graphs;
+	/** most recently used first */
+	LruList m_lru;
+};
+
+/** resumable hierarchical path search
+ *
+ * A* over regions of block graphs finds a corridor of regions, then A* over
+ * nodes inside of corridor builds the path. Work done by one run() call is
+ * limited by iterations (expanded regions or nodes) and time, next run()
+ * continues from same state.
+ */
+class PathSearch {
+public:
+	enum Status {
+		SEARCHING,
+		FOUND,
+		FAILED
+	};
+
+	/** searchdistance is rounded up to whole blocks, max_jump and max_drop
+	 * are limited to PATH_GRAPH_MAX_STEP */
+	PathSearch(v3s16 source,
+			v3s16 destination,
+			unsigned int searchdistance,
+			unsigned int max_jump,
+			unsigned int max_drop);
+	~PathSearch();
+
+	/**
+	 * continue search
+	 * @param max_iterations iterations limit of this call, 0 is unlimited
+	 * @param max_time_ms time limit of this call, 0 is unlimited
+	 * @return status after this call
+	 */
+	Status run(ServerEnvironment *env, u32 max_iterations, u32 max_time_ms);
+
+	Status getStatus() const { return m_status; }
+	/** path from source to destination, valid if FOUND */
+	const std::vector<v3s16> &getPath() const { return m_path; }
+	/** iterations of all run() calls */
+	u32 getIterations() const { return m_iterations; }
+
+private:
+	struct State;
+
+	Status m_status;
+	std::vector<v3s16> m_path;
+	u32 m_iterations;
+	std::unique_ptr<State> m_state;
+};
+
 #endif /* PATHFINDER_H_ */
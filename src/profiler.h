@@ -27,6 +27,7 @@ along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
 #include "irrlichttypes.h"
 #include <string>
 #include <map>
+#include <cstdio>
 
 #include "threading/mutex.h"
 #include "threading/mutex_auto_lock.h"
@@ -87,6 +88,21 @@ class Profiler
 		add(name, value);
 	}
 
+	// Average of value and count of values in power of 4 buckets
+	// ("name <=00016" .. "name >16384"), used for latencies in ms
+	void histogram(const std::string &name, float value)
+	{
+		if(!g_profiler_enabled)
+			return;
+		add(name, value);
+		u32 bucket = 1;
+		while (bucket < value && bucket < 16384)
+			bucket *= 4;
+		char buf[16];
+		snprintf(buf, sizeof(buf), bucket < value ? " >%05u" : " <=%05u", bucket);
+		add(name + buf, 1);
+	}
+
 	void clear()
 	{
 		MutexAutoLock lock(m_mutex);
@@ -106,6 +122,14 @@ class Profiler
 		return data->second.avg;
 	}
 
+	unsigned int getCount(const std::string &name) const
+	{
+		auto data = m_data.find(name);
+		if (data == m_data.end())
+			return 0;
+		return data->second.calls;
+	}
+
 	void printPage(std::ostream &o, u32 page, u32 pagecount)
 	{
 		MutexAutoLock lock(m_mutex);
@@ -29,6 +29,7 @@ extern "C" {
 #include "server.h"
 #include "s_async.h"
 #include "log.h"
+#include "settings.h"
 #include "filesys.h"
 #include "porting.h"
 #include "common/c_internal.h"
@@ -36,6 +37,7 @@ extern "C" {
 /******************************************************************************/
 AsyncEngine::AsyncEngine() :
 	initDone(false),
+	server(NULL),
 	jobIdCounter(0)
 {
 }
@@ -86,9 +88,10 @@ bool AsyncEngine::registerFunction(const char* name, lua_CFunction func)
 }
 
 /******************************************************************************/
-void AsyncEngine::initialize(unsigned int numEngines)
+void AsyncEngine::initialize(unsigned int numEngines, Server *server)
 {
 	initDone = true;
+	this->server = server;
 
 	for (unsigned int i = 0; i < numEngines; i++) {
 		AsyncWorkerThread *toAdd = new AsyncWorkerThread(this,
@@ -218,6 +221,13 @@ AsyncWorkerThread::AsyncWorkerThread(AsyncEngine* jobDispatcher,
 	ScriptApiBase(),
 	jobDispatcher(jobDispatcher)
 {
+	if (jobDispatcher->server) {
+		// Jobs of mods can not do more than mods itself
+		setServer(jobDispatcher->server);
+		if (g_settings->getBool("secure.enable_security"))
+			initializeSecurity();
+	}
+
 	lua_State *L = getStack();
 
 	// Prepare job lua environment
@@ -244,7 +254,7 @@ void* AsyncWorkerThread::run()
 
 	std::string script = getServer()->getBuiltinLuaPath() + DIR_DELIM + "init.lua";
 	try {
-		loadScript(script);
+		loadMod(script, BUILTIN_MOD_NAME);
 	} catch (const ModError &e) {
 		errorstream << "Execution of async base environment failed: "
 			<< e.what() << std::endl;
@@ -275,15 +285,21 @@ void* AsyncWorkerThread::run()
 
 		luaL_checktype(L, -1, LUA_TFUNCTION);
 
-		// Call it
-		lua_pushlstring(L,
+		// Bytecode is loaded here: lua functions of secure environment refuse it
+		int result = luaL_loadbuffer(L,
 				toProcess.serializedFunction.data(),
-				toProcess.serializedFunction.size());
-		lua_pushlstring(L,
-				toProcess.serializedParams.data(),
-				toProcess.serializedParams.size());
-
-		int result = lua_pcall(L, 2, 1, error_handler);
+				toProcess.serializedFunction.size(),
+				"=(async)");
+		if (!result) {
+			// Call it
+			lua_pushlstring(L,
+					toProcess.serializedParams.data(),
+					toProcess.serializedParams.size());
+
+			result = lua_pcall(L, 2, 1, error_handler);
+		} else {
+			lua_remove(L, -2);  // Pop job processor, error message stays as retval
+		}
 		if (result) {
 			PCALL_RES(result);
 			toProcess.serializedResult = "";
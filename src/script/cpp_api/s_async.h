@@ -30,6 +30,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "debug.h"
 #include "lua.h"
 #include "cpp_api/s_base.h"
+#include "cpp_api/s_security.h"
 //#include "threading/thread_pool.h"
 
 // Forward declarations
@@ -53,7 +54,9 @@ struct LuaJobInfo {
 };
 
 // Asynchronous working environment
-class AsyncWorkerThread : public Thread, public ScriptApiBase {
+class AsyncWorkerThread : public Thread,
+		virtual public ScriptApiBase,
+		public ScriptApiSecurity {
 public:
 	AsyncWorkerThread(AsyncEngine* jobDispatcher, const std::string &name);
 	virtual ~AsyncWorkerThread();
@@ -81,8 +84,9 @@ class AsyncEngine {
 	/**
 	 * Create async engine tasks and lock function registration
 	 * @param numEngines Number of async threads to be started
+	 * @param server Server for jobs of mods, secured like game environment
 	 */
-	void initialize(unsigned int numEngines);
+	void initialize(unsigned int numEngines, Server *server = NULL);
 
 	/**
 	 * Queue an async job
@@ -132,6 +136,9 @@ class AsyncEngine {
 	// Variable locking the engine against further modification
 	bool initDone;
 
+	// Server of game environment, NULL for main menu
+	Server *server;
+
 	// Internal store for registred functions
 	std::map<std::string, lua_CFunction> functionList;
 
@@ -38,6 +38,7 @@ along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
 #include "treegen.h"
 #include "emerge.h"
 #include "pathfinder.h"
+#include "settings.h"
 #include <unordered_set>
 
 struct EnumString ModApiEnvMod::es_ClearObjectsMode[] =
@@ -947,7 +948,7 @@ int ModApiEnvMod::l_delete_area(lua_State *L)
 		v3s16 bp(x, y, z);
 		if (map.deleteBlock(bp)) {
 			env->setStaticForActiveObjectsInBlock(bp, false);
-			//event.modified_blocks.insert(bp);
+			event.modified_blocks.insert(bp);
 		} else {
 			success = false;
 		}
@@ -958,8 +959,23 @@ int ModApiEnvMod::l_delete_area(lua_State *L)
 	return 1;
 }
 
+static void push_path(lua_State *L, const std::vector<v3s16> &path)
+{
+	lua_newtable(L);
+	int top = lua_gettop(L);
+	unsigned int index = 1;
+	for (std::vector<v3s16>::const_iterator i = path.begin(); i != path.end();i++)
+	{
+		lua_pushnumber(L,index);
+		push_v3s16(L, *i);
+		lua_settable(L, top);
+		index++;
+	}
+}
+
 // find_path(pos1, pos2, searchdistance,
-//     max_jump, max_drop, algorithm) -> table containing path
+//     max_jump, max_drop, algorithm, budget) -> table containing path
+//     or PathSearch if budget is used up
 int ModApiEnvMod::l_find_path(lua_State *L)
 {
 	GET_ENV_PTR;
@@ -978,6 +994,16 @@ int ModApiEnvMod::l_find_path(lua_State *L)
 
 		if (algorithm == "Dijkstra")
 			algo = PA_DIJKSTRA;
+
+		if (algorithm == "hierarchical")
+			algo = PA_HIERARCHICAL;
+	}
+
+	if (algo == PA_HIERARCHICAL && lua_istable(L, 7)) {
+		LuaPathSearch *o = new LuaPathSearch(pos1, pos2,
+				searchdistance, max_jump, max_drop);
+		LuaPathSearch::create(L, o);
+		return o->run(L, env, 7, lua_gettop(L));
 	}
 
 	std::vector<v3s16> path = get_path(env, pos1, pos2,
@@ -985,16 +1011,7 @@ int ModApiEnvMod::l_find_path(lua_State *L)
 
 	if (path.size() > 0)
 	{
-		lua_newtable(L);
-		int top = lua_gettop(L);
-		unsigned int index = 1;
-		for (std::vector<v3s16>::iterator i = path.begin(); i != path.end();i++)
-		{
-			lua_pushnumber(L,index);
-			push_v3s16(L, *i);
-			lua_settable(L, top);
-			index++;
-		}
+		push_path(L, path);
 		return 1;
 	}
 
@@ -1194,3 +1211,92 @@ void ModApiEnvMod::Initialize(lua_State *L, int top)
 	API_FCT(make_explosion);
 */
 }
+
+
+/*
+	LuaPathSearch
+*/
+
+int LuaPathSearch::run(lua_State *L, ServerEnvironment *env, int budget, int self)
+{
+	u32 max_iterations = g_settings->getU32("pathfinder_max_iterations");
+	u32 max_time = g_settings->getU32("pathfinder_max_time");
+	if (lua_istable(L, budget)) {
+		getintfield(L, budget, "iterations", max_iterations);
+		getintfield(L, budget, "time", max_time);
+	}
+
+	switch (m_search.run(env, max_iterations, max_time)) {
+	case PathSearch::SEARCHING:
+		lua_pushvalue(L, self);
+		return 1;
+	case PathSearch::FOUND:
+		push_path(L, m_search.getPath());
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+// resume(self, budget) -> table containing path or PathSearch
+int LuaPathSearch::l_resume(lua_State *L)
+{
+	GET_ENV_PTR;
+
+	LuaPathSearch *o = checkobject(L, 1);
+	return o->run(L, env, 2, 1);
+}
+
+void LuaPathSearch::create(lua_State *L, LuaPathSearch *o)
+{
+	*(void **)(lua_newuserdata(L, sizeof(void *))) = o;
+	luaL_getmetatable(L, className);
+	lua_setmetatable(L, -2);
+}
+
+int LuaPathSearch::gc_object(lua_State *L)
+{
+	LuaPathSearch *o = *(LuaPathSearch **)(lua_touserdata(L, 1));
+	delete o;
+	return 0;
+}
+
+LuaPathSearch *LuaPathSearch::checkobject(lua_State *L, int narg)
+{
+	luaL_checktype(L, narg, LUA_TUSERDATA);
+	void *ud = luaL_checkudata(L, narg, className);
+	if (!ud)
+		luaL_typerror(L, narg, className);
+	return *(LuaPathSearch **)ud;
+}
+
+void LuaPathSearch::Register(lua_State *L)
+{
+	lua_newtable(L);
+	int methodtable = lua_gettop(L);
+	luaL_newmetatable(L, className);
+	int metatable = lua_gettop(L);
+
+	lua_pushliteral(L, "__metatable");
+	lua_pushvalue(L, methodtable);
+	lua_settable(L, metatable);
+
+	lua_pushliteral(L, "__index");
+	lua_pushvalue(L, methodtable);
+	lua_settable(L, metatable);
+
+	lua_pushliteral(L, "__gc");
+	lua_pushcfunction(L, gc_object);
+	lua_settable(L, metatable);
+
+	lua_pop(L, 1);
+
+	luaL_openlib(L, 0, methods, 0);
+	lua_pop(L, 1);
+}
+
+const char LuaPathSearch::className[] = "PathSearch";
+const luaL_reg LuaPathSearch::methods[] = {
+	luamethod(LuaPathSearch, resume),
+	{0,0}
+};
@@ -163,7 +163,8 @@ class ModApiEnvMod : public ModApiBase {
 	static int l_line_of_sight(lua_State *L);
 
 	// find_path(pos1, pos2, searchdistance,
-	//     max_jump, max_drop, algorithm) -> table containing path
+	//     max_jump, max_drop, algorithm, budget) -> table containing path
+	//     or PathSearch if budget is used up
 	static int l_find_path(lua_State *L);
 
 	// transforming_liquid_add(pos)
@@ -271,6 +272,41 @@ class LuaLBM : public LoadingBlockModifierDef
 	virtual void trigger(ServerEnvironment *env, v3s16 p, MapNode n);
 };
 
+/*
+	PathSearch: hierarchical find_path which ran out of budget
+*/
+class LuaPathSearch : public ModApiBase {
+private:
+	PathSearch m_search;
+
+	static const char className[];
+	static const luaL_reg methods[];
+
+	// garbage collector
+	static int gc_object(lua_State *L);
+
+	// resume(self, budget) -> table containing path or PathSearch
+	static int l_resume(lua_State *L);
+
+public:
+	LuaPathSearch(v3s16 source, v3s16 destination,
+			unsigned int searchdistance,
+			unsigned int max_jump, unsigned int max_drop) :
+		m_search(source, destination, searchdistance, max_jump, max_drop)
+	{}
+
+	// Creates an LuaPathSearch and leaves it on top of stack
+	static void create(lua_State *L, LuaPathSearch *o);
+
+	// Continues search with budget {iterations=, time=} at index budget,
+	// pushes path, PathSearch at index self if not done or nothing
+	int run(lua_State *L, ServerEnvironment *env, int budget, int self);
+
+	static LuaPathSearch *checkobject(lua_State *L, int narg);
+
+	static void Register(lua_State *L);
+};
+
 struct ScriptCallbackState {
 	GameScripting *script;
 	int callback_ref;
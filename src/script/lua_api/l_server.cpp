@@ -25,6 +25,7 @@ along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
 #include "common/c_converter.h"
 #include "common/c_content.h"
 #include "cpp_api/s_base.h"
+#include "scripting_game.h"
 #include "server.h"
 #include "environment.h"
 #include "player.h"
@@ -477,6 +478,42 @@ int ModApiServer::l_set_last_run_mod(lua_State *L)
 	return 0;
 }
 
+static int dump_writer(lua_State *L, const void *p, size_t sz, void *ud)
+{
+	((std::string *)ud)->append((const char *)p, sz);
+	return 0;
+}
+
+// do_async_callback(func, serialized_params)
+int ModApiServer::l_do_async_callback(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+	luaL_checktype(L, 1, LUA_TFUNCTION);
+	size_t param_length;
+	const char *serialized_param_raw = luaL_checklstring(L, 2, &param_length);
+
+	// Dumped here and not by mod: async environment loads only bytecode made by lua itself
+	std::string serialized_func;
+	lua_pushvalue(L, 1);
+	int result = lua_dump(L, dump_writer, &serialized_func);
+	lua_pop(L, 1);
+	if (result || serialized_func.empty())
+		throw LuaError("do_async_callback: unable to dump function");
+
+	GameScripting *script = getScriptApi<GameScripting>(L);
+	lua_pushinteger(L, script->queueAsync(serialized_func,
+			std::string(serialized_param_raw, param_length)));
+	return 1;
+}
+
+// get_finished_jobs()
+int ModApiServer::l_get_finished_jobs(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+	getScriptApi<GameScripting>(L)->pushFinishedJobs(L);
+	return 1;
+}
+
 #ifndef NDEBUG
 // cause_error(type_of_error)
 int ModApiServer::l_cause_error(lua_State *L)
@@ -538,6 +575,9 @@ void ModApiServer::Initialize(lua_State *L, int top)
 
 	API_FCT(get_last_run_mod);
 	API_FCT(set_last_run_mod);
+
+	API_FCT(do_async_callback);
+	API_FCT(get_finished_jobs);
 #ifndef NDEBUG
 	API_FCT(cause_error);
 #endif
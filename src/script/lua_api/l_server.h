@@ -100,6 +100,12 @@ class ModApiServer : public ModApiBase {
 	// set_last_run_mod(modname)
 	static int l_set_last_run_mod(lua_State *L);
 
+	// do_async_callback(func, serialized_params)
+	static int l_do_async_callback(lua_State *L);
+
+	// get_finished_jobs()
+	static int l_get_finished_jobs(lua_State *L);
+
 #ifndef NDEBUG
 	//  cause_error(type_of_error)
 	static int l_cause_error(lua_State *L);
@@ -73,7 +73,7 @@ int LuaVoxelManip::l_get_data(lua_State *L)
 	if (use_buffer)
 		lua_pushvalue(L, 2);
 	else
-		lua_newtable(L);
+		lua_createtable(L, volume, 0);
 
 	for (u32 i = 0; i != volume; i++) {
 		lua_Integer cid = vm->m_data[i].getContent();
@@ -242,7 +242,7 @@ int LuaVoxelManip::l_get_light_data(lua_State *L)
 
 	u32 volume = vm->m_area.getVolume();
 
-	lua_newtable(L);
+	lua_createtable(L, volume, 0);
 	for (u32 i = 0; i != volume; i++) {
 		lua_Integer light = vm->m_data[i].param1;
 		lua_pushinteger(L, light);
@@ -284,7 +284,7 @@ int LuaVoxelManip::l_get_param2_data(lua_State *L)
 
 	u32 volume = vm->m_area.getVolume();
 
-	lua_newtable(L);
+	lua_createtable(L, volume, 0);
 	for (u32 i = 0; i != volume; i++) {
 		lua_Integer param2 = vm->m_data[i].param2;
 		lua_pushinteger(L, param2);
@@ -317,6 +317,29 @@ int LuaVoxelManip::l_set_param2_data(lua_State *L)
 	return 0;
 }
 
+// get_buffer(self, ["content" | "param1" | "param2"])
+int LuaVoxelManip::l_get_buffer(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	checkobject(L, 1);
+	std::string name = luaL_optstring(L, 2, "content");
+
+	u8 field;
+	if (name == "content")
+		field = LuaVoxelBuffer::FIELD_CONTENT;
+	else if (name == "param1")
+		field = LuaVoxelBuffer::FIELD_PARAM1;
+	else if (name == "param2")
+		field = LuaVoxelBuffer::FIELD_PARAM2;
+	else
+		return luaL_argerror(L, 2, "expected \"content\", \"param1\" or \"param2\"");
+
+	LuaVoxelBuffer::create(L, 1, field);
+
+	return 1;
+}
+
 int LuaVoxelManip::l_update_map(lua_State *L)
 {
 	GET_ENV_PTR;
@@ -337,12 +360,10 @@ int LuaVoxelManip::l_update_map(lua_State *L)
 
 	MapEditEvent event;
 	event.type = MEET_OTHER;
-/*
 	for (std::map<v3s16, MapBlock *>::iterator
 		it = mblocks->begin();
 		it != mblocks->end(); ++it)
 		event.modified_blocks.insert(it->first);
-*/
 	map->dispatchEvent(&event);
 
 	mblocks->clear();
@@ -477,7 +498,207 @@ const luaL_reg LuaVoxelManip::methods[] = {
 	luamethod(LuaVoxelManip, set_light_data),
 	luamethod(LuaVoxelManip, get_param2_data),
 	luamethod(LuaVoxelManip, set_param2_data),
+	luamethod(LuaVoxelManip, get_buffer),
 	luamethod(LuaVoxelManip, was_modified),
 	luamethod(LuaVoxelManip, get_emerged_area),
 	{0,0}
 };
+
+static inline lua_Integer get_field(const MapNode &n, u8 field)
+{
+	switch (field) {
+	case LuaVoxelBuffer::FIELD_PARAM1:
+		return n.param1;
+	case LuaVoxelBuffer::FIELD_PARAM2:
+		return n.param2;
+	default:
+		return n.getContent();
+	}
+}
+
+static inline void set_field(MapNode &n, u8 field, lua_Integer value)
+{
+	switch (field) {
+	case LuaVoxelBuffer::FIELD_PARAM1:
+		n.param1 = value;
+		break;
+	case LuaVoxelBuffer::FIELD_PARAM2:
+		n.param2 = value;
+		break;
+	default:
+		n.setContent(value);
+	}
+}
+
+// garbage collector
+int LuaVoxelBuffer::gc_object(lua_State *L)
+{
+	LuaVoxelBuffer *o = *(LuaVoxelBuffer **)(lua_touserdata(L, 1));
+	luaL_unref(L, LUA_REGISTRYINDEX, o->vm_ref);
+	delete o;
+
+	return 0;
+}
+
+// buffer[i], out of area is nil, other keys are methods
+int LuaVoxelBuffer::mt_index(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	LuaVoxelBuffer *o = checkobject(L, 1);
+
+	if (lua_type(L, 2) != LUA_TNUMBER) {
+		lua_pushvalue(L, 2);
+		lua_rawget(L, lua_upvalueindex(1));
+		return 1;
+	}
+
+	MMVManip *vm = o->vmo->vm;
+	lua_Integer i = lua_tointeger(L, 2) - 1;
+	if (i < 0 || i >= (lua_Integer)vm->m_area.getVolume()) {
+		lua_pushnil(L);
+		return 1;
+	}
+
+	lua_pushinteger(L, get_field(vm->m_data[i], o->field));
+	return 1;
+}
+
+// buffer[i] = value
+int LuaVoxelBuffer::mt_newindex(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	LuaVoxelBuffer *o = checkobject(L, 1);
+	MMVManip *vm = o->vmo->vm;
+
+	lua_Integer i = luaL_checkinteger(L, 2) - 1;
+	if (i < 0 || i >= (lua_Integer)vm->m_area.getVolume())
+		return luaL_argerror(L, 2, "index out of VoxelManip area");
+
+	set_field(vm->m_data[i], o->field, luaL_checkinteger(L, 3));
+	return 0;
+}
+
+// #buffer
+int LuaVoxelBuffer::mt_len(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	LuaVoxelBuffer *o = checkobject(L, 1);
+
+	lua_pushinteger(L, o->vmo->vm->m_area.getVolume());
+	return 1;
+}
+
+// fill(self, value)
+int LuaVoxelBuffer::l_fill(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	LuaVoxelBuffer *o = checkobject(L, 1);
+	lua_Integer value = luaL_checkinteger(L, 2);
+	MMVManip *vm = o->vmo->vm;
+
+	u32 volume = vm->m_area.getVolume();
+	for (u32 i = 0; i != volume; i++)
+		set_field(vm->m_data[i], o->field, value);
+
+	return 0;
+}
+
+// get_pointer(self) -> lightuserdata of nodes array, nil if empty
+// Nodes are {u16 content, u8 param1, u8 param2}, 0 based, valid until
+// next read_from_map() of VoxelManip
+int LuaVoxelBuffer::l_get_pointer(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	LuaVoxelBuffer *o = checkobject(L, 1);
+	MMVManip *vm = o->vmo->vm;
+
+	if (!vm->m_data || !vm->m_area.getVolume()) {
+		lua_pushnil(L);
+		return 1;
+	}
+
+	lua_pushlightuserdata(L, vm->m_data);
+	return 1;
+}
+
+LuaVoxelBuffer::LuaVoxelBuffer(LuaVoxelManip *vmo, int vm_ref, u8 field) :
+	vmo(vmo),
+	vm_ref(vm_ref),
+	field(field)
+{
+}
+
+void LuaVoxelBuffer::create(lua_State *L, int vm_index, u8 field)
+{
+	LuaVoxelManip *vmo = LuaVoxelManip::checkobject(L, vm_index);
+
+	lua_pushvalue(L, vm_index);
+	int vm_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+
+	LuaVoxelBuffer *o = new LuaVoxelBuffer(vmo, vm_ref, field);
+	*(void **)(lua_newuserdata(L, sizeof(void *))) = o;
+	luaL_getmetatable(L, className);
+	lua_setmetatable(L, -2);
+}
+
+LuaVoxelBuffer *LuaVoxelBuffer::checkobject(lua_State *L, int narg)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	luaL_checktype(L, narg, LUA_TUSERDATA);
+
+	void *ud = luaL_checkudata(L, narg, className);
+	if (!ud)
+		luaL_typerror(L, narg, className);
+
+	return *(LuaVoxelBuffer **)ud;  // unbox pointer
+}
+
+void LuaVoxelBuffer::Register(lua_State *L)
+{
+	lua_newtable(L);
+	int methodtable = lua_gettop(L);
+	luaL_newmetatable(L, className);
+	int metatable = lua_gettop(L);
+
+	lua_pushliteral(L, "__metatable");
+	lua_pushvalue(L, methodtable);
+	lua_settable(L, metatable);  // hide metatable from Lua getmetatable()
+
+	// Numbers are data, other keys are looked up in methodtable
+	lua_pushliteral(L, "__index");
+	lua_pushvalue(L, methodtable);
+	lua_pushcclosure(L, mt_index, 1);
+	lua_settable(L, metatable);
+
+	lua_pushliteral(L, "__newindex");
+	lua_pushcfunction(L, mt_newindex);
+	lua_settable(L, metatable);
+
+	lua_pushliteral(L, "__len");
+	lua_pushcfunction(L, mt_len);
+	lua_settable(L, metatable);
+
+	lua_pushliteral(L, "__gc");
+	lua_pushcfunction(L, gc_object);
+	lua_settable(L, metatable);
+
+	lua_pop(L, 1);  // drop metatable
+
+	luaL_openlib(L, 0, methods, 0);  // fill methodtable
+	lua_pop(L, 1);  // drop methodtable
+
+	// Created only by VoxelManip:get_buffer()
+}
+
+const char LuaVoxelBuffer::className[] = "VoxelBuffer";
+const luaL_reg LuaVoxelBuffer::methods[] = {
+	luamethod(LuaVoxelBuffer, fill),
+	luamethod(LuaVoxelBuffer, get_pointer),
+	{0,0}
+};
@@ -63,6 +63,8 @@ class LuaVoxelManip : public ModApiBase {
 	static int l_get_param2_data(lua_State *L);
 	static int l_set_param2_data(lua_State *L);
 
+	static int l_get_buffer(lua_State *L);
+
 	static int l_was_modified(lua_State *L);
 	static int l_get_emerged_area(lua_State *L);
 
@@ -83,4 +85,44 @@ class LuaVoxelManip : public ModApiBase {
 	static void Register(lua_State *L);
 };
 
+/*
+  VoxelBuffer
+  View of content, param1 or param2 of VoxelManip nodes without copy,
+  indexed same as get_data() tables
+ */
+class LuaVoxelBuffer : public ModApiBase {
+private:
+	LuaVoxelManip *vmo;
+	// Reference to VoxelManip userdata, it must live while view exists
+	int vm_ref;
+	u8 field;
+
+	static const char className[];
+	static const luaL_reg methods[];
+
+	static int gc_object(lua_State *L);
+	static int mt_index(lua_State *L);
+	static int mt_newindex(lua_State *L);
+	static int mt_len(lua_State *L);
+
+	static int l_fill(lua_State *L);
+	static int l_get_pointer(lua_State *L);
+
+public:
+	enum {
+		FIELD_CONTENT,
+		FIELD_PARAM1,
+		FIELD_PARAM2,
+	};
+
+	LuaVoxelBuffer(LuaVoxelManip *vmo, int vm_ref, u8 field);
+
+	// Creates view of VoxelManip at vm_index and leaves it on top of stack
+	static void create(lua_State *L, int vm_index, u8 field);
+
+	static LuaVoxelBuffer *checkobject(lua_State *L, int narg);
+
+	static void Register(lua_State *L);
+};
+
 #endif /* L_VMANIP_H_ */
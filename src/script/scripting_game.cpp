@@ -105,12 +105,34 @@ void GameScripting::InitializeModApi(lua_State *L, int top)
 	LuaPerlinNoiseMap::Register(L);
 	LuaPseudoRandom::Register(L);
 	LuaPcgRandom::Register(L);
+	LuaPathSearch::Register(L);
 	LuaSecureRandom::Register(L);
 	LuaVoxelManip::Register(L);
+	LuaVoxelBuffer::Register(L);
 	NodeMetaRef::Register(L);
 	NodeTimerRef::Register(L);
 	ObjectRef::Register(L);
 	LuaSettings::Register(L);
+
+	// Register functions to async environment
+	ModApiUtil::InitializeAsync(asyncEngine);
+
+	// Initialize async environment, mods jobs run there with same security
+	int async_threads = g_settings->getS32("server_async_threads");
+	if (async_threads <= 0)
+		async_threads = Thread::getNumberOfProcessors();
+	asyncEngine.initialize(async_threads, getServer());
+}
+
+unsigned int GameScripting::queueAsync(const std::string &serialized_func,
+		const std::string &serialized_params)
+{
+	return asyncEngine.queueAsyncJob(serialized_func, serialized_params);
+}
+
+void GameScripting::pushFinishedJobs(lua_State *L)
+{
+	asyncEngine.pushFinishedJobs(L);
 }
 
 void log_deprecated(const std::string &message)
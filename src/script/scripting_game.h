@@ -31,6 +31,7 @@ along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
 #include "cpp_api/s_player.h"
 #include "cpp_api/s_server.h"
 #include "cpp_api/s_security.h"
+#include "cpp_api/s_async.h"
 
 /*****************************************************************************/
 /* Scripting <-> Game Interface                                              */
@@ -51,8 +52,16 @@ class GameScripting :
 
 	// use ScriptApiBase::loadMod() to load mods
 
+	// Pass jobs of mods to async threads
+	unsigned int queueAsync(const std::string &serialized_func,
+			const std::string &serialized_params);
+	// Push finished jobs table, results are called back from globalstep
+	void pushFinishedJobs(lua_State *L);
+
 private:
 	void InitializeModApi(lua_State *L, int top);
+
+	AsyncEngine asyncEngine;
 };
 
 void log_deprecated(const std::string &message);
@@ -27,8 +27,14 @@ along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
 	#define ZLIB_WINAPI
 #endif
 #include "zlib.h"
+#if USE_ZSTD
+	#include <zstd.h>
+	#include <zdict.h>
+#endif
+#include "log.h"
 
 #include <sstream>
+#include <memory>
 
 /* report a zlib or i/o error */
 void zerr(int ret)
@@ -289,3 +295,198 @@ void decompressZlib(const std::string &is, std::string &os) {
 	os = oss.str();
 }
 
+
+/*
+	Block data compression
+*/
+
+static u8 block_compressor = BLOCK_COMPRESSOR_ZLIB;
+static int block_compression_level = -1;
+
+void setBlockCompression(const std::string &name, int level)
+{
+	block_compression_level = level;
+	if (name == "zlib") {
+		block_compressor = BLOCK_COMPRESSOR_ZLIB;
+		return;
+	}
+#if USE_ZSTD
+	if (name == "zstd") {
+		block_compressor = BLOCK_COMPRESSOR_ZSTD;
+		return;
+	}
+#endif
+	warningstream << "Unsupported block_compression=" << name << ", using zlib" << std::endl;
+	block_compressor = BLOCK_COMPRESSOR_ZLIB;
+}
+
+u8 getBlockDiskVersion()
+{
+	if (block_compressor == BLOCK_COMPRESSOR_ZLIB)
+		return SER_FMT_VER_HIGHEST_WRITE;
+	return SER_FMT_VER_COMPRESSOR;
+}
+
+void compressBlockData(SharedBuffer<u8> data, std::ostream &os, u8 version, bool disk)
+{
+	if (version < SER_FMT_VER_COMPRESSOR) {
+		compressZlib(data, os);
+		return;
+	}
+
+	std::ostringstream oss(std::ios_base::binary);
+	u8 compressor = block_compressor;
+	switch (compressor) {
+#if USE_ZSTD
+	case BLOCK_COMPRESSOR_ZSTD:
+		compressZstd(*data, data.getSize(), oss,
+			block_compression_level < 0 ? 1 : block_compression_level, disk);
+		break;
+#endif
+	default:
+		compressor = BLOCK_COMPRESSOR_ZLIB;
+		compressZlib(data, oss, block_compression_level < 0 ? 2 : block_compression_level);
+	}
+
+	std::string compressed = oss.str();
+	writeU8(os, compressor);
+	writeU32(os, compressed.size());
+	os.write(compressed.data(), compressed.size());
+}
+
+void compressBlockData(const std::string &data, std::ostream &os, u8 version, bool disk)
+{
+	SharedBuffer<u8> databuf((u8*)data.c_str(), data.size());
+	compressBlockData(databuf, os, version, disk);
+}
+
+void decompressBlockData(std::istream &is, std::ostream &os, u8 version)
+{
+	if (version < SER_FMT_VER_COMPRESSOR) {
+		decompressZlib(is, os);
+		return;
+	}
+
+	u8 compressor = readU8(is);
+	u32 size = readU32(is);
+	if (size > 0x10000000)
+		throw SerializationError("decompressBlockData: invalid size");
+	std::string compressed(size, 0);
+	is.read(&compressed[0], size);
+	if ((u32)is.gcount() != size)
+		throw SerializationError("decompressBlockData: stream ended halfway");
+
+	switch (compressor) {
+	case BLOCK_COMPRESSOR_ZLIB: {
+		std::istringstream iss(compressed, std::ios_base::binary);
+		decompressZlib(iss, os);
+		break;
+	}
+#if USE_ZSTD
+	case BLOCK_COMPRESSOR_ZSTD:
+		decompressZstd(compressed, os);
+		break;
+#endif
+	default:
+		throw SerializationError("decompressBlockData: unsupported compressor " + std::to_string(compressor));
+	}
+}
+
+#if USE_ZSTD
+
+// Set once at startup, only read after that
+static std::unique_ptr<ZSTD_CDict, size_t(*)(ZSTD_CDict*)> zstd_cdict(nullptr, ZSTD_freeCDict);
+static std::unique_ptr<ZSTD_DDict, size_t(*)(ZSTD_DDict*)> zstd_ddict(nullptr, ZSTD_freeDDict);
+static std::string zstd_dictionary;
+static int zstd_cdict_level = 0;
+
+bool setZstdDictionary(const std::string &dictionary)
+{
+	zstd_dictionary = dictionary;
+	zstd_cdict.reset();
+	zstd_ddict.reset();
+	if (dictionary.empty())
+		return true;
+	zstd_cdict_level = block_compression_level < 0 ? 1 : block_compression_level;
+	zstd_cdict.reset(ZSTD_createCDict(zstd_dictionary.data(), zstd_dictionary.size(), zstd_cdict_level));
+	zstd_ddict.reset(ZSTD_createDDict(zstd_dictionary.data(), zstd_dictionary.size()));
+	if (!zstd_cdict || !zstd_ddict) {
+		zstd_cdict.reset();
+		zstd_ddict.reset();
+		zstd_dictionary.clear();
+		return false;
+	}
+	return true;
+}
+
+void compressZstd(const u8 *data, size_t size, std::ostream &os, int level, bool use_dictionary)
+{
+	std::string output(ZSTD_compressBound(size), 0);
+	size_t ret;
+	if (use_dictionary && zstd_cdict && level == zstd_cdict_level) {
+		std::unique_ptr<ZSTD_CCtx, size_t(*)(ZSTD_CCtx*)> cctx(ZSTD_createCCtx(), ZSTD_freeCCtx);
+		if (!cctx)
+			throw SerializationError("compressZstd: ZSTD_createCCtx failed");
+		ret = ZSTD_compress_usingCDict(cctx.get(), &output[0], output.size(),
+			data, size, zstd_cdict.get());
+	} else {
+		ret = ZSTD_compress(&output[0], output.size(), data, size, level);
+	}
+	if (ZSTD_isError(ret))
+		throw SerializationError(std::string("compressZstd: ") + ZSTD_getErrorName(ret));
+	os.write(output.data(), ret);
+}
+
+void compressZstd(const std::string &data, std::ostream &os, int level, bool use_dictionary)
+{
+	compressZstd((const u8 *)data.data(), data.size(), os, level, use_dictionary);
+}
+
+void decompressZstd(const std::string &data, std::ostream &os)
+{
+	unsigned long long size = ZSTD_getFrameContentSize(data.data(), data.size());
+	// Blocks and metadata never come near this
+	if (size == ZSTD_CONTENTSIZE_UNKNOWN || size == ZSTD_CONTENTSIZE_ERROR
+			|| size > 0x10000000)
+		throw SerializationError("decompressZstd: invalid frame content size");
+
+	std::string output(size, 0);
+	size_t ret;
+	unsigned int dict_id = ZSTD_getDictID_fromFrame(data.data(), data.size());
+	if (dict_id) {
+		if (!zstd_ddict || ZSTD_getDictID_fromDDict(zstd_ddict.get()) != dict_id)
+			throw SerializationError("decompressZstd: missing dictionary " + std::to_string(dict_id));
+		std::unique_ptr<ZSTD_DCtx, size_t(*)(ZSTD_DCtx*)> dctx(ZSTD_createDCtx(), ZSTD_freeDCtx);
+		if (!dctx)
+			throw SerializationError("decompressZstd: ZSTD_createDCtx failed");
+		ret = ZSTD_decompress_usingDDict(dctx.get(), &output[0], output.size(),
+			data.data(), data.size(), zstd_ddict.get());
+	} else {
+		ret = ZSTD_decompress(&output[0], output.size(), data.data(), data.size());
+	}
+	if (ZSTD_isError(ret))
+		throw SerializationError(std::string("decompressZstd: ") + ZSTD_getErrorName(ret));
+	os.write(output.data(), ret);
+}
+
+std::string trainZstdDictionary(const std::vector<std::string> &samples, size_t dictionary_size)
+{
+	std::string buffer;
+	std::vector<size_t> sizes;
+	sizes.reserve(samples.size());
+	for (const auto &sample : samples) {
+		buffer += sample;
+		sizes.push_back(sample.size());
+	}
+	std::string dictionary(dictionary_size, 0);
+	size_t ret = ZDICT_trainFromBuffer(&dictionary[0], dictionary.size(),
+		buffer.data(), sizes.data(), sizes.size());
+	if (ZDICT_isError(ret)) {
+		errorstream << "trainZstdDictionary: " << ZDICT_getErrorName(ret) << std::endl;
+		return "";
+	}
+	dictionary.resize(ret);
+	return dictionary;
+}
+
+#endif
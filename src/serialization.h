@@ -25,7 +25,10 @@ along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "irrlichttypes.h"
 #include "exceptions.h"
+#include "config.h"
 #include <iostream>
+#include <string>
+#include <vector>
 #include "util/pointer.h"
 
 /*
@@ -65,11 +68,19 @@ along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
 	24: 16-bit node ids and node timers (never released as stable)
 	25: Improved node timer format
 	26: Never written; read the same as 25
+	27: (freeminer) Compressor id and size before compressed node data and
+	    node metadata, zstd (only with USE_ZSTD and not with minetest protocol)
 */
 // This represents an uninitialized or invalid format
 #define SER_FMT_VER_INVALID 255
 // Highest supported serialization version
+#if USE_ZSTD && !MINETEST_PROTO
+#define SER_FMT_VER_HIGHEST_READ 27
+#else
 #define SER_FMT_VER_HIGHEST_READ 26
+#endif
+// First version with selectable block data compressor
+#define SER_FMT_VER_COMPRESSOR 27
 // Saved on disk version
 #define SER_FMT_VER_HIGHEST_WRITE 25
 // Lowest supported serialization version
@@ -100,5 +111,36 @@ void decompress(std::istream &is, std::ostream &os, u8 version);
 void compressZlib(const std::string &data, std::string &os, int level = 2);
 void decompressZlib(const std::string &is, std::string &os);
 
+/*
+	Block data (bulk nodes, node metadata) compression.
+	Versions < SER_FMT_VER_COMPRESSOR: zlib stream.
+	Newer: [u8 BlockCompressor][u32 size][compressed data].
+	Configure once at startup, before any block is serialized.
+*/
+enum BlockCompressor {
+	BLOCK_COMPRESSOR_ZLIB = 0,
+	BLOCK_COMPRESSOR_ZSTD = 1,
+};
+
+// name: "zlib" or "zstd", level < 0: compressor default
+void setBlockCompression(const std::string &name, int level = -1);
+// Version for writing blocks to disk: zlib blocks stay readable by old versions
+u8 getBlockDiskVersion();
+
+void compressBlockData(SharedBuffer<u8> data, std::ostream &os, u8 version, bool disk = false);
+void compressBlockData(const std::string &data, std::ostream &os, u8 version, bool disk = false);
+void decompressBlockData(std::istream &is, std::ostream &os, u8 version);
+
+#if USE_ZSTD
+// Trained dictionary used for disk blocks, frames remember dictionary id
+#define BLOCK_COMPRESSION_DICTIONARY_FILE "blocks.zstd_dict"
+
+void compressZstd(const u8 *data, size_t size, std::ostream &os, int level = 1, bool use_dictionary = false);
+void compressZstd(const std::string &data, std::ostream &os, int level = 1, bool use_dictionary = false);
+void decompressZstd(const std::string &data, std::ostream &os);
+bool setZstdDictionary(const std::string &dictionary);
+std::string trainZstdDictionary(const std::vector<std::string> &samples, size_t dictionary_size);
+#endif
+
 #endif
 
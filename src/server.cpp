@@ -72,7 +72,7 @@ along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
 #include <iomanip>
 #include "msgpack_fix.h"
 #include <chrono>
-#include "threading/thread_pool.h"
+#include "threading/task_scheduler.h"
 #include "key_value_storage.h"
 #include "database.h"
 
@@ -195,11 +195,8 @@ Server::Server(
 	m_craftdef(createCraftDefManager()),
 	m_event(new EventManager()),
 	m_thread(NULL),
-	m_map_thread(nullptr),
-	m_sendblocks(nullptr),
-	m_liquid(nullptr),
+	m_workers(nullptr),
 	m_envthread(nullptr),
-	m_abmthread(nullptr),
 	m_time_of_day_send_timer(0),
 	m_uptime(0),
 	m_clients(&m_con),
@@ -255,11 +252,8 @@ Server::Server(
 	m_emerge = new EmergeManager(this);
 
 	if (m_more_threads) {
-		m_map_thread = new MapThread(this);
-		m_sendblocks = new SendBlocksThread(this);
-		m_liquid = new LiquidThread(this);
+		m_workers = new task_scheduler("ServerWorker", 20);
 		m_envthread = new EnvThread(this);
-		m_abmthread = new AbmThread(this);
 	}
 
 	// Create world if it doesn't exist
@@ -382,6 +376,7 @@ Server::Server(
 	// Initialize Environment
 	m_env = new ServerEnvironment(servermap, m_script, this, m_path_world);
 	m_env->m_more_threads = m_more_threads;
+	m_env->m_workers = m_workers;
 	m_emerge->env = m_env;
 
 	m_clients.setEnv(m_env);
@@ -462,10 +457,7 @@ Server::~Server()
 	stop();
 	delete m_thread;
 
-	delete m_liquid;
-	delete m_sendblocks;
-	delete m_map_thread;
-	delete m_abmthread;
+	delete m_workers;
 	delete m_envthread;
 
 	// stop all emerge threads before deleting players that may have
@@ -513,16 +505,10 @@ void Server::start(Address bind_addr)
 
 	// Start thread
 	m_thread->restart();
-	if (m_map_thread)
-		m_map_thread->restart();
-	if (m_sendblocks)
-		m_sendblocks->restart();
-	if (m_liquid)
-		m_liquid->restart();
+	if (m_workers)
+		startWorkerTasks();
 	if(m_envthread)
 		m_envthread->restart();
-	if(m_abmthread)
-		m_abmthread->restart();
 
 	actionstream << "\033[1mfree\033[1;33mminer \033[1;36mv" << g_version_hash << "\033[0m \t"
 #if ENABLE_THREADS
@@ -564,28 +550,16 @@ void Server::stop()
 
 	// Stop threads (set run=false first so both start stopping)
 	m_thread->stop();
-	if (m_liquid)
-		m_liquid->stop();
-	if (m_sendblocks)
-		m_sendblocks->stop();
-	if (m_map_thread)
-		m_map_thread->stop();
-	if(m_abmthread)
-		m_abmthread->stop();
+	if (m_workers)
+		m_workers->stop();
 	if(m_envthread)
 		m_envthread->stop();
 
 	//m_emergethread.setRun(false);
 	m_thread->join();
 	//m_emergethread.stop();
-	if (m_liquid)
-		m_liquid->join();
-	if (m_sendblocks)
-		m_sendblocks->join();
-	if (m_map_thread)
-		m_map_thread->join();
-	if(m_abmthread)
-		m_abmthread->join();
+	if (m_workers)
+		m_workers->join();
 	if(m_envthread)
 		m_envthread->join();
 
@@ -827,7 +801,8 @@ void Server::AsyncRunStep(float dtime, bool initial_step)
 			m_env->getRemovedActiveObjects(player, radius_deactivate, player_radius,
 					client->m_known_objects, removed_objects);
 			m_env->getAddedActiveObjects(player, radius, player_radius,
-					client->m_known_objects, added_objects);
+					client->m_known_objects, client->m_object_interest,
+					added_objects);
 
 			// Ignore if nothing happened
 			if (removed_objects.empty() && added_objects.empty()) {
@@ -944,8 +919,11 @@ void Server::AsyncRunStep(float dtime, bool initial_step)
 				u8 type = obj->getSendType();
 
 				std::string data = obj->getClientInitializationData(client->net_proto_version);
-				if (!data.size())
+				if (!data.size()) {
+					// Not sent, look for it again on next step
+					client->m_object_interest.reset();
 					continue;
+				}
 
 				added_objects_data.push_back(ActiveObjectAddData(id, type, data));
 
@@ -961,7 +939,7 @@ void Server::AsyncRunStep(float dtime, bool initial_step)
 			PACK(TOCLIENT_ACTIVE_OBJECT_REMOVE_ADD_ADD, added_objects_data);
 
 			// Send as reliable
-			m_clients.send(client->peer_id, 0, buffer, true);
+			m_clients.send(client->peer_id, 0, std::move(buffer), true);
 #endif
 
 		}
@@ -976,26 +954,15 @@ void Server::AsyncRunStep(float dtime, bool initial_step)
 		ScopeProfiler sp(g_profiler, "Server: sending object messages");
 
 		// Key = object id
-		// Value = data sent by object
-		std::map<u16, std::vector<ActiveObjectMessage>* > buffered_messages;
+		// Value = data sent by object, encoded once for all clients
+		std::map<u16, ActiveObjectMessagesEncoded> buffered_messages;
 
 		// Get active object messages from environment
 		for(;;) {
 			ActiveObjectMessage aom = m_env->getActiveObjectMessage();
 			if (aom.id == 0)
 				break;
-
-			std::vector<ActiveObjectMessage>* message_list = NULL;
-			std::map<u16, std::vector<ActiveObjectMessage>* >::iterator n;
-			n = buffered_messages.find(aom.id);
-			if (n == buffered_messages.end()) {
-				message_list = new std::vector<ActiveObjectMessage>;
-				buffered_messages[aom.id] = message_list;
-			}
-			else {
-				message_list = n->second;
-			}
-			message_list->push_back(aom);
+			buffered_messages[aom.id].add(aom);
 		}
 
 		auto clients = m_clients.getClientList();
@@ -1006,34 +973,13 @@ void Server::AsyncRunStep(float dtime, bool initial_step)
 			std::string reliable_data;
 			std::string unreliable_data;
 			// Go through all objects in message buffer
-			for (std::map<u16, std::vector<ActiveObjectMessage>* >::iterator
-					j = buffered_messages.begin();
-					j != buffered_messages.end(); ++j) {
+			for (auto & j : buffered_messages) {
 				// If object is not known by client, skip it
-				u16 id = j->first;
+				u16 id = j.first;
 				if (client->m_known_objects.find(id) == client->m_known_objects.end())
 					continue;
-
-				// Get message list of object
-				std::vector<ActiveObjectMessage>* list = j->second;
-				// Go through every message
-				for (std::vector<ActiveObjectMessage>::iterator
-						k = list->begin(); k != list->end(); ++k) {
-					// Compose the full new data with header
-					ActiveObjectMessage aom = *k;
-					std::string new_data;
-					// Add object id
-					char buf[2];
-					writeU16((u8*)&buf[0], aom.id);
-					new_data.append(buf, 2);
-					// Add data
-					new_data += serializeString(aom.datastring);
-					// Add data to buffer
-					if(aom.reliable)
-						reliable_data += new_data;
-					else
-						unreliable_data += new_data;
-				}
+				reliable_data += j.second.reliable;
+				unreliable_data += j.second.unreliable;
 			}
 			/*
 				reliable_data and unreliable_data are now ready.
@@ -1048,46 +994,37 @@ void Server::AsyncRunStep(float dtime, bool initial_step)
 			}
 
 #else
-			ActiveObjectMessages reliable_data;
-			ActiveObjectMessages unreliable_data;
+			std::vector<const std::string *> reliable_data;
+			std::vector<const std::string *> unreliable_data;
+			u32 reliable_count = 0, unreliable_count = 0;
 			// Go through all objects in message buffer
-			for(auto
-					j = buffered_messages.begin();
-					j != buffered_messages.end(); ++j) {
+			for (auto & j : buffered_messages) {
 				// If object is not known by client, skip it
-				u16 id = j->first;
+				u16 id = j.first;
 				if (client->m_known_objects.find(id) == client->m_known_objects.end())
 					continue;
-				// Get message list of object
-				std::vector<ActiveObjectMessage>* list = j->second;
-				// Go through every message
-				for(auto
-						k = list->begin(); k != list->end(); ++k) {
-					// Add data to buffer
-					if(k->reliable)
-						reliable_data.push_back(make_pair(k->id, k->datastring));
-					else
-						unreliable_data.push_back(make_pair(k->id, k->datastring));
+				const auto & encoded = j.second;
+				if (encoded.reliable_count) {
+					reliable_data.push_back(&encoded.reliable);
+					reliable_count += encoded.reliable_count;
+				}
+				if (encoded.unreliable_count) {
+					unreliable_data.push_back(&encoded.unreliable);
+					unreliable_count += encoded.unreliable_count;
 				}
 			}
 			/*
 				reliable_data and unreliable_data are now ready.
 				Send them.
 			*/
-			if(reliable_data.size() > 0) {
-				SendActiveObjectMessages(client->peer_id, reliable_data);
+			if(reliable_count > 0) {
+				SendActiveObjectMessages(client->peer_id, reliable_data, reliable_count);
 			}
-			if(unreliable_data.size() > 0) {
-				SendActiveObjectMessages(client->peer_id, unreliable_data, false);
+			if(unreliable_count > 0) {
+				SendActiveObjectMessages(client->peer_id, unreliable_data, unreliable_count, false);
 			}
 #endif
 		}
-		// Clear buffered_messages
-		for (auto
-				i = buffered_messages.begin();
-				i != buffered_messages.end(); ++i) {
-			delete i->second;
-		}
 	}
 
 	/*
@@ -1102,10 +1039,8 @@ void Server::AsyncRunStep(float dtime, bool initial_step)
 		// Don't send too many at a time
 		u32 count = 0;
 
-		// Single change sending is disabled if queue size is not small
-		bool disable_single_change_sending = false;
-		if(m_unsent_map_edit_queue.size() > 1)
-			disable_single_change_sending = true;
+		// Node changes collected per block, sent after loop
+		unordered_map_v3POS<BlockNodesDelta> deltas;
 
 		//int event_count = m_unsent_map_edit_queue.size();
 
@@ -1121,30 +1056,25 @@ void Server::AsyncRunStep(float dtime, bool initial_step)
 		{
 			auto event = std::unique_ptr<MapEditEvent>(m_unsent_map_edit_queue.pop_front());
 
-			// Players far away from the change are stored here.
-			// Instead of sending the changes, MapBlocks are set not sent
-			// for them.
-			std::vector<u16> far_players;
-
-			if(event->type == MEET_ADDNODE || event->type == MEET_SWAPNODE) {
-				//infostream<<"Server: MEET_ADDNODE"<<std::endl;
-				prof.add("MEET_ADDNODE", 1);
-				if(disable_single_change_sending)
-					sendAddNode(event->p, event->n, event->already_known_by_peer,
-							&far_players, 5, event->type == MEET_ADDNODE);
-				else
-					sendAddNode(event->p, event->n, event->already_known_by_peer,
-							&far_players, 30, event->type == MEET_ADDNODE);
-			}
-			else if(event->type == MEET_REMOVENODE) {
-				//infostream<<"Server: MEET_REMOVENODE"<<std::endl;
-				prof.add("MEET_REMOVENODE", 1);
-				if(disable_single_change_sending)
-					sendRemoveNode(event->p, event->already_known_by_peer,
-							&far_players, 5);
-				else
-					sendRemoveNode(event->p, event->already_known_by_peer,
-							&far_players, 30);
+			if(event->type == MEET_ADDNODE || event->type == MEET_SWAPNODE
+					|| event->type == MEET_REMOVENODE) {
+				u8 action = NODE_DELTA_ADD;
+				if (event->type == MEET_ADDNODE) {
+					prof.add("MEET_ADDNODE", 1);
+				} else if (event->type == MEET_SWAPNODE) {
+					prof.add("MEET_SWAPNODE", 1);
+					action = NODE_DELTA_SWAP;
+				} else {
+					prof.add("MEET_REMOVENODE", 1);
+					action = NODE_DELTA_REMOVE;
+				}
+				v3POS blockpos = getNodeBlockPos(event->p);
+				v3POS rel = event->p - blockpos * MAP_BLOCKSIZE;
+				u16 index = rel.Z * MAP_BLOCKSIZE * MAP_BLOCKSIZE + rel.Y * MAP_BLOCKSIZE + rel.X;
+				auto &delta = deltas[blockpos];
+				delta.nodes.emplace_back(index, event->n.param0, event->n.param1, event->n.param2, action);
+				delta.known_by_peer.push_back(event->already_known_by_peer);
+				delta.changed.emplace_back(event->block_changed_before, event->block_changed_after);
 			}
 			else if(event->type == MEET_BLOCK_NODE_METADATA_CHANGED) {
 /*
@@ -1158,15 +1088,14 @@ void Server::AsyncRunStep(float dtime, bool initial_step)
 				infostream<<"Server: MEET_OTHER"<<std::endl;
 */
 				prof.add("MEET_OTHER", 1);
-/*
-				for(std::set<v3s16>::iterator
-						i = event->modified_blocks.begin();
-						i != event->modified_blocks.end(); ++i)
-				{
-					setBlockNotSent(*i);
+				if (event->modified_blocks.empty()) {
+					SetBlocksNotSent();
+				} else {
+					std::map<v3s16, MapBlock *> modified_blocks;
+					for (const auto &p : event->modified_blocks)
+						modified_blocks[p] = nullptr;
+					SetBlocksNotSent(modified_blocks);
 				}
-*/
-				SetBlocksNotSent();
 			}
 			else {
 				prof.add("unknown", 1);
@@ -1175,32 +1104,6 @@ void Server::AsyncRunStep(float dtime, bool initial_step)
 				//break;
 			}
 
-			/*
-				Set blocks not sent to far players
-			*/
-			if (!far_players.empty()) {
-				// Convert list format to that wanted by SetBlocksNotSent
-/*
-				std::map<v3s16, MapBlock*> modified_blocks2;
-				for(std::set<v3s16>::iterator
-						i = event->modified_blocks.begin();
-						i != event->modified_blocks.end(); ++i) {
-					modified_blocks2[*i] =
-							m_env->getMap().getBlockNoCreateNoEx(*i);
-				}
-*/
-				// Set blocks not sent
-				for (auto
-						i = far_players.begin();
-						i != far_players.end(); ++i) {
-					u16 peer_id = *i;
-					RemoteClient *client = getClient(peer_id);
-					if(client==NULL)
-						continue;
-					client->SetBlocksNotSent(/*modified_blocks2*/);
-				}
-			}
-
 			//delete event;
 
 			++count;
@@ -1211,6 +1114,9 @@ void Server::AsyncRunStep(float dtime, bool initial_step)
 				break;
 		}
 
+		for (const auto & delta : deltas)
+			sendNodesDelta(delta.first, delta.second, 30);
+
 /*
 		if(event_count >= 10){
 			infostream<<"Server: MapEditEvents count="<<count<<"/"<<event_count<<" :"<<std::endl;
@@ -1662,7 +1568,10 @@ void Server::setInventoryModified(const InventoryLocation &loc, bool playerSend)
 
 void Server::SetBlocksNotSent(std::map<v3s16, MapBlock *>& block)
 {
-	SetBlocksNotSent();
+	std::vector<u16> clients = m_clients.getClientIDs();
+	for (auto i = clients.begin(); i != clients.end(); ++i)
+		if (RemoteClient *client = m_clients.lockedGetClientNoEx(*i))
+			client->SetBlocksNotSent(block);
 }
 
 void Server::SetBlocksNotSent()
@@ -2267,6 +2176,20 @@ u32 Server::SendActiveObjectRemoveAdd(u16 peer_id, const std::string &datas)
 	return pkt.getSize();
 }
 
+#if MINETEST_PROTO
+void ActiveObjectMessagesEncoded::add(const ActiveObjectMessage &aom)
+{
+	std::string &data = aom.reliable ? reliable : unreliable;
+	// Add object id
+	char buf[2];
+	writeU16((u8*)&buf[0], aom.id);
+	data.append(buf, 2);
+	// Add data
+	data += serializeString(aom.datastring);
+	++(aom.reliable ? reliable_count : unreliable_count);
+}
+#endif
+
 void Server::SendActiveObjectMessages(u16 peer_id, const std::string &datas, bool reliable)
 {
 	NetworkPacket pkt(TOCLIENT_ACTIVE_OBJECT_MESSAGES,
@@ -2442,6 +2365,45 @@ void Server::sendAddNode(v3s16 p, MapNode n, u16 ignore_id,
 	}
 }
 
+void Server::sendNodesDelta(v3POS blockpos, const BlockNodesDelta &delta, float far_d_nodes)
+{
+	static const u16 max_nodes = g_settings->getU16("block_delta_max_nodes");
+	const auto &nodes = delta.nodes;
+	const auto &known_by_peer = delta.known_by_peer;
+
+	// No delta packet in minetest protocol: per node packets to near players
+	std::vector<u16> far_players;
+	if (nodes.size() > max_nodes) {
+		far_players = m_clients.getClientIDs();
+	} else {
+		for (size_t i = 0; i < nodes.size(); ++i) {
+			const auto & node = nodes[i];
+			v3POS p = blockpos * MAP_BLOCKSIZE + v3POS(
+					node.index % MAP_BLOCKSIZE,
+					node.index / MAP_BLOCKSIZE % MAP_BLOCKSIZE,
+					node.index / (MAP_BLOCKSIZE * MAP_BLOCKSIZE));
+			if (node.action == NODE_DELTA_REMOVE)
+				sendRemoveNode(p, known_by_peer[i], &far_players, far_d_nodes);
+			else
+				sendAddNode(p, MapNode(node.param0, node.param1, node.param2),
+						known_by_peer[i], &far_players, far_d_nodes,
+						node.action == NODE_DELTA_ADD);
+		}
+	}
+
+	std::sort(far_players.begin(), far_players.end());
+	far_players.erase(std::unique(far_players.begin(), far_players.end()), far_players.end());
+	for (auto peer_id : m_clients.getClientIDs()) {
+		RemoteClient *client = getClientNoEx(peer_id);
+		if (!client)
+			continue;
+		if (std::binary_search(far_players.begin(), far_players.end(), peer_id))
+			client->SetBlockNotSent(blockpos);
+		else
+			client->SentBlockDelta(blockpos, delta.changed);
+	}
+}
+
 #endif
 
 void Server::SendChatMessage(u16 peer_id, const std::wstring &message) {
@@ -2547,16 +2509,18 @@ int Server::SendBlocks(float dtime)
 		if(!client)
 			continue;
 
+		u32 changed;
 		{
 		auto lock = block->try_lock_shared_rec();
 		if (!lock->owns_lock())
 			continue;
 
+		changed = block->m_changed_counter;
 		// maybe sometimes blocks will not load (must wait 1+ minute), but reduce network load: q.priority<=4
 		SendBlockNoLock(q.peer_id, block, client->serialization_version, client->net_proto_version);
 		}
 
-		client->SentBlock(q.pos, m_uptime.get() + m_env->m_game_time_start);
+		client->SentBlock(q.pos, m_uptime.get() + m_env->m_game_time_start, changed);
 		++total;
 	}
 	return total;
@@ -64,11 +64,8 @@ struct SimpleSoundSpec;
 class Circuit;
 class Stat;
 class ServerThread;
-class MapThread;
-class SendBlocksThread;
-class LiquidThread;
+class task_scheduler;
 class EnvThread;
-class AbmThread;
 
 enum ClientDeletionReason {
 	CDR_LEAVE,
@@ -172,6 +169,25 @@ struct ServerPlayingSound
 	std::set<u16> clients; // peer ids
 };
 
+/*
+	Messages of one active object from one server step, encoded once and
+	appended as is to packets of every client that knows the object
+*/
+struct ActiveObjectMessagesEncoded
+{
+	ActiveObjectMessagesEncoded():
+		reliable_count(0),
+		unreliable_count(0)
+	{}
+
+	void add(const ActiveObjectMessage &aom);
+
+	std::string reliable;
+	std::string unreliable;
+	u32 reliable_count;
+	u32 unreliable_count;
+};
+
 class Server : public con::PeerHandler, public MapEventReceiver,
 		public InventoryManager, public IGameDef
 {
@@ -460,6 +476,21 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 	void sendAddNode(v3s16 p, MapNode n, u16 ignore_id=0,
 			std::vector<u16> *far_players=NULL, float far_d_nodes=100,
 			bool remove_metadata=true);
+	// Node changes of one block collected from map edit events
+	struct BlockNodesDelta {
+		std::vector<NodeDelta> nodes;
+		// Peer which already has nodes[i], 0 for none
+		std::vector<u16> known_by_peer;
+		// Block change counter before and after nodes[i]
+		std::vector<std::pair<u32, u32>> changed;
+	};
+	/*
+		Send all changes of one block in one packet to near players,
+		block stays sent for them if no other change was made meanwhile.
+		Far players and blocks with more than block_delta_max_nodes
+		changes get full block later.
+	*/
+	void sendNodesDelta(v3POS blockpos, const BlockNodesDelta &delta, float far_d_nodes);
 	void setBlockNotSent(v3s16 p);
 
 	// Environment and Connection must be locked when called
@@ -498,7 +529,9 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 	u32 SendActiveObjectRemoveAdd(u16 peer_id, const std::string &datas);
 //mt compat:
 	void SendActiveObjectMessages(u16 peer_id, const std::string &datas, bool reliable = true);
-	void SendActiveObjectMessages(u16 peer_id, const ActiveObjectMessages &datas, bool reliable = true);
+	// datas are encoded messages, count is total count of messages in them
+	void SendActiveObjectMessages(u16 peer_id, const std::vector<const std::string *> &datas,
+			u32 count, bool reliable = true);
 
 	/*
 		Something random
@@ -631,11 +664,10 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 	// The server mainly operates in this thread
 	ServerThread *m_thread;
 
-	MapThread *m_map_thread;
-	SendBlocksThread *m_sendblocks;
-	LiquidThread *m_liquid;
+	// Map, send blocks and liquid steps with more_threads
+	task_scheduler *m_workers;
+	void startWorkerTasks();
 	EnvThread *m_envthread;
-	AbmThread *m_abmthread;
 
 	/*
 		Time related stuff
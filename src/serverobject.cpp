@@ -46,6 +46,16 @@ ServerActiveObject::~ServerActiveObject()
 {
 }
 
+void ServerActiveObject::setBasePosition(v3f pos)
+{
+	std::lock_guard<Mutex> lock(m_base_position_mutex);
+	// Under lock to keep grid updates in same order as positions
+	if (m_env && getId() &&
+			ActiveObjectGrid::getCell(m_base_position) != ActiveObjectGrid::getCell(pos))
+		m_env->m_objects_grid.move(getId(), pos);
+	m_base_position = pos;
+}
+
 ServerActiveObject* ServerActiveObject::create(ActiveObjectType type,
 		ServerEnvironment *env, u16 id, v3f pos,
 		const std::string &data)
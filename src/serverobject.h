@@ -87,10 +87,8 @@ class ServerActiveObject : public ActiveObject
 		std::lock_guard<Mutex> lock(m_base_position_mutex);
 		return m_base_position;
 	}
-	void setBasePosition(v3f pos) {
-		std::lock_guard<Mutex> lock(m_base_position_mutex);
-		m_base_position = pos;
-	}
+	// Also updates environment objects grid when block changes
+	void setBasePosition(v3f pos);
 	ServerEnvironment* getEnv(){ return m_env; }
 	
 	/*
@@ -0,0 +1,388 @@
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef THREADING_CONCURENT_SHARDED_MAP_HEADER
+#define THREADING_CONCURENT_SHARDED_MAP_HEADER
+
+#include <unordered_map>
+#include <array>
+#include <algorithm>
+#include <vector>
+#include <iterator>
+#include <utility>
+
+#include "lock.h"
+#include "concurrent_unordered_map.h"
+
+/*
+	Hash map split to SHARDS stripes, every stripe have own shared mutex.
+	Single key operations lock only one stripe: lookups (get_value, count)
+	shared, changes exclusive. size() and empty() are lock free.
+	lock_*_rec() lock all stripes (in order) for iteration, single key
+	operations from same thread inside it are recursive, like
+	concurrent_unordered_map (and same as there, changes from thread which
+	holds lock_shared_rec() are not safe).
+	Unlocked lookups return copies (get_value), references returned by get()
+	and iterators are valid only under lock_*_rec().
+*/
+
+template < class Key, class T, class Hash = std::hash<Key>, class Pred = std::equal_to<Key>,
+           size_t SHARDS = 32 >
+class concurrent_sharded_map_ {
+public:
+	typedef std::unordered_map<Key, T, Hash, Pred>                     full_type;
+	typedef Key                                                        key_type;
+	typedef T                                                          mapped_type;
+	typedef std::pair<const key_type, mapped_type>                     value_type;
+	typedef size_t                                                     size_type;
+
+private:
+	struct shard {
+		try_shared_mutex mtx;
+		// Thread which locked stripe exclusive
+		std::atomic<std::size_t> thread_id;
+		full_type map;
+		char pad[64]; // no false sharing of neighbour mutexes
+		shard() { thread_id = 0; }
+	};
+
+	static std::size_t thread_me() {
+		return std::hash<std::thread::id>()(std::this_thread::get_id());
+	}
+
+	// Maps with all stripes locked shared by this thread
+	static std::vector<const concurrent_sharded_map_ *> & shared_by_me() {
+		static thread_local std::vector<const concurrent_sharded_map_ *> maps;
+		return maps;
+	}
+	bool locked_shared_by_me() const {
+		const auto & maps = shared_by_me();
+		return std::find(maps.begin(), maps.end(), this) != maps.end();
+	}
+
+	// Recursive lock of one stripe without allocation
+	class shard_lock {
+	public:
+		shard_lock(concurrent_sharded_map_ &m, shard &s_, bool shared, bool try_lock = false) :
+			s(s_), owned(true), exclusive(false) {
+			auto me = thread_me();
+			if (s.thread_id == me || m.locked_shared_by_me())
+				return;
+			if (shared) {
+				shared_guard = try_lock ? try_shared_lock(s.mtx, try_to_lock) : try_shared_lock(s.mtx);
+				owned = shared_guard.owns_lock();
+				return;
+			}
+			unique_guard = try_lock ? unique_lock(s.mtx, try_to_lock) : unique_lock(s.mtx);
+			owned = unique_guard.owns_lock();
+			if (owned) {
+				s.thread_id = me;
+				exclusive = true;
+			}
+		}
+		~shard_lock() {
+			// Before guard unlocks mutex
+			if (exclusive)
+				s.thread_id = 0;
+		}
+		bool owns_lock() { return owned; }
+	private:
+		shard &s;
+		bool owned, exclusive;
+		try_shared_lock shared_guard;
+		unique_lock unique_guard;
+	};
+
+public:
+	// Lock of all stripes, returned by lock_*_rec()
+	class all_lock {
+	public:
+		all_lock(concurrent_sharded_map_ &m_, bool shared_, bool try_lock) :
+			m(m_), owned(true), shared(shared_ && !m_.locked_shared_by_me()) {
+			locked.fill(false);
+			// Already locked by this thread
+			if (m.locked_shared_by_me())
+				return;
+			auto me = thread_me();
+			for (size_t i = 0; i < SHARDS; ++i) {
+				auto & s = m.m_shards[i];
+				if (s.thread_id == me)
+					continue;
+				if (shared) {
+					shared_guards[i] = try_lock ? try_shared_lock(s.mtx, try_to_lock) : try_shared_lock(s.mtx);
+					if (!shared_guards[i].owns_lock()) {
+						unlock();
+						owned = false;
+						return;
+					}
+				} else {
+					unique_guards[i] = try_lock ? unique_lock(s.mtx, try_to_lock) : unique_lock(s.mtx);
+					if (!unique_guards[i].owns_lock()) {
+						unlock();
+						owned = false;
+						return;
+					}
+					s.thread_id = me;
+				}
+				locked[i] = true;
+			}
+			if (shared)
+				shared_by_me().push_back(&m);
+		}
+		~all_lock() { unlock(); }
+		bool owns_lock() { return owned; }
+		void unlock() {
+			if (shared) {
+				auto & maps = shared_by_me();
+				auto i = std::find(maps.begin(), maps.end(), &m);
+				if (i != maps.end())
+					maps.erase(i);
+			}
+			for (size_t i = SHARDS; i-- > 0;) {
+				if (!locked[i])
+					continue;
+				if (shared) {
+					shared_guards[i].unlock();
+				} else {
+					m.m_shards[i].thread_id = 0;
+					unique_guards[i].unlock();
+				}
+				locked[i] = false;
+			}
+		}
+	private:
+		concurrent_sharded_map_ &m;
+		std::array<bool, SHARDS> locked;
+		std::array<try_shared_lock, SHARDS> shared_guards;
+		std::array<unique_lock, SHARDS> unique_guards;
+		bool owned, shared;
+	};
+
+	class iterator {
+	public:
+		typedef std::forward_iterator_tag iterator_category;
+		typedef typename full_type::value_type value_type;
+		typedef std::ptrdiff_t difference_type;
+		typedef value_type* pointer;
+		typedef value_type& reference;
+
+		iterator() : m(nullptr), index(SHARDS) {}
+		iterator(concurrent_sharded_map_ *m_, size_t index_, typename full_type::iterator it_) :
+			m(m_), index(index_), it(it_) {}
+
+		reference operator*() const { return *it; }
+		pointer operator->() const { return &*it; }
+		iterator& operator++() {
+			++it;
+			skip_empty();
+			return *this;
+		}
+		iterator operator++(int) {
+			iterator old = *this;
+			++*this;
+			return old;
+		}
+		bool operator==(const iterator &other) const {
+			return index == other.index && (index >= SHARDS || it == other.it);
+		}
+		bool operator!=(const iterator &other) const { return !(*this == other); }
+
+	private:
+		friend class concurrent_sharded_map_;
+		void skip_empty() {
+			while (index < SHARDS && it == m->m_shards[index].map.end()) {
+				if (++index < SHARDS)
+					it = m->m_shards[index].map.begin();
+			}
+		}
+
+		concurrent_sharded_map_ *m;
+		size_t index;
+		typename full_type::iterator it;
+	};
+	typedef iterator const_iterator;
+
+	concurrent_sharded_map_() { m_size = 0; }
+
+	// Inserted if missing, reference is valid only under lock_unique_rec()
+	mapped_type& get(const key_type& k) {
+		auto & s = get_shard(k);
+		shard_lock lock(*this, s, false);
+		auto i = s.map.find(k);
+		if (i != s.map.end())
+			return i->second;
+		++m_size;
+		return s.map[k];
+	}
+
+	void set(const key_type& k, const mapped_type& v) {
+		auto & s = get_shard(k);
+		shard_lock lock(*this, s, false);
+		auto r = s.map.insert(value_type(k, v));
+		if (r.second)
+			++m_size;
+		else
+			r.first->second = v;
+	}
+
+	bool set_try(const key_type& k, const mapped_type& v) {
+		auto & s = get_shard(k);
+		shard_lock lock(*this, s, false, true);
+		if (!lock.owns_lock())
+			return false;
+		auto r = s.map.insert(value_type(k, v));
+		if (r.second)
+			++m_size;
+		else
+			r.first->second = v;
+		return true;
+	}
+
+	// Copy of value: false if not found or if try_lock and stripe locked by other thread
+	bool get_value(const key_type& k, mapped_type& v, bool try_lock = false) {
+		auto & s = get_shard(k);
+		shard_lock lock(*this, s, true, try_lock);
+		if (!lock.owns_lock())
+			return false;
+		auto i = s.map.find(k);
+		if (i == s.map.end())
+			return false;
+		v = i->second;
+		return true;
+	}
+
+	// Atomic read-modify-write of one value (inserted if missing), returns func result
+	template <class Func>
+	auto update(const key_type& k, Func func) -> decltype(func(std::declval<mapped_type&>())) {
+		auto & s = get_shard(k);
+		shard_lock lock(*this, s, false);
+		auto r = s.map.insert(value_type(k, mapped_type()));
+		if (r.second)
+			++m_size;
+		return func(r.first->second);
+	}
+
+	bool empty() const { return !m_size; }
+
+	size_type size() const { return m_size; }
+
+	size_type count(const key_type& k) {
+		auto & s = get_shard(k);
+		shard_lock lock(*this, s, true);
+		return s.map.count(k);
+	}
+
+	iterator begin() {
+		iterator i(this, 0, m_shards[0].map.begin());
+		i.skip_empty();
+		return i;
+	}
+
+	iterator end() {
+		return iterator(this, SHARDS, typename full_type::iterator());
+	}
+
+	size_type erase(const key_type& k) {
+		auto & s = get_shard(k);
+		shard_lock lock(*this, s, false);
+		auto n = s.map.erase(k);
+		m_size -= n;
+		return n;
+	}
+
+	iterator erase(iterator position) {
+		auto & s = m_shards[position.index];
+		shard_lock lock(*this, s, false);
+		iterator next(this, position.index, s.map.erase(position.it));
+		--m_size;
+		next.skip_empty();
+		return next;
+	}
+
+	void clear() {
+		all_lock lock(*this, false, false);
+		for (auto & s : m_shards)
+			s.map.clear();
+		m_size = 0;
+	}
+
+	std::unique_ptr<all_lock> lock_unique_rec() {
+		return std::unique_ptr<all_lock>(new all_lock(*this, false, false));
+	}
+	std::unique_ptr<all_lock> try_lock_unique_rec() {
+		return std::unique_ptr<all_lock>(new all_lock(*this, false, true));
+	}
+	std::unique_ptr<all_lock> lock_shared_rec() {
+		return std::unique_ptr<all_lock>(new all_lock(*this, true, false));
+	}
+	std::unique_ptr<all_lock> try_lock_shared_rec() {
+		return std::unique_ptr<all_lock>(new all_lock(*this, true, true));
+	}
+
+private:
+	size_t get_index(const key_type& k) const {
+		size_t h = m_hash(k);
+		// Spread weak hashes (like v3POSHash) over stripes
+		h ^= (h >> 7) ^ (h >> 17);
+		return h % SHARDS;
+	}
+	shard & get_shard(const key_type& k) {
+		return m_shards[get_index(k)];
+	}
+
+	std::array<shard, SHARDS> m_shards;
+	std::atomic<size_type> m_size;
+	Hash m_hash;
+};
+
+template <class Key, class T, class Hash = std::hash<Key>, class Pred = std::equal_to<Key>>
+using concurrent_sharded_map = concurrent_sharded_map_<Key, T, Hash, Pred>;
+
+#if ENABLE_THREADS
+
+template <class Key, class T, class Hash = std::hash<Key>, class Pred = std::equal_to<Key>>
+using maybe_concurrent_sharded_map = concurrent_sharded_map<Key, T, Hash, Pred>;
+
+#else
+
+template <class Key, class T, class Hash = std::hash<Key>, class Pred = std::equal_to<Key>>
+class not_concurrent_sharded_map: public not_concurrent_unordered_map<Key, T, Hash, Pred> {
+public:
+	typedef typename std::unordered_map<Key, T, Hash, Pred>            full_type;
+	typedef Key                                                        key_type;
+	typedef T                                                          mapped_type;
+
+	bool get_value(const key_type& k, mapped_type& v, bool try_lock = false) {
+		auto i = full_type::find(k);
+		if (i == full_type::end())
+			return false;
+		v = i->second;
+		return true;
+	}
+
+	template <class Func>
+	auto update(const key_type& k, Func func) -> decltype(func(std::declval<mapped_type&>())) {
+		return func(full_type::operator[](k));
+	}
+};
+
+template <class Key, class T, class Hash = std::hash<Key>, class Pred = std::equal_to<Key>>
+using maybe_concurrent_sharded_map = not_concurrent_sharded_map<Key, T, Hash, Pred>;
+
+#endif
+
+#endif
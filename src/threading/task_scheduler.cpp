@@ -0,0 +1,285 @@
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "task_scheduler.h"
+#include "debug.h"
+#include "log.h"
+#include "porting.h"
+
+task_scheduler::task_scheduler(const std::string &name, int priority) :
+	thread_pool(name, priority) {
+	m_worker_next = 0;
+	m_size = 0;
+}
+
+task_scheduler::~task_scheduler() {
+	join();
+}
+
+void task_scheduler::start(int n) {
+	if (n <= 0)
+		n = std::thread::hardware_concurrency();
+	if (n <= 0)
+		n = 1;
+	m_queues.clear();
+	for (int i = 0; i < n; ++i)
+		m_queues.emplace_back(new worker_queue);
+	{
+		std::lock_guard<std::mutex> lock(m_worker_index_mutex);
+		m_worker_index.clear();
+	}
+	m_worker_next = 0;
+	thread_pool::start(n);
+}
+
+void task_scheduler::restart(int n) {
+	join();
+	start(n);
+}
+
+void task_scheduler::stop() {
+	thread_pool::stop();
+	std::lock_guard<std::mutex> lock(m_wait_mutex);
+	m_wait.notify_all();
+}
+
+void task_scheduler::join() {
+	stop();
+	thread_pool::join();
+	// Not started tasks are dropped
+	for (auto & queue : m_queues)
+		queue->tasks.clear();
+	m_shared.tasks.clear();
+	{
+		std::lock_guard<std::mutex> lock(m_timers_mutex);
+		m_timers = std::priority_queue<timer_task>();
+	}
+	m_size = 0;
+}
+
+int task_scheduler::get_worker_index() {
+	std::lock_guard<std::mutex> lock(m_worker_index_mutex);
+	auto i = m_worker_index.find(std::this_thread::get_id());
+	if (i == m_worker_index.end())
+		return -1;
+	return i->second;
+}
+
+void task_scheduler::submit(const task_type &task) {
+	auto index = get_worker_index();
+	auto & queue = index >= 0 ? *m_queues[index] : m_shared;
+	// Counted before push, so pop() never makes it below zero
+	++m_size;
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.tasks.emplace_back(task);
+	}
+	std::lock_guard<std::mutex> lock(m_wait_mutex);
+	m_wait.notify_one();
+}
+
+void task_scheduler::submit_after(unsigned int ms, const task_type &task) {
+	{
+		std::lock_guard<std::mutex> lock(m_timers_mutex);
+		m_timers.push({porting::getTimeMs() + ms, task});
+	}
+	// Wake one worker to recalculate wait time
+	std::lock_guard<std::mutex> lock(m_wait_mutex);
+	m_wait.notify_one();
+}
+
+void task_scheduler::repeat(const repeat_type &func) {
+	auto shared_func = std::make_shared<repeat_type>(func);
+	++m_size;
+	{
+		std::lock_guard<std::mutex> lock(m_shared.mutex);
+		m_shared.tasks.emplace_back([this, shared_func]() { repeat_run(shared_func); });
+	}
+	std::lock_guard<std::mutex> lock(m_wait_mutex);
+	m_wait.notify_one();
+}
+
+void task_scheduler::repeat_run(const std::shared_ptr<repeat_type> &func) {
+	if (stopRequested())
+		return;
+	int delay = 0;
+#if !EXEPTION_DEBUG
+	try {
+#endif
+		delay = (*func)();
+#if !EXEPTION_DEBUG
+	} catch (std::exception &e) {
+		// Keep repeating after errors, like dedicated thread loops do
+		errorstream << m_name << ": exception: " << e.what() << std::endl;
+		delay = 100;
+	} catch (...) {
+		errorstream << m_name << ": Ooops..." << std::endl;
+		delay = 100;
+	}
+#endif
+	if (delay < 0 || stopRequested())
+		return;
+	task_type task = [this, func]() { repeat_run(func); };
+	if (delay) {
+		submit_after(delay, task);
+		return;
+	}
+	// Backlog: to the end of shared queue, not to own deque, to not starve other tasks
+	++m_size;
+	{
+		std::lock_guard<std::mutex> lock(m_shared.mutex);
+		m_shared.tasks.emplace_back(task);
+	}
+	std::lock_guard<std::mutex> lock(m_wait_mutex);
+	m_wait.notify_one();
+}
+
+void task_scheduler::run_all(std::vector<task_type> &tasks, unsigned int threads) {
+	struct batch {
+		std::vector<task_type> tasks;
+		std::atomic_uint next;
+		std::atomic_uint done;
+		std::mutex mutex;
+		std::condition_variable finished;
+	};
+	auto state = std::make_shared<batch>();
+	state->tasks.swap(tasks);
+	state->next = 0;
+	state->done = 0;
+	const unsigned int count = state->tasks.size();
+	if (!count)
+		return;
+
+	auto process = [this, state, count]() {
+		for (unsigned int i = state->next++; i < count; i = state->next++) {
+			run_task(state->tasks[i]);
+			if (++state->done == count) {
+				std::lock_guard<std::mutex> lock(state->mutex);
+				state->finished.notify_all();
+			}
+		}
+	};
+
+	if (!threads || threads > m_queues.size() + 1)
+		threads = m_queues.size() + 1;
+	unsigned int helpers = std::min<unsigned int>(count, threads) - 1;
+	for (unsigned int i = 0; i < helpers; ++i)
+		submit(process);
+
+	process();
+
+	std::unique_lock<std::mutex> lock(state->mutex);
+	while (state->done < count)
+		state->finished.wait(lock);
+}
+
+size_t task_scheduler::size() {
+	return m_size;
+}
+
+bool task_scheduler::pop(int index, task_type &task) {
+	if (!m_size)
+		return false;
+	{
+		auto & queue = *m_queues[index];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (!queue.tasks.empty()) {
+			task = queue.tasks.back();
+			queue.tasks.pop_back();
+			--m_size;
+			return true;
+		}
+	}
+	{
+		std::lock_guard<std::mutex> lock(m_shared.mutex);
+		if (!m_shared.tasks.empty()) {
+			task = m_shared.tasks.front();
+			m_shared.tasks.pop_front();
+			--m_size;
+			return true;
+		}
+	}
+	for (size_t i = 1; i < m_queues.size(); ++i) {
+		auto & queue = *m_queues[(index + i) % m_queues.size()];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (!queue.tasks.empty()) {
+			task = queue.tasks.front();
+			queue.tasks.pop_front();
+			--m_size;
+			return true;
+		}
+	}
+	return false;
+}
+
+// Move due timers to shared queue, returns ms to next timer
+unsigned int task_scheduler::timers_run() {
+	unsigned int wait = 1000;
+	std::lock_guard<std::mutex> lock(m_timers_mutex);
+	auto now = porting::getTimeMs();
+	while (!m_timers.empty()) {
+		auto & top = m_timers.top();
+		if (top.time > now) {
+			if (top.time - now < wait)
+				wait = top.time - now;
+			break;
+		}
+		++m_size;
+		{
+			std::lock_guard<std::mutex> lock_shared(m_shared.mutex);
+			m_shared.tasks.emplace_back(top.task);
+		}
+		m_timers.pop();
+	}
+	return wait;
+}
+
+void task_scheduler::run_task(const task_type &task) {
+#if !EXEPTION_DEBUG
+	try {
+#endif
+		task();
+#if !EXEPTION_DEBUG
+	} catch (std::exception &e) {
+		errorstream << m_name << ": exception: " << e.what() << std::endl;
+	} catch (...) {
+		errorstream << m_name << ": Ooops..." << std::endl;
+	}
+#endif
+}
+
+void * task_scheduler::run() {
+	int index = m_worker_next++;
+	{
+		std::lock_guard<std::mutex> lock(m_worker_index_mutex);
+		m_worker_index[std::this_thread::get_id()] = index;
+	}
+
+	while (!stopRequested()) {
+		auto wait = timers_run();
+		task_type task;
+		if (pop(index, task)) {
+			run_task(task);
+			continue;
+		}
+		std::unique_lock<std::mutex> lock(m_wait_mutex);
+		if (m_size || stopRequested())
+			continue;
+		m_wait.wait_for(lock, std::chrono::milliseconds(wait));
+	}
+	return nullptr;
+}
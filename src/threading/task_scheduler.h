@@ -0,0 +1,101 @@
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef THREADING_TASK_SCHEDULER_HEADER
+#define THREADING_TASK_SCHEDULER_HEADER
+
+#include <deque>
+#include <queue>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
+#include <memory>
+
+#include "thread_pool.h"
+
+/*
+	Work-stealing task scheduler.
+
+	Every worker have own deque: tasks submitted from worker go to its back
+	and are taken LIFO by owner, idle workers steal from front of other deques.
+	Tasks from other threads and repeating tasks go to shared FIFO queue.
+	Tasks must be short (bounded by max_cycle_ms or similar), long tasks only
+	occupy one worker, other workers continue with queued tasks.
+*/
+
+class task_scheduler : public thread_pool {
+public:
+	typedef std::function<void()> task_type;
+	// Returns ms to wait before next run: 0 - run again asap (backlog), <0 - stop repeating
+	typedef std::function<int()> repeat_type;
+
+	task_scheduler(const std::string &name = "Tasks", int priority = 0);
+	~task_scheduler();
+
+	// n = 0 : one worker per core
+	void start(int n = 0);
+	void restart(int n = 0);
+	void stop();
+	void join();
+
+	void submit(const task_type &task);
+	void submit_after(unsigned int ms, const task_type &task);
+	void repeat(const repeat_type &func);
+
+	// Run all tasks and wait until all done, calling thread helps too
+	// threads: max threads used including calling, 0 - all workers
+	void run_all(std::vector<task_type> &tasks, unsigned int threads = 0);
+
+	size_t size();
+	size_t workers_count() { return m_queues.size(); }
+
+	void * run();
+
+private:
+	struct worker_queue {
+		std::mutex mutex;
+		std::deque<task_type> tasks;
+	};
+	struct timer_task {
+		unsigned int time;
+		task_type task;
+		bool operator<(const timer_task &other) const { return time > other.time; }
+	};
+
+	int get_worker_index();
+	bool pop(int index, task_type &task);
+	void run_task(const task_type &task);
+	void repeat_run(const std::shared_ptr<repeat_type> &func);
+	unsigned int timers_run();
+
+	std::vector<std::unique_ptr<worker_queue>> m_queues;
+	std::unordered_map<std::thread::id, int> m_worker_index;
+	std::mutex m_worker_index_mutex;
+	std::atomic_int m_worker_next;
+
+	worker_queue m_shared;
+
+	std::mutex m_timers_mutex;
+	std::priority_queue<timer_task> m_timers;
+
+	std::mutex m_wait_mutex;
+	std::condition_variable m_wait;
+	std::atomic_uint m_size;
+};
+
+#endif
@@ -0,0 +1,200 @@
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "test.h"
+
+#include "fm_block_send_queue.h"
+#include "constants.h"
+
+class TestBlockSendQueue : public TestBase {
+public:
+	TestBlockSendQueue() { TestManager::registerTestModule(this); }
+	const char *getName() { return "TestBlockSendQueue"; }
+
+	void runTests(IGameDef *gamedef);
+
+	void testScore();
+	void testQueue();
+	void testMove();
+};
+
+static TestBlockSendQueue g_test_instance;
+
+void TestBlockSendQueue::runTests(IGameDef *gamedef)
+{
+	TEST(testScore);
+	TEST(testQueue);
+	TEST(testMove);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Player in center of block 0,0,0 looking to +Z
+static BlockSendQueue::View make_view(s16 range)
+{
+	BlockSendQueue::View view;
+	view.center = v3POS(0, 0, 0);
+	view.range = range;
+	view.camera_pos = v3f(0.5, 0.5, 0.5) * MAP_BLOCKSIZE * BS;
+	view.camera_dir = v3f(0, 0, 1);
+	view.camera_fov = (72 + 5) * 3.14159f / 180 * 4 / 3;
+	return view;
+}
+
+void TestBlockSendQueue::testScore()
+{
+	BlockSendQueue::View view = make_view(10);
+
+	// Ahead first, then side, blocks behind only when near
+	float ahead = BlockSendQueue::score(view, v3POS(0, 0, 5));
+	float side = BlockSendQueue::score(view, v3POS(2, 0, 5));
+	UASSERT(ahead < side);
+	UASSERT(side < BLOCK_SEND_OUT_OF_SIGHT);
+	UASSERT(BlockSendQueue::score(view, v3POS(0, 0, -5)) >= BLOCK_SEND_OUT_OF_SIGHT);
+	UASSERT(BlockSendQueue::score(view, v3POS(0, 0, -1)) <= BLOCK_SEND_NEAR_SCORE);
+
+	// Blocks on predicted path are near even behind camera
+	view.motion = v3f(0, 0, -6) * MAP_BLOCKSIZE * BS;
+	UASSERT(BlockSendQueue::score(view, v3POS(0, 0, -5)) <= BLOCK_SEND_NEAR_SCORE);
+	view.motion = v3f(0, 0, 0);
+
+	// Ground between underground player and blocks above
+	float above = BlockSendQueue::score(view, v3POS(0, 4, 5));
+	view.ground = -1;
+	UASSERT(BlockSendQueue::score(view, v3POS(0, 4, 5)) > above);
+	UASSERT(BlockSendQueue::score(view, v3POS(0, -4, 5)) == BlockSendQueue::score(make_view(10), v3POS(0, -4, 5)));
+}
+
+void TestBlockSendQueue::testQueue()
+{
+	BlockSendQueue queue;
+	queue.setView(make_view(2));
+	UASSERTEQ(size_t, queue.size(), 5 * 5 * 5);
+	UASSERT(queue.scoring());
+	UASSERT(!queue.queued());
+
+	// Scored nearest first, whole distance at once
+	UASSERTEQ(u32, queue.scoreNext(1), 1);
+	UASSERTEQ(u32, queue.scoreNext(1), 3 * 3 * 3 - 1);
+	UASSERTEQ(u32, queue.scoreNext(1000), 5 * 5 * 5 - 3 * 3 * 3);
+	UASSERT(!queue.scoring());
+	UASSERT(queue.queued() > 0);
+	UASSERT(queue.queued() < queue.size());
+
+	// Lowest score first, popped candidates stay until done
+	size_t queued = queue.queued();
+	BlockSendQueue::Candidate c;
+	float last = -1;
+	size_t popped = 0;
+	while (queue.pop(c)) {
+		UASSERT(c.score >= last);
+		UASSERT(c.score < BLOCK_SEND_OUT_OF_SIGHT);
+		last = c.score;
+		++popped;
+	}
+	UASSERTEQ(size_t, popped, queued);
+	UASSERTEQ(size_t, queue.size(), 5 * 5 * 5);
+
+	queue.rescore();
+	queue.scoreNext(1);
+	UASSERT(queue.pop(c));
+	UASSERT(c.pos == v3POS(0, 0, 0));
+	queue.done(c.pos);
+	UASSERTEQ(size_t, queue.size(), 5 * 5 * 5 - 1);
+
+	// Deferred candidate is back on requeue, done one is not
+	queue.scoreNext(1000);
+	UASSERT(queue.pop(c));
+	v3POS deferred = c.pos;
+	queue.defer(deferred);
+	queue.defer(v3POS(0, 0, 0));
+	while (queue.pop(c))
+		;
+	queue.requeue();
+	UASSERT(queue.pop(c));
+	UASSERT(c.pos == deferred);
+	UASSERT(!queue.pop(c));
+
+	// Out of range or done blocks are not queued
+	queue.add(v3POS(0, 0, 3));
+	UASSERT(!queue.pop(c));
+	queue.add(v3POS(0, 0, 0));
+	UASSERT(queue.pop(c));
+	UASSERT(c.pos == v3POS(0, 0, 0));
+	UASSERTEQ(size_t, queue.size(), 5 * 5 * 5);
+
+	// Added again while queued is popped once
+	queue.add(v3POS(0, 0, 1));
+	queue.add(v3POS(0, 0, 1));
+	UASSERT(queue.pop(c));
+	UASSERT(c.pos == v3POS(0, 0, 1));
+	UASSERT(!queue.pop(c));
+}
+
+void TestBlockSendQueue::testMove()
+{
+	BlockSendQueue queue;
+	BlockSendQueue::View view = make_view(2);
+	UASSERT(!queue.setView(view));
+	queue.scoreNext(1000);
+	queue.done(v3POS(0, 0, 2));
+
+	// Small turn keeps scores, big one needs rescore
+	view.camera_dir = v3f(0.1, 0, 1);
+	view.camera_dir.normalize();
+	UASSERT(!queue.setView(view));
+	view.camera_dir = v3f(1, 0, 0);
+	UASSERT(queue.setView(view));
+	queue.rescore();
+
+	// Queued ones are scored again when popped, without scoreNext()
+	BlockSendQueue::Candidate c;
+	UASSERT(queue.pop(c));
+	UASSERTEQ(float, c.score, BlockSendQueue::score(view, c.pos));
+	queue.defer(c.pos);
+	queue.requeue();
+	queue.scoreNext(1000);
+
+	// Only blocks entering and leaving range, done ones in range stay done
+	view.center = v3POS(1, 0, 0);
+	view.camera_pos += v3f(MAP_BLOCKSIZE * BS, 0, 0);
+	UASSERT(queue.setView(view));
+	UASSERTEQ(size_t, queue.size(), 5 * 5 * 5 - 1);
+	queue.rescore();
+	queue.scoreNext(1000);
+
+	while (queue.pop(c)) {
+		UASSERT(c.pos.X >= -1 && c.pos.X <= 3);
+		UASSERT(!(c.pos == v3POS(0, 0, 2)));
+	}
+
+	// Range change drops or adds only the edge
+	view.range = 1;
+	UASSERT(!queue.setView(view));
+	UASSERTEQ(size_t, queue.size(), 3 * 3 * 3);
+	view.range = 2;
+	UASSERT(!queue.setView(view));
+	UASSERTEQ(size_t, queue.size(), 5 * 5 * 5);
+	UASSERT(queue.pop(c));
+	UASSERTEQ(s16, BlockSendQueue::distance(view, c.pos), 2);
+
+	// Teleport replaces all candidates
+	view.center = v3POS(100, 0, 0);
+	view.camera_pos = v3f(100.5, 0.5, 0.5) * MAP_BLOCKSIZE * BS;
+	queue.setView(view);
+	UASSERTEQ(size_t, queue.size(), 5 * 5 * 5);
+}
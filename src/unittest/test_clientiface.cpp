@@ -0,0 +1,79 @@
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "test.h"
+
+#include "clientiface.h"
+#include "map.h"
+#include "mapblock.h"
+
+class TestClientIface : public TestBase {
+public:
+	TestClientIface() { TestManager::registerTestModule(this); }
+	const char *getName() { return "TestClientIface"; }
+
+	void runTests(IGameDef *gamedef);
+
+	void testBlockSentDelta(IGameDef *gamedef);
+};
+
+static TestClientIface g_test_instance;
+
+void TestClientIface::runTests(IGameDef *gamedef)
+{
+	TEST(testBlockSentDelta, gamedef);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void TestClientIface::testBlockSentDelta(IGameDef *gamedef)
+{
+	Map map(gamedef);
+	v3s16 blockpos(0, 0, 0);
+	MapBlock *block = map.createBlankBlock(blockpos);
+	RemoteClient client(nullptr);
+	MapNode stone(t_CONTENT_STONE);
+
+	UASSERT(!client.isBlockSent(blockpos, block->m_changed_counter));
+	client.SentBlock(blockpos, 1, block->m_changed_counter);
+	UASSERT(client.isBlockSent(blockpos, block->m_changed_counter));
+
+	// Node changes sent as delta do not queue full block
+	for (s16 x = 0; x < 3; ++x) {
+		u32 before = block->m_changed_counter;
+		block->setNodeNoCheck(v3s16(x, 2, 3), stone);
+		UASSERT(!client.isBlockSent(blockpos, block->m_changed_counter));
+		client.SentBlockDelta(blockpos, {{before, block->m_changed_counter}});
+		UASSERT(client.isBlockSent(blockpos, block->m_changed_counter));
+	}
+
+	// Change without delta before delta: full block is needed
+	block->setNodeNoCheck(v3s16(1, 1, 1), stone);
+	u32 before = block->m_changed_counter;
+	block->setNodeNoCheck(v3s16(1, 1, 2), stone);
+	client.SentBlockDelta(blockpos, {{before, block->m_changed_counter}});
+	UASSERT(!client.isBlockSent(blockpos, block->m_changed_counter));
+
+	// Block changed without node events (metadata, VoxelManip) stays not
+	// sent after deltas
+	client.SentBlock(blockpos, 2, block->m_changed_counter);
+	client.SetBlockNotSent(blockpos);
+	before = block->m_changed_counter;
+	block->setNodeNoCheck(v3s16(1, 1, 3), stone);
+	client.SentBlockDelta(blockpos, {{before, block->m_changed_counter}});
+	UASSERT(!client.isBlockSent(blockpos, block->m_changed_counter));
+}
@@ -20,6 +20,10 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "test.h"
 
 #include "collision.h"
+#include "gamedef.h"
+#include "map.h"
+#include "mapblock.h"
+#include "voxel.h"
 
 class TestCollision : public TestBase {
 public:
@@ -29,6 +33,8 @@ class TestCollision : public TestBase {
 	void runTests(IGameDef *gamedef);
 
 	void testAxisAlignedCollision();
+	void testObjectBoxSnapshot();
+	void testBlockCollisionBoxes(IGameDef *gamedef);
 };
 
 static TestCollision g_test_instance;
@@ -36,6 +42,8 @@ static TestCollision g_test_instance;
 void TestCollision::runTests(IGameDef *gamedef)
 {
 	TEST(testAxisAlignedCollision);
+	TEST(testObjectBoxSnapshot);
+	TEST(testBlockCollisionBoxes, gamedef);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -178,3 +186,65 @@ void TestCollision::testAxisAlignedCollision()
 		}
 	}
 }
+
+void TestCollision::testObjectBoxSnapshot()
+{
+	// Only addresses of objects are used, to skip self
+	char objects[200];
+	std::vector<aabb3f> all;
+	ObjectBoxSnapshot snapshot;
+	for (int i = 0; i < 200; i++) {
+		f32 x = (i * 37 % 101) - 50, y = (i * 13 % 7), z = (i * 53 % 97) - 48;
+		f32 size = 0.2 + (i % 5) * 0.7;
+		aabb3f box(x, y, z, x + size, y + size * 2, z + size);
+		all.push_back(box);
+		snapshot.add((const ActiveObject *)&objects[i], box);
+	}
+	snapshot.finish();
+	UASSERTEQ(size_t, snapshot.size(), 200);
+
+	for (int j = 0; j < 50; j++) {
+		f32 x = (j * 29 % 103) - 51, z = (j * 31 % 89) - 44;
+		aabb3f area(x, 0, z, x + 1 + j % 4, 3, z + 2);
+		const ActiveObject *self = (const ActiveObject *)&objects[j];
+
+		std::vector<aabb3f> found;
+		snapshot.getInsideArea(area, self, found);
+
+		size_t expected = 0;
+		for (int i = 0; i < 200; i++)
+			if (i != j && all[i].intersectsWithBox(area))
+				expected++;
+		UASSERTEQ(size_t, found.size(), expected);
+		for (size_t i = 0; i < found.size(); i++)
+			UASSERT(found[i].intersectsWithBox(area));
+	}
+}
+
+void TestCollision::testBlockCollisionBoxes(IGameDef *gamedef)
+{
+	INodeDefManager *nodedef = gamedef->getNodeDefManager();
+	Map map(gamedef);
+	MapBlock block(&map, v3s16(0, 0, 0), gamedef);
+	const v3s16 size(MAP_BLOCKSIZE, MAP_BLOCKSIZE, MAP_BLOCKSIZE);
+	VoxelManipulator v;
+	v.addArea(VoxelArea(v3s16(0, 0, 0), size - v3s16(1, 1, 1)));
+	v.fill(MapNode(CONTENT_AIR), v3s16(0, 0, 0), size);
+	block.copyFrom(v);
+
+	auto boxes = getBlockCollisionBoxes(nodedef, &block);
+	UASSERT(boxes);
+	UASSERT(getBlockCollisionBoxes(nodedef, &block) == boxes);
+	UASSERT(boxes->node_shape[0] == BlockCollisionBoxes::SHAPE_NONE);
+
+	// VoxelManip write back and node change in the same second both rebuild
+	v.setNode(v3s16(0, 0, 0), MapNode(t_CONTENT_STONE));
+	block.copyFrom(v);
+	boxes = getBlockCollisionBoxes(nodedef, &block);
+	UASSERT(boxes->node_shape[0] != BlockCollisionBoxes::SHAPE_NONE);
+
+	MapNode air(CONTENT_AIR);
+	block.setNodeNoCheck(v3s16(0, 0, 0), air);
+	boxes = getBlockCollisionBoxes(nodedef, &block);
+	UASSERT(boxes->node_shape[0] == BlockCollisionBoxes::SHAPE_NONE);
+}
@@ -26,6 +26,9 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "serialization.h"
 #include "nodedef.h"
 #include "noise.h"
+#include "porting.h"
+#include "util/serialize.h"
+#include "constants.h"
 
 class TestCompression : public TestBase {
 public:
@@ -37,6 +40,8 @@ class TestCompression : public TestBase {
 	void testRLECompression();
 	void testZlibCompression();
 	void testZlibLargeData();
+	void testBlockCompression();
+	void testCompressionBenchmark();
 };
 
 static TestCompression g_test_instance;
@@ -46,6 +51,8 @@ void TestCompression::runTests(IGameDef *gamedef)
 	TEST(testRLECompression);
 	TEST(testZlibCompression);
 	TEST(testZlibLargeData);
+	TEST(testBlockCompression);
+	TEST(testCompressionBenchmark);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -170,3 +177,102 @@ void TestCompression::testZlibLargeData()
 				i, str_decompressed[i], i, data_in[i]);
 	}
 }
+
+// Bulk node data like in mapblock: layers of stone, dirt, air with some ores and light
+static std::string make_block_like_data(u32 seed)
+{
+	const u32 nodecount = MAP_BLOCKSIZE * MAP_BLOCKSIZE * MAP_BLOCKSIZE;
+	std::string data(nodecount * 4, 0);
+	PseudoRandom pr(seed);
+	for (u32 i = 0; i < nodecount; i++) {
+		u32 y = (i / MAP_BLOCKSIZE) % MAP_BLOCKSIZE;
+		u16 content = y < 6 ? 10 : y < 9 ? 11 : 126;
+		if (content == 10 && pr.range(0, 40) == 0)
+			content = 20 + pr.range(0, 3);
+		data[i * 2] = content >> 8;
+		data[i * 2 + 1] = content & 0xff;
+		data[nodecount * 2 + i] = content == 126 ? 0xff : 0;
+		data[nodecount * 3 + i] = y == 9 && pr.range(0, 10) == 0 ? pr.range(0, 3) : 0;
+	}
+	return data;
+}
+
+void TestCompression::testBlockCompression()
+{
+	std::string data_in = make_block_like_data(42);
+
+	std::vector<std::string> compressors;
+	compressors.push_back("zlib");
+#if USE_ZSTD
+	compressors.push_back("zstd");
+#endif
+	for (const auto &compressor : compressors) {
+		setBlockCompression(compressor);
+		for (u8 version : {(u8)SER_FMT_VER_HIGHEST_WRITE, (u8)SER_FMT_VER_COMPRESSOR}) {
+			std::ostringstream os(std::ios_base::binary);
+			compressBlockData(data_in, os, version);
+			// Followed by other data, must stay in stream
+			writeU8(os, 0xAB);
+
+			std::istringstream is(os.str(), std::ios_base::binary);
+			if (version >= SER_FMT_VER_COMPRESSOR) {
+				u8 id = os.str()[0];
+				UASSERT(id == (compressor == "zlib" ? BLOCK_COMPRESSOR_ZLIB : BLOCK_COMPRESSOR_ZSTD));
+			}
+			std::ostringstream os_out(std::ios_base::binary);
+			decompressBlockData(is, os_out, version);
+			UASSERT(os_out.str() == data_in);
+			UASSERT(readU8(is) == 0xAB);
+		}
+	}
+
+	// Old versions are always zlib, whatever is configured
+	std::ostringstream os_old(std::ios_base::binary);
+	compressBlockData(data_in, os_old, SER_FMT_VER_HIGHEST_WRITE);
+	std::istringstream is_old(os_old.str(), std::ios_base::binary);
+	std::ostringstream os_zlib(std::ios_base::binary);
+	decompressZlib(is_old, os_zlib);
+	UASSERT(os_zlib.str() == data_in);
+
+	setBlockCompression("zlib");
+	UASSERTEQ(int, getBlockDiskVersion(), SER_FMT_VER_HIGHEST_WRITE);
+}
+
+void TestCompression::testCompressionBenchmark()
+{
+	std::vector<std::string> blocks;
+	for (u32 i = 0; i < 200; i++)
+		blocks.push_back(make_block_like_data(i));
+
+	// Both codecs are timed for compress and decompress of every block
+	size_t zlib_size = 0;
+	u32 start = porting::getTimeMs();
+	for (const auto &block : blocks) {
+		std::ostringstream os(std::ios_base::binary);
+		compressZlib(block, os, 2);
+		std::istringstream is(os.str(), std::ios_base::binary);
+		std::ostringstream os_out(std::ios_base::binary);
+		decompressZlib(is, os_out);
+		UASSERT(os_out.str() == block);
+		zlib_size += os.str().size();
+	}
+	u32 zlib_ms = porting::getTimeMs() - start;
+	infostream << "Block compression and decompression " << blocks.size()
+		<< " blocks: zlib=" << zlib_size << " bytes " << zlib_ms << "ms";
+
+#if USE_ZSTD
+	size_t zstd_size = 0;
+	start = porting::getTimeMs();
+	for (const auto &block : blocks) {
+		std::ostringstream os(std::ios_base::binary);
+		compressZstd(block, os, 1);
+		std::ostringstream os_out(std::ios_base::binary);
+		decompressZstd(os.str(), os_out);
+		UASSERT(os_out.str() == block);
+		zstd_size += os.str().size();
+	}
+	u32 zstd_ms = porting::getTimeMs() - start;
+	infostream << " zstd=" << zstd_size << " bytes " << zstd_ms << "ms";
+#endif
+	infostream << std::endl;
+}
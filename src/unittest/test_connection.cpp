@@ -23,6 +23,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "socket.h"
 #include "settings.h"
 #include "util/serialize.h"
+#include "util/numeric.h"
 #include "network/connection.h"
 
 #include "config.h"
@@ -41,6 +42,8 @@ class TestConnection : public TestBase {
 
 	void testHelpers();
 	void testConnectSendReceive();
+	void testSendBenchmark();
+	void testShardedSend();
 };
 
 static TestConnection g_test_instance;
@@ -50,6 +53,9 @@ void TestConnection::runTests(IGameDef *gamedef)
 #if MINETEST_PROTO
 	TEST(testHelpers);
 	TEST(testConnectSendReceive);
+#else
+	TEST(testSendBenchmark);
+	TEST(testShardedSend);
 #endif
 }
 
@@ -353,4 +359,165 @@ void TestConnection::testConnectSendReceive()
 	UASSERT(hand_server.last_id == 2);
 }
 
+#else
+
+////////////////////////////////////////////////////////////////////////////////
+
+struct PeerCounter : public con::PeerHandler
+{
+	void peerAdded(u16 peer_id) { ids.push_back(peer_id); }
+	void deletingPeer(u16 peer_id, bool timeout) {}
+
+	std::vector<u16> ids;
+};
+
+// Processes connection events for time_ms
+static void pump_events(con::Connection &con, u32 time_ms)
+{
+	u32 start = porting::getTimeMs();
+	while (porting::getTimeMs() - start < time_ms) {
+		NetworkPacket pkt;
+		con.Receive(&pkt, 5);
+	}
+}
+
+// Sends count packets to every peer, returns ms until all were received
+static u32 send_receive(con::Connection &server, const std::vector<u16> &peers,
+		std::vector<con::Connection *> clients, bool zero_copy, u32 count, u32 size)
+{
+	std::string payload(size, 'x');
+	u32 start = porting::getTimeMs();
+	for (u32 i = 0; i < count; ++i) {
+		msgpack::sbuffer buffer;
+		msgpack::packer<msgpack::sbuffer> pk(&buffer);
+		pk.pack(std::make_pair(i, payload));
+		if (zero_copy) {
+			server.Send(peers, 0, std::move(buffer), true);
+			UASSERT(buffer.size() == 0);
+		} else {
+			for (auto peer_id : peers)
+				server.Send(peer_id, 0, buffer, true);
+		}
+	}
+
+	std::vector<u32> received(clients.size());
+	u32 received_all = 0;
+	while (received_all < count * clients.size() &&
+			porting::getTimeMs() - start < 5000) {
+		for (size_t c = 0; c < clients.size(); ++c) {
+			NetworkPacket pkt;
+			u32 got = clients[c]->Receive(&pkt, 1);
+			if (!got)
+				continue;
+			msgpack::unpacked msg;
+			msgpack::unpack(msg, (const char *)pkt.getU8Ptr(0), pkt.getSize());
+			std::pair<u32, std::string> data;
+			msg.get().convert(data);
+			// Reliable channel keeps order
+			UASSERTEQ(u32, data.first, received[c]);
+			UASSERT(data.second == payload);
+			++received[c];
+			++received_all;
+		}
+	}
+	UASSERTEQ(u32, received_all, count * clients.size());
+	return porting::getTimeMs() - start;
+}
+
+void TestConnection::testSendBenchmark()
+{
+	u32 proto_id = 0xad26846a;
+	// Not fixed, other tests or a running server may use it
+	u16 port = myrand_range(40000, 50000);
+
+	PeerCounter hand_server, hand_client1, hand_client2;
+	con::Connection server(proto_id, 512, 5.0, false, &hand_server);
+	server.Serve(Address(0, 0, 0, 0, port));
+	sleep_ms(50);
+
+	con::Connection client1(proto_id, 512, 5.0, false, &hand_client1);
+	con::Connection client2(proto_id, 512, 5.0, false, &hand_client2);
+	client1.Connect(Address(127, 0, 0, 1, port));
+	client2.Connect(Address(127, 0, 0, 1, port));
+
+	u32 start = porting::getTimeMs();
+	while (hand_server.ids.size() < 2 && porting::getTimeMs() - start < 5000)
+		pump_events(server, 10);
+	pump_events(client1, 10);
+	pump_events(client2, 10);
+	UASSERTEQ(size_t, hand_server.ids.size(), 2);
+
+	std::vector<con::Connection *> clients = {&client1, &client2};
+	const u32 count = 200, size = 1000;
+	u32 copy_ms = send_receive(server, hand_server.ids, clients, false, count, size);
+	u32 zero_copy_ms = send_receive(server, hand_server.ids, clients, true, count, size);
+
+	infostream << "Connection send " << count << " packets of " << size
+		<< " bytes to " << clients.size() << " peers: copy=" << copy_ms
+		<< "ms shared zero copy=" << zero_copy_ms << "ms" << std::endl;
+}
+
+// Restores setting changed by test
+struct SettingRestore
+{
+	SettingRestore(const std::string &a_name, const std::string &value) :
+		name(a_name), old_value(g_settings->get(a_name))
+	{
+		g_settings->set(name, value);
+	}
+	~SettingRestore() { g_settings->set(name, old_value); }
+
+	std::string name, old_value;
+};
+
+void TestConnection::testShardedSend()
+{
+	u32 proto_id = 0xad26846a;
+	u16 port = myrand_range(40000, 50000);
+
+	// Peers are spread by kernel over hosts of all threads, every peer
+	// must be served only by thread of its own host
+	SettingRestore threads("enet_threads", "4");
+	PeerCounter hand_server;
+	con::Connection server(proto_id, 512, 5.0, false, &hand_server);
+	server.Serve(Address(0, 0, 0, 0, port));
+	sleep_ms(50);
+
+	const size_t clients_count = 8;
+	std::vector<std::unique_ptr<PeerCounter>> handlers;
+	std::vector<std::unique_ptr<con::Connection>> connections;
+	std::vector<con::Connection *> clients;
+	for (size_t i = 0; i < clients_count; ++i) {
+		handlers.emplace_back(new PeerCounter);
+		connections.emplace_back(new con::Connection(proto_id, 512, 5.0, false,
+				handlers.back().get()));
+		connections.back()->Connect(Address(127, 0, 0, 1, port));
+		clients.push_back(connections.back().get());
+	}
+
+	u32 start = porting::getTimeMs();
+	while (hand_server.ids.size() < clients_count && porting::getTimeMs() - start < 5000)
+		pump_events(server, 10);
+	for (auto client : clients)
+		pump_events(*client, 10);
+	UASSERTEQ(size_t, hand_server.ids.size(), clients_count);
+
+	// Per peer and shared packets, each one only to own peer
+	send_receive(server, hand_server.ids, clients, false, 20, 100);
+	send_receive(server, hand_server.ids, clients, true, 20, 100);
+
+	msgpack::sbuffer buffer;
+	msgpack::packer<msgpack::sbuffer> pk(&buffer);
+	pk.pack(std::make_pair(u32(0), std::string(100, 'x')));
+	server.SendToAll(0, std::move(buffer), true);
+	for (auto client : clients) {
+		NetworkPacket pkt;
+		u32 got = 0;
+		start = porting::getTimeMs();
+		while (!got && porting::getTimeMs() - start < 5000)
+			got = client->Receive(&pkt, 10);
+		UASSERT(got > 0);
+	}
+}
+
 #endif
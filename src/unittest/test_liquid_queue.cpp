@@ -0,0 +1,116 @@
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "test.h"
+
+#include "fm_liquid_queue.h"
+
+class TestLiquidQueue : public TestBase {
+public:
+	TestLiquidQueue() { TestManager::registerTestModule(this); }
+	const char *getName() { return "TestLiquidQueue"; }
+
+	void runTests(IGameDef *gamedef);
+
+	void testRegions();
+	void testPop();
+};
+
+static TestLiquidQueue g_test_instance;
+
+void TestLiquidQueue::runTests(IGameDef *gamedef)
+{
+	TEST(testRegions);
+	TEST(testPop);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void TestLiquidQueue::testRegions()
+{
+	const s16 size = 1 << LiquidRegionQueue::REGION_BITS;
+	UASSERT(size == MAP_BLOCKSIZE * 2);
+	UASSERT(LiquidRegionQueue::getRegion(v3POS(0, 0, 0)) == v3POS(0, 0, 0));
+	UASSERT(LiquidRegionQueue::getRegion(v3POS(size - 1, 0, 0)) == v3POS(0, 0, 0));
+	UASSERT(LiquidRegionQueue::getRegion(v3POS(size, 0, 0)) == v3POS(1, 0, 0));
+	UASSERT(LiquidRegionQueue::getRegion(v3POS(-1, -size, -size - 1)) == v3POS(-1, -1, -2));
+
+	// Neighbour regions never have same color
+	v3POS r(-3, 5, 0);
+	u8 color = LiquidRegionQueue::getColor(r);
+	UASSERT(color < LiquidRegionQueue::COLORS);
+	for (s16 x = -1; x <= 1; ++x)
+	for (s16 y = -1; y <= 1; ++y)
+	for (s16 z = -1; z <= 1; ++z) {
+		if (!x && !y && !z)
+			continue;
+		UASSERT(LiquidRegionQueue::getColor(r + v3POS(x, y, z)) != color);
+	}
+}
+
+void TestLiquidQueue::testPop()
+{
+	LiquidRegionQueue queue;
+	const s16 size = 1 << LiquidRegionQueue::REGION_BITS;
+
+	UASSERT(queue.push_back(v3POS(1, 1, 1)));
+	UASSERT(!queue.push_back(v3POS(1, 1, 1)));
+	UASSERT(queue.push_back(v3POS(2, 1, 1)));
+	UASSERT(queue.push_back(v3POS(size, 1, 1)));
+	UASSERTEQ(u32, queue.size(), 3);
+	UASSERTEQ(size_t, queue.regionsCount(), 2);
+
+	std::vector<std::pair<LiquidRegionQueue::RegionP, u32>> regions;
+	queue.getRegions(regions);
+	UASSERTEQ(size_t, regions.size(), 2);
+
+	LiquidRegionQueue::RegionP first;
+	for (const auto & region : regions) {
+		if (region.first->pos == v3POS(0, 0, 0)) {
+			UASSERTEQ(u32, region.second, 2);
+			first = region.first;
+		} else {
+			UASSERTEQ(u32, region.second, 1);
+		}
+	}
+	UASSERT(first);
+
+	// Pop from one region keeps order of pushes
+	v3POS p;
+	UASSERT(queue.pop_front(*first, p));
+	UASSERT(p == v3POS(1, 1, 1));
+	UASSERT(queue.pop_front(*first, p));
+	UASSERT(p == v3POS(2, 1, 1));
+	UASSERT(!queue.pop_front(*first, p));
+	UASSERTEQ(u32, queue.size(), 1);
+
+	// Empty regions are dropped
+	regions.clear();
+	queue.getRegions(regions);
+	UASSERTEQ(size_t, regions.size(), 1);
+	UASSERTEQ(size_t, queue.regionsCount(), 1);
+
+	// Node handed over from other region is queued again
+	UASSERT(queue.push_back(v3POS(1, 1, 1)));
+	UASSERTEQ(size_t, queue.regionsCount(), 2);
+
+	UASSERT(queue.pop_front(p));
+	UASSERT(queue.pop_front(p));
+	UASSERT(!queue.pop_front(p));
+	UASSERTEQ(u32, queue.size(), 0);
+	UASSERTEQ(size_t, queue.regionsCount(), 0);
+}
@@ -0,0 +1,163 @@
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "test.h"
+
+#include <sstream>
+#include "map.h"
+#include "mapblock.h"
+#include "serialization.h"
+#include "voxel.h"
+
+class TestMapBlock : public TestBase {
+public:
+	TestMapBlock() { TestManager::registerTestModule(this); }
+	const char *getName() { return "TestMapBlock"; }
+
+	void runTests(IGameDef *gamedef);
+
+	void testSerializeCache(IGameDef *gamedef);
+	void testContentOnlyAnalyze(IGameDef *gamedef);
+	void testContentOnlyWrite(IGameDef *gamedef);
+	void testContentOnlySerialize(IGameDef *gamedef);
+};
+
+static TestMapBlock g_test_instance;
+
+void TestMapBlock::runTests(IGameDef *gamedef)
+{
+	TEST(testSerializeCache, gamedef);
+	TEST(testContentOnlyAnalyze, gamedef);
+	TEST(testContentOnlyWrite, gamedef);
+	TEST(testContentOnlySerialize, gamedef);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static const v3s16 block_size(MAP_BLOCKSIZE, MAP_BLOCKSIZE, MAP_BLOCKSIZE);
+
+// VoxelManipulator with area of block 0,0,0 filled with n
+static void fill_vmanip(VoxelManipulator &v, const MapNode &n)
+{
+	v.addArea(VoxelArea(v3s16(0, 0, 0), block_size - v3s16(1, 1, 1)));
+	v.fill(n, v3s16(0, 0, 0), block_size);
+}
+
+void TestMapBlock::testSerializeCache(IGameDef *gamedef)
+{
+	Map map(gamedef);
+	MapBlock block(&map, v3s16(0, 0, 0), gamedef);
+	VoxelManipulator v;
+	fill_vmanip(v, MapNode(t_CONTENT_STONE));
+	block.copyFrom(v);
+
+	auto first = block.serializeNetworkCached(SER_FMT_VER_HIGHEST_WRITE, false);
+	UASSERT(block.serializeNetworkCached(SER_FMT_VER_HIGHEST_WRITE, false) == first);
+
+	// VoxelManip write back (Lua write_to_map, mapgen) in the same second
+	v.setNode(v3s16(1, 2, 3), MapNode(t_CONTENT_BRICK));
+	block.copyFrom(v);
+	auto second = block.serializeNetworkCached(SER_FMT_VER_HIGHEST_WRITE, false);
+	UASSERT(second != first);
+	UASSERT(*second != *first);
+	UASSERT(block.serializeNetworkCached(SER_FMT_VER_HIGHEST_WRITE, false) == second);
+}
+
+void TestMapBlock::testContentOnlyAnalyze(IGameDef *gamedef)
+{
+	Map map(gamedef);
+	MapBlock block(&map, v3s16(0, 0, 0), gamedef);
+	VoxelManipulator v;
+	fill_vmanip(v, MapNode(t_CONTENT_STONE));
+
+	// Uniform block keeps one node instead of data[]
+	block.copyFrom(v);
+	UASSERT(!block.isDataAllocated());
+	UASSERTEQ(content_t, block.content_only, t_CONTENT_STONE);
+	UASSERT(block.isValid());
+	UASSERTEQ(content_t, block.getNodeNoEx(v3s16(5, 6, 7)).getContent(), t_CONTENT_STONE);
+
+	// Not uniform
+	v.setNode(v3s16(1, 2, 3), MapNode(t_CONTENT_BRICK));
+	block.copyFrom(v);
+	UASSERT(block.isDataAllocated());
+	UASSERTEQ(content_t, block.content_only, CONTENT_IGNORE);
+	UASSERTEQ(content_t, block.analyzeContent(), CONTENT_IGNORE);
+	UASSERT(block.isDataAllocated());
+}
+
+void TestMapBlock::testContentOnlyWrite(IGameDef *gamedef)
+{
+	Map map(gamedef);
+	MapBlock block(&map, v3s16(0, 0, 0), gamedef);
+	block.fill(MapNode(t_CONTENT_STONE));
+	UASSERT(!block.isDataAllocated());
+
+	// Same node: nothing to expand
+	MapNode stone(t_CONTENT_STONE);
+	block.setNode(v3s16(1, 2, 3), stone);
+	UASSERT(!block.isDataAllocated());
+	UASSERTEQ(content_t, block.content_only, t_CONTENT_STONE);
+
+	// Other node: data[] allocated with old node everywhere else
+	MapNode brick(t_CONTENT_BRICK);
+	block.setNode(v3s16(1, 2, 3), brick);
+	UASSERT(block.isDataAllocated());
+	UASSERTEQ(content_t, block.content_only, CONTENT_IGNORE);
+	UASSERTEQ(content_t, block.getNodeNoEx(v3s16(1, 2, 3)).getContent(), t_CONTENT_BRICK);
+	UASSERTEQ(content_t, block.getNodeNoEx(v3s16(0, 0, 0)).getContent(), t_CONTENT_STONE);
+	UASSERTEQ(content_t, block.getNodeNoEx(v3s16(15, 15, 15)).getContent(), t_CONTENT_STONE);
+
+	// Uniform again
+	block.setNode(v3s16(1, 2, 3), stone);
+	UASSERTEQ(content_t, block.analyzeContent(), t_CONTENT_STONE);
+	UASSERT(!block.isDataAllocated());
+}
+
+void TestMapBlock::testContentOnlySerialize(IGameDef *gamedef)
+{
+	Map map(gamedef);
+	MapBlock block(&map, v3s16(0, 0, 0), gamedef);
+	block.fill(MapNode(t_CONTENT_STONE, 0, 3));
+	// Not generated blocks are serialized without nodes
+	block.setGenerated(true);
+
+	// Disk format always has data[]
+	std::ostringstream os_disk(std::ios_base::binary);
+	block.serialize(os_disk, SER_FMT_VER_HIGHEST_WRITE, true);
+	std::istringstream is_disk(os_disk.str(), std::ios_base::binary);
+	MapBlock block_disk(&map, v3s16(0, 0, 0), gamedef);
+	block_disk.deSerialize(is_disk, SER_FMT_VER_HIGHEST_WRITE, true);
+	UASSERT(!block_disk.isDataAllocated());
+	UASSERTEQ(content_t, block_disk.content_only, t_CONTENT_STONE);
+	UASSERTEQ(u8, block_disk.content_only_param2, 3);
+
+	// Network format without data[], node is sent separately
+	std::ostringstream os_net(std::ios_base::binary);
+	block.serialize(os_net, SER_FMT_VER_HIGHEST_WRITE, false, true);
+	UASSERT(os_net.str().size() < os_disk.str().size());
+	std::istringstream is_net(os_net.str(), std::ios_base::binary);
+	MapBlock block_net(&map, v3s16(0, 0, 0), gamedef);
+	block_net.content_only = block.content_only;
+	block_net.content_only_param1 = block.content_only_param1;
+	block_net.content_only_param2 = block.content_only_param2;
+	block_net.deSerialize(is_net, SER_FMT_VER_HIGHEST_WRITE, false);
+	UASSERT(!block_net.isDataAllocated());
+	MapNode n = block_net.getNodeNoEx(v3s16(4, 5, 6));
+	UASSERTEQ(content_t, n.getContent(), t_CONTENT_STONE);
+	UASSERTEQ(u8, n.getParam2(), 3);
+}
@@ -33,6 +33,8 @@ class TestNodeDef : public TestBase {
 	void runTests(IGameDef *gamedef);
 
 	void testContentFeaturesSerialization();
+	void testGroupRatings();
+	void testContentFlags();
 };
 
 static TestNodeDef g_test_instance;
@@ -40,6 +42,8 @@ static TestNodeDef g_test_instance;
 void TestNodeDef::runTests(IGameDef *gamedef)
 {
 	TEST(testContentFeaturesSerialization);
+	TEST(testGroupRatings);
+	TEST(testContentFlags);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -64,3 +68,71 @@ void TestNodeDef::testContentFeaturesSerialization()
 	UASSERT(f.walkable == f2.walkable);
 	UASSERT(f.node_box.type == f2.node_box.type);
 }
+
+void TestNodeDef::testGroupRatings()
+{
+	IWritableNodeDefManager *ndef = createNodeDefManager();
+
+	ContentFeatures f;
+	f.name = "default:lava_source";
+	f.groups["hot"] = 3;
+	f.groups["falling_node"] = 1;
+	content_t lava = ndef->set(f.name, f);
+	UASSERT(lava != CONTENT_IGNORE);
+
+	UASSERT(ndef->getGroup(lava, CONTENT_GROUP_HOT) == 3);
+	UASSERT(ndef->getGroup(lava, CONTENT_GROUP_FALLING_NODE) == 1);
+	UASSERT(ndef->getGroup(lava, CONTENT_GROUP_COLD) == 0);
+	UASSERT(ndef->getGroup(MapNode(lava), CONTENT_GROUP_HOT) == 3);
+	UASSERT(ndef->getGroup(CONTENT_AIR, CONTENT_GROUP_HOT) == 0);
+	UASSERT(ndef->getGroup(CONTENT_IGNORE, CONTENT_GROUP_HOT) == 0);
+
+	// Redefinition updates ratings
+	f.groups["hot"] = 1;
+	ndef->set(f.name, f);
+	UASSERT(ndef->getGroup(lava, CONTENT_GROUP_HOT) == 1);
+
+	delete ndef;
+}
+
+void TestNodeDef::testContentFlags()
+{
+	IWritableNodeDefManager *ndef = createNodeDefManager();
+
+	ContentFeatures f;
+	f.name = "default:torch";
+	f.walkable = false;
+	f.light_propagates = true;
+	f.param_type = CPT_LIGHT;
+	f.light_source = 13;
+	content_t torch = ndef->set(f.name, f);
+	UASSERT(torch != CONTENT_IGNORE);
+
+	UASSERT(!ndef->isWalkable(torch));
+	UASSERT(ndef->lightPropagates(torch));
+	UASSERT(!ndef->sunlightPropagates(torch));
+	UASSERT(ndef->hasLightParam(torch));
+	UASSERT(ndef->getLightSource(torch) == 13);
+	UASSERT(ndef->getLiquidType(torch) == LIQUID_NONE);
+
+	// Builtin nodes
+	UASSERT(!ndef->isWalkable(CONTENT_AIR));
+	UASSERT(ndef->sunlightPropagates(CONTENT_AIR));
+	UASSERT(!ndef->lightPropagates(CONTENT_IGNORE));
+	UASSERT(ndef->isWalkable(CONTENT_UNKNOWN));
+
+	// Not registered ids are same as CONTENT_UNKNOWN
+	UASSERT(ndef->getContentFlags(4000) ==
+		ndef->getContentFlags(CONTENT_UNKNOWN));
+
+	// Redefinition updates flags
+	f.walkable = true;
+	f.light_source = 0;
+	f.liquid_type = LIQUID_SOURCE;
+	ndef->set(f.name, f);
+	UASSERT(ndef->isWalkable(torch));
+	UASSERT(ndef->getLightSource(torch) == 0);
+	UASSERT(ndef->getLiquidType(torch) == LIQUID_SOURCE);
+
+	delete ndef;
+}
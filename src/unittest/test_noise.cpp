@@ -19,8 +19,13 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "test.h"
 
+#include <string.h>
 #include "exceptions.h"
+#include "log.h"
 #include "noise.h"
+#include "mg_noise_cache.h"
+#include "noise_simd.h"
+#include "porting.h"
 
 class TestNoise : public TestBase {
 public:
@@ -34,6 +39,9 @@ class TestNoise : public TestBase {
 	void testNoise3dPoint();
 	void testNoise3dBulk();
 	void testNoiseInvalidParams();
+	void testNoiseKernels();
+	void testNoiseKernelsOffsets();
+	void testNoiseMapCache();
 
 	static const float expected_2d_results[10 * 10];
 	static const float expected_3d_results[10 * 10 * 10];
@@ -48,6 +56,9 @@ void TestNoise::runTests(IGameDef *gamedef)
 	TEST(testNoise3dPoint);
 	TEST(testNoise3dBulk);
 	TEST(testNoiseInvalidParams);
+	TEST(testNoiseKernels);
+	TEST(testNoiseKernelsOffsets);
+	TEST(testNoiseMapCache);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -120,6 +131,107 @@ void TestNoise::testNoiseInvalidParams()
 	UASSERT(exception_thrown);
 }
 
+// Maps of every kernel set must be bit-identical with original per point loops
+void TestNoise::testNoiseKernels()
+{
+	const u32 flags[] = {NOISE_FLAG_DEFAULTS, NOISE_FLAG_EASED, 0,
+		NOISE_FLAG_ABSVALUE, NOISE_FLAG_EASED | NOISE_FLAG_ABSVALUE};
+	const u32 size = 21;
+
+	float persistence[size * size * size];
+	for (u32 i = 0; i != size * size * size; i++)
+		persistence[i] = 0.3f + (i % 7) * 0.05f;
+
+	for (u32 f : flags)
+	for (u32 p = 0; p != 2; p++)
+	for (u32 is3d = 0; is3d != 2; is3d++) {
+		NoiseParams np(3, 12, v3f(9, 5, 7), 5934, 4, 0.63, 2.3, f);
+		float *persistence_map = p ? persistence : NULL;
+		u32 sz = is3d ? size : 1;
+
+		Noise reference(&np, 1337, size, size, sz);
+		reference.kernels = NULL;
+		float *expected = is3d ?
+			reference.perlinMap3D(-103.3, 12.5, 4000.7, persistence_map) :
+			reference.perlinMap2D(-103.3, 12.5, persistence_map);
+
+		for (const NoiseKernels *kernels : NoiseKernels::getSupported()) {
+			Noise noise(&np, 1337, size, size, sz);
+			noise.kernels = kernels;
+			float *actual = is3d ?
+				noise.perlinMap3D(-103.3, 12.5, 4000.7, persistence_map) :
+				noise.perlinMap2D(-103.3, 12.5, persistence_map);
+			UASSERT(memcmp(actual, expected, sizeof(float) * size * size * sz) == 0);
+		}
+	}
+}
+
+void TestNoise::testNoiseKernelsOffsets()
+{
+	// Mapgen like params, maps at neighbouring chunk offsets
+	NoiseParams np(0, 12, v3f(100, 50, 70), 5934, 5, 0.63, 2.0, NOISE_FLAG_EASED);
+	const u32 size = 16;
+	Noise reference(&np, 1337, size, size, size);
+	reference.kernels = NULL;
+
+	for (const NoiseKernels *kernels : NoiseKernels::getSupported()) {
+		Noise noise(&np, 1337, size, size, size);
+		noise.kernels = kernels;
+		u32 time_ms = 0;
+		for (u32 i = 0; i != 3; i++) {
+			float *expected = reference.perlinMap3D(i * size, -(s32)size, 0);
+			u32 start = porting::getTimeMs();
+			float *actual = noise.perlinMap3D(i * size, -(s32)size, 0);
+			time_ms += porting::getTimeMs() - start;
+			UASSERT(memcmp(actual, expected, sizeof(float) * size * size * size) == 0);
+		}
+		infostream << "Noise perlinMap3D " << size << "^3 x 3 "
+			<< kernels->name << "=" << time_ms << "ms" << std::endl;
+	}
+}
+
+void TestNoise::testNoiseMapCache()
+{
+	NoiseParams np(20, 40, v3f(50, 50, 50), 9, 5, 0.6, 2.0);
+	Noise noise(&np, 1337, 10, 10);
+	Noise reference(&np, 1337, 10, 10);
+	const size_t bufsize = sizeof(float) * 10 * 10;
+
+	NoiseMapCache cache;
+	cache.setLimit(2);
+
+	reference.perlinMap2D(100, 200);
+	cache.perlinMap2D(&noise, 100, 200);
+	UASSERT(memcmp(noise.result, reference.result, bufsize) == 0);
+	UASSERTEQ(size_t, cache.size(), 1);
+
+	// Hit: result is copied back to noise
+	memset(noise.result, 0, bufsize);
+	cache.perlinMap2D(&noise, 100, 200);
+	UASSERT(memcmp(noise.result, reference.result, bufsize) == 0);
+	UASSERTEQ(size_t, cache.size(), 1);
+
+	// Other persistence map is not a hit
+	float persistence[10 * 10];
+	for (u32 i = 0; i != 10 * 10; i++)
+		persistence[i] = 0.5;
+	reference.perlinMap2D(100, 200, persistence);
+	cache.perlinMap2D(&noise, 100, 200, persistence);
+	UASSERT(memcmp(noise.result, reference.result, bufsize) == 0);
+
+	// Least recently used map is dropped
+	cache.perlinMap2D(&noise, 300, 200);
+	cache.perlinMap2D(&noise, 500, 200);
+	UASSERTEQ(size_t, cache.size(), 2);
+
+	reference.perlinMap2D(300, 200);
+	cache.perlinMap2D(&noise, 300, 200);
+	UASSERT(memcmp(noise.result, reference.result, bufsize) == 0);
+
+	cache.setLimit(0);
+	UASSERTEQ(size_t, cache.size(), 0);
+}
+
 const float TestNoise::expected_2d_results[10 * 10] = {
 	19.11726, 18.49626, 16.48476, 15.02135, 14.75713, 16.26008, 17.54822,
 	18.06860, 18.57016, 18.48407, 18.49649, 17.89160, 15.94162, 14.54901,
@@ -0,0 +1,175 @@
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "test.h"
+
+#include <algorithm>
+#include "fm_objects_grid.h"
+#include "constants.h"
+
+class TestObjectsGrid : public TestBase {
+public:
+	TestObjectsGrid() { TestManager::registerTestModule(this); }
+	const char *getName() { return "TestObjectsGrid"; }
+
+	void runTests(IGameDef *gamedef);
+
+	void testAddRemove();
+	void testMove();
+	void testQueries();
+	void testChanged();
+};
+
+static TestObjectsGrid g_test_instance;
+
+void TestObjectsGrid::runTests(IGameDef *gamedef)
+{
+	TEST(testAddRemove);
+	TEST(testMove);
+	TEST(testQueries);
+	TEST(testChanged);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static bool has_id(const std::vector<u16> &ids, u16 id)
+{
+	return std::find(ids.begin(), ids.end(), id) != ids.end();
+}
+
+void TestObjectsGrid::testAddRemove()
+{
+	ActiveObjectGrid grid;
+	UASSERTEQ(size_t, grid.size(), 0);
+
+	grid.add(1, v3f(0, 0, 0));
+	grid.add(2, v3f(5 * BS, 0, 0));
+	grid.add(3, v3f(-1 * BS, 0, 0));
+	UASSERTEQ(size_t, grid.size(), 3);
+	UASSERTEQ(u32, grid.count(v3POS(0, 0, 0)), 2);
+	UASSERTEQ(u32, grid.count(v3POS(-1, 0, 0)), 1);
+
+	grid.remove(2);
+	grid.remove(2);
+	UASSERTEQ(size_t, grid.size(), 2);
+	UASSERTEQ(u32, grid.count(v3POS(0, 0, 0)), 1);
+
+	grid.clear();
+	UASSERTEQ(size_t, grid.size(), 0);
+	UASSERTEQ(u32, grid.count(v3POS(0, 0, 0)), 0);
+}
+
+void TestObjectsGrid::testMove()
+{
+	ActiveObjectGrid grid;
+	grid.add(1, v3f(0, 0, 0));
+
+	// Inside same block
+	grid.move(1, v3f(10 * BS, 10 * BS, 10 * BS));
+	UASSERTEQ(u32, grid.count(v3POS(0, 0, 0)), 1);
+
+	// To neighbour block
+	grid.move(1, v3f(20 * BS, 0, 0));
+	UASSERTEQ(u32, grid.count(v3POS(0, 0, 0)), 0);
+	UASSERTEQ(u32, grid.count(v3POS(1, 0, 0)), 1);
+
+	// Unknown id is ignored
+	grid.move(7, v3f(0, 0, 0));
+	UASSERTEQ(size_t, grid.size(), 1);
+	UASSERTEQ(u32, grid.count(v3POS(0, 0, 0)), 0);
+
+	// Far away positions are clamped, not wrapped
+	grid.move(1, v3f(1e9, -1e9, 0));
+	UASSERTEQ(size_t, grid.size(), 1);
+	UASSERT(ActiveObjectGrid::getCell(v3f(1e9, 0, 0)).X > 0);
+	UASSERT(ActiveObjectGrid::getCell(v3f(-1e9, 0, 0)).X < 0);
+}
+
+void TestObjectsGrid::testQueries()
+{
+	ActiveObjectGrid grid;
+	grid.add(1, v3f(0, 0, 0));
+	grid.add(2, v3f(40 * BS, 0, 0));
+	grid.add(3, v3f(0, -100 * BS, 0));
+
+	std::vector<u16> ids;
+	grid.getInsideRadius(v3f(0, 0, 0), 5 * BS, ids);
+	UASSERT(has_id(ids, 1));
+	UASSERT(!has_id(ids, 2));
+	UASSERT(!has_id(ids, 3));
+
+	ids.clear();
+	grid.getInsideRadius(v3f(0, 0, 0), 50 * BS, ids);
+	UASSERT(has_id(ids, 1));
+	UASSERT(has_id(ids, 2));
+	UASSERT(!has_id(ids, 3));
+
+	// Huge radius walks all cells
+	ids.clear();
+	grid.getInsideRadius(v3f(0, 0, 0), 1e7, ids);
+	UASSERTEQ(size_t, ids.size(), 3);
+
+	ids.clear();
+	grid.getInsideArea(aabb3f(v3f(-BS, -200 * BS, -BS), v3f(BS, -50 * BS, BS)), ids);
+	UASSERTEQ(size_t, ids.size(), 1);
+	UASSERT(has_id(ids, 3));
+}
+
+void TestObjectsGrid::testChanged()
+{
+	ActiveObjectGrid grid;
+	grid.add(1, v3f(0, 0, 0));
+	grid.add(2, v3f(40 * BS, 0, 0));
+	grid.add(3, v3f(0, -100 * BS, 0));
+
+	// First call: all cells in range
+	std::vector<u16> ids;
+	v3POS center(0, 0, 0);
+	u64 stamp = grid.getChanged(center, 3, NULL, 0, ids);
+	UASSERTEQ(size_t, ids.size(), 2);
+	UASSERT(has_id(ids, 1));
+	UASSERT(has_id(ids, 2));
+
+	// Nothing changed
+	ids.clear();
+	stamp = grid.getChanged(center, 3, &center, stamp, ids);
+	UASSERTEQ(size_t, ids.size(), 0);
+
+	// Moves inside a cell are not changes, moves to other cell are
+	grid.move(2, v3f(41 * BS, 0, 0));
+	grid.move(1, v3f(20 * BS, 0, 0));
+	ids.clear();
+	stamp = grid.getChanged(center, 3, &center, stamp, ids);
+	UASSERTEQ(size_t, ids.size(), 1);
+	UASSERT(has_id(ids, 1));
+
+	// Center moved: only cells which came into range
+	v3POS moved(0, -4, 0);
+	ids.clear();
+	stamp = grid.getChanged(moved, 3, &center, stamp, ids);
+	UASSERTEQ(size_t, ids.size(), 1);
+	UASSERT(has_id(ids, 3));
+
+	// Small range walks cells around center
+	ids.clear();
+	grid.getChanged(v3POS(1, 0, 0), 0, NULL, 0, ids);
+	UASSERTEQ(size_t, ids.size(), 1);
+	UASSERT(has_id(ids, 1));
+
+	UASSERT(ActiveObjectGrid::inRange(v3POS(0, -7, 0), moved, 3));
+	UASSERT(!ActiveObjectGrid::inRange(v3POS(1, 0, 0), moved, 3));
+}
@@ -0,0 +1,163 @@
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "test.h"
+
+#include "pathfinder.h"
+#include "constants.h"
+#include "gamedef.h"
+#include "map.h"
+#include "mapblock.h"
+#include "voxel.h"
+
+class TestPathfinder : public TestBase {
+public:
+	TestPathfinder() { TestManager::registerTestModule(this); }
+	const char *getName() { return "TestPathfinder"; }
+
+	void runTests(IGameDef *gamedef);
+
+	void testGraphFlat();
+	void testGraphWall();
+	void testGraphIgnore();
+	void testGraphCache(IGameDef *gamedef);
+};
+
+static TestPathfinder g_test_instance;
+
+void TestPathfinder::runTests(IGameDef *gamedef)
+{
+	TEST(testGraphFlat);
+	TEST(testGraphWall);
+	TEST(testGraphIgnore);
+	TEST(testGraphCache, gamedef);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static u8 flatFloor(v3s16 p)
+{
+	return p.Y < 0 ? PathBlockGraph::NODE_WALKABLE : 0;
+}
+
+// Floor with wall of height 2 along x = 8
+static u8 wallFloor(v3s16 p)
+{
+	if (p.Y < 0 || (p.X == 8 && p.Y < 2))
+		return PathBlockGraph::NODE_WALKABLE;
+	return 0;
+}
+
+void TestPathfinder::testGraphFlat()
+{
+	PathBlockGraph graph;
+	graph.build(v3s16(0, 0, 0), 1, 3, flatFloor);
+
+	UASSERTEQ(int, graph.region_count, 1);
+	UASSERTEQ(int, graph.getRegion(v3s16(3, 0, 3)), 1);
+	UASSERTEQ(int, graph.getRegion(v3s16(3, 1, 3)), 0);
+	UASSERTEQ(int, graph.getRegion(v3s16(3, -1, 3)), 0);
+	UASSERTEQ(int, graph.getRegion(v3s16(16, 0, 3)), 0);
+
+	// Every node of block side leads to neighbour block
+	UASSERTEQ(size_t, graph.portals.size(), 4 * MAP_BLOCKSIZE);
+	for (size_t i = 0; i < graph.portals.size(); ++i) {
+		const PathBlockGraph::Portal &portal = graph.portals[i];
+		UASSERT(portal.to.Y == 0 && portal.cost == 1);
+		UASSERT(portal.to.X < 0 || portal.to.X >= MAP_BLOCKSIZE ||
+				portal.to.Z < 0 || portal.to.Z >= MAP_BLOCKSIZE);
+	}
+}
+
+void TestPathfinder::testGraphWall()
+{
+	// Wall can not be climbed, top of wall is left by one way drops
+	PathBlockGraph graph;
+	graph.build(v3s16(0, 0, 0), 1, 3, wallFloor);
+
+	UASSERTEQ(int, graph.region_count, 3);
+	u16 west = graph.getRegion(v3s16(0, 0, 0));
+	u16 east = graph.getRegion(v3s16(15, 0, 15));
+	u16 top = graph.getRegion(v3s16(8, 2, 7));
+	UASSERT(west && east && top);
+	UASSERT(west != east && west != top && east != top);
+	UASSERTEQ(int, graph.getRegion(v3s16(8, 0, 0)), 0);
+
+	bool drop_west = false, drop_east = false;
+	for (u32 i = graph.portal_begin[top]; i < graph.portal_begin[top + 1]; ++i) {
+		const PathBlockGraph::Portal &portal = graph.portals[i];
+		if (graph.getRegion(portal.to) == west)
+			drop_west = true;
+		if (graph.getRegion(portal.to) == east)
+			drop_east = true;
+	}
+	UASSERT(drop_west && drop_east);
+	for (u32 i = graph.portal_begin[west]; i < graph.portal_begin[west + 1]; ++i)
+		UASSERT(graph.getRegion(graph.portals[i].to) != top);
+
+	// Wall can be climbed
+	graph.build(v3s16(0, 0, 0), 2, 2, wallFloor);
+	UASSERTEQ(int, graph.region_count, 1);
+}
+
+void TestPathfinder::testGraphIgnore()
+{
+	PathBlockGraph graph;
+	graph.build(v3s16(0, 0, 0), 1, 3,
+			[](v3s16 p) -> u8 { return PathBlockGraph::NODE_IGNORE; });
+	UASSERTEQ(int, graph.region_count, 0);
+	UASSERT(graph.portals.empty());
+
+	// Moves to not loaded neighbours are not portals
+	graph.build(v3s16(0, 0, 0), 1, 3, [](v3s16 p) -> u8 {
+		if (p.X < 0 || p.Z < 0 || p.X >= MAP_BLOCKSIZE || p.Z >= MAP_BLOCKSIZE)
+			return PathBlockGraph::NODE_IGNORE;
+		return flatFloor(p);
+	});
+	UASSERTEQ(int, graph.region_count, 1);
+	UASSERT(graph.portals.empty());
+}
+
+void TestPathfinder::testGraphCache(IGameDef *gamedef)
+{
+	INodeDefManager *ndef = gamedef->getNodeDefManager();
+	Map map(gamedef);
+	v3s16 blockpos(0, 0, 0);
+	MapBlock *block = map.createBlankBlock(blockpos);
+
+	PathGraphCache cache;
+	cache.setLimit(16);
+	auto graph = cache.get(&map, ndef, blockpos, 1, 3);
+	UASSERT(graph);
+	UASSERT(cache.get(&map, ndef, blockpos, 1, 3) == graph);
+
+	// Node placed in the same second
+	MapNode stone(t_CONTENT_STONE);
+	block->setNodeNoCheck(v3s16(3, 0, 3), stone);
+	UASSERT(cache.get(&map, ndef, blockpos, 1, 3) != graph);
+	graph = cache.get(&map, ndef, blockpos, 1, 3);
+	UASSERT(cache.get(&map, ndef, blockpos, 1, 3) == graph);
+
+	// VoxelManip write back (Lua write_to_map)
+	VoxelManipulator v;
+	const v3s16 size(MAP_BLOCKSIZE, MAP_BLOCKSIZE, MAP_BLOCKSIZE);
+	v.addArea(VoxelArea(v3s16(0, 0, 0), size - v3s16(1, 1, 1)));
+	block->copyTo(v);
+	v.setNode(v3s16(4, 0, 4), stone);
+	block->copyFrom(v);
+	UASSERT(cache.get(&map, ndef, blockpos, 1, 3) != graph);
+}
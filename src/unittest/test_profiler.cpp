@@ -29,6 +29,7 @@ class TestProfiler : public TestBase {
 	void runTests(IGameDef *gamedef);
 
 	void testProfilerAverage();
+	void testProfilerHistogram();
 };
 
 static TestProfiler g_test_instance;
@@ -36,6 +37,7 @@ static TestProfiler g_test_instance;
 void TestProfiler::runTests(IGameDef *gamedef)
 {
 	TEST(testProfilerAverage);
+	TEST(testProfilerHistogram);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -70,3 +72,22 @@ void TestProfiler::testProfilerAverage()
 
 	UASSERT(p.getValue("Test2") == 123.57f);
 }
+
+void TestProfiler::testProfilerHistogram()
+{
+	Profiler p;
+
+	p.histogram("Test", 0.5f);
+	p.histogram("Test", 3.f);
+	p.histogram("Test", 4.f);
+	p.histogram("Test", 5.f);
+	p.histogram("Test", 100000.f);
+
+	UASSERT(p.getValue("Test") == 20002.5f);
+	UASSERTEQ(unsigned int, p.getCount("Test"), 5);
+	UASSERTEQ(unsigned int, p.getCount("Test <=00001"), 1);
+	UASSERTEQ(unsigned int, p.getCount("Test <=00004"), 2);
+	UASSERTEQ(unsigned int, p.getCount("Test <=00016"), 1);
+	UASSERTEQ(unsigned int, p.getCount("Test <=00064"), 0);
+	UASSERTEQ(unsigned int, p.getCount("Test >16384"), 1);
+}
@@ -20,7 +20,10 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "test.h"
 
 #include "gamedef.h"
+#include "log.h"
 #include "voxelalgorithms.h"
+#include "noise.h"
+#include "porting.h"
 
 class TestVoxelAlgorithms : public TestBase {
 public:
@@ -31,6 +34,8 @@ class TestVoxelAlgorithms : public TestBase {
 
 	void testPropogateSunlight(INodeDefManager *ndef);
 	void testClearLightAndCollectSources(INodeDefManager *ndef);
+	void testLightPropagator(INodeDefManager *ndef);
+	void testLightPropagatorBenchmark(INodeDefManager *ndef);
 };
 
 static TestVoxelAlgorithms g_test_instance;
@@ -41,6 +46,8 @@ void TestVoxelAlgorithms::runTests(IGameDef *gamedef)
 
 	TEST(testPropogateSunlight, ndef);
 	TEST(testClearLightAndCollectSources, ndef);
+	TEST(testLightPropagator, ndef);
+	TEST(testLightPropagatorBenchmark, ndef);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -202,3 +209,170 @@ void TestVoxelAlgorithms::testClearLightAndCollectSources(INodeDefManager *ndef)
 		UASSERT(unlight_from.size() == 1);
 	}
 }
+
+// Closed box of air with some stone and torches inside
+static void make_light_box(VoxelManipulator &v, s16 size, u32 seed,
+		std::vector<v3s16> &torches)
+{
+	PseudoRandom pr(seed);
+	v.addArea(VoxelArea(v3s16(0,0,0), v3s16(size - 1, size - 1, size - 1)));
+	for (s16 z = 0; z < size; z++)
+	for (s16 y = 0; y < size; y++)
+	for (s16 x = 0; x < size; x++) {
+		bool wall = x == 0 || y == 0 || z == 0
+				|| x == size - 1 || y == size - 1 || z == size - 1;
+		v.setNode(v3s16(x, y, z), MapNode(
+				wall || pr.range(0, 4) == 0 ? t_CONTENT_STONE : CONTENT_AIR));
+	}
+	for (auto & p : torches)
+		v.setNode(p, MapNode(t_CONTENT_TORCH));
+}
+
+static bool same_light(VoxelManipulator &a, VoxelManipulator &b, s16 size,
+		INodeDefManager *ndef)
+{
+	for (s16 z = 0; z < size; z++)
+	for (s16 y = 0; y < size; y++)
+	for (s16 x = 0; x < size; x++) {
+		v3s16 p(x, y, z);
+		MapNode na = a.getNode(p), nb = b.getNode(p);
+		if (na.getLight(LIGHTBANK_DAY, ndef) != nb.getLight(LIGHTBANK_DAY, ndef)
+				|| na.getLight(LIGHTBANK_NIGHT, ndef) != nb.getLight(LIGHTBANK_NIGHT, ndef))
+			return false;
+	}
+	return true;
+}
+
+static void old_spread(VoxelManipulator &v, const std::vector<v3s16> &sources,
+		INodeDefManager *ndef)
+{
+	std::set<v3s16> from(sources.begin(), sources.end());
+	v.spreadLight(LIGHTBANK_DAY, from, ndef);
+	v.spreadLight(LIGHTBANK_NIGHT, from, ndef);
+}
+
+static void old_remove(VoxelManipulator &v, const std::vector<v3s16> &removed,
+		INodeDefManager *ndef)
+{
+	std::map<v3s16, u8> unlight_from;
+	for (auto & p : removed) {
+		unlight_from[p] = v.getNode(p).getLight(LIGHTBANK_DAY, ndef);
+		v.setNode(p, MapNode(CONTENT_AIR));
+	}
+	for (int bank = 0; bank < 2; ++bank) {
+		std::map<v3s16, u8> from = unlight_from;
+		std::set<v3s16> light_sources;
+		v.unspreadLight((LightBank)bank, from, light_sources, ndef);
+		v.spreadLight((LightBank)bank, light_sources, ndef);
+	}
+}
+
+static u32 new_spread(VoxelManipulator &v, s16 size,
+		const std::vector<v3s16> &sources, INodeDefManager *ndef)
+{
+	VoxelArea a(v3s16(0,0,0), v3s16(size - 1, size - 1, size - 1));
+	voxalgo::LightPropagator light(v, a, ndef);
+	for (auto & p : sources)
+		light.addSource(p);
+	return light.run();
+}
+
+static u32 new_remove(VoxelManipulator &v, s16 size,
+		const std::vector<v3s16> &removed, INodeDefManager *ndef)
+{
+	VoxelArea a(v3s16(0,0,0), v3s16(size - 1, size - 1, size - 1));
+	voxalgo::LightPropagator light(v, a, ndef, true);
+	for (auto & p : removed) {
+		MapNode n = v.getNode(p);
+		light.addUnlight(p, n.getLight(LIGHTBANK_DAY, ndef),
+				n.getLight(LIGHTBANK_NIGHT, ndef));
+		v.setNode(p, MapNode(CONTENT_AIR));
+	}
+	return light.run();
+}
+
+void TestVoxelAlgorithms::testLightPropagator(INodeDefManager *ndef)
+{
+	const s16 size = 24;
+	std::vector<v3s16> torches;
+	torches.push_back(v3s16(5, 5, 5));
+	torches.push_back(v3s16(12, 10, 15));
+	torches.push_back(v3s16(13, 10, 15));
+
+	VoxelManipulator v_old, v_new;
+	make_light_box(v_old, size, 7, torches);
+	make_light_box(v_new, size, 7, torches);
+
+	old_spread(v_old, torches, ndef);
+	UASSERT(new_spread(v_new, size, torches, ndef) > 0);
+	UASSERT(same_light(v_old, v_new, size, ndef));
+	UASSERTEQ(int, v_new.getNode(v3s16(5, 5, 5)).getLight(LIGHTBANK_NIGHT, ndef), LIGHT_MAX - 1);
+
+	// Remove one of two near torches and a far one
+	std::vector<v3s16> removed;
+	removed.push_back(torches[0]);
+	removed.push_back(torches[1]);
+	old_remove(v_old, removed, ndef);
+	UASSERT(new_remove(v_new, size, removed, ndef) > 0);
+	UASSERT(same_light(v_old, v_new, size, ndef));
+	UASSERTEQ(int, v_new.getNode(v3s16(5, 5, 5)).getLight(LIGHTBANK_DAY, ndef), 0);
+	UASSERTEQ(int, v_new.getNode(v3s16(12, 10, 15)).getLight(LIGHTBANK_DAY, ndef), LIGHT_MAX - 2);
+
+	// Nodes outside of area are not touched
+	VoxelManipulator v;
+	make_light_box(v, size, 7, torches);
+	VoxelArea a(v3s16(0,0,0), v3s16(size - 1, 8, size - 1));
+	voxalgo::LightPropagator light(v, a, ndef, true);
+	light.addSource(v3s16(5, 5, 5));
+	light.addSource(v3s16(12, 10, 15)); // outside, ignored
+	light.run();
+	UASSERTEQ(int, v.getNode(v3s16(5, 9, 5)).getLight(LIGHTBANK_DAY, ndef), 0);
+	std::vector<v3s16> blocks;
+	light.getChangedBlocks(blocks);
+	UASSERT(!blocks.empty());
+	for (auto & b : blocks)
+		UASSERTEQ(s16, b.Y, 0);
+	const std::vector<bool> &nodes = light.getChangedNodes();
+	u32 changed_nodes = 0;
+	for (s16 z = 0; z < size; z++)
+	for (s16 y = 0; y < size; y++)
+	for (s16 x = 0; x < size; x++) {
+		if (!nodes[v.m_area.index(v3s16(x, y, z))])
+			continue;
+		UASSERT(y <= 8);
+		++changed_nodes;
+	}
+	UASSERT(changed_nodes > 0);
+}
+
+void TestVoxelAlgorithms::testLightPropagatorBenchmark(INodeDefManager *ndef)
+{
+	const s16 size = 64;
+	PseudoRandom pr(13);
+	std::set<v3s16> unique;
+	while (unique.size() < 100)
+		unique.insert(v3s16(pr.range(1, size - 2), pr.range(1, size - 2), pr.range(1, size - 2)));
+	std::vector<v3s16> torches(unique.begin(), unique.end());
+	std::vector<v3s16> removed(torches.begin(), torches.begin() + 50);
+
+	VoxelManipulator v_old, v_new;
+	make_light_box(v_old, size, 3, torches);
+	make_light_box(v_new, size, 3, torches);
+
+	u32 start = porting::getTimeMs();
+	old_spread(v_old, torches, ndef);
+	old_remove(v_old, removed, ndef);
+	u32 old_ms = porting::getTimeMs() - start;
+
+	start = porting::getTimeMs();
+	u32 changed = new_spread(v_new, size, torches, ndef);
+	changed += new_remove(v_new, size, removed, ndef);
+	u32 new_ms = porting::getTimeMs() - start;
+
+	UASSERT(same_light(v_old, v_new, size, ndef));
+
+	infostream << "Light " << size << "^3 nodes, " << torches.size() << " sources, "
+		<< removed.size() << " removed: spreadLight/unspreadLight=" << old_ms
+		<< "ms LightPropagator=" << new_ms << "ms (" << changed << " nodes changed)"
+		<< std::endl;
+}
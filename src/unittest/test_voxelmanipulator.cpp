@@ -34,6 +34,7 @@ class TestVoxelManipulator : public TestBase {
 
 	void testVoxelArea();
 	void testVoxelManipulator(INodeDefManager *nodedef);
+	void testVoxelManipulatorFill();
 };
 
 static TestVoxelManipulator g_test_instance;
@@ -42,6 +43,7 @@ void TestVoxelManipulator::runTests(IGameDef *gamedef)
 {
 	TEST(testVoxelArea);
 	TEST(testVoxelManipulator, gamedef->getNodeDefManager());
+	TEST(testVoxelManipulatorFill);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -106,3 +108,28 @@ void TestVoxelManipulator::testVoxelManipulator(INodeDefManager *nodedef)
 	UASSERT(v.getNode(v3s16(-1,0,-1)).getContent() == t_CONTENT_GRASS);
 	EXCEPTION_CHECK(InvalidPositionException, v.getNode(v3s16(0,1,1)));
 }
+
+
+void TestVoxelManipulator::testVoxelManipulatorFill()
+{
+	VoxelManipulator v;
+	VoxelArea a(v3s16(-2,-2,-2), v3s16(2,2,2));
+	v.addArea(a);
+
+	// Inner 3x2x3 area, like MapBlock::copyTo() of uniform block
+	v.fill(MapNode(t_CONTENT_STONE, 1, 2), v3s16(-1,0,-1), v3s16(3,2,3));
+
+	for (s16 z = -2; z <= 2; z++)
+	for (s16 y = -2; y <= 2; y++)
+	for (s16 x = -2; x <= 2; x++) {
+		v3s16 p(x, y, z);
+		bool inside = x >= -1 && x <= 1 && y >= 0 && y <= 1 && z >= -1 && z <= 1;
+		if (inside) {
+			MapNode n = v.getNode(p);
+			UASSERT(n.getContent() == t_CONTENT_STONE);
+			UASSERT(n.getParam1() == 1 && n.getParam2() == 2);
+		} else {
+			UASSERT(v.getNodeNoExNoEmerge(p).getContent() != t_CONTENT_STONE);
+		}
+	}
+}
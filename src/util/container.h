@@ -81,6 +81,70 @@ class UniqueQueue {
 	std::queue<Value> m_queue;
 };
 
+/*
+FIFO queue in one growing power of two array, no allocation per element.
+Not thread safe.
+*/
+template<typename T>
+class RingQueue {
+public:
+	RingQueue(size_t capacity = 64):
+		m_head(0),
+		m_size(0)
+	{
+		size_t c = 1;
+		while (c < capacity)
+			c <<= 1;
+		m_data.resize(c);
+	}
+
+	void push_back(const T &value)
+	{
+		if (m_size == m_data.size())
+			grow();
+		m_data[(m_head + m_size) & (m_data.size() - 1)] = value;
+		++m_size;
+	}
+
+	T pop_front()
+	{
+		T value = m_data[m_head];
+		m_head = (m_head + 1) & (m_data.size() - 1);
+		--m_size;
+		return value;
+	}
+
+	bool empty() const
+	{
+		return !m_size;
+	}
+
+	size_t size() const
+	{
+		return m_size;
+	}
+
+	void clear()
+	{
+		m_head = 0;
+		m_size = 0;
+	}
+
+private:
+	void grow()
+	{
+		std::vector<T> data(m_data.size() * 2);
+		for (size_t i = 0; i < m_size; ++i)
+			data[i] = m_data[(m_head + i) & (m_data.size() - 1)];
+		m_data.swap(data);
+		m_head = 0;
+	}
+
+	std::vector<T> m_data;
+	size_t m_head;
+	size_t m_size;
+};
+
 template<typename Key, typename Value>
 class MutexedMap
 {
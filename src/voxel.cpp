@@ -26,6 +26,7 @@ along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
 #include "nodedef.h"
 #include "util/timetaker.h"
 #include <string.h>  // memcpy, memset
+#include <algorithm>
 
 /*
 	Debug stuff
@@ -286,6 +287,19 @@ void VoxelManipulator::copyTo(MapNode *dst, const VoxelArea& dst_area,
 	}
 }
 
+void VoxelManipulator::fill(const MapNode &n, v3s16 to_pos, v3s16 size)
+{
+	s32 dest_step = m_area.getExtent().X;
+	for (s16 z = 0; z < size.Z; z++) {
+		s32 i_local = m_area.index(to_pos.X, to_pos.Y, to_pos.Z + z);
+		for (s16 y = 0; y < size.Y; y++) {
+			std::fill(&m_data[i_local], &m_data[i_local] + size.X, n);
+			memset(&m_flags[i_local], 0, size.X);
+			i_local += dest_step;
+		}
+	}
+}
+
 /*
 	Algorithms
 	-----------------------------------------------------
@@ -371,7 +385,7 @@ void VoxelManipulator::unspreadLight(enum LightBank bank, v3s16 p, u8 oldlight,
 			/*
 				And the neighbor is transparent and it has some light
 			*/
-			if(nodemgr->get(n2).light_propagates && light2 != 0)
+			if(nodemgr->lightPropagates(n2.getContent()) && light2 != 0)
 			{
 				/*
 					Set light to 0 and add to queue
@@ -483,7 +497,7 @@ void VoxelManipulator::spreadLight(enum LightBank bank, v3s16 p,
 		*/
 		if(light2 < newlight)
 		{
-			if(nodemgr->get(n2).light_propagates)
+			if(nodemgr->lightPropagates(n2.getContent()))
 			{
 				n2.setLight(bank, newlight, nodemgr);
 				spreadLight(bank, n2pos, nodemgr);
@@ -565,7 +579,7 @@ void VoxelManipulator::spreadLight(enum LightBank bank,
 				*/
 				if(light2 < newlight)
 				{
-					if(nodemgr->get(n2).light_propagates)
+					if(nodemgr->lightPropagates(n2.getContent()))
 					{
 						n2.setLight(bank, newlight, nodemgr);
 						lighted_nodes.insert(n2pos);
@@ -534,6 +534,9 @@ class VoxelManipulator /*: public NodeContainer*/
 	void copyTo(MapNode *dst, const VoxelArea& dst_area,
 			v3s16 dst_pos, v3s16 from_pos, v3s16 size);
 
+	// Set nodes to n and flags to 0, like copyFrom() of uniform area
+	void fill(const MapNode &n, v3s16 to_pos, v3s16 size);
+
 	/*
 		Algorithms
 	*/
@@ -22,6 +22,8 @@ along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "voxelalgorithms.h"
 #include "nodedef.h"
+#include "constants.h"
+#include "util/numeric.h"
 
 namespace voxalgo
 {
@@ -61,7 +63,7 @@ void clearLightAndCollectSources(VoxelManipulator &v, VoxelArea a,
 		n.setLight(bank, 0, ndef);
 
 		// If node sources light, add to list
-		u8 source = ndef->get(n).light_source;
+		u8 source = ndef->getLightSource(n.getContent());
 		if(source != 0)
 			light_sources.insert(p);
 
@@ -117,9 +119,9 @@ SunlightPropagateResult propagateSunlight(VoxelManipulator &v, VoxelArea a,
 			if(incoming_light == 0){
 				// Do nothing
 			} else if(incoming_light == LIGHT_SUN &&
-					ndef->get(n).sunlight_propagates){
+					ndef->sunlightPropagates(n.getContent())){
 				// Do nothing
-			} else if(ndef->get(n).sunlight_propagates == false){
+			} else if(!ndef->sunlightPropagates(n.getContent())){
 				incoming_light = 0;
 			} else {
 				incoming_light = diminish_light(incoming_light);
@@ -156,5 +158,188 @@ SunlightPropagateResult propagateSunlight(VoxelManipulator &v, VoxelArea a,
 	return SunlightPropagateResult(bottom_sunlight_valid);
 }
 
+static const v3s16 light_dirs[6] = {
+	v3s16(0,0,1), // back
+	v3s16(0,1,0), // top
+	v3s16(1,0,0), // right
+	v3s16(0,0,-1), // front
+	v3s16(0,-1,0), // bottom
+	v3s16(-1,0,0), // left
+};
+
+LightPropagator::LightPropagator(VoxelManipulator &v, const VoxelArea &area,
+		INodeDefManager *ndef, bool track_blocks):
+	m_v(v),
+	m_area(area),
+	m_ndef(ndef),
+	m_unlight(1024),
+	m_light(1024),
+	m_changed(0),
+	m_track_blocks(track_blocks)
+{
+	v3s16 em = m_v.m_area.getExtent();
+	for (int d = 0; d < 6; ++d)
+		m_offsets[d] = light_dirs[d].Z * em.X * em.Y + light_dirs[d].Y * em.X + light_dirs[d].X;
+
+	if (m_track_blocks) {
+		m_blocks_min = getContainerPos(m_area.MinEdge, MAP_BLOCKSIZE);
+		m_blocks_extent = getContainerPos(m_area.MaxEdge, MAP_BLOCKSIZE)
+				- m_blocks_min + v3s16(1,1,1);
+		m_changed_blocks.resize(
+				(u32)m_blocks_extent.X * m_blocks_extent.Y * m_blocks_extent.Z, false);
+		m_changed_nodes.resize(m_v.m_area.getVolume(), false);
+	}
+}
+
+void LightPropagator::addUnlight(v3s16 p, u8 oldlight_day, u8 oldlight_night)
+{
+	if (!m_area.contains(p) || (!oldlight_day && !oldlight_night))
+		return;
+	Entry e = {m_v.m_area.index(p), p, oldlight_day, oldlight_night};
+	m_unlight.push_back(e);
+}
+
+void LightPropagator::addSource(v3s16 p)
+{
+	if (!m_area.contains(p))
+		return;
+	Entry e = {m_v.m_area.index(p), p, 0, 0};
+	m_light.push_back(e);
+}
+
+u32 LightPropagator::run()
+{
+	// Unspreading finds all light sources needed to fill the dark
+	while (!m_unlight.empty())
+		unspread(m_unlight.pop_front());
+	while (!m_light.empty())
+		spread(m_light.pop_front());
+	return m_changed;
+}
+
+void LightPropagator::changed(const v3s16 &p, u32 i)
+{
+	++m_changed;
+	if (!m_track_blocks)
+		return;
+	m_changed_nodes[i] = true;
+	v3s16 b = getContainerPos(p, MAP_BLOCKSIZE) - m_blocks_min;
+	m_changed_blocks[(b.Z * m_blocks_extent.Y + b.Y) * m_blocks_extent.X + b.X] = true;
+}
+
+void LightPropagator::getChangedBlocks(std::vector<v3s16> &blocks)
+{
+	u32 i = 0;
+	v3s16 b;
+	for (b.Z = 0; b.Z < m_blocks_extent.Z; ++b.Z)
+	for (b.Y = 0; b.Y < m_blocks_extent.Y; ++b.Y)
+	for (b.X = 0; b.X < m_blocks_extent.X; ++b.X, ++i)
+		if (m_changed_blocks[i])
+			blocks.push_back(m_blocks_min + b);
+}
+
+void LightPropagator::unspread(const Entry &e)
+{
+	for (int d = 0; d < 6; ++d) {
+		v3s16 p2 = e.p + light_dirs[d];
+		if (!m_area.contains(p2))
+			continue;
+		u32 i2 = e.i + m_offsets[d];
+		if (m_v.m_flags[i2] & VOXELFLAG_NO_DATA)
+			continue;
+		MapNode &n2 = m_v.m_data[i2];
+		if (n2.getContent() == CONTENT_IGNORE)
+			continue;
+
+		content_t c2 = n2.getContent();
+		u8 flags2 = m_ndef->getContentFlags(c2);
+		u8 light_source2 = m_ndef->getLightSource(c2);
+		u8 light_day = 0, light_night = 0;
+		if (flags2 & CONTENT_FLAG_LIGHT_PARAM) {
+			light_day = n2.param1 & 0x0f;
+			light_night = (n2.param1 >> 4) & 0x0f;
+		}
+		light_day = MYMAX(light_day, light_source2);
+		light_night = MYMAX(light_night, light_source2);
+
+		// Dimmer neighbor was lit by this node, brighter one is a source
+		u8 clear_day = 0, clear_night = 0;
+		bool source = false;
+		if (e.day) {
+			if (light_day >= e.day)
+				source = true;
+			else if (flags2 & CONTENT_FLAG_LIGHT_PROPAGATES)
+				clear_day = light_day;
+		}
+		if (e.night) {
+			if (light_night >= e.night)
+				source = true;
+			else if (flags2 & CONTENT_FLAG_LIGHT_PROPAGATES)
+				clear_night = light_night;
+		}
+
+		if ((clear_day || clear_night) && (flags2 & CONTENT_FLAG_LIGHT_PARAM)) {
+			if (clear_day)
+				n2.param1 &= 0xf0;
+			if (clear_night)
+				n2.param1 &= 0x0f;
+			changed(p2, i2);
+			Entry e2 = {i2, p2, clear_day, clear_night};
+			m_unlight.push_back(e2);
+			if (light_source2)
+				source = true;
+		}
+
+		if (source) {
+			Entry e2 = {i2, p2, 0, 0};
+			m_light.push_back(e2);
+		}
+	}
+}
+
+void LightPropagator::spread(const Entry &e)
+{
+	const MapNode &n = m_v.m_data[e.i];
+	content_t c = n.getContent();
+	u8 light_source = m_ndef->getLightSource(c);
+	u8 light_day = 0, light_night = 0;
+	if (m_ndef->hasLightParam(c)) {
+		light_day = n.param1 & 0x0f;
+		light_night = (n.param1 >> 4) & 0x0f;
+	}
+	light_day = diminish_light(MYMAX(light_day, light_source));
+	light_night = diminish_light(MYMAX(light_night, light_source));
+	if (!light_day && !light_night)
+		return;
+
+	for (int d = 0; d < 6; ++d) {
+		v3s16 p2 = e.p + light_dirs[d];
+		if (!m_area.contains(p2))
+			continue;
+		u32 i2 = e.i + m_offsets[d];
+		if (m_v.m_flags[i2] & VOXELFLAG_NO_DATA)
+			continue;
+		MapNode &n2 = m_v.m_data[i2];
+		if (n2.getContent() == CONTENT_IGNORE)
+			continue;
+		const u8 needed = CONTENT_FLAG_LIGHT_PROPAGATES | CONTENT_FLAG_LIGHT_PARAM;
+		if ((m_ndef->getContentFlags(n2.getContent()) & needed) != needed)
+			continue;
+
+		u8 param1 = n2.param1;
+		if ((param1 & 0x0f) < light_day)
+			param1 = (param1 & 0xf0) | light_day;
+		if (((param1 >> 4) & 0x0f) < light_night)
+			param1 = (param1 & 0x0f) | (light_night << 4);
+		if (param1 == n2.param1)
+			continue;
+
+		n2.param1 = param1;
+		changed(p2, i2);
+		Entry e2 = {i2, p2, 0, 0};
+		m_light.push_back(e2);
+	}
+}
+
 } // namespace voxalgo
 
@@ -25,8 +25,10 @@ along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "voxel.h"
 #include "mapnode.h"
+#include "util/container.h"
 #include <set>
 #include <map>
+#include <vector>
 
 namespace voxalgo
 {
@@ -55,6 +57,60 @@ SunlightPropagateResult propagateSunlight(VoxelManipulator &v, VoxelArea a,
 		std::set<v3s16> & light_sources,
 		INodeDefManager *ndef);
 
+/*
+	Breadth first light spreading on dense VoxelManipulator data.
+	Day and night banks go in one pass, queues are ring buffers of
+	data indexes. Nodes outside of area, without data or CONTENT_IGNORE
+	are never changed.
+	Light values and decay are same as in VoxelManipulator::spreadLight().
+*/
+class LightPropagator
+{
+public:
+	// area must be inside of v.m_area
+	// track_blocks: remember MapBlocks and nodes with changed light
+	LightPropagator(VoxelManipulator &v, const VoxelArea &area,
+			INodeDefManager *ndef, bool track_blocks = false);
+
+	// Node had this light: remove it from nodes lit by it
+	void addUnlight(v3s16 p, u8 oldlight_day, u8 oldlight_night);
+	// Spread current light of node to neighbors
+	void addSource(v3s16 p);
+
+	// Unspread all queued, then spread sources and nodes found by
+	// unspreading. Returns number of changed nodes
+	u32 run();
+
+	void getChangedBlocks(std::vector<v3s16> &blocks);
+	// Indexed as m_data of v, true for nodes with changed light (track_blocks)
+	const std::vector<bool> &getChangedNodes() const { return m_changed_nodes; }
+
+private:
+	struct Entry {
+		u32 i;
+		v3s16 p;
+		u8 day, night;
+	};
+
+	void unspread(const Entry &e);
+	void spread(const Entry &e);
+	void changed(const v3s16 &p, u32 i);
+
+	VoxelManipulator &m_v;
+	VoxelArea m_area;
+	INodeDefManager *m_ndef;
+	s32 m_offsets[6];
+	RingQueue<Entry> m_unlight;
+	RingQueue<Entry> m_light;
+	u32 m_changed;
+
+	bool m_track_blocks;
+	v3s16 m_blocks_min;
+	v3s16 m_blocks_extent;
+	std::vector<bool> m_changed_blocks;
+	std::vector<bool> m_changed_nodes;
+};
+
 } // namespace voxalgo
 
 #endif